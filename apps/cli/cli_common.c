@@ -94,11 +94,10 @@ init_candidate_db(clicon_handle h, enum candidate_db_type type)
     case CANDIDATE_DB_NONE:
 	break;
     case CANDIDATE_DB_PRIVATE:
+	/* Private candidate is an overlay of running: no copy is made */
 	if (lstat(candidate_db, &sb) < 0){
-	    if (file_cp(running_db, candidate_db) < 0){
-		clicon_err(OE_UNIX, errno, "Error when copying %s to %s", 
-			   running_db, candidate_db);
-		unlink(candidate_db);
+	    if (db_overlay_init(candidate_db, running_db) < 0){
+		db_remove(candidate_db);
 		goto err;
 	    }
 	}
@@ -118,11 +117,8 @@ init_candidate_db(clicon_handle h, enum candidate_db_type type)
 		clicon_proto_copy(s, running_db, candidate_db);
 	    }
 	    else
-		if (file_cp(running_db, candidate_db) < 0){
-		    clicon_err(OE_UNIX, errno, "Error when copying %s to %s", 
-			       running_db, candidate_db);
+		if (db_overlay_init(candidate_db, running_db) < 0)
 		    goto err;
-		}
 	}
 	break;
     case CANDIDATE_DB_CURRENT:
@@ -897,9 +893,118 @@ expand_dbvar_auto(void *h, char *name, cvec *cvec, cg_var *arg,
 
 }
 
+/*
+ * Completion cache of expand_db_variable(). The values of a variable are 
+ * cached per (db, key pattern, variable) as long as the change stamp of the
+ * database, and of its base if it is an overlay, is unchanged, see 
+ * db_stamp(). 
+ * An entry is stored in the hash as one blob: an expand_cache header followed 
+ * by the values as consecutive null-terminated strings.
+ */
+struct expand_cache {
+    char    ec_stamp[DB_STAMPLEN*2];
+    int     ec_nr;      /* Number of values */
+    char    ec_vals[0]; /* Values, null-terminated strings */
+};
+
+static clicon_hash_t *_expand_cache = NULL;
+
+/*! Add value to expand-type list of commands
+ * The list is grown geometrically, *maxnr is the allocated length.
+ */
+static int
+expand_add(char *val, int *nr, int *maxnr, char ***commands)
+{
+    char **tmp;
+
+    if (*nr >= *maxnr){
+	*maxnr = *maxnr ? *maxnr*2 : 16;
+	if ((tmp = realloc(*commands, sizeof(char *) * (*maxnr))) == NULL) {
+	    clicon_err(OE_UNDEF, errno, "realloc: %s", strerror (errno));	
+	    return -1;
+	}
+	*commands = tmp;
+    }
+    (*commands)[(*nr)++] = val;
+    return 0;
+}
+
+/*! Save expanded values of a database variable in completion cache 
+ */
+static int
+expand_cache_set(char *ckey, char *stamp, int nr, char **commands)
+{
+    struct expand_cache *ec;
+    size_t               len;
+    char                *p;
+    int                  i;
+    int                  retval = -1;
+
+    if (_expand_cache == NULL && (_expand_cache = hash_init()) == NULL)
+	return -1;
+    len = sizeof(*ec);
+    for (i=0; i<nr; i++)
+	len += strlen(commands[i]) + 1;
+    if ((ec = malloc(len)) == NULL){
+	clicon_err(OE_UNIX, errno, "malloc: %s", strerror (errno));	
+	return -1;
+    }
+    strcpy(ec->ec_stamp, stamp);
+    ec->ec_nr    = nr;
+    p = ec->ec_vals;
+    for (i=0; i<nr; i++){
+	strcpy(p, commands[i]);
+	p += strlen(p) + 1;
+    }
+    if (hash_add(_expand_cache, ckey, ec, len) == NULL)
+	goto done;
+    retval = 0;
+  done:
+    free(ec);
+    return retval;
+}
+
+/*! Get expanded values of a database variable from completion cache 
+ * @retval  1  Found: values returned in commands
+ * @retval  0  Not found, or database changed
+ * @retval -1  Error
+ */
+static int
+expand_cache_get(char *ckey, char *stamp, int *nr, char ***commands)
+{
+    struct expand_cache *ec;
+    int                  maxnr = 0;
+    int                  i;
+    char                *p;
+    char                *val;
+
+    if (_expand_cache == NULL ||
+	(ec = hash_value(_expand_cache, ckey, NULL)) == NULL)
+	return 0;
+    if (strcmp(ec->ec_stamp, stamp) != 0){
+	hash_del(_expand_cache, ckey);
+	return 0;
+    }
+    p = ec->ec_vals;
+    for (i=0; i<ec->ec_nr; i++){
+	if ((val = strdup(p)) == NULL){
+	    clicon_err(OE_UNIX, errno, "strdup: %s", strerror (errno));	
+	    return -1;
+	}
+	if (expand_add(val, nr, &maxnr, commands) < 0){
+	    free(val);
+	    return -1;
+	}
+	p += strlen(p) + 1;
+    }
+    return 1;
+}
+
 /*! Expand database variable
  * Given a database, a basekey (pattern) and a variable, return an expand-type
  * list of commands as used by cligen 'expand' functionality.
+ * Values are unique and cached per database, pattern and variable until the
+ * database, or the base of an overlay database, changes. 
  * @see expand_dbvar
  */
 int
@@ -911,17 +1016,34 @@ expand_db_variable(clicon_handle h,
 		   char       ***commands)
 {
     char           *key;
-    int             i;
-    int             j;
     int             retval = -1;
-    int             npairs;
-    struct db_pair *pairs;
-    cvec           *cvec;
-    cg_var         *cv = NULL;
-    char          **tmp;
+    int             ret;
+    int             vlen;
+    int             maxnr = 0;
+    int             cache;
+    db_cursor      *dc = NULL;
+    clicon_hash_t  *seen = NULL;
+    struct lvalue  *lv;
+    char            stamp[DB_STAMPLEN*2];
     char           *val = NULL;
     char           *k;
+    char           *lvec;
+    char           *ckey;
 
+    *nr = 0;
+    /* Lookup in completion cache, stamp before reading db */
+    if ((ckey = chunk_sprintf(__FUNCTION__, "%s %s %s", 
+			      dbname, basekey, variable)) == NULL)
+	goto quit;
+    cache = (db_stamp(dbname, stamp) == 0 && stamp[0] != '\0');
+    if (!cache)
+	clicon_err_reset();
+    else{
+	if ((ret = expand_cache_get(ckey, stamp, nr, commands)) < 0)
+	    goto quit;
+	if (ret == 1)
+	    goto ok;
+    }
     /* adhoc to detect regexp keys. If so, dont call db_gen_rxkey */
     if (index(basekey, '^') == NULL){
 	if ((key = db_gen_rxkey(basekey, __FUNCTION__)) == NULL)
@@ -929,46 +1051,42 @@ expand_db_variable(clicon_handle h,
     }
     else
 	key = chunkdup(basekey, strlen(basekey)+1, __FUNCTION__);
-    
-    npairs = db_regexp(dbname, key, __FUNCTION__, &pairs, 1);
-    if (npairs < 0)
+    if ((seen = hash_init()) == NULL)
 	goto quit;
-    *nr = 0;
-    for (i = 0; i < npairs; i++) {
-	k = pairs[i].dp_key;
+    /* Find variable in values as they are read, no extra lookup per key */
+    if ((dc = db_cursor_open(dbname, key, 0)) == NULL)
+	goto quit;
+    while ((ret = db_cursor_next(dc, &k, &lvec, &vlen)) == 1) {
 	if(key_isvector_n(k) || key_iskeycontent(k))
 	    continue;
-	if ((cvec = dbkey2cvec(dbname, pairs[i].dp_key)) == NULL)
+	if ((lv = lvec_find(lvec, vlen, variable)) == NULL)
+	    continue;
+	if ((val = lv2str(lv)) == NULL)
 	    goto quit;
-	cv = NULL;
-	while ((cv = cvec_each(cvec, cv)) != NULL) {
-	    if (strcmp(cv_name_get(cv), variable) != 0)
-		continue;
-	    if ((val = cv2str_dup(cv)) == NULL)
-		goto quit;
-	    /* Check if value already in vector? No duplicates */
-	    for (j=0; j<*nr; j++)
-		if (strcmp(val, (*commands)[j]) == 0)
-		    break;
-	    if (j<*nr){
-		free(val);
-		val = NULL;
-		continue;
-	    }
-	    if ((tmp = realloc(*commands, sizeof(char *) * ((*nr)+1))) == NULL) {
-		clicon_err(OE_UNDEF, errno, "realloc: %s", strerror (errno));	
-		goto quit;
-	    }
-	    *commands = tmp;
-	    (*commands)[*nr] = val;
+	/* No duplicates */
+	if (hash_lookup(seen, val) != NULL){
+	    free(val);
 	    val = NULL;
-	    (*nr)++;
-	    break;
+	    continue;
 	}
-	cvec_free(cvec);
+	if (hash_add(seen, val, NULL, 0) == NULL)
+	    goto quit;
+	if (expand_add(val, nr, &maxnr, commands) < 0)
+	    goto quit;
+	val = NULL;
     }
+    if (ret < 0)
+	goto quit;
+    if (cache && expand_cache_set(ckey, stamp, *nr, *commands) < 0)
+	goto quit;
+  ok:
     retval = 0;
 quit:
+    if (val)
+	free(val);
+    if (seen)
+	hash_free(seen);
+    db_cursor_close(dc);
     unchunk_group(__FUNCTION__);
     return retval;
 }
@@ -1155,62 +1273,105 @@ expand_dir(char *dir, int *nr, char ***commands, mode_t flags, int detail)
 
 
 /*
- * Compare two dbs using XML
+ * Stream writing to memory, used to render configurations for diff.
  */
-static int
-compare_xmls(cxobj *xc1, cxobj *xc2, int astext)
+struct cli_memf {
+    FILE   *mf_f;
+    char   *mf_buf;
+    size_t  mf_len;
+};
+
+static FILE *
+cli_memf_open(struct cli_memf *mf)
 {
-    int fd;
-    FILE *f;
-    char filename1[MAXPATHLEN];
-    char filename2[MAXPATHLEN];
-    char cmd[MAXPATHLEN];
-    int retval = -1;
-    cxobj *xc;
+    memset(mf, 0, sizeof(*mf));
+#ifdef HAVE_OPEN_MEMSTREAM
+    if ((mf->mf_f = open_memstream(&mf->mf_buf, &mf->mf_len)) == NULL)
+	clicon_err(OE_UNIX, errno, "open_memstream: %s", strerror (errno));
+#else
+    if ((mf->mf_f = tmpfile()) == NULL)
+	clicon_err(OE_UNIX, errno, "tmpfile: %s", strerror (errno));
+#endif
+    return mf->mf_f;
+}
+
+/*
+ * Close memory stream and return malloced null-terminated content.
+ */
+static char *
+cli_memf_close(struct cli_memf *mf)
+{
+#ifdef HAVE_OPEN_MEMSTREAM
+    if (fclose(mf->mf_f) != 0){
+	clicon_err(OE_UNIX, errno, "fclose: %s", strerror (errno));
+	if (mf->mf_buf)
+	    free(mf->mf_buf);
+	return NULL;
+    }
+#else
+    long len;
 
-    snprintf(filename1, sizeof(filename1), "/tmp/cliconXXXXXX");
-    snprintf(filename2, sizeof(filename2), "/tmp/cliconXXXXXX");
-    if ((fd = mkstemp(filename1)) < 0){
-	clicon_err(OE_UNDEF, errno, "tmpfile: %s", strerror (errno));
+    if (fflush(mf->mf_f) != 0 || (len = ftell(mf->mf_f)) < 0){
+	clicon_err(OE_UNIX, errno, "tmpfile: %s", strerror (errno));
 	goto done;
     }
-    if ((f = fdopen(fd, "w")) == NULL)
+    rewind(mf->mf_f);
+    if ((mf->mf_buf = malloc(len+1)) == NULL){
+	clicon_err(OE_UNIX, errno, "malloc: %s", strerror (errno));
 	goto done;
-    xc = NULL;
+    }
+    mf->mf_len = fread(mf->mf_buf, 1, len, mf->mf_f);
+    mf->mf_buf[mf->mf_len] = '\0';
+  done:
+    fclose(mf->mf_f);
+#endif
+    return mf->mf_buf;
+}
+
+/*
+ * Print xml tree to a string, as text or xml.
+ */
+static char *
+xml2diffbuf(cxobj *xt, int astext)
+{
+    struct cli_memf mf;
+    cxobj          *xc = NULL;
+
+    if (cli_memf_open(&mf) == NULL)
+	return NULL;
     if (astext)
-	while ((xc = xml_child_each(xc1, xc, -1)) != NULL)
-	    xml2txt(f, xc, 0);
+	while ((xc = xml_child_each(xt, xc, -1)) != NULL)
+	    xml2txt(mf.mf_f, xc, 0);
     else
-	while ((xc = xml_child_each(xc1, xc, -1)) != NULL)
-	    clicon_xml2file(f, xc, 0, 1);
+	while ((xc = xml_child_each(xt, xc, -1)) != NULL)
+	    clicon_xml2file(mf.mf_f, xc, 0, 1);
+    return cli_memf_close(&mf);
+}
 
-    fclose(f);
-    close(fd);
+/*
+ * Compare two dbs using XML
+ * Differences are printed as unified diff with 'context' lines around 
+ * each change.
+ */
+static int
+compare_xmls(cxobj *xc1, cxobj *xc2, int astext, int context)
+{
+    char *buf1 = NULL;
+    char *buf2 = NULL;
+    int   retval = -1;
 
-    if ((fd = mkstemp(filename2)) < 0){
-	clicon_err(OE_UNDEF, errno, "mkstemp: %s", strerror (errno));
+    if ((buf1 = xml2diffbuf(xc1, astext)) == NULL)
 	goto done;
-    }
-    if ((f = fdopen(fd, "w")) == NULL)
+    if ((buf2 = xml2diffbuf(xc2, astext)) == NULL)
 	goto done;
-    xc = NULL;
-    if (astext)
-	while ((xc = xml_child_each(xc2, xc, -1)) != NULL)
-	    xml2txt(f, xc, 0);
-    else
-	while ((xc = xml_child_each(xc2, xc, -1)) != NULL)
-	    clicon_xml2file(f, xc, 0, 1);
-    fclose(f);
-    close(fd);
-
-    snprintf(cmd, sizeof(cmd), "/usr/bin/diff -dU 1 %s %s |  grep -v @@ | sed 1,2d", 		 filename1, filename2);
-    if (system(cmd) < 0)
+    if (clicon_diff_buf(stdout, buf1, buf2, context) < 0)
 	goto done;
-
     retval = 0;
   done:
-    unlink(filename1);
-    unlink(filename2);
+    if (buf1)
+	free(buf1);
+    if (buf2)
+	free(buf2);
     return retval;
 }
 
@@ -1241,7 +1402,7 @@ compare_dbs(clicon_handle h, cvec *vars, cg_var *arg)
     if ((xc2 = db2xml_key(candidate, clicon_dbspec_key(h), NULL, "dbc")) == NULL)
 	goto done;
 
-    if (compare_xmls(xc1, xc2, arg?cv_int32_get(arg):0) < 0) /* astext? */
+    if (compare_xmls(xc1, xc2, arg?cv_int32_get(arg):0, 1) < 0) /* astext? */
 	goto done;
     retval = 0;
   done:
@@ -1262,57 +1423,38 @@ compare_dbs(clicon_handle h, cvec *vars, cg_var *arg)
 int
 cli_show_diff(clicon_handle h, char *db1, char *db2, struct lvmap *lmap)
 {
-    int ret;
-    int  retval = -1;
-    char *cmd;
-    char *tmp1 = NULL;
-    char *tmp2 = NULL;
-    FILE *f1 = NULL;
-    FILE *f2 = NULL;
+    int   ret;
+    int   retval = -1;
+    char *buf1 = NULL;
+    char *buf2 = NULL;
+    struct cli_memf mf;
 
-    /* dump db1 to file */
-    if ((tmp1 = clicon_tmpfile(__FUNCTION__)) == NULL)
-	goto quit;
-    if ((f1 = fopen(tmp1, "w")) == NULL){
-	clicon_err(OE_UNIX, errno, "fopen");
+    /* print db1 */
+    if (cli_memf_open(&mf) == NULL)
 	goto quit;
-    }
-    ret = lvmap_print(f1, db1, lmap, NULL);
-    fclose(f1);
-    if (ret < 0)
+    ret = lvmap_print(mf.mf_f, db1, lmap, NULL);
+    buf1 = cli_memf_close(&mf);
+    if (ret < 0 || buf1 == NULL)
 	goto quit;
 
-    /* dump db2 to file */
-    if ((tmp2 = clicon_tmpfile(__FUNCTION__)) == NULL)
+    /* print db2 */
+    if (cli_memf_open(&mf) == NULL)
 	goto quit;
-    if ((f2 = fopen(tmp2, "w")) == NULL){
-	clicon_err(OE_UNIX, errno, "fopen");
-	goto quit;
-    }
-    ret = lvmap_print(f2, db2, lmap, NULL);
-    fclose(f2);
-    if (ret < 0)
+    ret = lvmap_print(mf.mf_f, db2, lmap, NULL);
+    buf2 = cli_memf_close(&mf);
+    if (ret < 0 || buf2 == NULL)
 	goto quit;
 
     /* diff candidate with snapshot */
-    cmd = chunk_sprintf(__FUNCTION__,
-			"/usr/bin/diff -dU 1 %s %s | grep -v @@ | sed 1,2d", 
-			tmp1, tmp2);
-    if (cmd == NULL) {
-	clicon_err(OE_UNIX, errno, "chunk");
-	goto quit;
-    }
-    if (system(cmd) < 0)
+    if (clicon_diff_buf(stdout, buf1, buf2, 1) < 0)
 	goto quit;
     
     retval = 0;
 quit:
-    
-    if (tmp1)
-	unlink(tmp1);
-    if (tmp2)
-	unlink(tmp2);
-    unchunk_group(__FUNCTION__);
+    if (buf1)
+	free(buf1);
+    if (buf2)
+	free(buf2);
     return retval;
 }
 
@@ -1521,11 +1663,7 @@ load_config_file(clicon_handle h, cvec *vars, cg_var *arg)
     }
     else{
 	if (replace){
-	    if (unlink(dbname) < 0){
-		clicon_err(OE_UNIX, 0, "rm %s %s", filename, strerror(errno));
-		goto done;
-	    }
-	    if (db_init(dbname) < 0) 
+	    if (db_remove(dbname) < 0 || db_init(dbname) < 0)
 		goto done;
 	}
 	if (load_xml_to_db(filename, clicon_dbspec_key(h), dbname) < 0) 
@@ -1536,6 +1674,54 @@ load_config_file(clicon_handle h, cvec *vars, cg_var *arg)
     return ret;
 }
 
+/*! Restore a snapshot saved at commit into candidate database
+ * @param[in] h     CLICON handle
+ * @param[in] vars  Vector of variables
+ * @param[in] arg   A string: "<varname>" 
+ *   <varname> is name of an int32 variable in the cligen command string,
+ *   with the snapshot number. 0 is the most recent.
+ * Snapshots are kept by the config daemon, which must be running.
+ * @code
+ *   # cligen spec
+ *   rollback <nr:int32>, cli_rollback("nr");
+ * @endcode
+ */
+int 
+cli_rollback(clicon_handle h, cvec *vars, cg_var *arg)
+{
+    int         ret = -1;
+    char       *str;
+    char       *dbname;
+    char       *s;
+    cg_var     *cv;
+
+    if (arg == NULL || (str = cv_string_get(arg)) == NULL){
+	clicon_err(OE_PLUGIN, 0, "%s: requires string argument", __FUNCTION__);
+	goto done;
+    }
+    if ((cv = cvec_find_var(vars, str)) == NULL){
+	clicon_err(OE_PLUGIN, 0, "No such var name: %s", str);	
+	goto done;
+    }
+    if ((dbname = clicon_candidate_db(h)) == NULL){
+	clicon_err(OE_FATAL, 0, "candidate db not set");
+	goto done;
+    }
+    if (!cli_usedaemon(h)){
+	clicon_err(OE_PLUGIN, 0, "%s: requires config daemon", __FUNCTION__);
+	goto done;
+    }
+    if ((s = clicon_sock(h)) == NULL){
+	clicon_err(OE_FATAL, 0, "CLICON_SOCK option not set");
+	goto done;
+    }
+    if (clicon_proto_rollback(s, cv_int32_get(cv), dbname) < 0)
+	goto done;
+    ret = 0;
+  done:
+    return ret;
+}
+
 /*
  * save_config_file
  * Copy db to file Argument is database
@@ -1650,11 +1836,7 @@ delete_all(clicon_handle h, cvec *vars, cg_var *arg)
 	clicon_proto_initdb(s, dbname);
     }
     else{
-	if (unlink(dbname) < 0){
-	    clicon_err(OE_FATAL, errno, "unlink(%s)", dbname);
-	    goto done;
-	}
-	if (db_init(dbname) < 0) 
+	if (db_remove(dbname) < 0 || db_init(dbname) < 0)
 	    goto done;
     }
     retval = 0;
@@ -110,6 +110,7 @@ int cli_show_diff(clicon_handle h, char *db, char *db2, struct lvmap *lmap);
 
 int load_config_file(clicon_handle h, cvec *vars, cg_var *arg);
 int save_config_file(clicon_handle h, cvec *vars, cg_var *arg);
+int cli_rollback(clicon_handle h, cvec *vars, cg_var *arg);
 int delete_all(clicon_handle h, cvec *vars, cg_var *arg);
 int discard_changes(clicon_handle h, cvec *vars, cg_var *arg);
 int show_conf_as_xml(clicon_handle h, cvec *vars, cg_var *arg);
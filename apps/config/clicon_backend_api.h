@@ -95,6 +95,7 @@ typedef	int (*subscription_fn_t)(clicon_handle, void *filter, void *arg);
 /* Notification subscription info 
  * @see client_subscription in config_client.h
  */
+struct notify_filter;
 struct handle_subscription{
     struct handle_subscription *hs_next;
     enum format_enum     hs_format; /*  format (enum format_enum) XXX not needed? */
@@ -102,6 +103,8 @@ struct handle_subscription{
     char                *hs_filter; /* filter, if format=xml: xpath, if text: fnmatch */
     subscription_fn_t    hs_fn;     /* Callback when event occurs */
     void                *hs_arg;    /* Callback argument */
+    struct notify_filter *hs_nf;    /* Filter index entry (internal) */
+    struct handle_subscription *hs_fnext; /* Next with same stream and filter */
 };
 
 struct handle_subscription *subscription_add(clicon_handle h, char *stream, 
@@ -84,6 +84,14 @@ client_subscription_add(struct client_entry *ce,
     su->su_stream = strdup(stream);
     su->su_format = format;
     su->su_filter = strdup(filter);
+    su->su_ce     = ce;
+    if (backend_notify_index_add(ce->ce_handle, su) < 0){
+	free(su->su_stream);
+	free(su->su_filter);
+	free(su);
+	su = NULL;
+	goto done;
+    }
     su->su_next   = ce->ce_subscription;
     ce->ce_subscription = su;
   done:
@@ -112,6 +120,7 @@ client_subscription_delete(struct client_entry *ce,
     for (su = *su_prev; su; su = su->su_next){
 	if (su == su0){
 	    *su_prev = su->su_next;
+	    backend_notify_index_del(ce->ce_handle, su);
 	    free(su->su_stream);
 	    if (su->su_filter)
 		free(su->su_filter);
@@ -134,6 +143,233 @@ client_subscription_find(struct client_entry *ce, char *stream)
 
     return su;
 }
+#ifdef MSG_NOSIGNAL
+#define CLIENT_SEND_FLAGS (MSG_DONTWAIT|MSG_NOSIGNAL)
+#else
+#define CLIENT_SEND_FLAGS MSG_DONTWAIT
+#endif
+
+static int client_outq_cb(int s, void *arg);
+
+/*! Free all queued messages of a client
+ */
+static void
+client_outq_free(struct client_entry *ce)
+{
+    struct client_qmsg *qm;
+
+    while ((qm = ce->ce_outq) != NULL){
+	ce->ce_outq = qm->qm_next;
+	free(qm);
+    }
+    ce->ce_outq_last = NULL;
+    ce->ce_outq_nr = 0;
+}
+
+/*! Remove first notification in queue when it is completely sent
+ */
+static void
+client_outq_pop(struct client_entry *ce)
+{
+    struct client_qmsg *qm = ce->ce_outq;
+
+    ce->ce_outq = qm->qm_next;
+    if (ce->ce_outq == NULL)
+	ce->ce_outq_last = NULL;
+    ce->ce_outq_nr--;
+    ce->ce_stat_out++;
+    free(qm);
+}
+
+/*! Write queued messages to client as far as possible without blocking
+ * If the client socket fails, the queue is dropped and the client is removed 
+ * later when it is read.
+ * @retval  0  OK, queue may not be empty
+ * @retval -1  Socket error, queue dropped
+ */
+static int
+client_outq_write(struct client_entry *ce)
+{
+    struct client_qmsg *qm;
+    ssize_t             n;
+
+    while ((qm = ce->ce_outq) != NULL){
+	n = send(ce->ce_s, qm->qm_buf + qm->qm_pos, qm->qm_len - qm->qm_pos, 
+		 CLIENT_SEND_FLAGS);
+	if (n < 0){
+	    if (errno == EINTR)
+		continue;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK)
+		return 0;
+	    clicon_debug(1, "%s: client %d: %s", 
+			 __FUNCTION__, ce->ce_nr, strerror(errno));
+	    client_outq_free(ce);
+	    return -1;
+	}
+	qm->qm_pos += n;
+	if (qm->qm_pos < qm->qm_len)
+	    return 0;
+	client_outq_pop(ce);
+    }
+    return 0;
+}
+
+/*! Event loop callback when client socket is writable: drain queue
+ */
+static int
+client_outq_cb(int   s,
+	       void *arg)
+{
+    struct client_entry *ce = (struct client_entry *)arg;
+
+    client_outq_write(ce);
+    if (ce->ce_outq == NULL)
+	event_unreg_fd(ce->ce_s, client_outq_cb);
+    return 0;
+}
+
+/*! Queue message to a client and write as much as possible without blocking
+ * The message is copied, the rest is sent from the event loop when the 
+ * client socket is writable.
+ */
+static int
+client_outq_add(struct client_entry *ce,
+		struct clicon_msg   *msg)
+{
+    struct client_qmsg *qm;
+    int                 empty;
+
+    if ((qm = malloc(sizeof(*qm) + msg->op_len)) == NULL){
+	clicon_err(OE_UNIX, errno, "malloc");
+	return -1;
+    }
+    qm->qm_next = NULL;
+    qm->qm_len = msg->op_len;
+    qm->qm_pos = 0;
+    memcpy(qm->qm_buf, msg, msg->op_len);
+    empty = (ce->ce_outq == NULL);
+    if (empty)
+	ce->ce_outq = qm;
+    else
+	ce->ce_outq_last->qm_next = qm;
+    ce->ce_outq_last = qm;
+    ce->ce_outq_nr++;
+    if (!empty) /* Already waiting for socket to become writable */
+	return 0;
+    if (client_outq_write(ce) < 0)
+	return 0;
+    if (ce->ce_outq != NULL &&
+	event_reg_fd_write(ce->ce_s, client_outq_cb, ce, "client notify") < 0)
+	return -1;
+    return 0;
+}
+
+/*! Reply to a request of a client, see send_msg_reply()
+ * The reply is queued after the notifications not yet sent to the client, 
+ * and is never dropped. It is sent without blocking.
+ * @param[in]  ce       Client entry
+ * @param[in]  type     Message type, eg CLICON_MSG_OK
+ * @param[in]  data     Message body, or NULL
+ * @param[in]  datalen  Length of data
+ */
+int
+backend_client_reply(struct client_entry *ce, 
+		     uint16_t             type, 
+		     char                *data, 
+		     uint16_t             datalen)
+{
+    struct clicon_msg *reply;
+    int                retval = -1;
+    int                len;
+
+    if (ce->ce_s == 0)
+	return 0;
+    len = sizeof(*reply) + datalen;
+    if ((reply = (struct clicon_msg *)chunk(len, __FUNCTION__)) == NULL)
+	goto done;
+    memset(reply, 0, len);
+    reply->op_type = type;
+    reply->op_len = len;
+    if (datalen > 0)
+	memcpy(reply->op_body, data, datalen);
+    if (client_outq_add(ce, reply) < 0)
+	goto done;
+    retval = 0;
+  done:
+    unchunk_group(__FUNCTION__);
+    return retval;
+}
+
+/*! Reply OK to a request of a client, see send_msg_ok()
+ */
+int
+backend_client_ok(struct client_entry *ce)
+{
+    return backend_client_reply(ce, CLICON_MSG_OK, NULL, 0);
+}
+
+/*! Reply error to a request of a client, see send_msg_err()
+ * As send_msg_err(), the error codes sent are clicon_errno and 
+ * clicon_suberrno.
+ */
+int
+backend_client_err(struct client_entry *ce, 
+		   int                  err, 
+		   int                  suberr, 
+		   char                *format, ...)
+{
+    va_list            args;
+    char              *reason;
+    int                len;
+    int                retval = -1;
+    struct clicon_msg *msg;
+
+    if (ce->ce_s == 0)
+	return 0;
+    va_start(args, format);
+    len = vsnprintf(NULL, 0, format, args) + 1;
+    va_end(args);
+    if ((reason = (char *)chunk(len, __FUNCTION__)) == NULL)
+	return -1;
+    va_start(args, format);
+    vsnprintf(reason, len, format, args);
+    va_end(args);
+    if ((msg = clicon_msg_err_encode(clicon_errno, clicon_suberrno, 
+				     reason, __FUNCTION__)) == NULL)
+	goto done;
+    if (client_outq_add(ce, msg) < 0)
+	goto done;
+    retval = 0;
+  done:
+    unchunk_group(__FUNCTION__);
+    return retval;
+}
+
+/*! Queue notification message to a client without blocking
+ * The message is copied and written as far as the socket accepts, the rest
+ * is sent from the event loop when the client socket is writable. 
+ * If the client already has CLIENT_OUTQ_MAX notifications queued, the message 
+ * is dropped and counted in ce_stat_drop. 
+ * A failing client does not affect notification of other clients.
+ * @param[in]  ce    Client entry
+ * @param[in]  msg   Encoded notification message, eg clicon_msg_notify_encode()
+ * @retval     0     OK, sent, queued or dropped
+ * @retval    -1     Error (memory)
+ * @see backend_notify
+ */
+int
+backend_client_notify(struct client_entry *ce,
+		      struct clicon_msg   *msg)
+{
+    if (ce->ce_s == 0)
+	return 0;
+    if (ce->ce_outq_nr >= CLIENT_OUTQ_MAX){
+	ce->ce_stat_drop++;
+	return 0;
+    }
+    return client_outq_add(ce, msg);
+}
+
 /*! Remove client entry state
  * Close down everything wrt clients (eg sockets, subscriptions)
  * Finally actually remove client struct in handle
@@ -153,11 +389,17 @@ backend_client_rm(clicon_handle h, struct client_entry *ce)
 	if (c == ce){
 	    if (ce->ce_s){
 		event_unreg_fd(ce->ce_s, from_client);
+		if (ce->ce_outq)
+		    event_unreg_fd(ce->ce_s, client_outq_cb);
 		close(ce->ce_s);
 		ce->ce_s = 0;
 	    }
 	    while ((su = ce->ce_subscription) != NULL)
 		client_subscription_delete(ce, su);
+	    if (ce->ce_stat_drop)
+		clicon_log(LOG_NOTICE, "client %d: %d notifications dropped", 
+			   ce->ce_nr, ce->ce_stat_drop);
+	    client_outq_free(ce);
 	    break;
 	}
 	ce_prev = &c->ce_next;
@@ -165,12 +407,43 @@ backend_client_rm(clicon_handle h, struct client_entry *ce)
     return backend_client_delete(h, ce); /* actually purge it */
 }
 
+/*
+ * Refuse a change of database dbname by session pid if dbname is the 
+ * candidate and another session holds a lock on key in it, or any lock if 
+ * key is NULL. The candidate may be given with another path. The error is 
+ * sent to the client.
+ * returns:
+ *   0 if dbname may be changed
+ *   1 if refused or on error, reply sent
+ */
+static int
+client_candidate_locked(clicon_handle h,
+			struct client_entry *ce,
+			int           pid,
+			char         *candidate_db,
+			char         *dbname,
+			char         *key)
+{
+    int locker;
+
+    if (!config_samedb(dbname, candidate_db))
+	return 0;
+    if ((locker = db_islocked(h, key, pid)) == 0)
+	return 0;
+    if (locker < 0)
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
+    else
+	backend_client_err(ce, OE_DB, 0, "lock failed: locked by %d", locker);
+    return 1;
+}
+
 /*
  * Change entry set/delete in database
  */
 static int
 from_client_change(clicon_handle h,
-		   int s, 
+		   struct client_entry *ce,
 		   int pid, 
 		   struct clicon_msg *msg, 
 		   const char *label)
@@ -185,26 +458,28 @@ from_client_change(clicon_handle h,
     char       *str = NULL;
     dbspec_key *dbspec;
     char       *candidate_db;
+    int         id;
 
     dbspec = clicon_dbspec_key(h);
     if (clicon_msg_change_decode(msg, &dbname, &op,
 				&basekey, 
 				&lvec, &lvec_len, 
 				label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     if ((candidate_db = clicon_candidate_db(h)) == NULL){
-	send_msg_err(s, 0, 0, "candidate db not set");
+	backend_client_err(ce, 0, 0, "candidate db not set");
 	goto done;
     }
-    /* candidate is locked by other client */
-    if (strcmp(dbname, candidate_db) == 0 &&
-	db_islocked(h) &&
-	pid != db_islocked(h)){
-	send_msg_err(s, OE_DB, 0,
-		     "lock failed: locked by %d", db_islocked(h));
+    /* key in candidate is locked by other client */
+    if (client_candidate_locked(h, ce, pid, candidate_db,
+				 dbname, basekey) != 0)
+	goto done;
+    /* database is being committed */
+    if ((id = commit_job_busy(dbname)) != 0){
+	backend_client_err(ce, OE_DB, 0, "commit %d in progress", id);
 	goto done;
     }
 
@@ -212,12 +487,12 @@ from_client_change(clicon_handle h,
     if((vr = lvec2cvec (lvec, lvec_len)) == NULL)
 	goto done;
     if (db_lv_op_exec(dbspec, dbname, basekey, op, vr) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
-//	send_msg_err(s, OE_DB, 0, "Executing operation on %s", dbname);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
+//	backend_client_err(ce, OE_DB, 0, "Executing operation on %s", dbname);
 	goto done;
     }
-    if (send_msg_ok(s) < 0)
+    if (backend_client_ok(ce) < 0)
 	goto done;
     retval = 0;
   done:
@@ -233,7 +508,7 @@ from_client_change(clicon_handle h,
  */
 static int
 from_client_save(clicon_handle h,
-		 int s, 
+		 struct client_entry *ce,
 		 struct clicon_msg *msg, 
 		 const char *label)
 {
@@ -248,8 +523,8 @@ from_client_save(clicon_handle h,
 			      &snapshot,
 			      &filename,
 			      label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     if (snapshot){
@@ -257,20 +532,20 @@ from_client_save(clicon_handle h,
 	    clicon_err(OE_PLUGIN, 0, "snapshot set and clicon_archive_dir not defined");
 	    goto done;
 	}
-	if (config_snapshot(clicon_dbspec_key(h), db, archive_dir) < 0){
-	    send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	if (config_snapshot(db, archive_dir) < 0){
+	    backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 
 	    goto done;
 	}
     }
     else
 	if (save_db_to_xml(filename, clicon_dbspec_key(h), db, 0) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	    goto done;
 	}
-    if (send_msg_ok(s) < 0)
+    if (backend_client_ok(ce) < 0)
 	goto done;
     retval = 0;
   done:
@@ -282,7 +557,7 @@ from_client_save(clicon_handle h,
  */
 static int
 from_client_load(clicon_handle h,
-		 int s, 
+		 struct client_entry *ce,
 		 int pid, 
 		 struct clicon_msg *msg,
 		 const char *label)
@@ -293,43 +568,99 @@ from_client_load(clicon_handle h,
     char *dbname = NULL;
     int   replace = 0;
     char *candidate_db;
+    int   id;
 
     if (clicon_msg_load_decode(msg, 
 			       &replace,
 			       &dbname, 
 			       &filename,
 			       label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     if ((candidate_db = clicon_candidate_db(h)) == NULL){
-	send_msg_err(s, 0, 0, "candidate db not set");
+	backend_client_err(ce, 0, 0, "candidate db not set");
 	goto done;
     }
-    /* candidate is locked by other client */
-    if (strcmp(dbname, candidate_db) == 0 &&
-	db_islocked(h) &&
-	pid != db_islocked(h)){
-	send_msg_err(s, OE_DB, 0, "lock failed: locked by %d", db_islocked(h));
+    /* candidate or part of it is locked by other client */
+    if (client_candidate_locked(h, ce, pid, candidate_db,
+				 dbname, NULL) != 0)
+	goto done;
+    /* database is being committed */
+    if ((id = commit_job_busy(dbname)) != 0){
+	backend_client_err(ce, OE_DB, 0, "commit %d in progress", id);
 	goto done;
     }
     if (replace){
-	if (unlink(dbname) < 0){
-	    send_msg_err(s, OE_UNIX, 0, "rm %s %s", filename, strerror(errno));
+	if (db_remove(dbname) < 0 || db_init(dbname) < 0){
+	    backend_client_err(ce, clicon_errno, clicon_suberrno,
+				clicon_err_reason);
 	    goto done;
 	}
-	if (db_init(dbname) < 0) 
-	    goto done;
     }
 
     if (load_xml_to_db(filename, clicon_dbspec_key(h), dbname) < 0) {
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	return -1;
     }
 
-    if (send_msg_ok(s) < 0)
+    if (backend_client_ok(ce) < 0)
+	goto done;
+    retval = 0;
+  done:
+    return retval;
+}
+
+/*
+ * Restore snapshot into database
+ */
+static int
+from_client_rollback(clicon_handle h,
+		     struct client_entry *ce,
+		     int pid, 
+		     struct clicon_msg *msg,
+		     const char *label)
+{
+    int      retval = -1;
+    char    *archive_dir;
+    char    *dbname;
+    uint32_t snapshot;
+    char    *candidate_db;
+    int      id;
+
+    if (clicon_msg_rollback_decode(msg, 
+				   &dbname, 
+				   &snapshot,
+				   label) < 0){
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
+	goto done;
+    }
+    if ((archive_dir = clicon_archive_dir(h)) == NULL){
+	backend_client_err(ce, OE_PLUGIN, 0, "clicon_archive_dir not defined");
+	goto done;
+    }
+    if ((candidate_db = clicon_candidate_db(h)) == NULL){
+	backend_client_err(ce, 0, 0, "candidate db not set");
+	goto done;
+    }
+    /* candidate or part of it is locked by other client */
+    if (client_candidate_locked(h, ce, pid, candidate_db,
+				 dbname, NULL) != 0)
+	goto done;
+    /* database is being committed */
+    if ((id = commit_job_busy(dbname)) != 0){
+	backend_client_err(ce, OE_DB, 0, "commit %d in progress", id);
+	goto done;
+    }
+    if (config_snapshot_get(archive_dir, snapshot, dbname) < 0){
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
+	goto done;
+    }
+    if (backend_client_ok(ce) < 0)
 	goto done;
     retval = 0;
   done:
@@ -341,7 +672,7 @@ from_client_load(clicon_handle h,
  */
 static int
 from_client_initdb(clicon_handle h,
-		   int s, 
+		   struct client_entry *ce,
 		   int pid, 
 		   struct clicon_msg *msg, 
 		   const char *label)
@@ -349,33 +680,36 @@ from_client_initdb(clicon_handle h,
     char  *filename1;
     int    retval = -1;
     char  *candidate_db;
+    int    id;
 
     if (clicon_msg_initdb_decode(msg, 
 			      &filename1,
 			      label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     if ((candidate_db = clicon_candidate_db(h)) == NULL){
-	send_msg_err(s, 0, 0, "candidate db not set");
+	backend_client_err(ce, 0, 0, "candidate db not set");
 	goto done;
     }
-    /* candidate is locked by other client */
-    if (strcmp(filename1, candidate_db) == 0 &&
-	db_islocked(h) &&
-	pid != db_islocked(h)){
-	send_msg_err(s, OE_DB, 0, "lock failed: locked by %d", db_islocked(h));
+    /* candidate or part of it is locked by other client */
+    if (client_candidate_locked(h, ce, pid, candidate_db,
+				 filename1, NULL) != 0)
+	goto done;
+    /* database is being committed */
+    if ((id = commit_job_busy(filename1)) != 0){
+	backend_client_err(ce, OE_DB, 0, "commit %d in progress", id);
 	goto done;
     }
 
     if (db_init(filename1) < 0) 
 	goto done;
     /* Change mode if shared candidate. XXXX full rights for all is no good */
-    if (strcmp(filename1, candidate_db) == 0)
+    if (config_samedb(filename1, candidate_db))
 	chmod(filename1, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
 
-    if (send_msg_ok(s) < 0)
+    if (backend_client_ok(ce) < 0)
 	goto done;
     retval = 0;
   done:
@@ -388,7 +722,7 @@ from_client_initdb(clicon_handle h,
  */
 static int
 from_client_rm(clicon_handle h,
-	       int s, 
+	       struct client_entry *ce,
 	       int pid, 
 	       struct clicon_msg *msg, 
 	       const char *label)
@@ -396,31 +730,35 @@ from_client_rm(clicon_handle h,
     char *filename1;
     int   retval = -1;
     char *candidate_db;
+    int   id;
 
     if (clicon_msg_rm_decode(msg, 
 			      &filename1,
 			      label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     if ((candidate_db = clicon_candidate_db(h)) == NULL){
-	send_msg_err(s, 0, 0, "candidate db not set");
+	backend_client_err(ce, 0, 0, "candidate db not set");
 	goto done;
     }
-    /* candidate is locked by other client */
-    if (strcmp(filename1, candidate_db) == 0 &&
-	db_islocked(h) &&
-	pid != db_islocked(h)){
-	send_msg_err(s, OE_DB, 0, "lock failed: locked by %d", db_islocked(h));
+    /* candidate or part of it is locked by other client */
+    if (client_candidate_locked(h, ce, pid, candidate_db,
+				 filename1, NULL) != 0)
+	goto done;
+    /* database is being committed */
+    if ((id = commit_job_busy(filename1)) != 0){
+	backend_client_err(ce, OE_DB, 0, "commit %d in progress", id);
 	goto done;
     }
 
-    if (unlink(filename1) < 0){
-	send_msg_err(s, OE_UNIX, 0, "rm %s %s", filename1, strerror(errno));
+    if (db_remove(filename1) < 0){
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
-    if (send_msg_ok(s) < 0)
+    if (backend_client_ok(ce) < 0)
 	goto done;
     retval = 0;
   done:
@@ -432,7 +770,7 @@ from_client_rm(clicon_handle h,
  */
 static int
 from_client_copy(clicon_handle h,
-		 int s, 
+		 struct client_entry *ce,
 		 int pid, 
 		 struct clicon_msg *msg, 
 		 const char *label)
@@ -441,36 +779,40 @@ from_client_copy(clicon_handle h,
     char *filename2;
     int   retval = -1;
     char *candidate_db;
+    int   id;
 
     if (clicon_msg_copy_decode(msg, 
 			      &filename1,
 			      &filename2,
 			      label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     if ((candidate_db = clicon_candidate_db(h)) == NULL){
-	send_msg_err(s, 0, 0, "candidate db not set");
+	backend_client_err(ce, 0, 0, "candidate db not set");
 	goto done;
     }
 
-    /* candidate is locked by other client */
-    if (strcmp(filename2, candidate_db) == 0 &&
-	db_islocked(h) &&
-	pid != db_islocked(h)){
-	send_msg_err(s, OE_DB, 0, "lock failed: locked by %d", db_islocked(h));
+    /* candidate or part of it is locked by other client */
+    if (client_candidate_locked(h, ce, pid, candidate_db,
+				 filename2, NULL) != 0)
+	goto done;
+    /* target database is being committed */
+    if ((id = commit_job_busy(filename2)) != 0){
+	backend_client_err(ce, OE_DB, 0, "commit %d in progress", id);
 	goto done;
     }
 
-    if (file_cp(filename1, filename2) < 0){
-	send_msg_err(s, OE_UNIX, errno, "copy %s to %s", filename1, filename2);
+    if (db_copy(filename1, filename2) < 0){
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     /* Change mode if shared candidate. XXXX full rights for all is no good */
-    if (strcmp(filename2, candidate_db) == 0)
+    if (config_samedb(filename2, candidate_db))
 	chmod(filename2, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
-    if (send_msg_ok(s) < 0)
+    if (backend_client_ok(ce) < 0)
 	goto done;
     retval = 0;
   done:
@@ -478,47 +820,48 @@ from_client_copy(clicon_handle h,
 }
 
 /*
- * Lock db
+ * Lock db, or a subtree of db given by a key (cf netconf partial-lock)
  */
 static int
 from_client_lock(clicon_handle h,
-		 int s, 
+		 struct client_entry *ce,
 		 int pid, 
 		 struct clicon_msg *msg, 
 		 const char *label)
 {
     char *db;
+    char *key;
     int   retval = -1;
     char *candidate_db;
-
+    int   locker;
 
     if (clicon_msg_lock_decode(msg, 
-			      &db,
-			      label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+			       &db,
+			       &key,
+			       label) < 0){
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     if ((candidate_db = clicon_candidate_db(h)) == NULL){
-	send_msg_err(s, 0, 0, "candidate db not set");
+	backend_client_err(ce, 0, 0, "candidate db not set");
 	goto done;
     }
     if (strcmp(db, candidate_db)){
-	send_msg_err(s, OE_DB, 0, "can not lock %s, only %s", 
-		     db, candidate_db);
+	backend_client_err(ce, OE_DB, 0, "can not lock %s, only %s", 
+			    db, candidate_db);
 	goto done;
     }
-    if (db_islocked(h)){
-	if (pid == db_islocked(h))
-	    ;
-	else{
-	    send_msg_err(s, OE_DB, 0, "lock failed: locked by %d", db_islocked(h));
-	    goto done;
-	}
+    if ((locker = db_lock(h, key, pid)) < 0){
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
+	goto done;
     }
-    else
-	db_lock(h, pid);
-    if (send_msg_ok(s) < 0)
+    if (locker){
+	backend_client_err(ce, OE_DB, 0, "lock failed: locked by %d", locker);
+	goto done;
+    }
+    if (backend_client_ok(ce) < 0)
 	goto done;
     retval = 0;
   done:
@@ -526,46 +869,49 @@ from_client_lock(clicon_handle h,
 }
 
 /*
- * unlock db
+ * unlock db, or a subtree of db
  */
 static int
 from_client_unlock(clicon_handle h,
-		   int s, 
+		   struct client_entry *ce,
 		   int pid, 
 		   struct clicon_msg *msg, 
 		   const char *label)
 {
     char *db;
+    char *key;
     int   retval = -1;
     char *candidate_db;
-
+    int   locker;
 
     if (clicon_msg_unlock_decode(msg, 
-			      &db,
-			      label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+				 &db,
+				 &key,
+				 label) < 0){
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     if ((candidate_db = clicon_candidate_db(h)) == NULL){
-	send_msg_err(s, 0, 0, "candidate db not set");
+	backend_client_err(ce, 0, 0, "candidate db not set");
 	goto done;
     }
 
     if (strcmp(db, candidate_db)){
-	send_msg_err(s, OE_DB, 0, "can not unlock %s, only %s", 
-		     db, clicon_candidate_db(h));
+	backend_client_err(ce, OE_DB, 0, "can not unlock %s, only %s", 
+			    db, clicon_candidate_db(h));
 	goto done;
     }
-    if (db_islocked(h)){
-	if (pid == db_islocked(h))
-	    db_unlock(h);
-	else{
-	    send_msg_err(s, OE_DB, 0, "unlock failed: locked by %d", db_islocked(h));
-	    goto done;
-	}
+    if ((locker = db_unlock(h, key, pid)) < 0){
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
+	goto done;
     }
-    if (send_msg_ok(s) < 0)
+    if (locker){
+	backend_client_err(ce, OE_DB, 0, "unlock failed: locked by %d", locker);
+	goto done;
+    }
+    if (backend_client_ok(ce) < 0)
 	goto done;
     retval = 0;
   done:
@@ -578,24 +924,27 @@ from_client_unlock(clicon_handle h,
  */
 static int
 from_client_kill(clicon_handle h,
-		 int s, 
+		 struct client_entry *ce,
 		 struct clicon_msg *msg, 
 		 const char *label)
 {
     uint32_t pid; /* other pid */
     int retval = -1;
-    struct client_entry *ce;
+    struct client_entry *kce;
 
     if (clicon_msg_kill_decode(msg, 
 			      &pid,
 			      label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     /* may or may not be in active client list, probably not */
-    if ((ce = ce_find_bypid(backend_client_list(h), pid)) != NULL)
-	backend_client_rm(h, ce);
+    if ((kce = ce_find_bypid(backend_client_list(h), pid)) != NULL){
+	if (kce == ce) /* Killed itself: no one to reply to */
+	    ce = NULL;
+	backend_client_rm(h, kce);
+    }
     if (kill (pid, 0) != 0 && errno == ESRCH) /* Nothing there */
 	;
     else{
@@ -607,14 +956,14 @@ from_client_kill(clicon_handle h,
     }
     if (1 || (kill (pid, 0) != 0 && errno == ESRCH)){ /* Nothing there */
 	/* clear from locks */
-	if (db_islocked(h) == pid)
-	    db_unlock(h);
+	db_unlock_all(h, pid);
     }
     else{ /* failed to kill client */
-	send_msg_err(s, OE_DB, 0, "failed to kill %d", pid);
+	if (ce)
+	    backend_client_err(ce, OE_DB, 0, "failed to kill %d", pid);
 	goto done;
     }
-    if (send_msg_ok(s) < 0)
+    if (ce && backend_client_ok(ce) < 0)
 	goto done;
     retval = 0;
   done:
@@ -627,7 +976,7 @@ from_client_kill(clicon_handle h,
  */
 static int
 from_client_debug(clicon_handle h,
-		 int s, 
+		 struct client_entry *ce,
 		 struct clicon_msg *msg, 
 		 const char *label)
 {
@@ -637,13 +986,13 @@ from_client_debug(clicon_handle h,
     if (clicon_msg_debug_decode(msg, 
 				&level,
 				label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
     clicon_debug_init(level, NULL); /* 0: dont debug, 1:debug */
 
-    if (send_msg_ok(s) < 0)
+    if (backend_client_ok(ce) < 0)
 	goto done;
     retval = 0;
   done:
@@ -655,7 +1004,7 @@ from_client_debug(clicon_handle h,
  */
 static int
 from_client_call(clicon_handle h,
-		 int s, 
+		 struct client_entry *ce,
 		 struct clicon_msg *msg, 
 		 const char *label)
 {
@@ -665,8 +1014,8 @@ from_client_call(clicon_handle h,
     struct clicon_msg_call_req *req;
 
     if (clicon_msg_call_decode(msg, &req, label) < 0) {
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	goto done;
     }
 #ifdef notyet
@@ -675,12 +1024,12 @@ from_client_call(clicon_handle h,
     else
 #endif
 	if (plugin_downcall(h, req, &reply_data_len, &reply_data) < 0)  {
-	    send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	    backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
 	    goto done;
 	}
     
-    retval = send_msg_reply(s,CLICON_MSG_OK, (char *)reply_data, reply_data_len);
+    retval = backend_client_reply(ce, CLICON_MSG_OK, (char *)reply_data, reply_data_len);
     free(reply_data);
 
  done:
@@ -710,14 +1059,14 @@ from_client_subscription(clicon_handle h,
 				       &format,
 				       &filter,
 				       label) < 0){
-	send_msg_err(ce->ce_s, clicon_errno, clicon_suberrno,
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
 		     clicon_err_reason);
 	goto done;
     }
 
     if (status){
 	if ((su = client_subscription_add(ce, stream, format, filter)) == NULL){
-	    send_msg_err(ce->ce_s, clicon_errno, clicon_suberrno,
+	    backend_client_err(ce, clicon_errno, clicon_suberrno,
 			 clicon_err_reason);
 	    goto done;
 	}
@@ -728,7 +1077,7 @@ from_client_subscription(clicon_handle h,
     }
     /* Avoid recursion when sending logs */
     old = clicon_log_register_callback(NULL, NULL);
-    if (send_msg_ok(ce->ce_s) < 0)
+    if (backend_client_ok(ce) < 0)
 	goto done;
     clicon_log_register_callback(old, h); /* XXX: old h */
     retval = 0;
@@ -757,56 +1106,60 @@ from_client(int s, void* arg)
     }
     switch (msg->op_type){
     case CLICON_MSG_COMMIT:
-	if (from_client_commit(h, ce->ce_s, msg, __FUNCTION__) < 0)
+	if (from_client_commit(h, ce, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_VALIDATE:
-	if (from_client_validate(h, ce->ce_s, msg, __FUNCTION__) < 0)
+	if (from_client_validate(h, ce, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_CHANGE:
-	if (from_client_change(h, ce->ce_s, ce->ce_pid, msg, 
+	if (from_client_change(h, ce, ce->ce_pid, msg, 
 			    (char *)__FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_SAVE:
-	if (from_client_save(h, ce->ce_s, msg, __FUNCTION__) < 0)
+	if (from_client_save(h, ce, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_LOAD:
-	if (from_client_load(h, ce->ce_s, ce->ce_pid, msg, __FUNCTION__) < 0)
+	if (from_client_load(h, ce, ce->ce_pid, msg, __FUNCTION__) < 0)
+	    goto done;
+	break;
+    case CLICON_MSG_ROLLBACK:
+	if (from_client_rollback(h, ce, ce->ce_pid, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_RM:
-	if (from_client_rm(h, ce->ce_s, ce->ce_pid, msg, __FUNCTION__) < 0)
+	if (from_client_rm(h, ce, ce->ce_pid, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_INITDB:
-	if (from_client_initdb(h, ce->ce_s, ce->ce_pid, msg, __FUNCTION__) < 0)
+	if (from_client_initdb(h, ce, ce->ce_pid, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_COPY:
-	if (from_client_copy(h, ce->ce_s, ce->ce_pid, msg, __FUNCTION__) < 0)
+	if (from_client_copy(h, ce, ce->ce_pid, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_LOCK:
-	if (from_client_lock(h, ce->ce_s, ce->ce_pid, msg, __FUNCTION__) < 0)
+	if (from_client_lock(h, ce, ce->ce_pid, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_UNLOCK:
-	if (from_client_unlock(h, ce->ce_s, ce->ce_pid, msg, __FUNCTION__) < 0)
+	if (from_client_unlock(h, ce, ce->ce_pid, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_KILL:
-	if (from_client_kill(h, ce->ce_s, msg, __FUNCTION__) < 0)
+	if (from_client_kill(h, ce, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_DEBUG:
-	if (from_client_debug(h, ce->ce_s, msg, __FUNCTION__) < 0)
+	if (from_client_debug(h, ce, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_CALL:
-	if (from_client_call(h, ce->ce_s, msg, __FUNCTION__) < 0)
+	if (from_client_call(h, ce, msg, __FUNCTION__) < 0)
 	    goto done;
 	break;
     case CLICON_MSG_SUBSCRIPTION:
@@ -814,7 +1167,7 @@ from_client(int s, void* arg)
 	    goto done;
 	break;
     default:
-	send_msg_err(s, OE_PROTO, 0, "Unexpected message: %d", msg->op_type);
+	backend_client_err(ce, OE_PROTO, 0, "Unexpected message: %d", msg->op_type);
 	goto done;
     }
 //    retval = 0;
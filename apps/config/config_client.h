@@ -39,17 +39,37 @@ struct client_entry{
     int                    ce_uid;   /* User id of calling process */
     clicon_handle          ce_handle; /* clicon config handle (all clients have same?) */
     struct client_subscription   *ce_subscription; /* notification subscriptions */
+    struct client_qmsg    *ce_outq;   /* Queued messages not yet sent */
+    struct client_qmsg    *ce_outq_last; /* Last queued message */
+    int                    ce_outq_nr;/* Nr of queued messages */
+    int                    ce_stat_drop;/* Nr of notifications dropped */
+};
+
+/* Max number of notifications queued to a client that does not read them.
+   Further notifications are dropped until the queue is drained */
+#define CLIENT_OUTQ_MAX 1024
+
+/* Queued notification or reply message to a client, qm_pos is bytes already sent */
+struct client_qmsg{
+    struct client_qmsg  *qm_next;
+    size_t               qm_len;
+    size_t               qm_pos;
+    char                 qm_buf[0];
 };
 
 /* Notification subscription info 
  * @see subscription in config_handle.c
  */
+struct notify_filter;
 struct client_subscription{
     struct client_subscription *su_next;
     int                  su_s; /* stream socket */
     enum format_enum     su_format; /* format of notification stream */
     char                *su_stream;
     char                *su_filter;
+    struct client_entry *su_ce;     /* Client of this subscription */
+    struct notify_filter *su_nf;    /* Filter index entry, see backend_notify() */
+    struct client_subscription *su_fnext; /* Next with same stream and filter */
 };
 
 /*
@@ -57,6 +77,16 @@ struct client_subscription{
  */ 
 int backend_client_rm(clicon_handle h, struct client_entry *ce);
 
+int backend_client_notify(struct client_entry *ce, struct clicon_msg *msg);
+
+int backend_client_reply(struct client_entry *ce, uint16_t type, 
+			 char *data, uint16_t datalen);
+
+int backend_client_ok(struct client_entry *ce);
+
+int backend_client_err(struct client_entry *ce, int err, int suberr, 
+		       char *format, ...);
+
 int from_client(int fd, void *arg);
 
 #endif  /* _CONFIG_CLIENT_H_ */
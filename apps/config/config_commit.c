@@ -57,6 +57,7 @@
 #include "config_dbdiff.h"
 #include "config_dbdep.h"
 #include "config_handle.h"
+#include "config_client.h"
 #include "config_commit.h"
 
 /*! A wrapper function for invoking the plugin dependency set/del call
@@ -340,17 +341,13 @@ validate_db(clicon_handle h, int nvec, dbdep_dd_t *ddvec,
 }
 
 /*
- * candidate_commit
- * Do a diff between candidate and running, and then call plugins to
- * commit the changes.
- * The code reverts changes if the commit fails. But if the revert
- * fails, we just ignore the errors and proceed. Maybe we should
- * do something more drastic?
- * Arguments:
- * running:   The current database. The state of the router corresponds
- *            to these values. Also called db1.
- * candidate: The candidate database. We are aiming to put the router in this
- *            state.   Also called db2.
+ * Commit job
+ * A commit is run as a job: diff, validation and the begin/complete hooks are
+ * made when the job is started, while the plugin commit callbacks are made
+ * one at a time from the event loop, see commit_job_step(). This way the 
+ * backend continues to serve other clients (lock, subscriptions, etc) during
+ * a long commit, and progress is reported on the CLICON_COMMIT_STREAM 
+ * notification stream. Only one commit job runs at a time.
 
 		       (_dp) [op, callback] (dpe_)
 		       +---------------+    +---------------+
@@ -370,22 +367,222 @@ validate_db(clicon_handle h, int nvec, dbdep_dd_t *ddvec,
 
 */
 
+/*! Check that candidate was created from the current running
+ * A candidate overlay of running is not merged with commits made since it
+ * was created, see db_overlay_current().
+ */
+static int
+candidate_current(char *candidate, char *running)
+{
+    int ret;
+
+    if ((ret = db_overlay_current(candidate)) < 0)
+	return -1;
+    if (ret == 0){
+	clicon_err(OE_DB, 0, "%s has changed since %s was created, "
+		   "discard changes and try again", running, candidate);
+	return -1;
+    }
+    return 0;
+}
+
+/* Chunk group of the diff of the running commit job */
+#define COMMIT_JOB_LABEL "commit_job"
+
+/* One plugin commit callback of a commit job: entry in ddvec and operation */
+struct commit_action{
+    int                  ca_index;      /* Index in cj_ddvec */
+    commit_op            ca_op;         /* Commit operation */
+};
+
+struct commit_job{
+    clicon_handle        cj_h;
+    int                  cj_id;         /* Commit id, used in notifications */
+    struct client_entry *cj_ce;         /* Client to reply to, or NULL */
+    int                  cj_ce_nr;      /* Client number, if cj_ce is gone */
+    char                *cj_candidate;  /* Database we commit from (db2) */
+    char                *cj_running;    /* Database we commit to (db1) */
+    uint32_t             cj_snapshot;   /* Make snapshot when done */
+    uint32_t             cj_startup;    /* Save startup config when done */
+    char               **cj_changes;    /* Keys changed in running */
+    int                  cj_nchanges;   /* Length of cj_changes */
+    char                *cj_from;       /* Stamp of running before commit */
+    char                 cj_to[DB_STAMPLEN]; /* Stamp of running after */
+    struct dbdiff        cj_df;         /* Differences running/candidate */
+    dbdep_dd_t          *cj_ddvec;      /* Commit processing of cj_df */
+    int                  cj_nvec;       /* Length of cj_ddvec */
+    struct commit_action *cj_actions;   /* Commit callbacks in order */
+    int                  cj_nactions;   /* Length of cj_actions */
+    int                  cj_next;       /* Next action to commit (or undo) */
+    int                  cj_failed;     /* Undo actions cj_next-1 .. 0 */
+    int                  cj_status;     /* 0 if committed, -1 if failed */
+    void                *cj_firsterr;   /* First error, see clicon_err_save */
+};
+
+/* The running commit job, if any */
+static struct commit_job *_commit_job = NULL;
+
+/* Commit id of latest job */
+static int _commit_id = 0;
+
+/*! Return id of running commit job if it uses database db (or any if db is NULL)
+ * Change, load, rollback, initdb, rm and copy requests for the candidate or
+ * running database of the job are refused while it runs.
+ * @param[in]  db   Database name, or NULL
+ * @retval     0    No commit job uses db
+ * @retval    >0    Commit id of job
+ */
 int
-candidate_commit(clicon_handle h, char *candidate, char *running)
+commit_job_busy(char *db)
 {
-    struct dbdiff      df = {0, };
-    dbdep_t           *dp;
-    struct dbdiff_ent *dfe;
-    dbdep_dd_t        *ddvec = NULL;
-    dbdep_dd_t        *dd;
-    int                nvec;
-    int                retval = -1;
-    int                i, j;
-    int                failed = 0;
+    struct commit_job *job = _commit_job;
+
+    if (job == NULL)
+	return 0;
+    if (db == NULL ||
+	config_samedb(db, job->cj_candidate) ||
+	config_samedb(db, job->cj_running))
+	return job->cj_id;
+    return 0;
+}
+
+static void
+commit_job_free(struct commit_job *job)
+{
+    int i;
+
+    if (job->cj_ddvec)
+	dbdep_commitvec_free(job->cj_ddvec, job->cj_nvec);
+    db_diff_free(&job->cj_df);
+    unchunk_group(COMMIT_JOB_LABEL);
+    if (job->cj_actions)
+	free(job->cj_actions);
+    if (job->cj_changes){
+	for (i=0; i<job->cj_nchanges; i++)
+	    free(job->cj_changes[i]);
+	free(job->cj_changes);
+    }
+    if (job->cj_from)
+	free(job->cj_from);
+    if (job->cj_candidate)
+	free(job->cj_candidate);
+    if (job->cj_running)
+	free(job->cj_running);
+    if (_commit_job == job)
+	_commit_job = NULL;
+    free(job);
+}
+
+/*! Add a commit callback action to a commit job
+ */
+static int
+commit_job_action_add(struct commit_job *job, int i, commit_op op)
+{
+    struct commit_action *ca;
+
+    ca = &job->cj_actions[job->cj_nactions++];
+    ca->ca_index = i;
+    ca->ca_op = op;
+    return 0;
+}
+
+/*! Make list of commit callbacks in the order they are called
+ * commit_order 0: all keys in priority order.
+ * commit_order 1: deleted keys in reverse prio order, then changed and added
+ *                 keys in prio order.
+ * commit_order 2: as 1, but a changed key is first deleted and then added
+ *                 (original mode where CHANGE=DEL/ADD)
+ */
+static int
+commit_job_actions(struct commit_job *job)
+{
+    int         order = clicon_commit_order(job->cj_h);
+    int         i;
+    dbdep_dd_t *dd;
+    commit_op   op;
+
+    /* At most two actions per key (commit_order 2) */
+    if ((job->cj_actions = calloc(2*job->cj_nvec+1, 
+				  sizeof(struct commit_action))) == NULL){
+	clicon_err(OE_UNIX, errno, "calloc");
+	return -1;
+    }
+    if (order == 0){
+	for (i=0; i < job->cj_nvec; i++){
+	    dd = &job->cj_ddvec[i];
+	    if ((dd->dd_dep->dp_type & TRANS_CB_COMMIT) == 0)
+		continue;
+	    commit_job_action_add(job, i, dbdiff2commit_op(dd->dd_dbdiff->dfe_op));
+	}
+	return 0;
+    }
+    /* For all keys that are not in candidate but in running, delete key
+       in reverse prio order */
+    for (i = job->cj_nvec-1; i >= 0; i--){
+	dd = &job->cj_ddvec[i];
+	if ((dd->dd_dep->dp_type & TRANS_CB_COMMIT) == 0)
+	    continue;
+	op = dbdiff2commit_op(dd->dd_dbdiff->dfe_op);
+	if (order == 2 && op == CO_CHANGE)
+	    op = CO_DELETE;
+	if (op == CO_DELETE)
+	    commit_job_action_add(job, i, op);
+    }
+    /* For all added or changed keys */
+    for (i=0; i < job->cj_nvec; i++){
+	dd = &job->cj_ddvec[i];
+	if ((dd->dd_dep->dp_type & TRANS_CB_COMMIT) == 0)
+	    continue;
+	op = dbdiff2commit_op(dd->dd_dbdiff->dfe_op);
+	if (op != CO_CHANGE && op != CO_ADD)
+	    continue;
+	if (order == 2 && op == CO_CHANGE)
+	    op = CO_ADD;
+	commit_job_action_add(job, i, op);
+    }
+    return 0;
+}
+
+/*! Start a commit job
+ * Do a diff between candidate and running, validate the candidate and
+ * compute the commit callbacks to be made. Call commit_job_step() until
+ * it returns 1 to make the callbacks and commit.
+ * @param[in]  h         Clicon handle
+ * @param[in]  candidate The candidate database. We are aiming to put the router
+ *                       in this state. Also called db2.
+ * @param[in]  running   The current database. The state of the router 
+ *                       corresponds to these values. Also called db1.
+ * @param[out] jobp      Commit job. Free with commit_job_end()
+ * @retval     0         OK, job started
+ * @retval    -1         Error, or validation failed. Plugin abort hooks called.
+ */
+static int
+commit_job_start(clicon_handle       h, 
+		 char               *candidate, 
+		 char               *running,
+		 struct commit_job **jobp)
+{
+    struct commit_job *job = NULL;
     struct stat        sb;
-    void              *firsterr = NULL;
-    commit_op          op;
+    int                retval = -1;
 
+    if (_commit_job != NULL){
+	clicon_err(OE_DB, 0, "commit %d in progress", _commit_job->cj_id);
+	return -1;
+    }
+    if ((job = malloc(sizeof(*job))) == NULL){
+	clicon_err(OE_UNIX, errno, "malloc");
+	goto done;
+    }
+    memset(job, 0, sizeof(*job));
+    _commit_job = job;
+    job->cj_h = h;
+    job->cj_id = ++_commit_id;
+    if ((job->cj_candidate = strdup(candidate)) == NULL ||
+	(job->cj_running = strdup(running)) == NULL){
+	clicon_err(OE_UNIX, errno, "strdup");
+	goto done;
+    }
     /* Sanity checks that databases exists. */
     if (stat(running, &sb) < 0){
 	clicon_err(OE_DB, errno, "%s", running);
@@ -395,20 +592,20 @@ candidate_commit(clicon_handle h, char *candidate, char *running)
 	clicon_err(OE_DB, errno, "%s", candidate);
 	goto done;
     }
-    memset(&df, 0, sizeof(df));
-
+    if (candidate_current(candidate, running) < 0)
+	goto done;
     /* Find the differences between the two databases and store it in df vector. */
     if (db_diff(running, candidate,
-		__FUNCTION__,
+		COMMIT_JOB_LABEL,
 		clicon_dbspec_key(h),
-		&df
+		&job->cj_df
 		) < 0)
 	goto done;
     /* 1. Get commit processing to dbdiff vector: one entry per key that changed.
        changes are registered as if they exist in the 1st(candidate) or
        2nd(running) dbs.
     */
-    if (dbdep_commitvec(h, &df, &nvec, &ddvec) < 0)
+    if (dbdep_commitvec(h, &job->cj_df, &job->cj_nvec, &job->cj_ddvec) < 0)
 	goto done;
 
     /* 2. Call plugin pre-commit hooks */
@@ -416,267 +613,195 @@ candidate_commit(clicon_handle h, char *candidate, char *running)
 	goto done;
 
     /* call generic cv_validate() on all new or changed keys. */
-    if (generic_validate(h, candidate, &df) < 0)
+    if (generic_validate(h, candidate, &job->cj_df) < 0)
 	goto done;
 
     /* user-defined callbacks */
-    if (validate_db(h, nvec, ddvec, running, candidate) < 0)
+    if (validate_db(h, job->cj_nvec, job->cj_ddvec, running, candidate) < 0)
 	goto done;
 
     /* Call plugin post-commit hooks */
     if (plugin_complete_hooks(h, candidate) < 0)
 	goto done;
 
-    if (clicon_commit_order(h) == 0){
-	for (i=0; i < nvec; i++){ /* revert in opposite order */
-	    dd = &ddvec[i];
-	    dp = dd->dd_dep;     /* op, callback, arg */
-	    if ((dp->dp_type & TRANS_CB_COMMIT) == 0)
-		continue;
-	    dfe = dd->dd_dbdiff; /* key1/key2/op */
-	    op = dbdiff2commit_op(dfe->dfe_op);
-	    if (plugin_commit_callback(h,
-				       op,                      /* oper */
-				       running,                 /* db1 */
-				       candidate,               /* db2 */
-				       dd->dd_mkey1,            /* key1 */
-				       dd->dd_mkey2,            /* key2 */
-				       dd->dd_dbdiff->dfe_vec1, /* vec1 */
-				       dd->dd_dbdiff->dfe_vec2, /* vec2 */
-				       dp                       /* callback */
-				       ) < 0){
-		firsterr = clicon_err_save(); /* save this error */
-		failed++;
-		break;
-	    }
-	}
-	if (!failed)
-	    if (file_cp(candidate, running) < 0){  /* Commit here in case cp fails */
-		clicon_err(OE_UNIX, errno, "file_cp");
-		failed++;
-	    }
-	/* Failed operation, start error handling: rollback in opposite order */
-	if (failed){
-	    for (j=i-1; j>=0; j--){ /* revert in opposite order */
-		dd = &ddvec[j];
-		dp = dd->dd_dep;     /* op, callback, arg */
-		if ((dp->dp_type & TRANS_CB_COMMIT) == 0)
-		    continue;
-		dfe = dd->dd_dbdiff; /* key1/key2/op */
-		op = dbdiff2commit_op(dfe->dfe_op);
-		switch (op){ /* reverse operation */
-		case CO_ADD:
-		    op = CO_DELETE;
-		    break;
-		case CO_DELETE:
-		    op = CO_ADD;
-		    break;
-		default:
-		    break;
-		}
-		if (plugin_commit_callback(h,
-					   op,                  /* oper */
-					   candidate,               /* db1 */
-					   running,                 /* db2 */
-					   dd->dd_mkey2,            /* key1 */
-					   dd->dd_mkey1,            /* key2 */
-					   dd->dd_dbdiff->dfe_vec2, /* vec1 */
-					   dd->dd_dbdiff->dfe_vec1, /* vec2 */
-					   dp                       /* callback */
-					   ) < 0){
-		    /* ignore errors or signal major setback ? */
-		    clicon_log(LOG_NOTICE, "Error in rollback, trying to continue");
-		    continue; 
-		}
-	    }
-	    goto done;
-	} /* error handling */
-    }
-    else { /* commit_order == 1 or 2 */
-	/* Now follows commit rules in order.
-	 * 4. For all keys that are not in candidate but in running, delete key
-	 * in reverse prio order
-	 */
-	for (i = nvec-1; i >= 0; i--){
-	    dd = &ddvec[i];
-	    dp = dd->dd_dep;     /* op, callback, arg */
-	    if ((dp->dp_type & TRANS_CB_COMMIT) == 0)
-		continue;
-	    dfe = dd->dd_dbdiff; /* key1/key2/op */
-	    op = dbdiff2commit_op(dfe->dfe_op);
-	    /* original mode 2 where CHANGE=DEL/ADD */
-	    if (clicon_commit_order(h) == 2 && op == CO_CHANGE)
-		op = CO_DELETE;
-	    if (op != CO_DELETE)
-		continue;
+    if (commit_job_actions(job) < 0)
+	goto done;
+    clicon_debug(1, "%s: commit %d %s: %d callbacks", __FUNCTION__, 
+		 job->cj_id, candidate, job->cj_nactions);
+    *jobp = job;
+    retval = 0;
+ done:
+    if (retval < 0){
+	/* Call plugin fail-commit hooks */
+	plugin_abort_hooks(h, candidate);
+	if (job)
+	    commit_job_free(job);
+    }
+    return retval;
+}
+
+/*! Report commit job progress on the commit notification stream
+ */
+static int
+commit_job_notify(struct commit_job *job, 
+		  char              *state, 
+		  commit_op          op, 
+		  char              *key)
+{
+    char txt[256];
+
+    snprintf(txt, sizeof(txt), "commit %d %s %d/%d %s %s", 
+	     job->cj_id, state, job->cj_next, job->cj_nactions,
+	     commitop2txt(op), key?key:"");
+    return backend_notify(job->cj_h, CLICON_COMMIT_STREAM, LOG_INFO, txt);
+}
+
+/*! Make one step of a commit job
+ * Either make the next plugin commit callback, or if a callback failed,
+ * revert the previous one (in opposite order). When all callbacks are made,
+ * candidate is copied to running and the plugin end hooks are called. 
+ * The code reverts changes if the commit fails. But if the revert
+ * fails, we just ignore the errors and proceed. Maybe we should
+ * do something more drastic?
+ * @param[in]  job   Commit job
+ * @retval     0     More steps to do
+ * @retval     1     Done, cj_status is 0 if committed, -1 if failed. 
+ */
+static int
+commit_job_step(struct commit_job *job)
+{
+    clicon_handle         h = job->cj_h;
+    struct commit_action *ca;
+    dbdep_dd_t           *dd;
+    commit_op             op;
+
+    if (!job->cj_failed){
+	if (job->cj_next < job->cj_nactions){
+	    ca = &job->cj_actions[job->cj_next];
+	    dd = &job->cj_ddvec[ca->ca_index];
 	    if (plugin_commit_callback(h,
-				       op,               /* oper */
-				       running,                 /* db1 */
-				       candidate,               /* db2 */
+				       ca->ca_op,               /* oper */
+				       job->cj_running,         /* db1 */
+				       job->cj_candidate,       /* db2 */
 				       dd->dd_mkey1,            /* key1 */
 				       dd->dd_mkey2,            /* key2 */
 				       dd->dd_dbdiff->dfe_vec1, /* vec1 */
 				       dd->dd_dbdiff->dfe_vec2, /* vec2 */
-				       dp                       /* callback */
+				       dd->dd_dep               /* callback */
 				       ) < 0){
-		firsterr = clicon_err_save(); /* save this error */
-		break;
+		job->cj_firsterr = clicon_err_save(); /* save this error */
+		job->cj_failed++;
+		return 0;
 	    }
+	    job->cj_next++;
+	    commit_job_notify(job, "commit", ca->ca_op, 
+			      ca->ca_op==CO_DELETE?dd->dd_mkey1:dd->dd_mkey2);
+	    return 0;
 	}
-	/* 5. Failed deletion, add the key value back to running */
-	if (i >= 0){ /* failed */
-	    for (j=i+1; j<nvec; j++){ /* revert in opposite order */
-		dd = &ddvec[j];
-		dp = dd->dd_dep;     /* op, callback, arg */
-		if ((dp->dp_type & TRANS_CB_COMMIT) == 0)
-		    continue;
-		dfe = dd->dd_dbdiff; /* key1/key2/op */
-		op = dbdiff2commit_op(dfe->dfe_op);
-		/* original mode 2 where CHANGE=DEL/ADD */
-		if (clicon_commit_order(h) == 2 && op == CO_CHANGE)
-		    op = CO_DELETE;
-		if (op != CO_DELETE)
-		    continue;
-		if (plugin_commit_callback(h,
-					   op,                  /* oper */
-					   candidate,               /* db1 */
-					   running,                 /* db2 */
-					   dd->dd_mkey2,            /* key1 */
-					   dd->dd_mkey1,            /* key2 */
-					   dd->dd_dbdiff->dfe_vec2, /* vec1 */
-					   dd->dd_dbdiff->dfe_vec1, /* vec2 */
-					   dp                       /* callback */
-					   ) < 0){
-		    /* ignore errors or signal major setback ? */
-		    clicon_log(LOG_NOTICE, "Error in rollback, trying to continue");
-		    continue; 
-		}
-	    }
-	    goto done;
+	/* Keys changed in running for the snapshot, if candidate is an
+	   overlay. Otherwise all of running is compared */
+	if (job->cj_snapshot &&
+	    db_overlay_changes(job->cj_candidate, &job->cj_changes, 
+			       &job->cj_nchanges, &job->cj_from) < 0)
+	    clicon_err_reset();
+	/* Commit here in case cp fails */
+	if (db_copy(job->cj_candidate, job->cj_running) < 0){
+	    job->cj_firsterr = clicon_err_save(); 
+	    job->cj_failed++;
+	    return 0;
 	}
-	/* 
-	 * 6. For all added or changed keys
-	 */
-	for (i=0; i < nvec; i++){
-	    dd = &ddvec[i];
-	    dp = dd->dd_dep;     /* op, callback, arg */
-	    if ((dp->dp_type & TRANS_CB_COMMIT) == 0)
-		continue;
-	    dfe = dd->dd_dbdiff; /* key1/key2/op */
-	    op = dbdiff2commit_op(dfe->dfe_op);
-	    if (op != CO_CHANGE && op != CO_ADD)
-		continue;
-	    /* original mode 2 where CHANGE=DEL/ADD */
-	    if (clicon_commit_order(h) == 2 && op == CO_CHANGE)
-		op = CO_ADD;
-	    if (plugin_commit_callback(h,
-				       op,                  /* oper */
-				       running,                 /* db1 */
-				       candidate,               /* db2 */
-				       dd->dd_mkey1,            /* key1 */
-				       dd->dd_mkey2,            /* key2 */
-				       dd->dd_dbdiff->dfe_vec1, /* vec1 */
-				       dd->dd_dbdiff->dfe_vec2, /* vec2 */
-				       dp                       /* callback */
-				       ) < 0){
-		firsterr = clicon_err_save(); /* save this error */
-		failed++;
-		break;
-	    }
+	if (job->cj_from &&
+	    db_engine_get()->de_stamp(job->cj_running, job->cj_to) < 0){
+	    clicon_err_reset();
+	    free(job->cj_from);
+	    job->cj_from = NULL;
 	}
-	if (!failed) /* Commit here in case cp fails */
-	    if (file_cp(candidate, running) < 0){
-		clicon_err(OE_UNIX, errno, "file_cp(candidate; running)");
-		failed++;
-	    }
-	/* 10. Failed setting keys in running, first remove the keys set */
-	if (failed){ /* failed */
-	    for (j=i-1; j>=0; j--){ /* revert in opposite order */
-		dd = &ddvec[j];
-		dp = dd->dd_dep;     /* op, callback, arg */
-		if ((dp->dp_type & TRANS_CB_COMMIT) == 0)
-		    continue;
-		dfe = dd->dd_dbdiff; /* key1/key2/op */
-		op = dbdiff2commit_op(dfe->dfe_op);
-		if (op != CO_CHANGE && op != CO_ADD)
-		    continue;
-		/* original mode 2 where CHANGE=DEL/ADD */
-		if (clicon_commit_order(h) == 2 && op == CO_CHANGE)
-		    op = CO_ADD;
-		if (op == CO_ADD) /* reverse op */
-		    op = CO_DELETE;
-		if (plugin_commit_callback(h,
-					   op,               /* oper */
-					   candidate,               /* db1 */
-					   running,                 /* db2 */
-					   dd->dd_mkey2,            /* key1 */
-					   dd->dd_mkey1,            /* key2 */
-					   dd->dd_dbdiff->dfe_vec2, /* vec1 */
-					   dd->dd_dbdiff->dfe_vec1, /* vec2 */
-					   dp                       /* callback */
-					   ) < 0){
-		    /* ignore errors or signal major setback ? */
-		    clicon_log(LOG_NOTICE, "Error in rollback, trying to continue");
-		    continue; 
-		}
-	    }
-	    for (j=0; j < nvec; j++){ /* revert in opposite order */
-		dd = &ddvec[j];
-		dp = dd->dd_dep;     /* op, callback, arg */
-		if ((dp->dp_type & TRANS_CB_COMMIT) == 0)
-		    continue;
-		dfe = dd->dd_dbdiff; /* key1/key2/op */
-		op = dbdiff2commit_op(dfe->dfe_op);
-		/* original mode 2 where CHANGE=DEL/ADD */
-		if (clicon_commit_order(h) == 2 && op == CO_CHANGE)
-		    op = CO_DELETE;
-		if (op != CO_DELETE)
-		    continue;
-		op = CO_ADD;
-		if (plugin_commit_callback(h,
-					   op,                  /* oper */
-					   candidate,               /* db1 */
-					   running,                 /* db2 */
-					   dd->dd_mkey2,            /* key1 */
-					   dd->dd_mkey1,            /* key2 */
-					   dd->dd_dbdiff->dfe_vec2, /* vec1 */
-					   dd->dd_dbdiff->dfe_vec1, /* vec2 */
-					   dp                       /* callback */
-					   ) < 0){
-		    /* ignore errors or signal major setback ? */
-		    clicon_log(LOG_NOTICE, "Error in rollback, trying to continue");
-		    continue; 
-		}
-	    }
-	    goto done;
+	/* Copy running back to candidate in case end functions triggered
+	   updates in running */
+	if (db_copy(job->cj_running, job->cj_candidate) < 0){
+	    /* ignore errors or signal major setback ? */
+	    clicon_log(LOG_NOTICE, "Error in rollback, trying to continue");
+	    job->cj_status = -1;
+	    plugin_abort_hooks(h, job->cj_candidate);
+	    return 1;
 	}
-    } /* commit_order */
-  
-    /* Copy running back to candidate in case end functions triggered
-       updates in running */
-    if (file_cp(running, candidate) < 0){
-	/* ignore errors or signal major setback ? */
-	clicon_err(OE_UNIX, errno, "file_cp(running, candidate)");
-	clicon_log(LOG_NOTICE, "Error in rollback, trying to continue");
-	goto done;
-    } 
-    
 	/* Call plugin post-commit hooks */
-    plugin_end_hooks(h, candidate);
-    
-    retval = 0;
- done:
-    if (retval < 0) /* Call plugin fail-commit hooks */
-	plugin_abort_hooks(h, candidate);
-    if (ddvec)
-	dbdep_commitvec_free(ddvec, nvec);
-    db_diff_free(&df);
-    unchunk_group(__FUNCTION__);
+	plugin_end_hooks(h, job->cj_candidate);
+	job->cj_status = 0;
+	return 1;
+    }
+    /* Failed operation, error handling: rollback in opposite order */
+    if (job->cj_next > 0){
+	ca = &job->cj_actions[--job->cj_next];
+	dd = &job->cj_ddvec[ca->ca_index];
+	switch ((op = ca->ca_op)){ /* reverse operation */
+	case CO_ADD:
+	    op = CO_DELETE;
+	    break;
+	case CO_DELETE:
+	    op = CO_ADD;
+	    break;
+	default:
+	    break;
+	}
+	if (plugin_commit_callback(h,
+				   op,                      /* oper */
+				   job->cj_candidate,       /* db1 */
+				   job->cj_running,         /* db2 */
+				   dd->dd_mkey2,            /* key1 */
+				   dd->dd_mkey1,            /* key2 */
+				   dd->dd_dbdiff->dfe_vec2, /* vec1 */
+				   dd->dd_dbdiff->dfe_vec1, /* vec2 */
+				   dd->dd_dep               /* callback */
+				   ) < 0)
+	    /* ignore errors or signal major setback ? */
+	    clicon_log(LOG_NOTICE, "Error in rollback, trying to continue");
+	commit_job_notify(job, "rollback", op, 
+			  op==CO_DELETE?dd->dd_mkey2:dd->dd_mkey1);
+	return 0;
+    }
+    /* Call plugin fail-commit hooks */
+    plugin_abort_hooks(h, job->cj_candidate);
+    job->cj_status = -1;
+    return 1;
+}
+
+/*! End a commit job that is done and free it
+ * @retval  0   Committed
+ * @retval -1   Commit failed, error is the first error of the commit
+ */
+static int
+commit_job_end(struct commit_job *job)
+{
+    int   retval = job->cj_status;
+    void *firsterr = job->cj_firsterr;
+
+    commit_job_free(job);
     if (firsterr)
 	clicon_err_restore(firsterr);
     return retval;
 }
 
+/*! Do a diff between candidate and running, and then call plugins to commit
+ * the changes. 
+ * Synchronous version, runs a commit job to completion. Used when the backend
+ * starts. Clients commit asynchronously, see from_client_commit().
+ * @param[in]  h         Clicon handle
+ * @param[in]  candidate The candidate database. Also called db2.
+ * @param[in]  running   The current database. Also called db1.
+ */
+int
+candidate_commit(clicon_handle h, char *candidate, char *running)
+{
+    struct commit_job *job;
+
+    if (commit_job_start(h, candidate, running, &job) < 0)
+	return -1;
+    while (commit_job_step(job) == 0)
+	;
+    return commit_job_end(job);
+}
+
  int
  candidate_validate(clicon_handle h, char *candidate, char *running)
  {
@@ -696,6 +821,8 @@ candidate_commit(clicon_handle h, char *candidate, char *running)
 	 clicon_err(OE_DB, errno, "%s", candidate);
 	 goto done;
      }
+     if (candidate_current(candidate, running) < 0)
+	 goto done;
      memset(&df, 0, sizeof(df));
 
      /* Find the differences between the two databases and store it in df vector. */
@@ -742,70 +869,137 @@ candidate_commit(clicon_handle h, char *candidate, char *running)
  }
 
 
+/*! Save snapshot and startup config after a client commit job succeeded
+ */
+static int
+commit_job_save(struct commit_job *job)
+{
+    clicon_handle h = job->cj_h;
+    char         *archive_dir;
+    char         *startup_config;
+
+    if (job->cj_snapshot){
+	if ((archive_dir = clicon_archive_dir(h)) == NULL){
+	    clicon_err(OE_PLUGIN, 0, "snapshot set and clicon_archive_dir not defined");
+	    return -1;
+	}
+	if (config_snapshot_changes(job->cj_running, archive_dir, 
+				    job->cj_changes, job->cj_nchanges,
+				    job->cj_from, job->cj_to) < 0)
+	    return -1;
+    }
+    if (job->cj_startup){
+	if ((startup_config = clicon_startup_config(h)) == NULL){
+	    clicon_err(OE_PLUGIN, 0, "startup set but startup_config not defined");
+	    return -1;
+	}
+	/* Same content as snapshot #0 */
+	if (save_db_to_xml(startup_config, clicon_dbspec_key(h), 
+			   job->cj_running, 0) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*! Event loop callback making one step of a client commit job at a time
+ * When the job is done, the client is replied (if it is still connected) and
+ * the result is notified on the commit stream.
+ * XXX: If commit succeeds and snapshot/startup fails, we have strange state:
+ *   the commit has succeeded but an error message is returned.
+ */
+static int
+commit_job_cb(int   fd, 
+	      void *arg)
+{
+    struct commit_job   *job = (struct commit_job *)arg;
+    clicon_handle        h = job->cj_h;
+    struct client_entry *ce;
+    struct client_entry *ce0 = job->cj_ce;
+    int                  ce_nr = job->cj_ce_nr;
+    int                  id = job->cj_id;
+    struct timeval       t;
+    char                 txt[256];
+    int                  status;
+
+    if (commit_job_step(job) == 0){ /* Continue in next turn of event loop */
+	gettimeofday(&t, NULL);
+	return event_reg_timeout(t, commit_job_cb, job, "commit job");
+    }
+    if (job->cj_status == 0 && commit_job_save(job) < 0)
+	job->cj_status = -1;
+    if ((status = commit_job_end(job)) < 0){
+	clicon_debug(1, "Commit %d failed", id);
+	snprintf(txt, sizeof(txt), "commit %d failed: %s", id, clicon_err_reason);
+    }
+    else{
+	clicon_debug(1, "Commit %d", id);
+	snprintf(txt, sizeof(txt), "commit %d ok", id);
+    }
+    /* Reply client if it has not disconnected during the commit */
+    for (ce = backend_client_list(h); ce; ce = ce->ce_next)
+	if (ce == ce0 && ce->ce_nr == ce_nr)
+	    break;
+    if (ce != NULL){
+	if (status < 0)
+	    /* XXX: more elaborate errstring? */
+	    backend_client_err(ce, clicon_errno, clicon_suberrno, 
+			 "%s", clicon_err_reason);
+	else
+	    backend_client_ok(ce);
+    }
+    backend_notify(h, CLICON_COMMIT_STREAM, LOG_INFO, txt);
+    return 0;
+}
+
 /*
  * from_client_commit
  * Handle an incoming commit message from a client.
- * XXX: If commit succeeds and snapshot/startup fails, we have strange state:
- *   the commit has succeeded but an error message is returned.
+ * Validation is made directly, if it fails an error is replied. Otherwise the
+ * commit continues as a job in the event loop, and the client is replied 
+ * when it is done, see commit_job_cb().
  */
 int
-from_client_commit(clicon_handle h,
-		   int s,
-		   struct clicon_msg *msg,
-		   const char *label)
+from_client_commit(clicon_handle        h,
+		   struct client_entry *ce,
+		   struct clicon_msg   *msg,
+		   const char          *label)
 {
-    int        retval = -1;
-    char      *candidate;
-    char      *running;
-    uint32_t   snapshot;
-    uint32_t   startup;
-    char      *snapshot_0;
-    char      *archive_dir;
-    char      *startup_config;
+    int                retval = -1;
+    char              *candidate;
+    char              *running;
+    uint32_t           snapshot;
+    uint32_t           startup;
+    struct commit_job *job;
+    struct timeval     t;
 
     if (clicon_msg_commit_decode(msg, &candidate, &running,
 				&snapshot, &startup, label) < 0)
 	goto err;
 
-    if (candidate_commit(h, candidate, running) < 0){
+    if (commit_job_start(h, candidate, running, &job) < 0){
 	clicon_debug(1, "Commit %s failed",  candidate);
 	retval = 0; /* We ignore errors from commit, but maybe
 		       we should fail on fatal errors? */
 	goto err;
     }
-    clicon_debug(1, "Commit %s",  candidate);
-    if (snapshot){
-	if ((archive_dir = clicon_archive_dir(h)) == NULL){
-	    clicon_err(OE_PLUGIN, 0, "snapshot set and clicon_archive_dir not defined");
-	    goto err;
-	}
-	if (config_snapshot(clicon_dbspec_key(h), running, archive_dir) < 0)
-	    goto err;
-    }
-
-    if (startup){
-	if ((archive_dir = clicon_archive_dir(h)) == NULL){
-	    clicon_err(OE_PLUGIN, 0, "startup set but clicon_archive_dir not defined");
-	    goto err;
-	}
-	if ((startup_config = clicon_startup_config(h)) == NULL){
-	    clicon_err(OE_PLUGIN, 0, "startup set but startup_config not defined");
-	    goto err;
-	}
-	snapshot_0 = chunk_sprintf(__FUNCTION__, "%s/0", archive_dir);
-	if (file_cp(snapshot_0, startup_config) < 0){
-	    clicon_err(OE_PROTO, errno, "%s: Error when creating startup",
-		    __FUNCTION__);
-		goto err;
-	}
+    job->cj_ce = ce;
+    job->cj_ce_nr = ce->ce_nr;
+    job->cj_snapshot = snapshot;
+    job->cj_startup = startup;
+    gettimeofday(&t, NULL);
+    if (event_reg_timeout(t, commit_job_cb, job, "commit job") < 0){
+	job->cj_failed++; /* No callbacks made, just call abort hooks */
+	while (commit_job_step(job) == 0)
+	    ;
+	commit_job_end(job);
+	goto err;
     }
+    clicon_debug(1, "Commit %d %s started", job->cj_id, candidate);
     retval = 0;
-    if (send_msg_ok(s) < 0)
-	goto done;
     goto done;
   err:
     /* XXX: more elaborate errstring? */
-    if (send_msg_err(s, clicon_errno, clicon_suberrno, "%s", clicon_err_reason) < 0)
+    if (backend_client_err(ce, clicon_errno, clicon_suberrno, "%s", clicon_err_reason) < 0)
 	retval = -1;
   done:
     unchunk_group(__FUNCTION__);
@@ -819,17 +1013,24 @@ from_client_commit(clicon_handle h,
  */
 int
 from_client_validate(clicon_handle h,
-		     int s,
+		     struct client_entry *ce,
 		     struct clicon_msg *msg,
 		     const char *label)
 {
     char *dbname;
     char *running_db;
     int retval = -1;
+    int id;
 
     if (clicon_msg_validate_decode(msg, &dbname, label) < 0){
-	send_msg_err(s, clicon_errno, clicon_suberrno,
-		     clicon_err_reason);
+	backend_client_err(ce, clicon_errno, clicon_suberrno,
+			    clicon_err_reason);
+	goto err;
+    }
+    /* Plugin validate callbacks may not interleave with a commit */
+    if ((id = commit_job_busy(NULL)) != 0){
+	clicon_err(OE_DB, 0, "commit %d in progress", id);
+	retval = 0;
 	goto err;
     }
 
@@ -845,12 +1046,12 @@ from_client_validate(clicon_handle h,
 	goto err;
     }
     retval = 0;
-    if (send_msg_ok(s) < 0)
+    if (backend_client_ok(ce) < 0)
 	goto done;
     goto done;
   err:
     /* XXX: more elaborate errstring? */
-    if (send_msg_err(s, clicon_errno, clicon_suberrno, "%s", clicon_err_reason) < 0)
+    if (backend_client_err(ce, clicon_errno, clicon_suberrno, "%s", clicon_err_reason) < 0)
 	retval = -1;
   done:
     unchunk_group(__FUNCTION__);
@@ -34,12 +34,19 @@ typedef struct {
   void *arg;		/* Application specific arg */
 } commit_data_t;
 
+/* Notification stream where commit jobs report progress, eg:
+ * "commit 7 commit 3/12 ADD interface.0", "commit 7 ok" */
+#define CLICON_COMMIT_STREAM "CLICON_COMMIT"
+
+struct client_entry; /* see config_client.h */
+
 /*
  * Prototypes
  */ 
 
-int from_client_validate(clicon_handle h, int s, struct clicon_msg *msg, const char *label);
-int from_client_commit(clicon_handle h, int s, struct clicon_msg *msg, const char *label);
+int from_client_validate(clicon_handle h, struct client_entry *ce, struct clicon_msg *msg, const char *label);
+int from_client_commit(clicon_handle h, struct client_entry *ce, struct clicon_msg *msg, const char *label);
 int candidate_commit(clicon_handle h, char *candidate, char *running);
+int commit_job_busy(char *db);
 
 #endif  /* _CONFIG_COMMIT_H_ */
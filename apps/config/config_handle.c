@@ -73,6 +73,28 @@ struct backend_handle {
     struct client_entry     *cb_ce_list;   /* The client list */
     int                      cb_ce_nr;     /* Number of clients, just increment */
     struct handle_subscription *cb_subscription; /* Event subscription list */
+    struct notify_stream    *cb_streams;   /* Subscriptions indexed by stream */
+};
+
+/*
+ * Subscriptions of clients and handle indexed by stream name, and within a 
+ * stream grouped by filter. An event is matched once against each distinct 
+ * filter of its stream. 
+ */
+struct notify_filter {
+    struct notify_filter       *nf_next;
+    char                       *nf_filter; /* fnmatch pattern or xpath */
+    xpath_plan                 *nf_xpath;  /* Compiled nf_filter (xml events) */
+    int                         nf_xerr;   /* nf_filter is not a valid xpath */
+    int                         nf_match;  /* Matched current event */
+    struct client_subscription *nf_subs;   /* Client subscriptions */
+    struct handle_subscription *nf_hsubs;  /* Handle subscriptions */
+};
+
+struct notify_stream {
+    struct notify_stream       *ns_next;
+    char                       *ns_name;   /* Name of event stream */
+    struct notify_filter       *ns_filters;
 };
 
 /*
@@ -92,12 +114,27 @@ backend_handle_init(void)
 int
 backend_handle_exit(clicon_handle h)
 {
+    struct backend_handle *cb = handle(h);
     struct client_entry   *ce;
+    struct notify_stream  *ns;
+    struct notify_filter  *nf;
 
     dbdeps_free(h); 
     /* only delete client structs, not close sockets, etc, see backend_client_rm */
     while ((ce = backend_client_list(h)) != NULL)
 	backend_client_delete(h, ce);
+    while ((ns = cb->cb_streams) != NULL){
+	cb->cb_streams = ns->ns_next;
+	while ((nf = ns->ns_filters) != NULL){
+	    ns->ns_filters = nf->nf_next;
+	    if (nf->nf_xpath)
+		xpath_plan_free(nf->nf_xpath);
+	    free(nf->nf_filter);
+	    free(nf);
+	}
+	free(ns->ns_name);
+	free(ns);
+    }
     clicon_handle_exit(h); /* frees h and options */
     return 0;
 }
@@ -119,6 +156,173 @@ backend_dbdep_set(clicon_handle h, dbdep_t *dbdep)
     return 0;
 }
 
+/*! Find stream index entry of a stream name
+ */
+static struct notify_stream *
+notify_stream_find(struct backend_handle *cb, char *stream)
+{
+    struct notify_stream *ns;
+
+    for (ns = cb->cb_streams; ns; ns = ns->ns_next)
+	if (strcmp(ns->ns_name, stream) == 0)
+	    break;
+    return ns;
+}
+
+/*! Create filter index entry of a stream
+ */
+static struct notify_filter *
+notify_filter_new(struct notify_stream *ns, char *filter)
+{
+    struct notify_filter *nf;
+
+    if ((nf = malloc(sizeof(*nf))) == NULL){
+	clicon_err(OE_PLUGIN, errno, "malloc");
+	return NULL;
+    }
+    memset(nf, 0, sizeof(*nf));
+    if ((nf->nf_filter = strdup(filter)) == NULL){
+	clicon_err(OE_PLUGIN, errno, "strdup");
+	free(nf);
+	return NULL;
+    }
+    if (strlen(filter) && (nf->nf_xpath = xpath_compile(filter)) == NULL){
+	nf->nf_xerr = 1;
+	clicon_err_reset(); /* Only an error for xml subscriptions */
+    }
+    nf->nf_next = ns->ns_filters;
+    ns->ns_filters = nf;
+    return nf;
+}
+
+/*! Remove filter index entry if it has no subscriptions, and its stream
+ * entry if it has no filters
+ */
+static void
+notify_filter_purge(struct backend_handle *cb, char *stream, 
+		    struct notify_filter *nf0)
+{
+    struct notify_stream  *ns;
+    struct notify_stream **ns_prev;
+    struct notify_filter  *nf;
+    struct notify_filter **nf_prev;
+
+    if (nf0->nf_subs || nf0->nf_hsubs)
+	return;
+    ns_prev = &cb->cb_streams;
+    for (ns = *ns_prev; ns; ns = ns->ns_next){
+	if (strcmp(ns->ns_name, stream) == 0)
+	    break;
+	ns_prev = &ns->ns_next;
+    }
+    if (ns == NULL)
+	return;
+    nf_prev = &ns->ns_filters;
+    for (nf = *nf_prev; nf; nf = nf->nf_next){
+	if (nf == nf0){
+	    *nf_prev = nf->nf_next;
+	    if (nf->nf_xpath)
+		xpath_plan_free(nf->nf_xpath);
+	    free(nf->nf_filter);
+	    free(nf);
+	    break;
+	}
+	nf_prev = &nf->nf_next;
+    }
+    if (ns->ns_filters == NULL){
+	*ns_prev = ns->ns_next;
+	free(ns->ns_name);
+	free(ns);
+    }
+}
+
+/*! Find or create filter index entry of a stream name and filter
+ * The filter is compiled as an xpath for xml events when the entry is 
+ * created. It is an error if format is xml and the filter is not a valid 
+ * xpath, a text filter is an fnmatch pattern and need not be one.
+ */
+static struct notify_filter *
+notify_filter_get(struct backend_handle *cb, 
+		  char                  *stream, 
+		  char                  *filter,
+		  enum format_enum       format)
+{
+    struct notify_stream *ns;
+    struct notify_filter *nf;
+
+    if ((ns = notify_stream_find(cb, stream)) == NULL){
+	if ((ns = malloc(sizeof(*ns))) == NULL){
+	    clicon_err(OE_PLUGIN, errno, "malloc");
+	    return NULL;
+	}
+	memset(ns, 0, sizeof(*ns));
+	if ((ns->ns_name = strdup(stream)) == NULL){
+	    clicon_err(OE_PLUGIN, errno, "strdup");
+	    free(ns);
+	    return NULL;
+	}
+	ns->ns_next = cb->cb_streams;
+	cb->cb_streams = ns;
+    }
+    for (nf = ns->ns_filters; nf; nf = nf->nf_next)
+	if (strcmp(nf->nf_filter, filter) == 0)
+	    break;
+    if (nf == NULL && (nf = notify_filter_new(ns, filter)) == NULL)
+	return NULL;
+    if (format == MSG_NOTIFY_XML && nf->nf_xerr){
+	clicon_err(OE_XML, 0, "Invalid xpath filter: %s", filter);
+	notify_filter_purge(cb, stream, nf);
+	return NULL;
+    }
+    return nf;
+}
+
+/*! Add client subscription to notification index 
+ * @see backend_notify
+ */
+int
+backend_notify_index_add(clicon_handle               h,
+			 struct client_subscription *su)
+{
+    struct backend_handle *cb = handle(h);
+    struct notify_filter  *nf;
+
+    if ((nf = notify_filter_get(cb, su->su_stream, su->su_filter, 
+				su->su_format)) == NULL)
+	return -1;
+    su->su_nf = nf;
+    su->su_fnext = nf->nf_subs;
+    nf->nf_subs = su;
+    return 0;
+}
+
+/*! Remove client subscription from notification index 
+ */
+int
+backend_notify_index_del(clicon_handle               h,
+			 struct client_subscription *su0)
+{
+    struct backend_handle        *cb = handle(h);
+    struct notify_filter         *nf = su0->su_nf;
+    struct client_subscription   *su;
+    struct client_subscription  **su_prev;
+
+    if (nf == NULL)
+	return 0;
+    su_prev = &nf->nf_subs;
+    for (su = *su_prev; su; su = su->su_fnext){
+	if (su == su0){
+	    *su_prev = su->su_fnext;
+	    break;
+	}
+	su_prev = &su->su_fnext;
+    }
+    su0->su_nf = NULL;
+    su0->su_fnext = NULL;
+    notify_filter_purge(cb, su0->su_stream, nf);
+    return 0;
+}
+
 /*! Notify event and distribute to all registered clients
  * 
  * @param[in]  h       Clicon handle
@@ -128,6 +332,7 @@ backend_dbdep_set(clicon_handle h, dbdep_t *dbdep)
  *
  * Stream is a string used to qualify the event-stream. Distribute the
  * event to all clients registered to this backend.  
+ * Each distinct filter of the stream is only matched once against the event.
  * XXX: event-log NYI.  
  * @see also subscription_add()
  * @see also backend_notify_xml()
@@ -135,32 +340,40 @@ backend_dbdep_set(clicon_handle h, dbdep_t *dbdep)
 int
 backend_notify(clicon_handle h, char *stream, int level, char *event)
 {
-    struct client_entry        *ce;
+    struct backend_handle      *cb = handle(h);
+    struct notify_stream       *ns;
+    struct notify_filter       *nf;
     struct client_subscription *su;
     struct handle_subscription *hs;
+    struct clicon_msg   *msg = NULL;
     int                  retval = -1;
 
-    /* First thru all clients(sessions), and all subscriptions and find matches */
-    for (ce = backend_client_list(h); ce; ce = ce->ce_next)
-	for (su = ce->ce_subscription; su; su = su->su_next)
-	    if (strcmp(su->su_stream, stream) == 0){
-		if (fnmatch(su->su_filter, event, 0) == 0)
-		    if (send_msg_notify(ce->ce_s, level, event) < 0)
-			goto done;
-	    }
-    /* Then go thru all global (handle) subscriptions and find matches */
-    hs = NULL;
-    while ((hs = subscription_each(h, hs)) != NULL){
-	if (hs->hs_format != MSG_NOTIFY_TXT)
+    if ((ns = notify_stream_find(cb, stream)) == NULL)
+	return 0;
+    /* First thru all clients(sessions) subscriptions with matching filter */
+    for (nf = ns->ns_filters; nf; nf = nf->nf_next){
+	nf->nf_match = (fnmatch(nf->nf_filter, event, 0) == 0);
+	if (!nf->nf_match || nf->nf_subs == NULL)
 	    continue;
-	if (strcmp(hs->hs_stream, stream))
-	    continue;
-	if (fnmatch(hs->hs_filter, event, 0) == 0)
-	    if ((*hs->hs_fn)(h, event, hs->hs_arg) < 0)
+	if (msg == NULL &&
+	    (msg = clicon_msg_notify_encode(level, event, __FUNCTION__)) == NULL)
+	    goto done;
+	for (su = nf->nf_subs; su; su = su->su_fnext)
+	    if (backend_client_notify(su->su_ce, msg) < 0)
 		goto done;
     }
+    /* Then go thru all global (handle) subscriptions with matching filter */
+    for (nf = ns->ns_filters; nf; nf = nf->nf_next)
+	if (nf->nf_match)
+	    for (hs = nf->nf_hsubs; hs; hs = hs->hs_fnext){
+		if (hs->hs_format != MSG_NOTIFY_TXT)
+		    continue;
+		if ((*hs->hs_fn)(h, event, hs->hs_arg) < 0)
+		    goto done;
+	    }
     retval = 0;
   done:
+    unchunk_group(__FUNCTION__);
     return retval;
 }
 
@@ -173,6 +386,8 @@ backend_notify(clicon_handle h, char *stream, int level, char *event)
  *
  * Stream is a string used to qualify the event-stream. Distribute the
  * event to all clients registered to this backend.  
+ * Each distinct filter of the stream is only evaluated once against the 
+ * event, and the event is only serialized once for all clients.
  * XXX: event-log NYI.  
  * @see also subscription_add()
  * @see also backend_notify()
@@ -180,46 +395,56 @@ backend_notify(clicon_handle h, char *stream, int level, char *event)
 int
 backend_notify_xml(clicon_handle h, char *stream, int level, cxobj *x)
 {
-    struct client_entry *ce;
+    struct backend_handle      *cb0 = handle(h);
+    struct notify_stream       *ns;
+    struct notify_filter       *nf;
     struct client_subscription *su;
     int                  retval = -1;
     cbuf                *cb = NULL;
+    struct clicon_msg   *msg = NULL;
     struct handle_subscription *hs;
 
-    /* Now go thru all clients(sessions), and all subscriptions and find matches */
-    for (ce = backend_client_list(h); ce; ce = ce->ce_next)
-	for (su = ce->ce_subscription; su; su = su->su_next)
-	    if (strcmp(su->su_stream, stream) == 0){
-		if (strlen(su->su_filter)==0 || xpath_first(x, su->su_filter) != NULL){
-		    if (cb==NULL){
-			if ((cb = cbuf_new()) == NULL){
-			    clicon_err(OE_PLUGIN, errno, "cbuf_new");
-			    goto done;
-			}
-			if (clicon_xml2cbuf(cb, x, 0, 0) < 0)
-			    goto done;
-		    }
-		    if (send_msg_notify(ce->ce_s, level, cbuf_get(cb)) < 0)
-			goto done;
-		}
-	    }
-    /* Then go thru all global (handle) subscriptions and find matches */
-    /* XXX: x contains name==dk-ore, but filter is 
-       id==/[userid=d2d5e46c-c6f9-42f3-9a69-fb52fe60940d] */
-    hs = NULL;
-    while ((hs = subscription_each(h, hs)) != NULL){
-	if (hs->hs_format != MSG_NOTIFY_XML)
+    if ((ns = notify_stream_find(cb0, stream)) == NULL)
+	return 0;
+    /* Now go thru all clients(sessions) subscriptions with matching filter */
+    for (nf = ns->ns_filters; nf; nf = nf->nf_next){
+	/* Filters that are not valid xpaths never match, see notify_filter_get */
+	nf->nf_match = (strlen(nf->nf_filter)==0 || 
+			(nf->nf_xpath && 
+			 xpath_plan_first(x, nf->nf_xpath) != NULL));
+	if (!nf->nf_match || nf->nf_subs == NULL)
 	    continue;
-	if (strcmp(hs->hs_stream, stream))
-	    continue;
-	if (strlen(hs->hs_filter)==0 || xpath_first(x, hs->hs_filter) != NULL)
-	    if ((*hs->hs_fn)(h, x, hs->hs_arg) < 0)
+	if (msg==NULL){
+	    if ((cb = cbuf_new()) == NULL){
+		clicon_err(OE_PLUGIN, errno, "cbuf_new");
+		goto done;
+	    }
+	    if (clicon_xml2cbuf(cb, x, 0, 0) < 0)
+		goto done;
+	    if ((msg = clicon_msg_notify_encode(level, cbuf_get(cb), 
+						__FUNCTION__)) == NULL)
+		goto done;
+	}
+	for (su = nf->nf_subs; su; su = su->su_fnext)
+	    if (backend_client_notify(su->su_ce, msg) < 0)
 		goto done;
     }
+    /* Then go thru all global (handle) subscriptions with matching filter */
+    /* XXX: x contains name==dk-ore, but filter is 
+       id==/[userid=d2d5e46c-c6f9-42f3-9a69-fb52fe60940d] */
+    for (nf = ns->ns_filters; nf; nf = nf->nf_next)
+	if (nf->nf_match)
+	    for (hs = nf->nf_hsubs; hs; hs = hs->hs_fnext){
+		if (hs->hs_format != MSG_NOTIFY_XML)
+		    continue;
+		if ((*hs->hs_fn)(h, x, hs->hs_arg) < 0)
+		    goto done;
+	    }
     retval = 0;
   done:
     if (cb)
 	cbuf_free(cb);
+    unchunk_group(__FUNCTION__);
     return retval;
 
 }
@@ -305,6 +530,15 @@ subscription_add(clicon_handle        h,
     hs->hs_next   = cb->cb_subscription;
     hs->hs_fn     = fn;
     hs->hs_arg    = arg;
+    if ((hs->hs_nf = notify_filter_get(cb, stream, filter, format)) == NULL){
+	free(hs->hs_stream);
+	free(hs->hs_filter);
+	free(hs);
+	hs = NULL;
+	goto done;
+    }
+    hs->hs_fnext  = hs->hs_nf->nf_hsubs;
+    hs->hs_nf->nf_hsubs = hs;
     cb->cb_subscription = hs;
   done:
     return hs;
@@ -328,12 +562,20 @@ subscription_delete(clicon_handle     h,
     struct backend_handle *cb = handle(h);
     struct handle_subscription   *hs;
     struct handle_subscription  **hs_prev;
+    struct handle_subscription  **hp;
 
     hs_prev = &cb->cb_subscription; /* this points to stack and is not real backpointer */
     for (hs = *hs_prev; hs; hs = hs->hs_next){
 	/* XXX arg == hs->hs_arg */
 	if (strcmp(hs->hs_stream, stream)==0 && hs->hs_fn == fn){
 	    *hs_prev = hs->hs_next;
+	    /* Remove from filter index */
+	    for (hp = &hs->hs_nf->nf_hsubs; *hp; hp = &(*hp)->hs_fnext)
+		if (*hp == hs){
+		    *hp = hs->hs_fnext;
+		    break;
+		}
+	    notify_filter_purge(cb, hs->hs_stream, hs->hs_nf);
 	    free(hs->hs_stream);
 	    if (hs->hs_filter)
 		free(hs->hs_filter);
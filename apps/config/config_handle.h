@@ -27,7 +27,7 @@
 /*
  * Structures
  */
-
+struct client_subscription; /* see config_client.h */
 
 
 
@@ -50,4 +50,8 @@ struct client_entry *backend_client_list(clicon_handle h);
 
 int backend_client_delete(clicon_handle h, struct client_entry *ce);
 
+int backend_notify_index_add(clicon_handle h, struct client_subscription *su);
+
+int backend_notify_index_del(clicon_handle h, struct client_subscription *su);
+
 #endif  /* _CONFIG_HANDLE_H_ */
@@ -32,6 +32,7 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <syslog.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/param.h>
@@ -49,46 +50,790 @@
 #include "config_lib.h"
 
 
+/*
+ * Snapshots are stored in the archive dir as:
+ *   current     Database with the latest snapshot (#0)
+ *   <i>.delta   Reverse delta from snapshot #i to snapshot #i+1, one line
+ *               per key: "<sha1> <key>" if the key had the value stored 
+ *               under sha1 in objects, or "- <key>" if it did not exist.
+ *   objects     Database of values referred to by deltas, keyed by sha1 of
+ *               the value. Each value is stored once with a reference count.
+ *   current.stamp  Change stamp of the database current was made from.
+ * A snapshot only writes the keys that changed since the previous one, and
+ * snapshot #n is reconstructed from current and the n first deltas.
+ * A new snapshot is written to current.next and new.delta, and published by
+ * renaming current.next to current. An interrupted snapshot is undone, or
+ * completed if current was renamed, by the next snapshot, see 
+ * snapshot_recover(). 
+ * If the keys that changed are known, eg from the candidate of a commit, 
+ * and the database has not changed otherwise since current was made from
+ * it, the delta is written to undo.delta and only the changed keys are 
+ * written to current, see config_snapshot_changes(). undo.delta is then 
+ * renamed to new.delta, and an interrupted snapshot is undone by writing
+ * undo.delta back to current.
+ * Old snapshots saved as XML files <i> are converted by
+ * config_snapshot_migrate().
+ */
+#define SNAPSHOT_CURRENT "current"
+#define SNAPSHOT_NEXT    "current.next"
+#define SNAPSHOT_STAMP   "current.stamp"
+#define SNAPSHOT_UNDO    "undo.delta"
+#define SNAPSHOT_NEW     "new.delta"
+#define SNAPSHOT_OLD     "old.delta"
+#define SNAPSHOT_OBJECTS "objects"
+#define SNAPSHOT_MIGRATE "migrate"
+#define SNAPSHOT_DELETED "-"
+
+/* Header of values in objects database */
+struct snapshot_obj {
+    uint32_t so_refs;
+    char     so_val[0];
+};
+
+/* Paths of files in archive dir */
+struct snapshot_files {
+    char sf_current[MAXPATHLEN];
+    char sf_next[MAXPATHLEN];
+    char sf_stamp[MAXPATHLEN];
+    char sf_undo[MAXPATHLEN];
+    char sf_new[MAXPATHLEN];
+    char sf_old[MAXPATHLEN];
+    char sf_objects[MAXPATHLEN];
+};
+
+/*
+ * Store value in objects database (or add a reference to it if already
+ * there). Return its name (sha1), malloced.
+ */
+static char *
+snapshot_obj_put(char *objects, char *val, size_t vlen)
+{
+    char                *hash;
+    struct snapshot_obj *so = NULL;
+    size_t               len;
+
+    if ((hash = clicon_sha1hex_buf(val, vlen)) == NULL)
+	return NULL;
+    if (db_get_alloc(objects, hash, (void**)&so, &len) < 0)
+	goto err;
+    if (so == NULL){
+	len = sizeof(*so) + vlen;
+	if ((so = malloc(len)) == NULL){
+	    clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	    goto err;
+	}
+	so->so_refs = 0;
+	memcpy(so->so_val, val, vlen);
+    }
+    so->so_refs++;
+    if (db_set(objects, hash, so, len) < 0)
+	goto err;
+    free(so);
+    return hash;
+  err:
+    if (so)
+	free(so);
+    free(hash);
+    return NULL;
+}
+
+/*
+ * Remove a reference to value in objects database
+ */
+static int
+snapshot_obj_release(char *objects, char *hash)
+{
+    struct snapshot_obj *so = NULL;
+    size_t               len;
+    int                  retval = -1;
+
+    if (db_get_alloc(objects, hash, (void**)&so, &len) < 0)
+	goto done;
+    if (so == NULL){ /* Already gone, nothing to do */
+	retval = 0;
+	goto done;
+    }
+    if (--so->so_refs == 0){
+	if (db_del(objects, hash) < 0)
+	    goto done;
+    }
+    else
+	if (db_set(objects, hash, so, len) < 0)
+	    goto done;
+    retval = 0;
+  done:
+    if (so)
+	free(so);
+    return retval;
+}
+
+/*
+ * Parse a delta line "<sha1> <key>\n" in place
+ */
+static int
+snapshot_delta_line(char *line, char **hash, char **key)
+{
+    char *p;
+
+    if ((p = strchr(line, '\n')) != NULL)
+	*p = '\0';
+    if ((p = strchr(line, ' ')) == NULL)
+	return -1;
+    *p = '\0';
+    *hash = line;
+    *key = p+1;
+    return 0;
+}
+
+/*
+ * Remove a delta file and the references it holds.
+ * The file is removed before the references are released, so that an 
+ * interrupted drop leaves unreferenced values instead of releasing values
+ * twice.
+ */
+static int
+snapshot_delta_drop(char *objects, char *deltafile)
+{
+    FILE       *f;
+    struct stat st;
+    char       *buf = NULL;
+    char       *line;
+    char       *next;
+    char       *hash;
+    char       *key;
+    int         retval = -1;
+
+    if ((f = fopen(deltafile, "r")) == NULL){
+	if (errno == ENOENT)
+	    return 0;
+	clicon_err(OE_CFG, errno, "%s: fopen(%s)", __FUNCTION__, deltafile);
+	return -1;
+    }
+    if (fstat(fileno(f), &st) < 0){
+	clicon_err(OE_CFG, errno, "%s: stat(%s)", __FUNCTION__, deltafile);
+	goto done;
+    }
+    if ((buf = malloc(st.st_size+1)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	goto done;
+    }
+    if (fread(buf, 1, st.st_size, f) != st.st_size){
+	clicon_err(OE_CFG, errno, "%s: read(%s)", __FUNCTION__, deltafile);
+	goto done;
+    }
+    buf[st.st_size] = '\0';
+    if (unlink(deltafile) < 0){
+	clicon_err(OE_CFG, errno, "%s: unlink(%s)", __FUNCTION__, deltafile);
+	goto done;
+    }
+    for (line = buf; *line; line = next){
+	if ((next = strchr(line, '\n')) != NULL)
+	    *next++ = '\0';
+	else
+	    next = line + strlen(line);
+	if (snapshot_delta_line(line, &hash, &key) < 0)
+	    continue;
+	if (strcmp(hash, SNAPSHOT_DELETED) != 0)
+	    if (snapshot_obj_release(objects, hash) < 0)
+		goto done;
+    }
+    retval = 0;
+  done:
+    if (buf)
+	free(buf);
+    fclose(f);
+    return retval;
+}
+
+/*
+ * Write the reverse delta from dbname to current (how to get back from 
+ * dbname to current) to deltafile, and take references to the old values 
+ * in objects. current is read into memory once. The delta is synced to disk.
+ */
+static int
+snapshot_delta(char *dbname, char *current, char *objects, char *deltafile)
+{
+    int            retval = -1;
+    FILE          *f = NULL;
+    clicon_hash_t *cur = NULL;
+    clicon_hash_t  e;
+    db_cursor     *dc = NULL;
+    char          *key;
+    char          *val;
+    int            vlen;
+    char          *old;
+    size_t         olen;
+    char          *hash;
+    size_t         iter = 0;
+    int            ret;
+
+    if ((cur = hash_init()) == NULL)
+	goto done;
+    if ((dc = db_cursor_open(current, NULL, 0)) == NULL)
+	goto done;
+    while ((ret = db_cursor_next(dc, &key, &val, &vlen)) == 1)
+	if (hash_add(cur, key, val, vlen) == NULL)
+	    goto done;
+    db_cursor_close(dc);
+    dc = NULL;
+    if (ret < 0)
+	goto done;
+    if ((f = fopen(deltafile, "w")) == NULL){
+	clicon_err(OE_CFG, errno, "%s: fopen(%s)", __FUNCTION__, deltafile);
+	goto done;
+    }
+    /* Added and changed keys */
+    if ((dc = db_cursor_open(dbname, NULL, 0)) == NULL)
+	goto done;
+    while ((ret = db_cursor_next(dc, &key, &val, &vlen)) == 1){
+	if ((old = hash_value(cur, key, &olen)) != NULL){
+	    if (olen == vlen && memcmp(old, val, vlen) == 0){
+		hash_del(cur, key);
+		continue;
+	    }
+	    if ((hash = snapshot_obj_put(objects, old, olen)) == NULL)
+		goto done;
+	    fprintf(f, "%s %s\n", hash, key);
+	    free(hash);
+	    hash_del(cur, key);
+	}
+	else
+	    fprintf(f, "%s %s\n", SNAPSHOT_DELETED, key);
+    }
+    if (ret < 0)
+	goto done;
+    /* Removed keys: those left in cur */
+    while ((e = hash_next(cur, &iter)) != NULL){
+	if ((hash = snapshot_obj_put(objects, e->h_val, e->h_vlen)) == NULL)
+	    goto done;
+	fprintf(f, "%s %s\n", hash, e->h_key);
+	free(hash);
+    }
+    if (fflush(f) != 0 || fsync(fileno(f)) < 0){
+	clicon_err(OE_CFG, errno, "%s: write(%s)", __FUNCTION__, deltafile);
+	goto done;
+    }
+    retval = 0;
+  done:
+    if (dc)
+	db_cursor_close(dc);
+    if (f)
+	fclose(f);
+    if (cur)
+	hash_free(cur);
+    return retval;
+}
+
+/*
+ * Write the reverse delta from dbname to current of only the changed keys to
+ * deltafile, as snapshot_delta(), and sync it to disk. Then write the values
+ * of the keys in dbname to current, as one batch. Only the changed keys are 
+ * read, so the cost is in the number of changed keys.
+ */
+static int
+snapshot_delta_keys(char  *dbname, 
+		    char  *current, 
+		    char  *objects, 
+		    char  *deltafile,
+		    char **keys, 
+		    int    nkeys)
+{
+    int                 retval = -1;
+    FILE               *f = NULL;
+    struct db_batch_op *ops = NULL;
+    char               *val = NULL;
+    size_t              vlen;
+    char               *old = NULL;
+    size_t              olen;
+    char               *hash;
+    int                 n = 0;
+    int                 i;
+
+    if ((ops = calloc(nkeys+1, sizeof(*ops))) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: calloc", __FUNCTION__);
+	goto done;
+    }
+    if ((f = fopen(deltafile, "w")) == NULL){
+	clicon_err(OE_CFG, errno, "%s: fopen(%s)", __FUNCTION__, deltafile);
+	goto done;
+    }
+    for (i=0; i<nkeys; i++){
+	if (db_get_alloc(dbname, keys[i], (void**)&val, &vlen) < 0)
+	    goto done;
+	if (db_get_alloc(current, keys[i], (void**)&old, &olen) < 0)
+	    goto done;
+	if (old == NULL && val != NULL)
+	    fprintf(f, "%s %s\n", SNAPSHOT_DELETED, keys[i]);
+	else if (old != NULL && 
+		 (val == NULL || olen != vlen || memcmp(old, val, vlen) != 0)){
+	    if ((hash = snapshot_obj_put(objects, old, olen)) == NULL)
+		goto done;
+	    fprintf(f, "%s %s\n", hash, keys[i]);
+	    free(hash);
+	}
+	else{ /* Not changed */
+	    if (old)
+		free(old);
+	    if (val)
+		free(val);
+	    old = val = NULL;
+	    continue;
+	}
+	if (old)
+	    free(old);
+	old = NULL;
+	ops[n].bo_key = keys[i];
+	ops[n].bo_val = val;
+	ops[n].bo_vlen = vlen;
+	n++;
+	val = NULL;
+    }
+    if (fflush(f) != 0 || fsync(fileno(f)) < 0){
+	clicon_err(OE_CFG, errno, "%s: write(%s)", __FUNCTION__, deltafile);
+	goto done;
+    }
+    if (n && db_batch(current, ops, n) < 0)
+	goto done;
+    retval = 0;
+  done:
+    if (f)
+	fclose(f);
+    if (ops){
+	for (i=0; i<n; i++)
+	    if (ops[i].bo_val)
+		free(ops[i].bo_val);
+	free(ops);
+    }
+    if (old)
+	free(old);
+    if (val)
+	free(val);
+    return retval;
+}
+
+/*
+ * Write the values of a delta file to database dbname, eg to go from 
+ * snapshot #i to #i+1. A last line without newline, left by an interrupted
+ * write, is skipped.
+ */
+static int
+snapshot_delta_apply(char *objects, char *deltafile, char *dbname)
+{
+    FILE                *f;
+    char                *line = NULL;
+    size_t               len = 0;
+    ssize_t              n;
+    char                *hash;
+    char                *key;
+    struct snapshot_obj *so = NULL;
+    size_t               solen;
+    int                  retval = -1;
+
+    if ((f = fopen(deltafile, "r")) == NULL){
+	clicon_err(OE_CFG, errno, "%s: fopen(%s)", __FUNCTION__, deltafile);
+	return -1;
+    }
+    while ((n = getline(&line, &len, f)) > 0){
+	if (line[n-1] != '\n' || snapshot_delta_line(line, &hash, &key) < 0)
+	    continue;
+	if (strcmp(hash, SNAPSHOT_DELETED) == 0){
+	    if (db_del(dbname, key) < 0)
+		goto done;
+	    continue;
+	}
+	if (db_get_alloc(objects, hash, (void**)&so, &solen) < 0)
+	    goto done;
+	if (so == NULL){
+	    clicon_err(OE_CFG, 0, "%s: %s: missing value of %s", 
+		       __FUNCTION__, deltafile, key);
+	    goto done;
+	}
+	if (db_set(dbname, key, so->so_val, solen - sizeof(*so)) < 0)
+	    goto done;
+	free(so);
+	so = NULL;
+    }
+    retval = 0;
+  done:
+    if (so)
+	free(so);
+    if (line)
+	free(line);
+    fclose(f);
+    return retval;
+}
+
+/*
+ * Undo an interrupted snapshot of changed keys, if any: write the old values
+ * in undo.delta back to current, and drop undo.delta.
+ */
+static int
+snapshot_undo(struct snapshot_files *sf)
+{
+    struct stat st;
+
+    if (stat(sf->sf_undo, &st) < 0)
+	return 0;
+    if (snapshot_delta_apply(sf->sf_objects, sf->sf_undo, sf->sf_current) < 0)
+	return -1;
+    return snapshot_delta_drop(sf->sf_objects, sf->sf_undo);
+}
+
+/*
+ * Read change stamp of the database current was made from, "" if not known.
+ * stamp has room for DB_STAMPLEN characters.
+ */
+static int
+snapshot_stamp_get(struct snapshot_files *sf, char *stamp)
+{
+    FILE  *f;
+    size_t len;
+
+    *stamp = '\0';
+    if ((f = fopen(sf->sf_stamp, "r")) == NULL){
+	if (errno == ENOENT)
+	    return 0;
+	clicon_err(OE_CFG, errno, "%s: fopen(%s)", __FUNCTION__, sf->sf_stamp);
+	return -1;
+    }
+    len = fread(stamp, 1, DB_STAMPLEN-1, f);
+    stamp[len] = '\0';
+    fclose(f);
+    return 0;
+}
+
+/*
+ * Save change stamp of the database current was made from, or remove it if
+ * stamp is NULL, eg before current is changed.
+ */
+static int
+snapshot_stamp_set(struct snapshot_files *sf, char *stamp)
+{
+    FILE *f;
+
+    if (stamp == NULL){
+	if (unlink(sf->sf_stamp) < 0 && errno != ENOENT){
+	    clicon_err(OE_CFG, errno, "%s: unlink(%s)", 
+		       __FUNCTION__, sf->sf_stamp);
+	    return -1;
+	}
+	return 0;
+    }
+    if ((f = fopen(sf->sf_stamp, "w")) == NULL){
+	clicon_err(OE_CFG, errno, "%s: fopen(%s)", __FUNCTION__, sf->sf_stamp);
+	return -1;
+    }
+    if (fputs(stamp, f) == EOF || fclose(f) != 0){
+	clicon_err(OE_CFG, errno, "%s: write(%s)", __FUNCTION__, sf->sf_stamp);
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * Make new.delta delta #0 and move the other deltas one step up. 
+ * Delta #SNAPSHOTS_NR-2 is dropped if all deltas exist.
+ * Can be run again if interrupted: the first missing delta is where an
+ * interrupted rotation stopped.
+ */
+static int
+snapshot_rotate(char *dir, struct snapshot_files *sf)
+{
+    char        filename0[MAXPATHLEN];
+    char        filename1[MAXPATHLEN];
+    struct stat st;
+    int         i;
+
+    for (i=0; i<SNAPSHOTS_NR-1; i++){
+	snprintf(filename0, MAXPATHLEN, "%s/%d.delta", dir, i);
+	if (stat(filename0, &st) < 0)
+	    break;
+    }
+    if (i == SNAPSHOTS_NR-1){ /* Drop oldest */
+	i = SNAPSHOTS_NR-2;
+	snprintf(filename0, MAXPATHLEN, "%s/%d.delta", dir, i);
+	if (rename(filename0, sf->sf_old) < 0){
+	    clicon_err(OE_CFG, errno, "%s: rename(%s, %s)", 
+		       __FUNCTION__, filename0, sf->sf_old);
+	    return -1;
+	}
+	if (snapshot_delta_drop(sf->sf_objects, sf->sf_old) < 0)
+	    return -1;
+    }
+    for (; i>0; i--){
+	snprintf(filename0, MAXPATHLEN, "%s/%d.delta", dir, i-1);
+	snprintf(filename1, MAXPATHLEN, "%s/%d.delta", dir, i);
+	if (rename(filename0, filename1) < 0){
+	    clicon_err(OE_CFG, errno, "%s: rename(%s, %s)", 
+		       __FUNCTION__, filename0, filename1);
+	    return -1;
+	}
+    }
+    snprintf(filename0, MAXPATHLEN, "%s/0.delta", dir);
+    if (rename(sf->sf_new, filename0) < 0){
+	clicon_err(OE_CFG, errno, "%s: rename(%s, %s)", 
+		   __FUNCTION__, sf->sf_new, filename0);
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * Set paths of archive dir files, and complete or undo an interrupted 
+ * snapshot: if undo.delta exists, current was partly written and is 
+ * restored. If current.next still exists, current was not replaced and the
+ * new delta is dropped. Otherwise the new delta is rotated in.
+ */
+static int
+snapshot_recover(char *dir, struct snapshot_files *sf)
+{
+    struct stat st;
+
+    if (stat(dir, &st) < 0){
+	clicon_err(OE_CFG, errno, "%s: stat(%s)", __FUNCTION__, dir);
+	return -1;
+    }
+    if (!S_ISDIR(st.st_mode)){
+	clicon_err(OE_CFG, 0, "%s: %s: not directory", __FUNCTION__, dir);
+	return -1;
+    }
+    snprintf(sf->sf_current, MAXPATHLEN, "%s/%s", dir, SNAPSHOT_CURRENT);
+    snprintf(sf->sf_next, MAXPATHLEN, "%s/%s", dir, SNAPSHOT_NEXT);
+    snprintf(sf->sf_stamp, MAXPATHLEN, "%s/%s", dir, SNAPSHOT_STAMP);
+    snprintf(sf->sf_undo, MAXPATHLEN, "%s/%s", dir, SNAPSHOT_UNDO);
+    snprintf(sf->sf_new, MAXPATHLEN, "%s/%s", dir, SNAPSHOT_NEW);
+    snprintf(sf->sf_old, MAXPATHLEN, "%s/%s", dir, SNAPSHOT_OLD);
+    snprintf(sf->sf_objects, MAXPATHLEN, "%s/%s", dir, SNAPSHOT_OBJECTS);
+    if (snapshot_delta_drop(sf->sf_objects, sf->sf_old) < 0)
+	return -1;
+    if (stat(sf->sf_undo, &st) == 0){
+	clicon_log(LOG_NOTICE, "%s: undoing interrupted snapshot in %s", 
+		   __FUNCTION__, dir);
+	if (snapshot_undo(sf) < 0)
+	    return -1;
+    }
+    if (stat(sf->sf_next, &st) == 0){
+	if (snapshot_delta_drop(sf->sf_objects, sf->sf_new) < 0)
+	    return -1;
+	if (db_remove(sf->sf_next) < 0)
+	    return -1;
+    }
+    else if (stat(sf->sf_new, &st) == 0){
+	clicon_log(LOG_NOTICE, "%s: completing interrupted snapshot in %s", 
+		   __FUNCTION__, dir);
+	if (snapshot_rotate(dir, sf) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
 /* 
  * config_snapshot
- * dump old running_db to IOS snapshot file #0
- * and move all other checkpoints
- * one step up
+ * Make dbname the most recent snapshot #0 in archive dir,
+ * and move all other snapshots one step up. Snapshot #SNAPSHOTS_NR-1 
+ * is dropped.
+ */
+int
+config_snapshot(char *dbname, char *dir)
+{
+    struct snapshot_files sf;
+    struct stat           st;
+    char                  stamp[DB_STAMPLEN];
+
+    if (snapshot_recover(dir, &sf) < 0)
+	return -1;
+    /* Stamp before copy, current is not used for changed keys if dbname 
+       changes during the copy */
+    if (db_engine_get()->de_stamp(dbname, stamp) < 0)
+	return -1;
+    if (snapshot_stamp_set(&sf, NULL) < 0)
+	return -1;
+    /* First snapshot */
+    if (stat(sf.sf_current, &st) < 0){
+	if (db_copy(dbname, sf.sf_current) < 0)
+	    return -1;
+	return snapshot_stamp_set(&sf, stamp);
+    }
+    if (stat(sf.sf_objects, &st) < 0 && db_init(sf.sf_objects) < 0)
+	return -1;
+    /* Copy dbname, so that the delta is made from the same content */
+    if (db_copy(dbname, sf.sf_next) < 0)
+	goto err;
+    if (snapshot_delta(sf.sf_next, sf.sf_current, sf.sf_objects, sf.sf_new) < 0)
+	goto err;
+    /* The snapshot is made here, the rotation is completed if interrupted */
+    if (db_rename(sf.sf_next, sf.sf_current) < 0)
+	goto err;
+    if (snapshot_rotate(dir, &sf) < 0)
+	return -1;
+    return snapshot_stamp_set(&sf, stamp);
+  err:
+    snapshot_delta_drop(sf.sf_objects, sf.sf_new);
+    db_remove(sf.sf_next);
+    return -1;
+}
+
+/* 
+ * config_snapshot_changes
+ * As config_snapshot(), when only keys have changed in dbname since it had 
+ * change stamp from, and it has change stamp to now, eg the keys of the 
+ * candidate of a commit, see db_overlay_changes(). If current was made from
+ * dbname at from, only the changed keys are read and written. Otherwise, or
+ * if from is NULL, all of dbname is compared with config_snapshot().
+ */
+int
+config_snapshot_changes(char  *dbname, 
+			char  *dir, 
+			char **keys, 
+			int    nkeys, 
+			char  *from, 
+			char  *to)
+{
+    struct snapshot_files sf;
+    struct stat           st;
+    char                  stamp[DB_STAMPLEN];
+
+    if (from == NULL)
+	return config_snapshot(dbname, dir);
+    if (snapshot_recover(dir, &sf) < 0)
+	return -1;
+    if (snapshot_stamp_get(&sf, stamp) < 0)
+	return -1;
+    if (*stamp == '\0' || strcmp(stamp, from) != 0)
+	return config_snapshot(dbname, dir);
+    /* dbname changed by others than keys since, eg by plugin end hooks */
+    if (db_engine_get()->de_stamp(dbname, stamp) < 0)
+	return -1;
+    if (strcmp(stamp, to) != 0)
+	return config_snapshot(dbname, dir);
+    if (stat(sf.sf_objects, &st) < 0 && db_init(sf.sf_objects) < 0)
+	return -1;
+    if (snapshot_stamp_set(&sf, NULL) < 0)
+	return -1;
+    if (snapshot_delta_keys(dbname, sf.sf_current, sf.sf_objects, sf.sf_undo,
+			    keys, nkeys) < 0)
+	goto err;
+    /* The snapshot is made here, the rotation is completed if interrupted */
+    if (rename(sf.sf_undo, sf.sf_new) < 0){
+	clicon_err(OE_CFG, errno, "%s: rename(%s, %s)", 
+		   __FUNCTION__, sf.sf_undo, sf.sf_new);
+	goto err;
+    }
+    if (snapshot_rotate(dir, &sf) < 0)
+	return -1;
+    return snapshot_stamp_set(&sf, to);
+  err:
+    snapshot_undo(&sf);
+    return -1;
+}
+
+/*
+ * config_snapshot_get
+ * Reconstruct snapshot #n (0 is most recent) from archive dir into dbname,
+ * eg for rollback. dbname is replaced when the snapshot is complete.
  */
 int
-config_snapshot(dbspec_key *dbspec, char *dbname, char *dir)
+config_snapshot_get(char *dir, int n, char *dbname)
 {
-    char filename0[MAXPATHLEN];
-    char filename1[MAXPATHLEN];
+    struct snapshot_files sf;
+    char    filename[MAXPATHLEN];
+    char    tmp[MAXPATHLEN];
     struct stat st;
-    int i;
+    int     i;
+    int     retval = -1;
 
-    if (stat(dir, &st) < 0){
-	clicon_err(OE_CFG, errno, "%s: stat(%s): %s\n", 
-		__FUNCTION__, dir, strerror(errno));
+    if (n < 0 || n >= SNAPSHOTS_NR){
+	clicon_err(OE_CFG, 0, "%s: No such snapshot: %d", __FUNCTION__, n);
 	return -1;
     }
-    if (!S_ISDIR(st.st_mode)){
-	clicon_err(OE_CFG, 0, "%s: %s: not directory\n", 
-		__FUNCTION__, dir);
-	return -1;
-    }
-    for (i=SNAPSHOTS_NR-1; i>0; i--){
-	snprintf(filename0, MAXPATHLEN, "%s/%d", 
-		 dir,
-		 i-1);
-	snprintf(filename1, MAXPATHLEN, "%s/%d", 
-		 dir,
-		 i);
-	if (stat(filename0, &st) == 0)
-	    if (rename(filename0, filename1) < 0){
-		clicon_err(OE_CFG, errno, "%s: rename(%s, %s): %s\n", 
-			__FUNCTION__, filename0, filename1, strerror(errno));
-		return -1;
-	    }
+    if (snapshot_recover(dir, &sf) < 0)
+	return -1;
+    if (stat(sf.sf_current, &st) < 0){
+	clicon_err(OE_CFG, errno, "%s: No such snapshot: %d", __FUNCTION__, n);
+	return -1;
+    }
+    snprintf(tmp, MAXPATHLEN, "%s.%u", dbname, (unsigned)getpid());
+    if (db_copy(sf.sf_current, tmp) < 0)
+	goto done;
+    for (i=0; i<n; i++){
+	snprintf(filename, MAXPATHLEN, "%s/%d.delta", dir, i);
+	if (stat(filename, &st) < 0){
+	    clicon_err(OE_CFG, errno, "%s: No such snapshot: %d", __FUNCTION__, n);
+	    goto done;
+	}
+	if (snapshot_delta_apply(sf.sf_objects, filename, tmp) < 0)
+	    goto done;
+    }
+    if (db_rename(tmp, dbname) < 0)
+	goto done;
+    retval = 0;
+  done:
+    if (retval < 0)
+	db_remove(tmp);
+    return retval;
+}
+
+/*
+ * config_snapshot_migrate
+ * Convert snapshots saved as XML files <i> in archive dir (before snapshots
+ * were stored as deltas) to deltas, oldest first, and remove the XML files.
+ * Only done if there are no delta snapshots yet, or if an earlier conversion
+ * was interrupted.
+ */
+int
+config_snapshot_migrate(dbspec_key *dbspec, char *dir)
+{
+    char        filename[MAXPATHLEN];
+    char        current[MAXPATHLEN];
+    char        tmp[MAXPATHLEN];
+    struct stat st;
+    int         i;
+    int         retval = -1;
+
+    if (stat(dir, &st) < 0 || !S_ISDIR(st.st_mode))
+	return 0;
+    snprintf(current, MAXPATHLEN, "%s/%s", dir, SNAPSHOT_CURRENT);
+    snprintf(tmp, MAXPATHLEN, "%s/%s", dir, SNAPSHOT_MIGRATE);
+    if (stat(current, &st) == 0 && stat(tmp, &st) < 0)
+	return 0;
+    for (i=SNAPSHOTS_NR-1; i>=0; i--){
+	snprintf(filename, MAXPATHLEN, "%s/%d", dir, i);
+	if (stat(filename, &st) < 0)
+	    continue;
+	/* tmp also marks that conversion is in progress */
+	if (db_init_size(tmp, 0) < 0)
+	    goto done;
+	if (load_xml_to_db(filename, dbspec, tmp) < 0)
+	    goto done;
+	if (config_snapshot(tmp, dir) < 0)
+	    goto done;
+	if (unlink(filename) < 0){
+	    clicon_err(OE_CFG, errno, "%s: unlink(%s)", __FUNCTION__, filename);
+	    goto done;
+	}
+	clicon_log(LOG_NOTICE, "%s: converted snapshot %s", 
+		   __FUNCTION__, filename);
     }
-    /* Make the most current snapshot */
-    snprintf(filename0, MAXPATHLEN, "%s/0", dir);
-    return save_db_to_xml(filename0, dbspec, dbname, 0);
+    retval = 0;
+  done:
+    if (retval == 0 && stat(tmp, &st) == 0 && db_remove(tmp) < 0)
+	retval = -1;
+    return retval;
 }
 
+/*
+ * Return 1 if db1 and db2 name the same database file, eg a candidate
+ * given with another path than the one in the configuration.
+ */
+int
+config_samedb(char *db1, char *db2)
+{
+    struct stat st1;
+    struct stat st2;
+
+    if (strcmp(db1, db2) == 0)
+	return 1;
+    if (stat(db1, &st1) < 0 || stat(db2, &st2) < 0)
+	return 0;
+    return st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino;
+}
@@ -31,7 +31,12 @@
 /*
  * Prototypes
  */ 
-int config_snapshot(dbspec_key *dbspec, char *dbname, char *dir);
+int config_snapshot(char *dbname, char *dir);
+int config_snapshot_changes(char *dbname, char *dir, char **keys, int nkeys,
+			    char *from, char *to);
+int config_snapshot_get(char *dir, int n, char *dbname);
+int config_snapshot_migrate(dbspec_key *dbspec, char *dir);
+int config_samedb(char *db1, char *db2);
 int group_name2gid(char *name, gid_t *gid);
 
 #endif  /* _CONFIG_LIB_H_ */
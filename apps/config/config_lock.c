@@ -54,43 +54,299 @@
 #include "config_lock.h"
 
 /*
- * Easy way out: store an integer for candidate db which contains
- * the session-id of the client holding the lock.
- * more general: any database
- * we dont make any sanity check on who is locking.
+ * Lock manager
+ * Locks are held by sessions (client pids) on subtrees of the candidate
+ * database, cf NETCONF partial-lock. A subtree is given by a database key
+ * prefix, eg "interface.0" covers "interface.0" and "interface.0.ipv4.1", and
+ * the empty key covers the whole database.
+ * Locks are kept in a tree with one node per key component. Each node records
+ * the session holding a lock on its subtree, and per session the number of 
+ * locks held strictly below it. A lock or change of a key then conflicts with
+ * other sessions by looking at the nodes on the path to the key only.
+ * Not persistent.
  */
-static int _db_locked = 0;
 
-/*
- * db_lock
+/* Number of locks held by a session below a lock node */
+struct lock_count{
+    struct lock_count *lc_next;
+    int                lc_id;      /* Session id */
+    int                lc_nr;      /* Nr of locks below node */
+};
+
+/* Lock tree node, one per key component, eg "interface", "0" */
+struct lock_node{
+    struct lock_node  *ln_next;    /* Next sibling */
+    struct lock_node  *ln_child;   /* First child */
+    char              *ln_name;    /* Key component */
+    int                ln_id;      /* Session holding lock on subtree, or 0 */
+    struct lock_count *ln_below;   /* Locks below this node per session */
+};
+
+/* Root of lock tree: the whole database */
+static struct lock_node _lock_root = {NULL, };
+
+/*! Split database key into key components used as lock path
+ * Vector keys are locked as the whole vector, ie "a.b[] $x" is "a.b"
+ * @param[in]  key    Database key or NULL (whole database)
+ * @param[out] nvec   Number of components
+ * @param[in]  label  Chunk label
+ * @retval     vec    Vector of key components (chunk)
+ * @retval     NULL   Error
  */
-int
-db_lock(clicon_handle h, int id)
+static char **
+lock_path(char *key, int *nvec, const char *label)
+{
+    char  *k;
+    size_t len;
+
+    *nvec = 0;
+    if ((k = chunk_sprintf(label, "%s", key?key:"")) == NULL){
+	clicon_err(OE_UNIX, errno, "chunk_sprintf");
+	return NULL;
+    }
+    len = strcspn(k, "[ ");
+    k[len] = '\0';
+    while (len && k[len-1] == '.')
+	k[--len] = '\0';
+    if (len == 0)
+	return (char**)chunk(sizeof(char*), label); /* Empty path */
+    return clicon_strsplit(k, ".", nvec, label);
+}
+
+static struct lock_node *
+lock_child(struct lock_node *ln, char *name)
+{
+    struct lock_node *lc;
+
+    for (lc = ln->ln_child; lc; lc = lc->ln_next)
+	if (strcmp(lc->ln_name, name) == 0)
+	    break;
+    return lc;
+}
+
+/*! Add n (1 or -1) to number of locks held by session id below node
+ */
+static int
+lock_count_add(struct lock_node *ln, int id, int n)
 {
-    _db_locked = id;
-    clicon_debug(1, "%s: lock db by %u",  __FUNCTION__, id);
+    struct lock_count  *lc;
+    struct lock_count **lcp;
+
+    for (lcp = &ln->ln_below; (lc = *lcp) != NULL; lcp = &lc->lc_next)
+	if (lc->lc_id == id)
+	    break;
+    if (lc == NULL){
+	if (n < 0)
+	    return 0;
+	if ((lc = malloc(sizeof(*lc))) == NULL){
+	    clicon_err(OE_UNIX, errno, "malloc");
+	    return -1;
+	}
+	memset(lc, 0, sizeof(*lc));
+	lc->lc_id = id;
+	*lcp = lc;
+    }
+    if ((lc->lc_nr += n) <= 0){
+	*lcp = lc->lc_next;
+	free(lc);
+    }
     return 0;
 }
 
-/*
- * db_unlock
+/*! Free lock nodes that hold no lock and have no locks below them
+ */
+static void
+lock_prune(struct lock_node *ln)
+{
+    struct lock_node  *lc;
+    struct lock_node **lcp = &ln->ln_child;
+
+    while ((lc = *lcp) != NULL){
+	lock_prune(lc);
+	if (lc->ln_id == 0 && lc->ln_child == NULL){
+	    *lcp = lc->ln_next;
+	    free(lc->ln_name);
+	    free(lc);
+	}
+	else
+	    lcp = &lc->ln_next;
+    }
+}
+
+/*! Check if session id may lock or change subtree given by key
+ * A subtree conflicts with a lock of another session on the same key, on 
+ * a key above it, or on a key below it.
+ * @param[in]  h    Clicon handle
+ * @param[in]  key  Database key or NULL for whole database
+ * @param[in]  id   Session id (pid) of client
+ * @retval     0    No conflict
+ * @retval    >0    Session id holding conflicting lock
+ * @retval    -1    Error
  */
 int
-db_unlock(clicon_handle h)
+db_islocked(clicon_handle h, char *key, int id)
 {
-    if (!_db_locked )
+    struct lock_node  *ln = &_lock_root;
+    struct lock_count *lc;
+    char             **vec;
+    int                nvec;
+    int                i;
+    int                retval = 0;
+
+    if (ln->ln_id == 0 && ln->ln_child == NULL) /* No locks */
 	return 0;
-    _db_locked = 0;
-    return 0;
+    if ((vec = lock_path(key, &nvec, __FUNCTION__)) == NULL){
+	retval = -1;
+	goto done;
+    }
+    for (i=0; i<nvec; i++){
+	if (ln->ln_id && ln->ln_id != id){
+	    retval = ln->ln_id;
+	    goto done;
+	}
+	if ((ln = lock_child(ln, vec[i])) == NULL)
+	    goto done; /* Nothing locked at or below key */
+    }
+    if (ln->ln_id && ln->ln_id != id){
+	retval = ln->ln_id;
+	goto done;
+    }
+    for (lc = ln->ln_below; lc; lc = lc->lc_next)
+	if (lc->lc_id != id){
+	    retval = lc->lc_id;
+	    break;
+	}
+  done:
+    unchunk_group(__FUNCTION__);
+    return retval;
 }
 
-/*
- * db_islocked
- * returns id of locker
+/*! Lock subtree of candidate given by key for session id
+ * Locking a subtree already locked by the same session is OK.
+ * @param[in]  h    Clicon handle
+ * @param[in]  key  Database key or NULL for whole database
+ * @param[in]  id   Session id (pid) of client
+ * @retval     0    OK, locked
+ * @retval    >0    Lock denied: session id holding conflicting lock
+ * @retval    -1    Error
+ */
+int
+db_lock(clicon_handle h, char *key, int id)
+{
+    struct lock_node *ln = &_lock_root;
+    struct lock_node *lc;
+    char            **vec;
+    int               nvec;
+    int               i;
+    int               retval = -1;
+
+    if ((retval = db_islocked(h, key, id)) != 0)
+	return retval;
+    retval = -1;
+    if ((vec = lock_path(key, &nvec, __FUNCTION__)) == NULL)
+	goto done;
+    for (i=0; i<nvec; i++){
+	if ((lc = lock_child(ln, vec[i])) == NULL){
+	    if ((lc = malloc(sizeof(*lc))) == NULL){
+		clicon_err(OE_UNIX, errno, "malloc");
+		goto done;
+	    }
+	    memset(lc, 0, sizeof(*lc));
+	    if ((lc->ln_name = strdup(vec[i])) == NULL){
+		clicon_err(OE_UNIX, errno, "strdup");
+		free(lc);
+		goto done;
+	    }
+	    lc->ln_next = ln->ln_child;
+	    ln->ln_child = lc;
+	}
+	ln = lc;
+    }
+    if (ln->ln_id != id){
+	ln->ln_id = id;
+	/* Count lock in all nodes above */
+	ln = &_lock_root;
+	for (i=0; i<nvec; i++){
+	    if (lock_count_add(ln, id, 1) < 0)
+		goto done;
+	    ln = lock_child(ln, vec[i]);
+	}
+    }
+    clicon_debug(1, "%s: lock %s by %u",  __FUNCTION__, key?key:"", id);
+    retval = 0;
+  done:
+    lock_prune(&_lock_root);
+    unchunk_group(__FUNCTION__);
+    return retval;
+}
+
+/*! Unlock subtree of candidate given by key locked by session id
+ * @param[in]  h    Clicon handle
+ * @param[in]  key  Database key or NULL for whole database
+ * @param[in]  id   Session id (pid) of client
+ * @retval     0    OK, unlocked or not locked
+ * @retval    >0    Unlock denied: session id holding the lock
+ * @retval    -1    Error
  */
 int
-db_islocked(clicon_handle h)
+db_unlock(clicon_handle h, char *key, int id)
 {
-    return _db_locked;
+    struct lock_node *ln = &_lock_root;
+    char            **vec;
+    int               nvec;
+    int               i;
+    int               retval = -1;
+
+    if ((vec = lock_path(key, &nvec, __FUNCTION__)) == NULL)
+	goto done;
+    for (i=0; i<nvec && ln; i++)
+	ln = lock_child(ln, vec[i]);
+    retval = 0;
+    if (ln == NULL || ln->ln_id == 0) /* Not locked */
+	goto done;
+    if (ln->ln_id != id){
+	retval = ln->ln_id;
+	goto done;
+    }
+    ln->ln_id = 0;
+    ln = &_lock_root;
+    for (i=0; i<nvec; i++){
+	lock_count_add(ln, id, -1);
+	ln = lock_child(ln, vec[i]);
+    }
+    lock_prune(&_lock_root);
+    clicon_debug(1, "%s: unlock %s by %u",  __FUNCTION__, key?key:"", id);
+  done:
+    unchunk_group(__FUNCTION__);
+    return retval;
+}
+
+static void
+db_unlock_all1(struct lock_node *ln, int id)
+{
+    struct lock_node   *lc;
+    struct lock_count  *c;
+    struct lock_count **cp;
+
+    if (ln->ln_id == id)
+	ln->ln_id = 0;
+    for (cp = &ln->ln_below; (c = *cp) != NULL; )
+	if (c->lc_id == id){
+	    *cp = c->lc_next;
+	    free(c);
+	}
+	else
+	    cp = &c->lc_next;
+    for (lc = ln->ln_child; lc; lc = lc->ln_next)
+	db_unlock_all1(lc, id);
 }
 
+/*! Release all locks held by session id, eg when the session is killed
+ */
+int
+db_unlock_all(clicon_handle h, int id)
+{
+    db_unlock_all1(&_lock_root, id);
+    lock_prune(&_lock_root);
+    return 0;
+}
@@ -20,7 +20,7 @@
 
  *
  * Database logical lock functions.
- * Only one lock (candidate_db)
+ * Locks on subtrees of candidate_db, see config_lock.c
  * Not persistent (needs another db)
  */
 
@@ -30,8 +30,9 @@
 /*
  * Prototypes
  */ 
-int db_lock(clicon_handle h, int id);
-int db_unlock(clicon_handle h);
-int db_islocked(clicon_handle h);
+int db_lock(clicon_handle h, char *key, int id);
+int db_unlock(clicon_handle h, char *key, int id);
+int db_unlock_all(clicon_handle h, int id);
+int db_islocked(clicon_handle h, char *key, int id);
 
 #endif  /* _CONFIG_LOCK_H_ */
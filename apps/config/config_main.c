@@ -82,6 +82,12 @@ config_terminate(clicon_handle h)
 	unlink(pidfile);   
     if (sockpath)
 	unlink(sockpath);   
+    if (clicon_running_db(h))
+	db_image_close(clicon_running_db(h));
+    if (clicon_candidate_db(h))
+	db_image_close(clicon_candidate_db(h));
+    if (clicon_running_db(h))
+	db_snapshot_close(clicon_running_db(h));
     backend_handle_exit(h);
     clicon_debug(1, "%s done", __FUNCTION__);
     if (debug)
@@ -156,10 +162,8 @@ usage(char *argv0, clicon_handle h)
 static int
 rundb_init(clicon_handle h, char *running_db)
 {
-    if (unlink(running_db) != 0 && errno != ENOENT) {
-	clicon_err(OE_UNIX, errno, "unlink");
+    if (db_remove(running_db) < 0)
 	return -1;
-    }
     if (db_init(running_db) < 0)
 	return -1;
     
@@ -185,10 +189,8 @@ rundb_main(clicon_handle h,
 
     if ((tmp = clicon_tmpfile(__FUNCTION__)) == NULL)
 	goto done;
-    if (file_cp(running_db, tmp) < 0){
-	clicon_err(OE_UNIX, errno, "file copy");
+    if (db_copy(running_db, tmp) < 0)
 	goto done;
-    }
     if (load_xml_to_db(app_config_file, clicon_dbspec_key(h), tmp) < 0) 
 	goto done;
     if (candidate_commit(h, tmp, running_db) < 0)
@@ -196,7 +198,7 @@ rundb_main(clicon_handle h,
     retval = 0;
 done:
     if (tmp)
-	unlink(tmp);
+	db_remove(tmp);
     unchunk_group(__FUNCTION__);
     return retval;
 }
@@ -210,10 +212,8 @@ candb_reset(clicon_handle h, char *running_db)
 
     if ((tmp = clicon_tmpfile(__FUNCTION__)) == NULL)
 	goto done;
-    if (file_cp(running_db, tmp) < 0){
-	clicon_err(OE_UNIX, errno, "file copy");
+    if (db_copy(running_db, tmp) < 0)
 	goto done;
-    }
     /* Request plugins to reset system state, eg initiate running from system 
      * -R
      */
@@ -224,7 +224,7 @@ candb_reset(clicon_handle h, char *running_db)
     retval = 0;
   done:
     if (tmp)
-	unlink(tmp);
+	db_remove(tmp);
     unchunk_group(__FUNCTION__);
     return retval;
 }
@@ -336,6 +336,7 @@ main(int argc, char **argv)
     int           reset_state_candidate;
     char         *app_config_file = NULL;
     char         *config_group;
+    char         *archive_dir;
     char         *argv0 = argv[0];
     char         *tmp;
     struct stat   st;
@@ -538,6 +539,11 @@ main(int argc, char **argv)
     /* Parse db spec file */
     if (dbspec_main_config(h, printspec, printalt) < 0)
 	goto done;
+    /* Convert snapshots saved as XML files by earlier versions */
+    if ((archive_dir = clicon_archive_dir(h)) != NULL &&
+	config_snapshot_migrate(clicon_dbspec_key(h), archive_dir) < 0)
+	clicon_log(LOG_WARNING, "%s: converting snapshots in %s: %s", 
+		   __PROGRAM__, archive_dir, clicon_err_reason);
 
     if ((running_db = clicon_running_db(h)) == NULL){
 	clicon_err(OE_FATAL, 0, "running db not set");
@@ -547,17 +553,17 @@ main(int argc, char **argv)
 	clicon_err(OE_FATAL, 0, "candidate db not set");
 	goto done;
     }
-    /* If running exists and reload_running set, make a copy to candidate */
+    /* If running exists and reload_running set, make a copy to candidate.
+       A real copy, not an overlay, since running may be reset below */
     if (reload_running){
 	if (stat(running_db, &st) && errno == ENOENT){
 	    clicon_log(LOG_NOTICE, "%s: -r (reload running) option given but no running_db found, proceeding without", __PROGRAM__);
 	    reload_running = 0; /* void it, so we dont commit candidate below */
 	}
 	else
-	    if (file_cp(running_db, candidate_db) < 0){
-		clicon_err(OE_UNIX, errno, "FATAL: file_cp");
+	    if (db_remove(candidate_db) < 0 ||
+		db_copy(running_db, candidate_db) < 0)
 		goto done;
-	    }
     }
     /* Init running db 
      * -I
@@ -600,14 +606,27 @@ main(int argc, char **argv)
 	if (rundb_main(h, app_config_file, running_db) < 0)
 	    goto done;
 
-    /* Initiate the shared candidate. Maybe we should not do this? */
-    if (file_cp(running_db, candidate_db) < 0){
-	clicon_err(OE_UNIX, errno, "FATAL: file_cp");
+    /* Initiate the shared candidate as an overlay of running. 
+       Maybe we should not do this? */
+    if (db_overlay_init(candidate_db, running_db) < 0)
 	goto done;
-    }
     /* XXX Hack for now. Change mode so that we all can write. Security issue*/
     chmod(candidate_db, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
 
+    /* Never lock running for readers in other processes. Candidate is not
+       a snapshot: it is written by CLI processes one key at a time, and
+       each write would copy the whole database */
+    if (clicon_backend_db_snapshot(h))
+	if (db_snapshot_open(running_db) < 0)
+	    goto done;
+    /* Serve reads of running and candidate from memory */
+    if (clicon_backend_db_image(h)){
+	if (db_image_open(running_db) < 0)
+	    goto done;
+	if (db_image_open(candidate_db) < 0)
+	    goto done;
+    }
+
     if (once)
 	goto done;
 
@@ -50,7 +50,7 @@
 #include <clicon/clicon.h>
 
 /* Command line options to be passed to getopt(3) */
-#define DBCTRL_OPTS "hDf:s:ZipPd:r:a:m:n:"
+#define DBCTRL_OPTS "hDf:s:ZipPd:r:a:m:n:b:t:l:k:"
 
 /*
  * dump_database
@@ -60,8 +60,11 @@ static int
 dump_database(char *dbname, char *rxkey, int brief, dbspec_key *dbspec)
 {
     int   retval = 0;
-    int   npairs;
-    struct db_pair *pairs;
+    int   ret;
+    int   vlen;
+    char *key;
+    char *val;
+    db_cursor *dc;
     cvec *vr = NULL;
     dbspec_key *ds;
     
@@ -69,41 +72,380 @@ dump_database(char *dbname, char *rxkey, int brief, dbspec_key *dbspec)
     if (rxkey == NULL)
 	rxkey = "^.*$";
 
-    /* Get all keys/values for vector */
-    if ((npairs = db_regexp(dbname, rxkey, __FUNCTION__, &pairs, 0)) < 0)
+    /* Stream all keys (and values unless brief) from database */
+    if ((dc = db_cursor_open(dbname, rxkey, brief)) == NULL)
         return -1;
-    
-    for (npairs--; npairs >= 0; npairs--) {
+    while ((ret = db_cursor_next(dc, &key, &val, &vlen)) == 1) {
 
-	fprintf(stdout, "%s\n", pairs[npairs].dp_key);
+	fprintf(stdout, "%s\n", key);
 	if (!brief)
 	    fprintf(stdout, "--------------------\n");
 	if (brief)
 	    continue;
-	if(key_isvector_n(pairs[npairs].dp_key) ||
-	   key_iskeycontent(pairs[npairs].dp_key)) {
+	if(key_isvector_n(key) || key_iskeycontent(key)) {
 	    printf("\ttype: number\tlen: %d\tdata: %d\n",
 		   (int)sizeof(int),
-		   *(int *)pairs[npairs].dp_val);
+		   *(int *)val);
 	}
 	else{ 
-	    if((vr = lvec2cvec(pairs[npairs].dp_val, pairs[npairs].dp_vlen)) == NULL){
-		if ((ds = key2spec_key(dbspec, pairs[npairs].dp_key)) == NULL){
-		    sanity_check_cvec(pairs[npairs].dp_key, ds, vr);
+	    if((vr = lvec2cvec(val, vlen)) == NULL){
+		if ((ds = key2spec_key(dbspec, key)) == NULL){
+		    sanity_check_cvec(key, ds, vr);
 		    cvec_free (vr);
 		}
 	    }
-	    if(lv_dump(stdout, pairs[npairs].dp_val, pairs[npairs].dp_vlen) < 0){
+	    if(lv_dump(stdout, val, vlen) < 0){
 		retval = -1;
 		break;
 	    }
 	}
 	fprintf(stdout, "\n");
     }
-    unchunk_group(__FUNCTION__);
+    if (ret < 0)
+	retval = -1;
+    db_cursor_close(dc);
+    return retval;
+}
+
+
+/*
+ * Dump files, see dump_stream() and load_stream().
+ * Binary format: DUMP_MAGIC_BIN, number of entries in database (a sizing
+ * hint), then for each entry: key length, value length, key, value. Ends 
+ * with key and value length zero. All numbers are 32-bit in network order.
+ * Text format: DUMP_MAGIC_TXT and the number of entries on the first line,
+ * then one line per entry: key, a tab, and the value in hex.
+ */
+#define DUMP_MAGIC_BIN "CLICON-DUMP-BIN 1\n"
+#define DUMP_MAGIC_TXT "CLICON-DUMP-TXT 1"
+
+/* Number of entries written to database per db_batch() when loading */
+#define LOAD_BATCH 4096
+
+/* Size of stdio buffers of dump files */
+#define DUMP_BUFSIZ (1024*1024)
+
+/*
+ * dump_part
+ * Return 1 if key belongs to part of nparts in a partitioned dump, 0 if not.
+ * Keys are partitioned by hash (the database has no key order), so that 
+ * parts can be dumped in parallel by separate processes.
+ */
+static int
+dump_part(char *key, int part, int nparts)
+{
+    uint32_t h = 2166136261U; /* FNV-1a */
+
+    if (nparts <= 1)
+	return 1;
+    for (; *key; key++)
+	h = (h ^ (uint8_t)*key) * 16777619U;
+    return (h % nparts) == part;
+}
+
+static int
+dump_put32(FILE *f, uint32_t n)
+{
+    n = htonl(n);
+    return fwrite(&n, sizeof(n), 1, f) == 1 ? 0 : -1;
+}
+
+static int
+load_get32(FILE *f, uint32_t *n)
+{
+    if (fread(n, sizeof(*n), 1, f) != 1)
+	return -1;
+    *n = ntohl(*n);
+    return 0;
+}
+
+/*
+ * dump_stream
+ * Stream database entries, optionally matching rxkey and belonging to 
+ * part of nparts, to file (stdout if "-") in binary or text dump format.
+ * Restore with load_stream().
+ */
+static int
+dump_stream(char *dbname, 
+	    char *rxkey, 
+	    char *filename, 
+	    int   binary, 
+	    int   part, 
+	    int   nparts)
+{
+    int        retval = -1;
+    int        ret;
+    int        i;
+    int        vlen;
+    int        nkeys;
+    char      *key;
+    char      *val;
+    db_cursor *dc = NULL;
+    FILE      *f;
+
+    if (strcmp(filename, "-") == 0)
+	f = stdout;
+    else
+	if ((f = fopen(filename, "w")) == NULL){
+	    clicon_err(OE_UNIX, errno, "fopen(%s)", filename);
+	    return -1;
+	}
+    setvbuf(f, NULL, _IOFBF, DUMP_BUFSIZ);
+    if ((nkeys = db_size(dbname)) < 0)
+	goto done;
+    nkeys = (nkeys + nparts - 1) / nparts; /* Keys spread evenly over parts */
+    if (binary){
+	if (fputs(DUMP_MAGIC_BIN, f) == EOF || dump_put32(f, nkeys) < 0)
+	    goto werr;
+    }
+    else
+	if (fprintf(f, "%s %d\n", DUMP_MAGIC_TXT, nkeys) < 0)
+	    goto werr;
+    if ((dc = db_cursor_open(dbname, rxkey, 0)) == NULL)
+        goto done;
+    while ((ret = db_cursor_next(dc, &key, &val, &vlen)) == 1) {
+	if (!dump_part(key, part, nparts))
+	    continue;
+	if (binary){
+	    if (dump_put32(f, strlen(key)) < 0 ||
+		dump_put32(f, vlen) < 0 ||
+		fwrite(key, 1, strlen(key), f) != strlen(key) ||
+		fwrite(val, 1, vlen, f) != vlen)
+		goto werr;
+	}
+	else {
+	    if (fputs(key, f) == EOF || fputc('\t', f) == EOF)
+		goto werr;
+	    for (i=0; i<vlen; i++)
+		if (fprintf(f, "%02x", (uint8_t)val[i]) < 0)
+		    goto werr;
+	    if (fputc('\n', f) == EOF)
+		goto werr;
+	}
+    }
+    if (ret < 0)
+	goto done;
+    if (binary && (dump_put32(f, 0) < 0 || dump_put32(f, 0) < 0))
+	goto werr;
+    if (fflush(f) == EOF)
+	goto werr;
+    retval = 0;
+    goto done;
+  werr:
+    clicon_err(OE_UNIX, errno, "write %s", filename);
+  done:
+    if (dc)
+	db_cursor_close(dc);
+    if (f != stdout && fclose(f) == EOF && retval == 0){
+	clicon_err(OE_UNIX, errno, "close %s", filename);
+	retval = -1;
+    }
     return retval;
 }
 
+/* Open dump file, read its header */
+struct load_file {
+    char  *lf_name;
+    FILE  *lf_f;
+    int    lf_binary;
+    char  *lf_line;      /* Text format: line buffer */
+    size_t lf_linelen;
+};
+
+static int
+load_open(struct load_file *lf, char *filename, int *nkeys)
+{
+    char magic[sizeof(DUMP_MAGIC_BIN)];
+    uint32_t n;
+
+    lf->lf_name = filename;
+    if (strcmp(filename, "-") == 0)
+	lf->lf_f = stdin;
+    else
+	if ((lf->lf_f = fopen(filename, "r")) == NULL){
+	    clicon_err(OE_UNIX, errno, "fopen(%s)", filename);
+	    return -1;
+	}
+    setvbuf(lf->lf_f, NULL, _IOFBF, DUMP_BUFSIZ);
+    if (fread(magic, 1, strlen(DUMP_MAGIC_BIN), lf->lf_f) != strlen(DUMP_MAGIC_BIN))
+	goto ferr;
+    magic[strlen(DUMP_MAGIC_BIN)] = '\0';
+    if (strcmp(magic, DUMP_MAGIC_BIN) == 0){
+	lf->lf_binary++;
+	if (load_get32(lf->lf_f, &n) < 0)
+	    goto ferr;
+	*nkeys = n;
+	return 0;
+    }
+    /* Text format: rest of first line, after the space read above, is
+       number of entries */
+    if (strncmp(magic, DUMP_MAGIC_TXT" ", strlen(DUMP_MAGIC_TXT)+1) != 0 ||
+	getline(&lf->lf_line, &lf->lf_linelen, lf->lf_f) < 0)
+	goto ferr;
+    *nkeys = atoi(lf->lf_line);
+    return 0;
+  ferr:
+    clicon_err(OE_CFG, 0, "%s: not a clicon_dbctrl dump file", filename);
+    return -1;
+}
+
+static void
+load_close(struct load_file *lf)
+{
+    if (lf->lf_f && lf->lf_f != stdin)
+	fclose(lf->lf_f);
+    if (lf->lf_line)
+	free(lf->lf_line);
+}
+
+static int
+hexval(int c)
+{
+    if (c >= '0' && c <= '9')
+	return c - '0';
+    if (c >= 'a' && c <= 'f')
+	return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+	return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * load_next
+ * Read next entry from dump file into a batch operation (malloced key and 
+ * value)
+ * returns: 1 if entry read, 0 at end of dump, -1 on error
+ */
+static int
+load_next(struct load_file *lf, struct db_batch_op *op)
+{
+    uint32_t klen;
+    uint32_t vlen;
+    ssize_t  len;
+    char    *tab;
+    char    *v;
+    int      i;
+
+    memset(op, 0, sizeof(*op));
+    if (lf->lf_binary){
+	if (load_get32(lf->lf_f, &klen) < 0 || load_get32(lf->lf_f, &vlen) < 0)
+	    goto ferr;
+	if (klen == 0)
+	    return 0;
+	if ((op->bo_key = malloc(klen+1)) == NULL ||
+	    (op->bo_val = malloc(vlen+1)) == NULL){
+	    clicon_err(OE_UNIX, errno, "malloc");
+	    goto err;
+	}
+	if (fread(op->bo_key, 1, klen, lf->lf_f) != klen ||
+	    fread(op->bo_val, 1, vlen, lf->lf_f) != vlen)
+	    goto ferr;
+	op->bo_key[klen] = '\0';
+	op->bo_vlen = vlen;
+	return 1;
+    }
+    if ((len = getline(&lf->lf_line, &lf->lf_linelen, lf->lf_f)) < 0){
+	if (ferror(lf->lf_f))
+	    goto ferr;
+	return 0;
+    }
+    if (len && lf->lf_line[len-1] == '\n')
+	lf->lf_line[--len] = '\0';
+    if ((tab = strchr(lf->lf_line, '\t')) == NULL || strlen(tab+1)%2)
+	goto ferr;
+    *tab++ = '\0';
+    vlen = strlen(tab)/2;
+    if ((op->bo_key = strdup(lf->lf_line)) == NULL ||
+	(op->bo_val = malloc(vlen+1)) == NULL){
+	clicon_err(OE_UNIX, errno, "malloc");
+	goto err;
+    }
+    v = op->bo_val;
+    for (i=0; i<vlen; i++){
+	if (hexval(tab[2*i]) < 0 || hexval(tab[2*i+1]) < 0)
+	    goto ferr;
+	v[i] = (hexval(tab[2*i]) << 4) | hexval(tab[2*i+1]);
+    }
+    op->bo_vlen = vlen;
+    return 1;
+  ferr:
+    clicon_err(OE_CFG, errno, "%s: truncated or malformed dump", lf->lf_name);
+  err:
+    if (op->bo_key)
+	free(op->bo_key);
+    if (op->bo_val)
+	free(op->bo_val);
+    memset(op, 0, sizeof(*op));
+    return -1;
+}
+
+/*
+ * load_stream
+ * Replace database with the entries of one or more dump files (eg the parts
+ * of a partitioned dump), see dump_stream().
+ * The entries are written to a new database sized for the number of entries,
+ * in batches with the database opened once per batch, and the new database 
+ * replaces dbname only when all files are loaded. On error, dbname is left
+ * unchanged.
+ */
+static int
+load_stream(char *dbname, char **files, int nfiles)
+{
+    int                 retval = -1;
+    struct load_file   *lfs = NULL;
+    struct db_batch_op *ops = NULL;
+    int                 nops = 0;
+    int                 nkeys = 0;
+    int                 n;
+    int                 i;
+    int                 ret;
+    char                tmpname[MAXPATHLEN];
+
+    snprintf(tmpname, sizeof(tmpname), "%s.load", dbname);
+    if ((lfs = calloc(nfiles, sizeof(*lfs))) == NULL ||
+	(ops = calloc(LOAD_BATCH, sizeof(*ops))) == NULL){
+	clicon_err(OE_UNIX, errno, "calloc");
+	goto done;
+    }
+    /* Read all headers first to size the new database */
+    for (i=0; i<nfiles; i++){
+	if (load_open(&lfs[i], files[i], &n) < 0)
+	    goto done;
+	nkeys += n;
+    }
+    if (db_init_size(tmpname, nkeys) < 0)
+	goto done;
+    for (i=0; i<nfiles; i++){
+	while ((ret = load_next(&lfs[i], &ops[nops])) == 1)
+	    if (++nops == LOAD_BATCH){
+		if (db_batch(tmpname, ops, nops) < 0)
+		    goto done;
+		while (nops)
+		    free(ops[--nops].bo_key), free(ops[nops].bo_val);
+	    }
+	if (ret < 0)
+	    goto done;
+    }
+    if (nops && db_batch(tmpname, ops, nops) < 0)
+	goto done;
+    if (db_rename(tmpname, dbname) < 0)
+	goto done;
+    retval = 0;
+  done:
+    if (ops){
+	while (nops)
+	    free(ops[--nops].bo_key), free(ops[nops].bo_val);
+	free(ops);
+    }
+    if (lfs){
+	for (i=0; i<nfiles; i++)
+	    load_close(&lfs[i]);
+	free(lfs);
+    }
+    if (retval < 0)
+	db_remove(tmpname);
+    return retval;
+}
 
 /*
  * remove_entry
@@ -132,7 +474,11 @@ usage(char *argv0)
     	    "\t-P\t\tDump database on stdout (brief output)\n"
 	    "\t-n \"<key> <var=%%T{value}> <var=...>\"\tAdd database entry\n"
             "\t-r <key>\tRemove database entry\n"
-	    "\t-m <regexp key>\tMatch regexp key in database\n"
+	    "\t-m <regexp key>\tMatch regexp key in database (with -b/-t: only dump matching keys)\n"
+	    "\t-b <file>\tDump database to file (binary, - for stdout)\n"
+	    "\t-t <file>\tDump database to file (text, - for stdout)\n"
+	    "\t-k <i>/<n>\tOnly dump part i of n (0 <= i < n)\n"
+	    "\t-l <file> [<file>...]\tReplace database with dump file(s) (- for stdin)\n"
     	    "\t-Z\t\tDelete database\n"
     	    "\t-i\t\tInit database\n",
 	    argv0
@@ -159,6 +505,13 @@ main(int argc, char **argv)
     int              use_syslog;
     char            *dbspec_type;
     dbspec_key      *dbspec = NULL;
+    char            *dumpfile = NULL;
+    int              dumpbin = 0;
+    char            *loadfile = NULL;
+    char           **loadfiles = NULL;
+    int              part = 0;
+    int              nparts = 1;
+    int              retval = 1;
 
     /* In the startup, logs to stderr & debug flag set later */
     clicon_log_init(__PROGRAM__, LOG_INFO, CLICON_LOG_STDERR); 
@@ -262,6 +615,23 @@ main(int argc, char **argv)
 	        usage(argv[0]);
 	    matchent++;
 	    break;
+	case 'b': /* binary dump to file */
+	case 't': /* text dump to file */
+	    if (!strlen(optarg))
+		usage(argv[0]);
+	    dumpfile = optarg;
+	    dumpbin = (c == 'b');
+	    break;
+	case 'k': /* dump part i of n */
+	    if (sscanf(optarg, "%d/%d", &part, &nparts) != 2 ||
+		nparts < 1 || part < 0 || part >= nparts)
+		usage(argv[0]);
+	    break;
+	case 'l': /* load dump file(s) */
+	    if (!strlen(optarg))
+		usage(argv[0]);
+	    loadfile = optarg;
+	    break;
 	case 'D':  /* Processed earlier, ignore now. */
 	case 'a':
 	case 'f':
@@ -295,7 +665,8 @@ main(int argc, char **argv)
         if (dump_database(dbname, NULL, brief, dbspec) < 0)
 	    goto quit;
 
-    if (matchent)
+    /* With -b or -t, -m only selects the keys to dump to file */
+    if (matchent && dumpfile == NULL)
         if (dump_database(dbname, matchkey, brief, dbspec)) {
 	    fprintf(stderr, "Match error\n");
 	    goto quit;
@@ -305,17 +676,33 @@ main(int argc, char **argv)
 	    fprintf(stderr, "Failed to add entry\n");
 	    goto quit;
 	}
+    if (dumpfile)
+	if (dump_stream(dbname, matchkey, dumpfile, dumpbin, part, nparts) < 0)
+	    goto quit;
+    if (loadfile){
+	/* Additional dump files, eg parts of a partitioned dump, follow */
+	if ((loadfiles = calloc(argc+1, sizeof(char*))) == NULL){
+	    clicon_err(OE_UNIX, errno, "calloc");
+	    goto quit;
+	}
+	loadfiles[0] = loadfile;
+	memcpy(&loadfiles[1], argv, argc*sizeof(char*));
+	if (load_stream(dbname, loadfiles, argc+1) < 0)
+	    goto quit;
+    }
     if (rment)
         if (remove_entry(dbname, rmkey) < 0)
 	    goto quit;
     if (zapdb) /* remove databases */
-	unlink(dbname);
+	db_remove(dbname);
     if (initdb)
 	if (db_init(dbname) < 0)
 	    goto quit;
-
+    retval = 0;
   quit:
+    if (loadfiles)
+	free(loadfiles);
     db_spec_free(dbspec);
     clicon_handle_exit(h);
-    return 0;
+    return retval;
 }
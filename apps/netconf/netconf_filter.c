@@ -569,12 +569,11 @@ netconf_xpath(cxobj *xsearch,
 	      cbuf *xf_err, 
 	      cxobj *xt)
 {
-    cxobj  *x;
+    cxobj            *x;
     int               retval = -1;
     char             *selector;
-    cxobj **xv;
-    int               xlen;
-    int               i;
+    xpath_plan       *xc = NULL;
+    xpath_cursor     *xcur;
 
     if ((selector = xml_find_value(xfilter, "select")) == NULL){
 	netconf_create_rpc_error(xf_err, xt, 
@@ -585,19 +584,9 @@ netconf_xpath(cxobj *xsearch,
 				 "select");
 	goto done;
     }
-
-    x = NULL;
-
-    clicon_errno = 0;
-    if ((xv = xpath_vec(xsearch, selector, &xlen)) != NULL) {
-	for (i=0; i<xlen; i++){
-	    x = xv[i];
-	    clicon_xml2cbuf(xf, x, 0, 1);
-	}
-	free(xv);
-    }
-    /* XXX: NULL means error sometimes */
-    if (clicon_errno){
+    /* Syntax errors in the selector are reported when it is compiled */
+    if ((xc = xpath_compile(selector)) == NULL ||
+	(xcur = xpath_cursor_open(xsearch, xc)) == NULL){
 	netconf_create_rpc_error(xf_err, xt, 
 				 "operation-failed", 
 				 "application", 
@@ -606,9 +595,13 @@ netconf_xpath(cxobj *xsearch,
 				 "select");
 	goto done;
     }
-
+    while ((x = xpath_cursor_next(xcur)) != NULL)
+	clicon_xml2cbuf(xf, x, 0, 1);
+    xpath_cursor_close(xcur);
     retval = 0;
   done:
+    if (xc)
+	xpath_plan_free(xc);
     return retval;
 }
 
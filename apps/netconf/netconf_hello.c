@@ -69,13 +69,24 @@
 static int
 netconf_hello(cxobj *xn)
 {
-    cxobj *x;
-
-    x = NULL;
-    while ((x = xpath_each(xn, "//capability", x)) != NULL) {
+    cxobj        *x;
+    xpath_plan   *xc;
+    xpath_cursor *xcur;
+    int           retval = -1;
+
+    if ((xc = xpath_compile("//capability")) == NULL)
+	goto done;
+    if ((xcur = xpath_cursor_open(xn, xc)) == NULL)
+	goto done;
+    while ((x = xpath_cursor_next(xcur)) != NULL) {
 	//fprintf(stderr, "cap: %s\n", xml_body(x));
     }
-    return 0;
+    xpath_cursor_close(xcur);
+    retval = 0;
+  done:
+    if (xc)
+	xpath_plan_free(xc);
+    return retval;
 }
 
 int
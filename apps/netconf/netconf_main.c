@@ -59,12 +59,17 @@
 /* Command line options to be passed to getopt(3) */
 #define NETCONF_OPTS "hDa:qf:s:d:S"
 
+/* Compiled xpaths used to dispatch every incoming packet */
+static xpath_plan *_xp_rpc = NULL;   /* //rpc */
+static xpath_plan *_xp_hello = NULL; /* //hello */
+
 static int
 packet(clicon_handle h, cbuf *xf)
 {
     char  *str;
     char  *str0;
     cxobj *xml_req = NULL; /* Request (in) */
+    cxobj *xrpc;
     int    isrpc = 0;   /* either hello or rpc */
     cbuf  *xf_out;
     cbuf  *xf_err;
@@ -95,11 +100,15 @@ packet(clicon_handle h, cbuf *xf)
 	goto done;
     }
     free(str0);
-    if (xpath_first(xml_req, "//rpc") != NULL){
+    if (_xp_rpc == NULL && (_xp_rpc = xpath_compile("//rpc")) == NULL)
+	goto done;
+    if (_xp_hello == NULL && (_xp_hello = xpath_compile("//hello")) == NULL)
+	goto done;
+    if ((xrpc = xpath_plan_first(xml_req, _xp_rpc)) != NULL){
         isrpc++;
     }
     else
-        if (xpath_first(xml_req, "//hello") != NULL)
+        if (xpath_plan_first(xml_req, _xp_hello) != NULL)
 	    ;
         else{
             clicon_log(LOG_WARNING, "Invalid netconf msg: neither rpc or hello: dropp\
@@ -121,7 +130,7 @@ ed");
     if (isrpc){
 	if (netconf_rpc_dispatch(h, 
 				 xml_req, 
-				 xpath_first(xml_req, "//rpc"), 
+				 xrpc, 
 				 xf_out, xf_err) < 0){
 	    assert(cbuf_len(xf_err));
 	    clicon_debug(1, "%s", cbuf_get(xf_err));
@@ -317,6 +326,10 @@ terminate(clicon_handle h)
 	db_spec_free(dbspec);
     if ((yspec = clicon_dbspec_yang(h)) != NULL)
 	yspec_free(yspec);
+    if (_xp_rpc)
+	xpath_plan_free(_xp_rpc);
+    if (_xp_hello)
+	xpath_plan_free(_xp_hello);
     clicon_handle_exit(h);
     return 0;
 }
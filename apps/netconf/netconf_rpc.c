@@ -61,12 +61,81 @@
     </rpc> 
  */
 
+/*! Append a top-level name to a database key regexp, escaping special chars
+ */
+static void
+filter_regex_add(cbuf *cb, 
+		 char *name)
+{
+    char *s;
+
+    cprintf(cb, "%s", cbuf_len(cb) ? "|" : "^(");
+    for (s = name; *s; s++){
+	if (strchr(".[]()*+?{}|^$\\", *s) != NULL)
+	    cprintf(cb, "\\");
+	cprintf(cb, "%c", *s);
+    }
+}
+
+/*! Translate a get-config filter into a database key regexp
+ *
+ * The first component of a database key is the name of the top-level 
+ * xml node it is mapped to by db2xml_key(). If the filter only selects 
+ * top-level nodes with given names, only keys starting with those names 
+ * need to be read and converted to xml.
+ * @param[in]  xfilterconf  Subtree filter: <configuration>...</configuration>
+ * @param[in]  xc           Compiled xpath filter
+ * @param[out] cb           Key regexp, or empty if whole database is needed
+ */
+static int
+filter_regex(cxobj      *xfilterconf, 
+	     xpath_plan *xc, 
+	     cbuf       *cb)
+{
+    cxobj  *x;
+    char  **vec = NULL;
+    int     len;
+    int     i;
+    int     ret;
+
+    if (xc != NULL){
+	if ((ret = xpath_plan_roots(xc, &vec, &len)) < 0)
+	    return -1;
+	if (ret == 0)
+	    return 0;
+	for (i=0; i<len; i++)
+	    filter_regex_add(cb, vec[i]);
+	free(vec);
+	if (len == 0){ /* xpath cannot match anything */
+	    cprintf(cb, "^$");
+	    return 0;
+	}
+    }
+    else{
+	/* Only containment nodes at top-level prune other top-level nodes, 
+	   see select_siblings() */
+	x = NULL;
+	while ((x = xml_child_each(xfilterconf, x, CX_ELMNT)) != NULL) 
+	    if (xml_child_nr(x) == 1 && 
+		xml_type(xml_child_i(x, 0)) == CX_BODY){
+		cbuf_reset(cb);
+		return 0;
+	    }
+	x = NULL;
+	while ((x = xml_child_each(xfilterconf, x, CX_ELMNT)) != NULL) 
+	    filter_regex_add(cb, xml_name(x));
+    }
+    if (cbuf_len(cb))
+	cprintf(cb, ")(\\..*)?$");
+    return 0;
+}
+
 /*
  * See get-config
  * xfilter is a filter expression starting with <filter>
  * only <filter type="xpath"/> supported
- * needs refactoring: move the lower part (after xfilter) up to get-config or 
- * sub-function., focus on xfilter part here.
+ * The filter is translated to a database key regexp (see filter_regex()) so 
+ * that only the parts of the database that can match are read.
  */
 static int
 netconf_filter(clicon_handle h, 
@@ -76,21 +145,19 @@ netconf_filter(clicon_handle h,
 	       cxobj        *xt, 
 	       char         *target)
 {
-    cxobj *xdb; 
+    cxobj *xdb = NULL; 
     cxobj *xc; 
     cxobj *xfilterconf = NULL; 
     char            *type;
-    char            *ftype;
+    char            *ftype = NULL;
+    char            *selector;
     int              retval = -1;
     dbspec_key *dbspec =    clicon_dbspec_key(h); /* XXX */
+    xpath_plan      *xp = NULL;
+    cbuf            *cbrx = NULL;
 
-    if ((xdb = db2xml_key(target, dbspec, NULL, "clicon")) == NULL){
-	netconf_create_rpc_error(cb_err, xt, 
-				 "operation-failed", 
-				 "application", 
-				 "error", 
-				 NULL,
-				 "read-registry");
+    if ((cbrx = cbuf_new()) == NULL){
+	clicon_err(OE_XML, errno, "%s: cbuf_new", __FUNCTION__);
 	goto done;
     }
     /* 
@@ -100,13 +167,7 @@ netconf_filter(clicon_handle h,
      */
     if (xfilter){
 	if ((ftype = xml_find_value(xfilter, "type")) != NULL){
-	    if (strcmp(ftype, "xpath")==0){ 
-		cprintf(cb, "<configuration>"); /* XXX: hardcoded */
-		retval = netconf_xpath(xdb, xfilter, cb, cb_err, xt);
-		cprintf(cb, "</configuration>");
-		goto done;
-	    }
-	    else{
+	    if (strcmp(ftype, "xpath") != 0){
 		netconf_create_rpc_error(cb_err, xt, 
 				 "operation-failed", 
 				 "application", 
@@ -115,16 +176,39 @@ netconf_filter(clicon_handle h,
 				 "type");
 		goto done;
 	    }
+	    /* Errors, eg no select attribute, are reported by netconf_xpath */
+	    if ((selector = xml_find_value(xfilter, "select")) != NULL &&
+		(xp = xpath_compile(selector)) != NULL)
+		if (filter_regex(NULL, xp, cbrx) < 0)
+		    goto done;
 	}
-
-
-	xfilterconf = xpath_first(xfilter, "//configuration");
-	if (xfilterconf == NULL){ 
-	    retval = 0;
-	    goto done;
+	else{
+	    xfilterconf = xpath_first(xfilter, "//configuration");
+	    if (xfilterconf == NULL){ 
+		retval = 0;
+		goto done;
+	    }
+	    if (filter_regex(xfilterconf, NULL, cbrx) < 0)
+		goto done;
 	}
     }
-
+    if ((xdb = db2xml_key(target, dbspec, 
+			  cbuf_len(cbrx) ? cbuf_get(cbrx) : NULL, 
+			  "clicon")) == NULL){
+	netconf_create_rpc_error(cb_err, xt, 
+				 "operation-failed", 
+				 "application", 
+				 "error", 
+				 NULL,
+				 "read-registry");
+	goto done;
+    }
+    if (ftype != NULL){ /* xpath */
+	cprintf(cb, "<configuration>"); /* XXX: hardcoded */
+	retval = netconf_xpath(xdb, xfilter, cb, cb_err, xt);
+	cprintf(cb, "</configuration>");
+	goto done;
+    }
     /* Add <configuration> under <top> */
     if ((xc = xml_insert(xdb, "configuration")) == NULL){
 	netconf_create_rpc_error(cb_err, xt, 
@@ -165,6 +249,10 @@ netconf_filter(clicon_handle h,
   done:
     if (xdb)
 	xml_free(xdb);
+    if (xp)
+	xpath_plan_free(xp);
+    if (cbrx)
+	cbuf_free(cbrx);
     return retval; 
 }
 
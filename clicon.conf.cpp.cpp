@@ -59,10 +59,14 @@ CLICON_CLI_DIR        libdir/APPNAME/cli
 # Location of frontend .cli cligen spec files
 CLICON_CLISPEC_DIR    libdir/APPNAME/clispec
 
-# Directory where to save configuration commit history (in XML). Snapshots
-# are saved chronologically
+# Directory where to save configuration commit history. The latest snapshot
+# is saved as a database, older ones as deltas from it
 CLICON_ARCHIVE_DIR      localstatedir/APPNAME/archive
 
+# Storage engine of the databases: depot (QDBM hash database) or memory 
+# (ordered in-memory database with checkpoint file and write-ahead log)
+# CLICON_DB_ENGINE        depot
+
 # XXX Name of startup configuration file (in XML)
 CLICON_STARTUP_CONFIG   localstatedir/APPNAME/startup-config
 
@@ -85,6 +89,16 @@ CLICON_BACKEND_PIDFILE  localstatedir/APPNAME/APPNAME.pidfile
 # 2: like (1) but CHANGE is replaced by (DEL;ADD)
 # CLICON_COMMIT_ORDER 0
 
+# Backend keeps an image of running and candidate in memory, written through
+# to the database files, so that commit, validate and get read from memory
+# CLICON_BACKEND_DB_IMAGE 1
+
+# Backend writes running as new versions that replace the file, so that CLI
+# and netconf reads never fail or wait on a commit (Depot engine).
+# Every open of running for writing copies all of running: backend plugins
+# should write running in few db_batch() calls, not one db_set() per key
+# CLICON_BACKEND_DB_SNAPSHOT 1
+
 # Name of master plugin (both frontend and backend). Master plugin has special 
 # callbacks for frontends. See clicon user manual for more info.
 # CLICON_MASTER_PLUGIN    master
@@ -198,8 +198,7 @@ class CliconDB(_clicon._CliconDB):
         return False
 
     def __iter__(self):
-        for key in self.keys():
-            yield key
+        return super(CliconDB, self)._iter(None, 1)
 
     def keys(self, rx='.*'):
         return super(CliconDB, self)._keys(rx)
@@ -246,9 +245,29 @@ class CliconDB(_clicon._CliconDB):
     def items(self, rx='.*'):
         return super(CliconDB, self)._items(rx)
 
+    def iter(self, rx=None):
+        """Iterate over database entries with keys matching rx (all if None).
+   Entries are read one at a time and yielded as read-only dict-like views
+   with a 'key' attribute, mapping variable names to int, bool or str values.
+   The view's cvec() method returns the value as a cligen.Cvec.
+   Writers to the database are blocked until the iterator is exhausted or
+   closed."""
+        return super(CliconDB, self)._iter(rx, 0)
+
     def delete(self, key):
         return super(CliconDB, self)._db_del(key)
 
+    def put_many(self, items):
+        """Write a sequence of (key, value) tuples, where value is a cligen.Cvec
+   or an entry from iter(), with the database opened once.
+   Returns number of keys written."""
+        return super(CliconDB, self)._db_put_many(items)
+
+    def delete_many(self, keys):
+        """Delete a sequence of keys with the database opened once.
+   Returns number of keys processed."""
+        return super(CliconDB, self)._db_del_many(keys)
+
 
     def db2txt(self, handle, *args, **kwargs):
         """
@@ -161,21 +161,19 @@ done:
     return retval;
 }
 
-static PyObject *
-_db_put(CliconDB *self, PyObject *args)
+/*
+ * Convert a cligen.Cvec (or any iterable of cligen.CgVar) to a cvec
+ */
+static cvec *
+Cvec2cvec(PyObject *Cvec)
 {
-    char *key;
     cg_var *cv;
     cg_var *new;
     cvec *vr = NULL;
-    PyObject *Cvec; 
     PyObject *Cv = NULL;
     PyObject *Iterator = NULL;
     PyObject *Item = NULL;
     
-    if (!PyArg_ParseTuple(args, "sO", &key, &Cvec))
-        return NULL;
-
     if ((Iterator = PyObject_GetIter(Cvec)) == NULL)
 	return NULL;
 
@@ -200,18 +198,11 @@ _db_put(CliconDB *self, PyObject *args)
 	Py_DECREF(Item);
 	Item = NULL;
     }
-    Py_DECREF(Iterator);
-
-    
-    if (clicon_dbput(self->filename, key, vr) < 0) {
-	PyErr_Format(PyExc_RuntimeError, /* XXX Need CLICON exceptions */
-		     "Failed to write data to database '%s'",
-		     self->filename);
+    if (PyErr_Occurred())
 	goto quit;
-    }
-    cvec_free(vr);
+    Py_DECREF(Iterator);
 
-    Py_RETURN_TRUE;
+    return vr;
     
 quit:
     if (vr)
@@ -223,6 +214,31 @@ quit:
     return NULL;
 }
 
+static PyObject *
+_db_put(CliconDB *self, PyObject *args)
+{
+    char *key;
+    cvec *vr = NULL;
+    PyObject *Cvec; 
+    
+    if (!PyArg_ParseTuple(args, "sO", &key, &Cvec))
+        return NULL;
+
+    if ((vr = Cvec2cvec(Cvec)) == NULL)
+	return NULL;
+    
+    if (clicon_dbput(self->filename, key, vr) < 0) {
+	PyErr_Format(PyExc_RuntimeError, /* XXX Need CLICON exceptions */
+		     "Failed to write data to database '%s'",
+		     self->filename);
+	cvec_free(vr);
+	return NULL;
+    }
+    cvec_free(vr);
+
+    Py_RETURN_TRUE;
+}
+
 static PyObject *
 _db_del(CliconDB *self, PyObject *args)
 {
@@ -246,41 +262,652 @@ _db_del(CliconDB *self, PyObject *args)
 	Py_RETURN_FALSE;
 }
 	
+/*
+ * CliconDBItem: lightweight read-only view of one database entry, yielded
+ * by the CliconDB iterator. The value is kept encoded (lvec) and decoded
+ * into a cvec on first access. Variables are returned as native Python 
+ * values (int, bool, str) without creating cligen objects.
+ */
+typedef struct _CliconDBItem {
+    PyObject_HEAD
+    PyObject *key;		/* Database key */
+    char     *lvec;		/* Encoded value */
+    size_t    lvec_len;		/* Length of lvec */
+    cvec     *vr;		/* Decoded value, NULL until used */
+} CliconDBItem;
+
+static PyTypeObject CliconDBItem_Type;
+
 static PyObject *
-_keys(CliconDB *self, PyObject *args)
+CliconDBItem_create(char *key, char *lvec, size_t lvec_len)
 {
-    int i;
-    size_t nkeys;
-    char **keys;
-    PyObject *Keys;
-    PyObject *Key;
-    char *rx = ".*";
+    CliconDBItem *self;
 
-    if (!PyArg_ParseTuple(args, "|s", &rx))
-        return NULL;
-    
-    if ((keys = clicon_dbkeys(self->filename, &nkeys, rx)) == NULL) {
-	/* XXX Need CLICON exceptoions */
-	PyErr_Format(PyExc_RuntimeError, "clicon_dbkeys failed");
+    if ((self = PyObject_New(CliconDBItem, &CliconDBItem_Type)) == NULL)
 	return NULL;
+    self->lvec = NULL;
+    self->lvec_len = lvec_len;
+    self->vr = NULL;
+    if ((self->key = StringFromString(key)) == NULL)
+	goto fail;
+    if ((self->lvec = malloc(lvec_len ? lvec_len : 1)) == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "failed to allocate memory");
+	goto fail;
     }
-    
-    if ((Keys = PyTuple_New(nkeys)) == NULL) {
-	free(keys);
+    memcpy(self->lvec, lvec, lvec_len);
+
+    return (PyObject *)self;
+
+fail:
+    Py_DECREF(self);
+    return NULL;
+}
+
+static void
+CliconDBItem_dealloc(CliconDBItem *self)
+{
+    Py_XDECREF(self->key);
+    if (self->lvec)
+	free(self->lvec);
+    if (self->vr)
+	cvec_free(self->vr);
+    PyObject_Del(self);
+}
+
+/* Decode lvec on first access */
+static cvec *
+CliconDBItem_cvec(CliconDBItem *self)
+{
+    if (self->vr == NULL && 
+	(self->vr = lvec2cvec(self->lvec, self->lvec_len)) == NULL &&
+	(self->vr = cvec_new(0)) == NULL) /* Not a key/value lvec */
+	PyErr_SetString(PyExc_MemoryError, "failed to allocate memory");
+    return self->vr;
+}
+
+/* Convert a cligen variable to a native Python value */
+static PyObject *
+cv2py(cg_var *cv)
+{
+    char *valstr;
+    PyObject *Val;
+
+    switch (cv_type_get(cv)) {
+    case CGV_INT8:
+	return PyLong_FromLong(cv_int8_get(cv));
+    case CGV_INT16:
+	return PyLong_FromLong(cv_int16_get(cv));
+    case CGV_INT32:
+	return PyLong_FromLong(cv_int32_get(cv));
+    case CGV_INT64:
+	return PyLong_FromLongLong(cv_int64_get(cv));
+    case CGV_UINT8:
+	return PyLong_FromUnsignedLong(cv_uint8_get(cv));
+    case CGV_UINT16:
+	return PyLong_FromUnsignedLong(cv_uint16_get(cv));
+    case CGV_UINT32:
+	return PyLong_FromUnsignedLong(cv_uint32_get(cv));
+    case CGV_UINT64:
+	return PyLong_FromUnsignedLongLong(cv_uint64_get(cv));
+    case CGV_BOOL:
+	return PyBool_FromLong(cv_bool_get(cv));
+    case CGV_STRING:
+    case CGV_REST:
+	return StringFromString(cv_string_get(cv) ? cv_string_get(cv) : "");
+    default:
+	break;
+    }
+    if ((valstr = cv2str_dup(cv)) == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "failed to allocate memory");
 	return NULL;
     }
+    Val = StringFromString(valstr);
+    free(valstr);
+
+    return Val;
+}
 
-    for (i = 0; i < nkeys; i++) {
-	if ((Key = StringFromString( keys[i])) == NULL) {
-	    Py_DECREF(Keys);
-	    free(keys);
+/* Find variable by Python name, sets KeyError if not found */
+static cg_var *
+CliconDBItem_find(CliconDBItem *self, PyObject *Name, int raise)
+{
+    char *name;
+    cvec *vr;
+    cg_var *cv;
+
+    if ((vr = CliconDBItem_cvec(self)) == NULL)
+	return NULL;
+    if ((name = StringAsString(Name)) == NULL)
+	return NULL;
+    cv = cvec_find(vr, name);
+    free(name);
+    if (cv == NULL && raise)
+	PyErr_SetObject(PyExc_KeyError, Name);
+
+    return cv;
+}
+
+static Py_ssize_t
+CliconDBItem_length(CliconDBItem *self)
+{
+    cvec *vr;
+
+    if ((vr = CliconDBItem_cvec(self)) == NULL)
+	return -1;
+    return cvec_len(vr);
+}
+
+static PyObject *
+CliconDBItem_subscript(CliconDBItem *self, PyObject *Name)
+{
+    cg_var *cv;
+
+    if ((cv = CliconDBItem_find(self, Name, 1)) == NULL)
+	return NULL;
+    return cv2py(cv);
+}
+
+static int
+CliconDBItem_contains(CliconDBItem *self, PyObject *Name)
+{
+    if (CliconDBItem_find(self, Name, 0) != NULL)
+	return 1;
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static PyObject *
+CliconDBItem_get(CliconDBItem *self, PyObject *args)
+{
+    PyObject *Name;
+    PyObject *Default = Py_None;
+    cg_var *cv;
+
+    if (!PyArg_ParseTuple(args, "O|O", &Name, &Default))
+        return NULL;
+    if ((cv = CliconDBItem_find(self, Name, 0)) == NULL) {
+	if (PyErr_Occurred())
 	    return NULL;
+	Py_INCREF(Default);
+	return Default;
+    }
+    return cv2py(cv);
+}
+
+/* List of variable names (what=0), values (what=1) or name/value tuples (2) */
+static PyObject *
+CliconDBItem_list(CliconDBItem *self, int what)
+{
+    cvec *vr;
+    cg_var *cv;
+    PyObject *List;
+    PyObject *Elem;
+    Py_ssize_t i = 0;
+
+    if ((vr = CliconDBItem_cvec(self)) == NULL)
+	return NULL;
+    if ((List = PyList_New(cvec_len(vr))) == NULL)
+	return NULL;
+    for (cv = NULL; (cv = cvec_each(vr, cv)); i++) {
+	switch (what) {
+	case 0:
+	    Elem = StringFromString(cv_name_get(cv));
+	    break;
+	case 1:
+	    Elem = cv2py(cv);
+	    break;
+	default:
+	    Elem = Py_BuildValue("(sN)", cv_name_get(cv), cv2py(cv));
+	    break;
+	}
+	if (Elem == NULL) {
+	    Py_DECREF(List);
+	    return NULL;
+	}
+	PyList_SET_ITEM(List, i, Elem);
+    }
+
+    return List;
+}
+
+static PyObject *
+CliconDBItem_keys(CliconDBItem *self)
+{
+    return CliconDBItem_list(self, 0);
+}
+
+static PyObject *
+CliconDBItem_values(CliconDBItem *self)
+{
+    return CliconDBItem_list(self, 1);
+}
+
+static PyObject *
+CliconDBItem_items(CliconDBItem *self)
+{
+    return CliconDBItem_list(self, 2);
+}
+
+/* Full conversion to a cligen.Cvec, as returned by CliconDB.get() */
+static PyObject *
+CliconDBItem_Cvec(CliconDBItem *self)
+{
+    cvec *vr;
+    PyObject *Cvec;
+    PyObject *Capsule;
+    PyObject *Ret;
+
+    if ((vr = CliconDBItem_cvec(self)) == NULL)
+	return NULL;
+    if ((Capsule = PyCapsule_New((void *)vr, NULL, NULL)) == NULL)
+	return NULL;
+    if ((Cvec = PyObject_CallMethod(__cligen_module(),"Cvec", NULL)) == NULL){
+	Py_DECREF(Capsule);
+	return NULL;
+    }
+    Ret = PyObject_CallMethod(Cvec, "__Cvec_from_cvec", "O", Capsule);
+    Py_DECREF(Capsule);
+    if (Ret == NULL) {
+	Py_DECREF(Cvec);
+	return NULL;
+    }
+    Py_DECREF(Ret);
+
+    return Cvec;
+}
+
+static PyObject *
+CliconDBItem_getkey(CliconDBItem *self, void *closure)
+{
+    Py_INCREF(self->key);
+    return self->key;
+}
+
+static PyMappingMethods CliconDBItem_as_mapping = {
+    (lenfunc)CliconDBItem_length,         /* mp_length */
+    (binaryfunc)CliconDBItem_subscript,   /* mp_subscript */
+    0,                                    /* mp_ass_subscript */
+};
+
+static PySequenceMethods CliconDBItem_as_sequence = {
+    0,                                    /* sq_length */
+    0,                                    /* sq_concat */
+    0,                                    /* sq_repeat */
+    0,                                    /* sq_item */
+    0,                                    /* sq_slice */
+    0,                                    /* sq_ass_item */
+    0,                                    /* sq_ass_slice */
+    (objobjproc)CliconDBItem_contains,    /* sq_contains */
+};
+
+static PyMethodDef CliconDBItem_methods[] = {
+    {"get", (PyCFunction)CliconDBItem_get, METH_VARARGS,
+     "Get value of variable, or default if not set"},
+    {"keys", (PyCFunction)CliconDBItem_keys, METH_NOARGS,
+     "Get list of variable names"},
+    {"values", (PyCFunction)CliconDBItem_values, METH_NOARGS,
+     "Get list of variable values"},
+    {"items", (PyCFunction)CliconDBItem_items, METH_NOARGS,
+     "Get list of variable name/value tuples"},
+    {"cvec", (PyCFunction)CliconDBItem_Cvec, METH_NOARGS,
+     "Get value as cligen.Cvec"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef CliconDBItem_getset[] = {
+    {"key", (getter)CliconDBItem_getkey, NULL, "Database key", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject CliconDBItem_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_clicon.CliconDBItem",    /* tp_name */
+    sizeof(CliconDBItem),      /* tp_basicsize */
+    0,                         /* tp_itemsize */
+    (destructor)CliconDBItem_dealloc, /* tp_dealloc */
+    0,                         /* tp_print */
+    0,                         /* tp_getattr */
+    0,                         /* tp_setattr */
+    0,                         /* tp_reserved */
+    0,                         /* tp_repr */
+    0,                         /* tp_as_number */
+    &CliconDBItem_as_sequence, /* tp_as_sequence */
+    &CliconDBItem_as_mapping,  /* tp_as_mapping */
+    0,                         /* tp_hash  */
+    0,                         /* tp_call */
+    0,                         /* tp_str */
+    0,                         /* tp_getattro */
+    0,                         /* tp_setattro */
+    0,                         /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,        /* tp_flags */
+    "CLICON database entry",   /* tp_doc */
+    0,                         /* tp_traverse */
+    0,                         /* tp_clear */
+    0,                         /* tp_richcompare */
+    0,                         /* tp_weaklistoffset */
+    0,                         /* tp_iter */
+    0,                         /* tp_iternext */
+    CliconDBItem_methods,      /* tp_methods */
+    0,                         /* tp_members */
+    CliconDBItem_getset,       /* tp_getset */
+};
+
+
+/*
+ * CliconDBIter: iterator over the entries of a database using a database
+ * cursor, see db_cursor_open(). Entries are read one at a time. The database
+ * is locked for writing until the iterator is exhausted or closed.
+ */
+typedef struct _CliconDBIter {
+    PyObject_HEAD
+    db_cursor *dc;		/* Open cursor, NULL when done */
+    int        noval;		/* Yield keys only */
+} CliconDBIter;
+
+static void
+CliconDBIter_dealloc(CliconDBIter *self)
+{
+    db_cursor_close(self->dc);
+    PyObject_Del(self);
+}
+
+static PyObject *
+CliconDBIter_next(CliconDBIter *self)
+{
+    char *key;
+    char *val;
+    int   vlen;
+    int   ret;
+
+    if (self->dc == NULL)
+	return NULL;
+    if ((ret = db_cursor_next(self->dc, &key, &val, &vlen)) == 1) {
+	if (self->noval)
+	    return StringFromString(key);
+	return CliconDBItem_create(key, val, vlen);
+    }
+    db_cursor_close(self->dc);
+    self->dc = NULL;
+    if (ret < 0)
+	/* XXX Need CLICON exceptions */
+	PyErr_Format(PyExc_RuntimeError, "db_cursor_next failed");
+    return NULL; /* StopIteration */
+}
+
+static PyObject *
+CliconDBIter_close(CliconDBIter *self)
+{
+    db_cursor_close(self->dc);
+    self->dc = NULL;
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef CliconDBIter_methods[] = {
+    {"close", (PyCFunction)CliconDBIter_close, METH_NOARGS,
+     "Close iterator and release database"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject CliconDBIter_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_clicon.CliconDBIter",    /* tp_name */
+    sizeof(CliconDBIter),      /* tp_basicsize */
+    0,                         /* tp_itemsize */
+    (destructor)CliconDBIter_dealloc, /* tp_dealloc */
+    0,                         /* tp_print */
+    0,                         /* tp_getattr */
+    0,                         /* tp_setattr */
+    0,                         /* tp_reserved */
+    0,                         /* tp_repr */
+    0,                         /* tp_as_number */
+    0,                         /* tp_as_sequence */
+    0,                         /* tp_as_mapping */
+    0,                         /* tp_hash  */
+    0,                         /* tp_call */
+    0,                         /* tp_str */
+    0,                         /* tp_getattro */
+    0,                         /* tp_setattro */
+    0,                         /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,        /* tp_flags */
+    "CLICON database iterator",/* tp_doc */
+    0,                         /* tp_traverse */
+    0,                         /* tp_clear */
+    0,                         /* tp_richcompare */
+    0,                         /* tp_weaklistoffset */
+    PyObject_SelfIter,         /* tp_iter */
+    (iternextfunc)CliconDBIter_next, /* tp_iternext */
+    CliconDBIter_methods,      /* tp_methods */
+};
+
+static PyObject *
+_iter(CliconDB *self, PyObject *args)
+{
+    char *rx = NULL;
+    int noval = 0;
+    CliconDBIter *Iter;
+
+    if (!PyArg_ParseTuple(args, "|zi", &rx, &noval))
+        return NULL;
+
+    if ((Iter = PyObject_New(CliconDBIter, &CliconDBIter_Type)) == NULL)
+	return NULL;
+    Iter->noval = noval;
+    if ((Iter->dc = db_cursor_open(self->filename, rx, noval)) == NULL) {
+	/* XXX Need CLICON exceptions */
+	PyErr_Format(PyExc_RuntimeError, "Failed to open database '%s'",
+		     self->filename);
+	Py_DECREF(Iter);
+	return NULL;
+    }
+
+    return (PyObject *)Iter;
+}
+
+/*
+ * Free batch operations, see _db_put_many() and _db_del_many()
+ */
+static void
+batch_free(struct db_batch_op *ops, int nops)
+{
+    int i;
+
+    for (i = 0; i < nops; i++) {
+	free(ops[i].bo_key);
+	if (ops[i].bo_val)
+	    free(ops[i].bo_val);
+    }
+    free(ops);
+}
+
+/*
+ * Apply batch of operations to database in one go, see db_batch()
+ */
+static PyObject *
+batch_apply(CliconDB *self, struct db_batch_op *ops, int nops)
+{
+    int n;
+
+    n = db_batch(self->filename, ops, nops);
+    batch_free(ops, nops);
+    if (n < 0) {
+	PyErr_Format(PyExc_RuntimeError, /* XXX Need CLICON exceptions */
+		     "Failed to write data to database '%s'",
+		     self->filename);
+	return NULL;
+    }
+
+    return PyInt_FromLong(n);
+}
+
+/*
+ * Add operation to batch, growing the vector geometrically
+ */
+static int
+batch_add(struct db_batch_op **ops, int *nops, int *size, 
+	  char *key, char *val, size_t vlen)
+{
+    struct db_batch_op *new;
+
+    if (*nops == *size) {
+	*size = *size ? 2 * *size : 64;
+	if ((new = realloc(*ops, *size * sizeof(**ops))) == NULL) {
+	    PyErr_SetString(PyExc_MemoryError, "failed to allocate memory");
+	    return -1;
+	}
+	*ops = new;
+    }
+    (*ops)[*nops].bo_key = key;
+    (*ops)[*nops].bo_val = val;
+    (*ops)[*nops].bo_vlen = vlen;
+    (*nops)++;
+
+    return 0;
+}
+
+/*
+ * Write a sequence of (key, value) pairs, where value is a cligen.Cvec or a
+ * CliconDBItem, in one database operation.
+ */
+static PyObject *
+_db_put_many(CliconDB *self, PyObject *args)
+{
+    PyObject *Items;
+    PyObject *Iterator = NULL;
+    PyObject *Item = NULL;
+    PyObject *Val;
+    CliconDBItem *DBItem;
+    struct db_batch_op *ops = NULL;
+    int nops = 0;
+    int size = 0;
+    char *key;
+    char *k = NULL;
+    char *lvec = NULL;
+    size_t lvec_len;
+    cvec *vr;
+
+    if (!PyArg_ParseTuple(args, "O", &Items))
+        return NULL;
+    if ((Iterator = PyObject_GetIter(Items)) == NULL)
+	return NULL;
+
+    while ((Item = PyIter_Next(Iterator))) {
+	if (!PyArg_ParseTuple(Item, "sO;items must be (key, value) tuples",
+			      &key, &Val))
+	    goto quit;
+	if ((k = strdup(key)) == NULL) {
+	    PyErr_SetString(PyExc_MemoryError, "failed to allocate memory");
+	    goto quit;
+	}
+	if (PyObject_TypeCheck(Val, &CliconDBItem_Type)) { /* Already encoded */
+	    DBItem = (CliconDBItem *)Val;
+	    lvec_len = DBItem->lvec_len;
+	    if ((lvec = malloc(lvec_len ? lvec_len : 1)) == NULL) {
+		PyErr_SetString(PyExc_MemoryError, "failed to allocate memory");
+		goto quit;
+	    }
+	    memcpy(lvec, DBItem->lvec, lvec_len);
+	}
+	else {
+	    if ((vr = Cvec2cvec(Val)) == NULL)
+		goto quit;
+	    lvec = cvec2lvec(vr, &lvec_len);
+	    cvec_free(vr);
+	    if (lvec == NULL) {
+		PyErr_SetString(PyExc_MemoryError, "failed to allocate memory");
+		goto quit;
+	    }
+	}
+	if (batch_add(&ops, &nops, &size, k, lvec, lvec_len) < 0)
+	    goto quit;
+	k = lvec = NULL;
+	Py_DECREF(Item);
+	Item = NULL;
+    }
+    if (PyErr_Occurred())
+	goto quit;
+    Py_DECREF(Iterator);
+
+    return batch_apply(self, ops, nops);
+
+quit:
+    if (k)
+	free(k);
+    if (lvec)
+	free(lvec);
+    if (ops)
+	batch_free(ops, nops);
+    Py_XDECREF(Item);
+    Py_XDECREF(Iterator);
+
+    return NULL;
+}
+
+/*
+ * Delete a sequence of keys in one database operation
+ */
+static PyObject *
+_db_del_many(CliconDB *self, PyObject *args)
+{
+    PyObject *Keys;
+    PyObject *Iterator = NULL;
+    PyObject *Key = NULL;
+    struct db_batch_op *ops = NULL;
+    int nops = 0;
+    int size = 0;
+    char *k;
+
+    if (!PyArg_ParseTuple(args, "O", &Keys))
+        return NULL;
+    if ((Iterator = PyObject_GetIter(Keys)) == NULL)
+	return NULL;
+
+    while ((Key = PyIter_Next(Iterator))) {
+	if ((k = StringAsString(Key)) == NULL)
+	    goto quit;
+	if (batch_add(&ops, &nops, &size, k, NULL, 0) < 0) {
+	    free(k);
+	    goto quit;
 	}
-	PyTuple_SET_ITEM(Keys, i, Key);
+	Py_DECREF(Key);
+	Key = NULL;
     }
-    free(keys);
+    if (PyErr_Occurred())
+	goto quit;
+    Py_DECREF(Iterator);
+
+    return batch_apply(self, ops, nops);
 
-    return Keys;    
+quit:
+    if (ops)
+	batch_free(ops, nops);
+    Py_XDECREF(Key);
+    Py_XDECREF(Iterator);
+
+    return NULL;
+}
+
+static PyObject *
+_keys(CliconDB *self, PyObject *args)
+{
+    PyObject *Iter;
+    PyObject *Keys;
+    PyObject *Tuple;
+    char *rx = ".*";
+
+    if (!PyArg_ParseTuple(args, "|s", &rx))
+        return NULL;
+    
+    /* Read keys only, directly from a database cursor */
+    if ((Iter = PyObject_CallMethod((PyObject *)self, "_iter", "si", 
+				    rx, 1)) == NULL)
+	return NULL;
+    Keys = PySequence_List(Iter);
+    Py_DECREF(Iter);
+    if (Keys == NULL)
+	return NULL;
+    Tuple = PyList_AsTuple(Keys);
+    Py_DECREF(Keys);
+
+    return Tuple;    
 }
 
 static PyObject *
@@ -335,8 +962,9 @@ _items(CliconDB *self, PyObject *args)
 
 	/* Append tuple to list */
 	PyList_SET_ITEM(Items, i, Item);
-	    goto quit;
 	Item = NULL;
+	Py_DECREF(Capsule);
+	Capsule = NULL;
     }
 
     Retval = Items;
@@ -395,6 +1023,12 @@ static PyMethodDef CliconDB_methods[] = {
      "Get contents from databased based on key regexp"},
     {"_items",  (PyCFunction)_items, METH_VARARGS,
      "Get list of key/value tuples from database"},
+    {"_iter",  (PyCFunction)_iter, METH_VARARGS,
+     "Get iterator over database entries based on key regexp"},
+    {"_db_put_many", (PyCFunction)_db_put_many, METH_VARARGS,
+     "Write a sequence of key/value tuples to db in one operation"},
+    {"_db_del_many", (PyCFunction)_db_del_many, METH_VARARGS,
+     "Delete a sequence of keys from db in one operation"},
     {"_db2txt",  (PyCFunction)_db2txt, METH_VARARGS,
      "Generate text output based on text format and database contents"},
 
@@ -450,6 +1084,10 @@ CliconDB_init_object(PyObject *m)
 
     if (PyType_Ready(&CliconDB_Type) < 0)
         return -1;
+    if (PyType_Ready(&CliconDBItem_Type) < 0)
+        return -1;
+    if (PyType_Ready(&CliconDBIter_Type) < 0)
+        return -1;
 
     Py_INCREF(&CliconDB_Type);
     PyModule_AddObject(m, "_CliconDB", (PyObject *)&CliconDB_Type);
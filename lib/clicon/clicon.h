@@ -39,6 +39,7 @@
 #include <clicon/clicon_hash.h>
 #include <clicon/clicon_handle.h>
 #include <clicon/clicon_db.h>
+#include <clicon/clicon_dbengine.h>
 #include <clicon/clicon_dbspec_key.h>
 #include <clicon/clicon_yang.h>
 #include <clicon/clicon_yang_type.h>
@@ -62,6 +63,8 @@
 #include <clicon/clicon_plugin.h>
 #include <clicon/clicon_dbvars.h>
 #include <clicon/clicon_db2txt.h>
+#include <clicon/clicon_diff.h>
+#include <clicon/clicon_sha1.h>
 #include <clicon/clicon_plugin.h>
 
 
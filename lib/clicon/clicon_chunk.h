@@ -70,6 +70,8 @@ typedef struct _chunk_block_t {
 	void	       *cb_blk;		/* Allocated memory block */
 
 	uint16_t	cb_ref;		/* Number of used chunks of block */
+
+	struct _chunk_group_t *cb_grp;	/* The group owning the block, or NULL */
 	
 } chunk_block_t;
 
@@ -77,8 +79,6 @@ typedef struct _chunk_block_t {
 /*
  * The chunk header.
  */
-struct _chunk_grpent_t;
-typedef struct _chunk_grpent_t chunk_grpent_t;
 typedef struct _chunk_t {
 	qelem_t		c_qelem;	/* Circular queue of chunks */
 
@@ -87,8 +87,6 @@ typedef struct _chunk_t {
 #ifdef CHUNK_DIAG
     	chunk_diag_t	c_diag;		/* The diagnostics structure */
 #endif /* CHUNK_DIAG */
-
-	chunk_grpent_t *c_grpent;
 } chunk_t;
 
 /*
@@ -113,28 +111,31 @@ struct _chunk_head_t {
 
 
 /*
- * The chunk group structure.
+ * Number of buckets in the chunk group hash table. Must be a power of 2.
  */
-typedef struct _chunk_group_t {
-	qelem_t		cg_qelem;	/* List of chunk groups */
-	
-	char           *cg_name;	/* Name of group */
-	
-	chunk_grpent_t *cg_ent;		/* List of chunks in the group */
-
-} chunk_group_t;
+#define CHUNK_GRP_HASHSZ	256
 
+/*
+ * Max number of released one-page blocks kept for reuse instead of unmapped.
+ */
+#define CHUNK_SPARE	16
 
 /*
- * The chunk group entry structure.
+ * The chunk group structure. A group allocates from blocks of its own, so
+ * releasing the group unmaps its blocks without visiting each chunk.
  */
-struct _chunk_grpent_t {
-	qelem_t		ce_qelem;	/* Circular list of entries */
+typedef struct _chunk_group_t {
+	qelem_t		cg_qelem;	/* List of chunk groups in hash bucket */
+	
+	char           *cg_name;	/* Name of group */
+
+	uint32_t	cg_hash;	/* Hash value of name */
 	
-	chunk_group_t  *ce_grp;		/* The group I belong to */
+	int		cg_ref;		/* Number of chunks in use in the group */
 
-	chunk_t	       *ce_cnk;		/* Pointer to the chunk */
-}; 
+	chunk_head_t	cg_heads[CHUNK_HEADS]; /* Blocks and chunks of the group */
+
+} chunk_group_t;
 
 /*
  * Public function declarations
@@ -52,11 +52,31 @@ struct db_pair {
     int dp_vlen;   /* length of vector of lvalues */
 };
 
+/* Database cursor, struct defined in clicon_qdb.c */
+typedef struct db_cursor db_cursor;
+
+/* One operation of db_batch(): set key to value, or delete key if bo_val 
+ * is NULL */
+struct db_batch_op {
+    char   *bo_key;   /* database key */
+    void   *bo_val;   /* value (lvec) to set, or NULL to delete key */
+    size_t  bo_vlen;  /* length of value */
+};
+
+/* Filter callback for db_regexp_filter(). 
+ * returns 1 to keep entry, 2 to keep entry and stop, 0 to skip it, 
+ * and -1 on error (and break) */
+typedef int (db_filter_t)(char *key, char *val, int vlen, void *arg);
+
 /*
  * Prototypes
  */ 
 int db_init(char *file);
 
+int db_init_size(char *file, int nkeys);
+
+int db_size(char *file);
+
 int db_set(char *file, char *key, void *data, size_t datalen);
 
 int db_get(char *file, char *key, void *data, size_t *datalen);
@@ -65,11 +85,39 @@ int db_get_alloc(char *file, char *key, void **data, size_t *datalen);
 
 int db_del(char *file, char *key);
 
+int db_batch(char *file, struct db_batch_op *ops, int nops);
+
 int db_exists(char *file, char *key);
 
+int db_seq_next(char *file, char *key, int init, int increment);
+
 int db_regexp(char *file, char *regexp, const char *label, 
 	      struct db_pair **pairs, int noval);
 
+int db_regexp_filter(char *file, char *regexp, const char *label, 
+		     struct db_pair **pairs, int noval,
+		     db_filter_t *filter, void *farg);
+
+db_cursor *db_cursor_open(char *file, char *regexp, int noval);
+
+int db_cursor_next(db_cursor *dc, char **key, char **val, int *vlen);
+
+void db_cursor_close(db_cursor *dc);
+
+int db_overlay_init(char *file, char *base);
+
+int db_overlay_current(char *file);
+
+int db_overlay_changes(char *file, char ***keys, int *nkeys, char **stamp);
+
+int db_stamp(char *file, char *stamp);
+
+int db_copy(char *src, char *target);
+
+int db_rename(char *src, char *target);
+
+int db_remove(char *file);
+
 char *db_sanitize(char *rx, const char *label);
 
 #endif  /* _CLICON_DB_H_ */
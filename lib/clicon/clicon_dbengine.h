@@ -0,0 +1,134 @@
+/*
+ *
+  Copyright (C) 2009-2015 Olof Hagsand and Benny Holmgren
+
+  This file is part of CLICON.
+
+  CLICON is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  CLICON is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with CLICON; see the file COPYING.  If not, see
+  <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef _CLICON_DBENGINE_H_
+#define _CLICON_DBENGINE_H_
+
+/*
+ * Storage engines.
+ * The database API in clicon_db.h (db_set(), db_get(), db_cursor_open(),..)
+ * stores keys and values in a storage engine given by the struct below.
+ * One engine is used for all databases of a process, selected with
+ * db_engine_set(), eg from option CLICON_DB_ENGINE. All processes using the
+ * same database files must use the same engine.
+ * Built-in engines:
+ *   depot   QDBM Depot hash database, one file per database (default)
+ *   memory  Ordered in-memory database loaded from a checkpoint file and a
+ *           write-ahead log (<file>.wal), see clicon_dbmem.c
+ * A process may also keep an image of a database file in memory, see 
+ * db_image_open(), and write a database file as snapshots so that readers 
+ * are never blocked, see db_snapshot_open().
+ */
+
+/* Open modes of de_open */
+#define DB_OREADER 0x01 /* Open for reading */
+#define DB_OWRITER 0x02 /* Open for reading and writing, one writer at a time */
+#define DB_OCREAT  0x04 /* Writer: create database if it does not exist */
+#define DB_OTRUNC  0x08 /* Writer: remove all entries */
+#define DB_OMEMORY 0x10 /* memory engine: database only in memory, no files */
+
+#define DB_STAMPLEN 128 /* Size of de_stamp buffer */
+
+/* Key with version of database file, written by dbe_close() when a writer
+   has changed the file. Not returned by db_cursor_next() */
+#define DB_VERSION_KEY "\001version"
+
+/*
+ * Storage engine. An open database is an opaque handle returned by de_open.
+ * All functions call clicon_err() on error.
+ * Functions returning int return -1 on error, if not stated otherwise.
+ */
+struct db_engine {
+    char  *de_name;
+    int    de_ordered;  /* Iteration is in key (strcmp) order */
+    /* Open database file. nkeys is a hint of the number of entries (0 if
+       unknown) */
+    void *(*de_open)(char *file, int mode, int nkeys);
+    int   (*de_close)(void *eh);
+    /* Get value of key, malloced in *val, or only check existence if val is
+       NULL. vlen may be NULL. Returns 1 if found, 0 if not found */
+    int   (*de_get)(void *eh, char *key, char **val, int *vlen);
+    int   (*de_put)(void *eh, char *key, void *val, int vlen);
+    /* Delete key. Returns 1 if deleted, 0 if not found */
+    int   (*de_del)(void *eh, char *key);
+    /* Number of entries */
+    int   (*de_count)(void *eh);
+    /* Start iteration. Ordered engines start at the first key >= from,
+       others ignore from. from may be NULL */
+    int   (*de_iterinit)(void *eh, char *from);
+    /* Next key, malloced. Returns 1 if key returned, 0 at end */
+    int   (*de_iternext)(void *eh, char **key);
+    /* Transactions of a writer: changes after de_txn_begin are undone by
+       de_txn_abort. NULL if engine has no transactions, then changes are
+       not undone */
+    int   (*de_txn_begin)(void *eh);
+    int   (*de_txn_commit)(void *eh);
+    int   (*de_txn_abort)(void *eh);
+    /* Operations on closed database files */
+    int   (*de_copy)(char *src, char *target);
+    int   (*de_rename)(char *src, char *target);
+    int   (*de_remove)(char *file);
+    /* Change stamp of database file: a string that changes when the database
+       is changed by any process, "" if the file does not exist */
+    int   (*de_stamp)(char *file, char *stamp);
+};
+
+/*
+ * Prototypes
+ */
+int   db_engine_register(struct db_engine *de);
+
+int   db_engine_set(char *name);
+
+struct db_engine *db_engine_get(void);
+
+void *dbe_open(char *file, int mode, int nkeys);
+
+int   dbe_close(void *eh);
+
+int   dbe_get(void *eh, char *key, char **val, int *vlen);
+
+int   dbe_put(void *eh, char *key, void *val, int vlen);
+
+int   dbe_del(void *eh, char *key);
+
+int   dbe_count(void *eh);
+
+int   dbe_iterinit(void *eh, char *from);
+
+int   dbe_iternext(void *eh, char **key);
+
+int   dbe_txn_begin(void *eh);
+
+int   dbe_txn_commit(void *eh);
+
+int   dbe_txn_abort(void *eh);
+
+int   db_snapshot_open(char *file);
+
+int   db_snapshot_close(char *file);
+
+int   db_image_open(char *file);
+
+int   db_image_close(char *file);
+
+#endif  /* _CLICON_DBENGINE_H_ */
@@ -58,6 +58,8 @@ struct lvalue *cv2lv (cg_var *cgv);
 
 char *lv2str(struct lvalue *lv);
 
+struct lvalue *lvec_find(char *lvec, int vlen, char *name);
+
 char *db_gen_rxkey(char *basekey, const char *label);
 
 char *dbspec_unique_str(dbspec_key *ds, cvec *setvars);
@@ -0,0 +1,33 @@
+/*
+ *
+  Copyright (C) 2009-2015 Olof Hagsand and Benny Holmgren
+
+  This file is part of CLICON.
+
+  CLICON is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  CLICON is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with CLICON; see the file COPYING.  If not, see
+  <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef _CLICON_DIFF_H_
+#define _CLICON_DIFF_H_
+
+/*
+ * Prototypes
+ */
+int clicon_diff_lines(FILE *f, char **lines1, int n1, char **lines2, int n2,
+		      int context);
+int clicon_diff_buf(FILE *f, char *buf1, char *buf2, int context);
+
+#endif  /* _CLICON_DIFF_H_ */
@@ -34,6 +34,8 @@ int clicon_exit_get(void);
 
 int event_reg_fd(int fd, int (*fn)(int, void*), void *arg, char *str);
 
+int event_reg_fd_write(int fd, int (*fn)(int, void*), void *arg, char *str);
+
 int event_unreg_fd(int s, int (*fn)(int, void*));
 
 int event_reg_timeout(struct timeval t,  int (*fn)(int, void*), 
@@ -25,7 +25,6 @@
 #define _CLICON_HASH_H_
 
 struct clicon_hash {
-    qelem_t	h_qelem;
     char       *h_key;
     size_t	h_vlen;
     void       *h_val;
@@ -40,11 +39,12 @@ clicon_hash_t hash_add (clicon_hash_t *head, const char *key, void *val, size_t
 int hash_del (clicon_hash_t *head, const char *key);
 void hash_dump(clicon_hash_t *head, FILE *f);
 char **hash_keys(clicon_hash_t *hash, size_t *nkeys);
+clicon_hash_t hash_next(clicon_hash_t *hash, size_t *iter);
 
 
 /*
- *   Macros to iterate over hash contents.
- *   XXX A bit crude. Just as easy for app to loop through the keys itself.
+ *   Macros to iterate over hash contents, without allocation. Entries may be
+ *   deleted but not added in the loop, see hash_next().
  *
  *  Example:
  *     char *k;
@@ -60,12 +60,11 @@ char **hash_keys(clicon_hash_t *hash, size_t *nkeys);
 */
 #define hash_each(__hash__, __key__) 					\
 {									\
-    int __i__;								\
-    size_t __n__;							\
-    char **__k__ = hash_keys((__hash__),&__n__);			\
-    if (__k__) {							\
-        for(__i__ = 0; __i__ < __n__ && ((__key__) = __k__[__i__]); __i__++)
-#define hash_each_end(__hash__)	 if (__k__) free(__k__);  } }
+    size_t __i__ = 0;							\
+    clicon_hash_t __h__;						\
+    while ((__h__ = hash_next((__hash__), &__i__)) != NULL &&		\
+	   ((__key__) = __h__->h_key) != NULL)
+#define hash_each_end(__hash__)	 }
 
 
 #endif /* _CLICON_HASH_H_ */
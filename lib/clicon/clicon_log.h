@@ -32,6 +32,9 @@
 #define CLICON_LOG_STDERR 2 /* print logs on stderr */
 #define CLICON_LOG_STDOUT 4 /* print logs on stdout */
 
+/* Log messages shorter than this are formatted on the stack */
+#define CLICON_LOG_BUFLEN 1024
+
 /*
  * Types
  */
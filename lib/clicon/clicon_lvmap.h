@@ -107,6 +107,8 @@ struct lm_iter{
 /*
  * Prototypes
  */ 
+int lvmap_key_cmp(const char *k1, const char *k2);
+
 int lvmap_get_dbregex_sort (const void *p1, const void *p2);
 
 int lvmap_get_dbregex(char *dbname, struct lvmap *lm, char *basekey,
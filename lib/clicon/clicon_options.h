@@ -85,6 +85,7 @@ char *clicon_cli_dir(clicon_handle h);
 char *clicon_clispec_dir(clicon_handle h);
 char *clicon_netconf_dir(clicon_handle h);
 char *clicon_archive_dir(clicon_handle h);
+char *clicon_db_engine(clicon_handle h);
 char *clicon_startup_config(clicon_handle h);
 char *clicon_sock(clicon_handle h);
 char *clicon_backend_pidfile(clicon_handle h);
@@ -104,6 +105,9 @@ int clicon_autocommit_set(clicon_handle h, int val);
 
 int clicon_commit_order(clicon_handle h);
 
+int clicon_backend_db_image(clicon_handle h);
+int clicon_backend_db_snapshot(clicon_handle h);
+
 dbspec_key *clicon_dbspec_key(clicon_handle h);
 int clicon_dbspec_key_set(clicon_handle h, dbspec_key *ds);
 
@@ -79,12 +79,14 @@ enum clicon_msg_type{
 		       */
     CLICON_MSG_LOCK ,   /* Lock a database. Body is
 			  1. name of db
+			  2. key of subtree to lock, empty for whole db
 			  The reply will be OK, or ERROR. If error is
 			  lock-denied, the session-id of the locking
 			  entity is returned (cf netconf)
 		       */
     CLICON_MSG_UNLOCK , /* Unlock a database. Body is:
 			  1. name of db *
+			  2. key of subtree to unlock, empty for whole db
 		       */
     CLICON_MSG_KILL, /* Kill (other) session:
 			  1. session-id
@@ -105,12 +107,16 @@ enum clicon_msg_type{
     CLICON_MSG_NOTIFY,   /* Notification. Body is:
 			    1. int: loglevel
 			    2. event: log message. */
-    CLICON_MSG_ERR       /* server->client reply. 
+    CLICON_MSG_ERR,      /* server->client reply. 
 			    Body is:
 			    1. uint32: man error category
 			    2. uint32: sub-error
 			    3. string: reason
 			 */
+    CLICON_MSG_ROLLBACK, /* Restore a snapshot into a database. Body is:
+			  1. uint32: snapshot number, 0 is most recent
+			  2. string: name of database to restore into
+		       */
 };
 
 /* Protocol message header */
@@ -35,10 +35,13 @@ int clicon_proto_commit(char *spath, char *running_db, char *db,
 int clicon_proto_validate(char *spath, char *db);
 int clicon_proto_save(char *spath, char *dbname, int snapshot, char *filename);
 int clicon_proto_load(char *spath, int replace, char *db, char *filename);
+int clicon_proto_rollback(char *spath, int snapshot, char *db);
 int clicon_proto_initdb(char *spath, char *filename);
 int clicon_proto_rm(char *spath, char *filename);
 int clicon_proto_lock(char *spath, char *dbname);
 int clicon_proto_unlock(char *spath, char *dbname);
+int clicon_proto_partial_lock(char *spath, char *dbname, char *key);
+int clicon_proto_partial_unlock(char *spath, char *dbname, char *key);
 int clicon_proto_kill(char *spath, int session_id);
 int clicon_proto_subscription(char *spath, int status, char *stream, 
 			      enum format_enum format, char *filter, int *s);
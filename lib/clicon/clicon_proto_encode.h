@@ -101,16 +101,18 @@ clicon_msg_copy_decode(struct clicon_msg *msg,
 		      const char *label);
 
 struct clicon_msg *
-clicon_msg_lock_encode(char *db, const char *label);
+clicon_msg_lock_encode(char *db, char *key, const char *label);
 
 int
-clicon_msg_lock_decode(struct clicon_msg *msg, char **db, const char *label);
+clicon_msg_lock_decode(struct clicon_msg *msg, char **db, char **key,
+		       const char *label);
 
 struct clicon_msg *
-clicon_msg_unlock_encode(char *db, const char *label);
+clicon_msg_unlock_encode(char *db, char *key, const char *label);
 
 int
-clicon_msg_unlock_decode(struct clicon_msg *msg, char **db, const char *label);
+clicon_msg_unlock_decode(struct clicon_msg *msg, char **db, char **key,
+			 const char *label);
 
 struct clicon_msg *
 clicon_msg_kill_encode(uint32_t session_id, const char *label);
@@ -150,6 +152,13 @@ int clicon_msg_subscription_decode(struct clicon_msg *msg,
 				   char             **filter, 
 				   const char        *label);
 
+struct clicon_msg *
+clicon_msg_rollback_encode(char *db, uint32_t snapshot, const char *label);
+
+int
+clicon_msg_rollback_decode(struct clicon_msg *msg, 
+			   char **db, uint32_t *snapshot, const char *label);
+
 struct clicon_msg *
 clicon_msg_notify_encode(int level, char *event, const char *label);
 
@@ -27,5 +27,6 @@
  *  Function Prototypes
  */
 char *clicon_sha1hex(const char *str);
+char *clicon_sha1hex_buf(const void *buf, size_t len);
 
 #endif /* _CLICON_SHA1_H_ */
@@ -23,9 +23,26 @@
 #ifndef _CLICON_XSL_H
 #define _CLICON_XSL_H
 
+/*
+ * Types
+ */
+/* Compiled xpath, struct defined in clicon_xsl.c */
+typedef struct xpath_plan xpath_plan;
+
+/* Cursor over matches of a compiled xpath, struct defined in clicon_xsl.c */
+typedef struct xpath_cursor xpath_cursor;
+
 /*
  * Prototypes
  */
+xpath_plan *xpath_compile(char *xpath);
+void    xpath_plan_free(xpath_plan *xc);
+cxobj  *xpath_plan_first(cxobj *xn_top, xpath_plan *xc);
+cxobj **xpath_plan_vec(cxobj *xn_top, xpath_plan *xc, int *xv_len);
+int     xpath_plan_roots(xpath_plan *xc, char ***vec, int *len);
+xpath_cursor *xpath_cursor_open(cxobj *xn_top, xpath_plan *xc);
+cxobj  *xpath_cursor_next(xpath_cursor *xcur);
+void    xpath_cursor_close(xpath_cursor *xcur);
 cxobj *xpath_first(cxobj *xn_top, char *xpath);
 cxobj *xpath_each(cxobj *xn_top, char *xpath, cxobj *prev);
 cxobj **xpath_vec(cxobj *xn_top, char *xpath, int *xv_len);
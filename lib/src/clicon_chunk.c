@@ -55,14 +55,16 @@ static int		chunk_pagesz;
 
 
 /*
- * List of chunk groups
+ * Hash table of chunk groups. Each bucket is a circular list of groups.
  */
-static chunk_group_t	*chunk_grp;
+static chunk_group_t	*chunk_grp[CHUNK_GRP_HASHSZ];
+
 
 /*
- * Hack to tell unchunk() not to remove chunk_group if empty
+ * Released one-page blocks kept for reuse by any chunk head.
  */
-static int		dont_unchunk_group;
+static chunk_block_t	*chunk_spare[CHUNK_SPARE];
+static int		chunk_nspare = 0;
 
 
 /*
@@ -110,8 +112,7 @@ chunk_initialize ()
 	}
 
 	/* Zero misc variables */
-	chunk_grp = NULL;
-	dont_unchunk_group = 0;
+	bzero (&chunk_grp, sizeof (chunk_grp));
   
 	chunk_initialized = 1;
 }
@@ -121,34 +122,44 @@ chunk_initialize ()
  * chunk_new_block()	- Allocate new block, initialize it and it's chunks.
  */
 static int
-chunk_new_block (chunk_head_t *chead)
+chunk_new_block (chunk_head_t *chead, chunk_group_t *grp)
 {
 	register int	idx;
 	register char  *c;
 	chunk_block_t  *blk;
 	chunk_t	       *cnk;
 
-	/* Map block header mem */
-	blk = (chunk_block_t *)
-		mmap(NULL, sizeof(chunk_block_t),
-		     PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
-	if (blk == MAP_FAILED)
-		return -1;
-	memset ((void *)blk, 0, sizeof(*blk));
-
-	/* Allocate chunk block */
-	blk->cb_blk = (void *)
-		mmap(NULL, chead->ch_blksz, 
-		     PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
-	if (blk->cb_blk == MAP_FAILED) {
-	    munmap (blk, chead->ch_blksz);
-	    return -1;
+	/* Reuse a spare block if there is one of the right size */
+	if (chead->ch_blksz == chunk_pagesz && chunk_nspare > 0) {
+		blk = chunk_spare[--chunk_nspare];
+		c = blk->cb_blk;
+		memset ((void *)blk, 0, sizeof(*blk));
+		blk->cb_blk = c;
+	}
+	else {
+		/* Map block header mem */
+		blk = (chunk_block_t *)
+			mmap(NULL, sizeof(chunk_block_t),
+			     PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+		if (blk == MAP_FAILED)
+			return -1;
+		memset ((void *)blk, 0, sizeof(*blk));
+
+		/* Allocate chunk block */
+		blk->cb_blk = (void *)
+			mmap(NULL, chead->ch_blksz, 
+			     PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+		if (blk->cb_blk == MAP_FAILED) {
+		    munmap (blk, chead->ch_blksz);
+		    return -1;
+		}
 	}
 	memset (blk->cb_blk, 0, chead->ch_blksz);
 
 	
 	/* Initialize chunk header */
 	blk->cb_head = chead;
+	blk->cb_grp = grp;
 	INSQ (blk, chead->ch_blks);
 	chead->ch_nblks++;
 
@@ -168,6 +179,20 @@ chunk_new_block (chunk_head_t *chead)
 	return 0;
 }
 
+/*
+ * chunk_unmap_block()	- Free block mem, or keep it as a spare block
+ */
+static void
+chunk_unmap_block (chunk_block_t *cblk, size_t blksz)
+{
+	if (blksz == chunk_pagesz && chunk_nspare < CHUNK_SPARE) {
+		chunk_spare[chunk_nspare++] = cblk;
+		return;
+	}
+	munmap ((void *)cblk->cb_blk, blksz);
+	munmap ((void *)cblk, sizeof(*cblk));
+}
+
 /*
  * chunk_release_block()	- Unqueue a block, it's chunks and free mem
  */
@@ -204,17 +229,17 @@ chunk_release_block (chunk_block_t *cblk)
 	/*
 	 * Free block 
 	 */
-	munmap ((void *)cblk->cb_blk, chead->ch_blksz);
-	munmap ((void *)cblk, sizeof(*cblk));
+	chunk_unmap_block (cblk, chead->ch_blksz);
 }
 
 
 
 /*
- * chunk_alloc()	- Map new chunk of memory
+ * chunk_alloc()	- Map new chunk of memory, from the blocks of the group
+ *			  if one is given
  */
 static void *
-chunk_alloc (size_t len)
+chunk_alloc (size_t len, chunk_group_t *grp)
 {
 	register int	idx;
 	chunk_head_t   *chead;
@@ -237,12 +262,12 @@ chunk_alloc (size_t len)
 		return (void *)NULL;
 	}
 
-	chead = &chunk_heads[idx];
+	chead = grp ? &grp->cg_heads[idx] : &chunk_heads[idx];
 
 	
 	/* Get new block if necessary */
 	if (!chead->ch_nfree)
-		if (chunk_new_block (chead))
+		if (chunk_new_block (chead, grp))
  			return (void *)NULL;
 		
 
@@ -253,6 +278,8 @@ chunk_alloc (size_t len)
 	INSQ (cnk, chead->ch_cnks);
 	/* Add reference to the corresponding block */
 	cnk->c_blk->cb_ref++;
+	if (grp)
+		grp->cg_ref++;
 	
 #ifdef CHUNK_DIAG
 	/* Clear diag info */
@@ -263,6 +290,123 @@ chunk_alloc (size_t len)
 	return (void *) (cnk + 1);
 }
 
+/*
+ * chunk_free()	- Move chunk back to free list. The group use count is not
+ *		  handled here.
+ */
+static void
+chunk_free (chunk_t *cnk)
+{
+	chunk_head_t	*chead;
+	chunk_block_t	*cblk;
+
+	cblk = cnk->c_blk;
+	chead = cblk->cb_head;
+
+	/* Move chunk back to free list
+	 */
+	DELQ (cnk, chead->ch_cnks, chunk_t *);
+	INSQ (cnk, chead->ch_free);
+	chead->ch_nfree++;
+
+	/* Check block refs is nil, if so free it
+	 */
+	cblk->cb_ref--;
+	if (cblk->cb_ref == 0)
+		chunk_release_block (cblk);
+}
+
+/*
+ * chunk_grp_hash()	- Hash value of group name (FNV-1a)
+ */
+static uint32_t
+chunk_grp_hash (const char *name)
+{
+	uint32_t h = 2166136261u;
+
+	while (*name) {
+		h ^= (uint8_t)*name++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/*
+ * chunk_grp_find()	- Find group by name in hash table
+ */
+static chunk_group_t *
+chunk_grp_find (const char *name, uint32_t h)
+{
+	chunk_group_t	*tmp;
+	chunk_group_t	*head;
+
+	head = chunk_grp[h & (CHUNK_GRP_HASHSZ-1)];
+	if ((tmp = head) != NULL) {
+		do {
+			if (tmp->cg_hash == h && !strcmp (tmp->cg_name, name))
+				return tmp;
+			tmp = NEXTQ(chunk_group_t *, tmp);
+		} while (tmp != head);
+	}
+	return NULL;
+}
+
+/*
+ * chunk_grp_new()	- Create group and add it to hash table
+ */
+static chunk_group_t *
+chunk_grp_new (const char *name, uint32_t h)
+{
+	int		 idx;
+	chunk_group_t	*grp;
+
+	grp = (chunk_group_t *) chunk_alloc (sizeof (chunk_group_t), NULL);
+	if (!grp)
+		return NULL;
+	bzero (grp, sizeof (chunk_group_t));
+
+	grp->cg_name = (char *) chunk_alloc (strlen (name) + 1, NULL);
+	if (!grp->cg_name) {
+		chunk_free ((chunk_t *)(((char *)grp) - sizeof (chunk_t)));
+		return NULL;
+	}
+	bcopy (name, grp->cg_name, strlen(name)+1);
+	grp->cg_hash = h;
+
+	/* The group heads have the same sizes as the global heads */
+	for (idx = 0; idx < CHUNK_HEADS; idx++) {
+		grp->cg_heads[idx].ch_size = chunk_heads[idx].ch_size;
+		grp->cg_heads[idx].ch_nchkperblk = chunk_heads[idx].ch_nchkperblk;
+		grp->cg_heads[idx].ch_blksz = chunk_heads[idx].ch_blksz;
+	}
+
+	INSQ (grp, chunk_grp[h & (CHUNK_GRP_HASHSZ-1)]);
+	return grp;
+}
+
+/*
+ * chunk_grp_release()	- Remove group from hash table and free it together
+ *			  with all its blocks. The chunks are not visited.
+ */
+static void
+chunk_grp_release (chunk_group_t *grp)
+{
+	int		 idx;
+	chunk_head_t	*chead;
+	chunk_block_t	*cblk;
+
+	DELQ (grp, chunk_grp[grp->cg_hash & (CHUNK_GRP_HASHSZ-1)], chunk_group_t *);
+	for (idx = 0; idx < CHUNK_HEADS; idx++) {
+		chead = &grp->cg_heads[idx];
+		while ((cblk = chead->ch_blks) != NULL) {
+			DELQ (cblk, chead->ch_blks, chunk_block_t *);
+			chunk_unmap_block (cblk, chead->ch_blksz);
+		}
+	}
+	chunk_free ((chunk_t *)(((char *)grp->cg_name) - sizeof (chunk_t)));
+	chunk_free ((chunk_t *)(((char *)grp) - sizeof (chunk_t)));
+}
+
 
 /*
  * chunk()	- Map new chunk of memory in group
@@ -274,12 +418,10 @@ _chunk (size_t len, const char *name, const char *file, int line)
 chunk (size_t len, const char *name)
 #endif
 {
-	int		 newgrp = 0;
+	uint32_t	 h;
 	void		*ptr = NULL;
 	chunk_t		*cnk;
-	chunk_group_t	*tmp;
 	chunk_group_t	*grp = NULL;
-	chunk_grpent_t	*ent = NULL;
 	
 	/* Make sure chunk_heads are initialized */
 	if (!chunk_initialized)
@@ -288,11 +430,24 @@ chunk (size_t len, const char *name)
 	if (!len)
 		return (void *)NULL;
 
+	/* Find the group, or create it if it does not exist. No name
+	 * given means an ungrouped chunk.
+	 */
+	if (name) {
+		h = chunk_grp_hash (name);
+		if ((grp = chunk_grp_find (name, h)) == NULL &&
+		    (grp = chunk_grp_new (name, h)) == NULL)
+			return (void *)NULL;
+	}
+
 	/* Get actual chunk 
 	 */
-	ptr = chunk_alloc (len);
-	if (!ptr)
-		goto error;
+	ptr = chunk_alloc (len, grp);
+	if (!ptr) {
+		if (grp && grp->cg_ref == 0)
+			chunk_grp_release (grp);
+		return (void *)NULL;
+	}
 	cnk = (chunk_t *) (((char *)ptr) - sizeof (chunk_t));
 
 #ifdef CHUNK_DIAG
@@ -302,77 +457,7 @@ chunk (size_t len, const char *name)
 	cnk->c_diag.cd_line = line;
 #endif /* CHUNK_DIAG */
 
-	/* No name given. Get an ungrouped chunk
-	 */
-	if (!name)
-		return ptr;
-
-
-	/* Try to find already existing entry 
-	 */
-	if (chunk_grp) {
-		tmp = chunk_grp;
-		do {
-			if (!strcmp (tmp->cg_name, name)) {
-				grp = tmp;
-				break;
-			}
-			
-			tmp = NEXTQ(chunk_group_t *, tmp);
-			
-		} while (tmp != chunk_grp);
-	}
-
-	/* New group.
-	 */
-	if ( !grp ) {
-		
-		grp = (chunk_group_t *) chunk_alloc (sizeof (chunk_group_t));
-		if (!grp)
-			goto error;
-
-		bzero (grp, sizeof (chunk_group_t));
-
-		grp->cg_name = (char *) chunk_alloc (strlen (name) + 1);
-		if (!grp->cg_name)
-		  goto error;
-		bcopy (name, grp->cg_name, strlen(name)+1);
-		newgrp = 1;
-	}
-		
-	
-	/* Get new entry.
-	 */
-	ent = (chunk_grpent_t *) chunk_alloc (sizeof (chunk_grpent_t));
-	if (!ent)
-		goto error;
-	bzero (ent, sizeof (chunk_grpent_t));
-
-	/* Now put everything together
-	 */
-	cnk->c_grpent = ent;
-	
-	ent->ce_cnk = cnk;
-	ent->ce_grp = grp;
-
-	INSQ (ent, grp->cg_ent);
-	if (newgrp)
-		INSQ (grp, chunk_grp);
-	
 	return (ptr);
-
- error:
-	if (grp && newgrp) {
-	  	if (grp->cg_name)
-		 	unchunk (grp->cg_name);
-		unchunk (grp);
-	}
-	if (ent)
-		unchunk (ent);
-	if (ptr)
-		unchunk (ptr);
-	
-	return (void *)	NULL;
 }
 
 
@@ -463,9 +548,6 @@ void
 unchunk (void *ptr)
 {
 	chunk_t		*cnk;
-	chunk_head_t	*chead;
-	chunk_block_t	*cblk;
-	chunk_grpent_t	*ent;
 	chunk_group_t	*grp;
 
 	if (!chunk_initialized)
@@ -474,37 +556,14 @@ unchunk (void *ptr)
 	/* Rewind pointer to beginning of chunk header 
 	 */
 	cnk = (chunk_t *) (((char *)ptr) - sizeof (chunk_t));
-	cblk = cnk->c_blk;
-	chead = cblk->cb_head;
-
-	/* Move chunk back to free list
-	 */
-	DELQ (cnk, chead->ch_cnks, chunk_t *);
-	INSQ (cnk, chead->ch_free);
-	chead->ch_nfree++;
+	grp = cnk->c_blk->cb_grp;
 
-	/* If chunk is grouped, remove from group.
-	 */
-	ent = cnk->c_grpent;
-	if (ent) {
-		grp = ent->ce_grp;
-		DELQ (ent, grp->cg_ent, chunk_grpent_t *);
-		unchunk (ent);
-		cnk->c_grpent = NULL;
-
-		/* Group empty? */
-		if (!dont_unchunk_group && !grp->cg_ent) {
-			DELQ (grp, chunk_grp, chunk_group_t *);
-			unchunk(grp->cg_name);
-			unchunk(grp);
-		}
-	}
+	chunk_free (cnk);
 
-	/* Check block refs is nil, if so free it
+	/* If chunk is grouped and the group is now empty, release it.
 	 */
-	cblk->cb_ref--;
-	if (cblk->cb_ref == 0)
-		chunk_release_block (cblk);
+	if (grp && --grp->cg_ref == 0)
+		chunk_grp_release (grp);
 }
 
 
@@ -514,46 +573,19 @@ unchunk (void *ptr)
 void
 unchunk_group (const char *name)
 {
-	chunk_group_t	*tmp;
-	chunk_group_t	*grp = NULL;
-	chunk_t		*cnk;
+	chunk_group_t	*grp;
 
 	if (!chunk_initialized)
 		return;
 
 	/* Try to find already existing entry 
 	 */
-	if (chunk_grp) {
-		tmp = chunk_grp;
-		do {
-			if (!strcmp (tmp->cg_name, name)) {
-				grp = tmp;
-				break;
-			}
-			
-			tmp = NEXTQ(chunk_group_t *, tmp);
-			
-		} while (tmp != chunk_grp);
-	}
-	if (!grp)
+	if ((grp = chunk_grp_find (name, chunk_grp_hash (name))) == NULL)
 		return;
 
-
-	/* Walk through all chunks in group an free them
+	/* Remove group from hash table and free it with all its blocks.
 	 */
-	dont_unchunk_group = 1;
-	while (grp->cg_ent) {
-		cnk = grp->cg_ent->ce_cnk;
-		unchunk ((chunk_t *)(((char *)cnk) + sizeof (chunk_t)));
-	}
-	dont_unchunk_group = 0;
-		
-
-	/* Remove group from list and free it 
-	 */
-	DELQ (grp, chunk_grp, chunk_group_t *);
-	unchunk (grp->cg_name);
-	unchunk (grp);
+	chunk_grp_release (grp);
 }
 
 /*
@@ -687,6 +719,40 @@ chunk_sprintf (const char *name, char *fmt, ...)
 }
 
 #ifdef CHUNK_DIAG
+/*
+ * chunk_check_heads()	- Report all non-freed chunks of a chunk head vector
+ */
+static void
+chunk_check_heads(FILE *fout, chunk_head_t *heads, const char *grpname)
+{
+	int		idx;
+	chunk_t	       *cnk;
+
+	for (idx = 0; idx < CHUNK_HEADS; idx++) {
+		chunk_head_t *chead = &heads[idx];
+
+		cnk = chead->ch_cnks;
+		if (cnk == (chunk_t *)NULL)
+		    continue;
+
+		do {
+		    
+			/* If no file name it's an internal chunk */
+			if (cnk->c_diag.cd_file) 
+				fprintf(fout ? fout : stdout,
+					"%s:%d,\t%zu bytes (%p), group \"%s\"\n", 
+					cnk->c_diag.cd_file,
+					cnk->c_diag.cd_line,
+					chead->ch_size,
+					(cnk +1),
+					grpname ? grpname : "NULL");
+
+			cnk = NEXTQ(chunk_t *, cnk);
+			
+		} while (cnk != chead->ch_cnks);
+	}
+}
+
 /*
  * chunk_check()	- Report all non-freed chunk for given group (if any)
  */
@@ -694,10 +760,7 @@ void
 chunk_check(FILE *fout, const char *name)
 {
 	int		idx;
-	chunk_t	       *cnk;
-	chunk_group_t  *tmp;
 	chunk_group_t  *grp = NULL;
-	chunk_grpent_t *ent;
 
 
 	if (!chunk_initialized)
@@ -708,30 +771,14 @@ chunk_check(FILE *fout, const char *name)
 	 */
 	if (name == (const char *)NULL) {
 	    
-		for (idx = 0; idx < CHUNK_HEADS; idx++) {
-			chunk_head_t *chead = &chunk_heads[idx];
-
-			cnk = chead->ch_cnks;
-			if (cnk == (chunk_t *)NULL)
-			    continue;
-
+		chunk_check_heads(fout, chunk_heads, NULL);
+		for (idx = 0; idx < CHUNK_GRP_HASHSZ; idx++) {
+			if ((grp = chunk_grp[idx]) == NULL)
+				continue;
 			do {
-			    
-				/* If no file name it's an internal chunk */
-				if (cnk->c_diag.cd_file) 
-					fprintf(fout ? fout : stdout,
-						"%s:%d,\t%zu bytes (%p), group \"%s\"\n", 
-						cnk->c_diag.cd_file,
-						cnk->c_diag.cd_line,
-						cnk->c_blk->cb_head->ch_size,
-						(cnk +1),
-						cnk->c_grpent ? 
-						    cnk->c_grpent->ce_grp->cg_name :
-						    "NULL");
-
-				cnk = NEXTQ(chunk_t *, cnk);
-				
-			} while (cnk != chead->ch_cnks);
+				chunk_check_heads(fout, grp->cg_heads, grp->cg_name);
+				grp = NEXTQ(chunk_group_t *, grp);
+			} while (grp != chunk_grp[idx]);
 		}
 	}
 
@@ -742,37 +789,10 @@ chunk_check(FILE *fout, const char *name)
 
 		/* Try to find already existing entry 
 		 */
-		if (chunk_grp) {
-			tmp = chunk_grp;
-			do {
-				if (!strcmp (tmp->cg_name, name)) {
-					grp = tmp;
-					break;
-				}
-			
-				tmp = NEXTQ(chunk_group_t *, tmp);
-			
-			} while (tmp != chunk_grp);
-		}
-		if (!grp)
+		if ((grp = chunk_grp_find (name, chunk_grp_hash (name))) == NULL)
 			return;
 
-		ent = grp->cg_ent;
-		do {
-			cnk = ent->ce_cnk;	    
-
-			fprintf(fout ? fout : stdout,
-				"%s:%d,\t%zu bytes (%p), group \"%s\"\n", 
-				cnk->c_diag.cd_file,
-				cnk->c_diag.cd_line,
-				cnk->c_blk->cb_head->ch_size,
-				(cnk +1),
-				cnk->c_grpent ?
-			            cnk->c_grpent->ce_grp->cg_name :
-			            "NULL");
-
-			ent = NEXTQ(chunk_grpent_t *, ent);
-		} while (ent != grp->cg_ent);	    
+		chunk_check_heads(fout, grp->cg_heads, grp->cg_name);
 	}
 }
 #endif /* CHUNK_DIAG */
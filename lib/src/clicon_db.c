@@ -429,59 +429,66 @@ clicon_dbitems(char *db, size_t *len, char *rx)
 {
     int i;
     int n;
-    int npairs;
-    int nkeys;
+    int ret;
+    int vlen;
+    int maxitems;
+    char *key;
+    char *val;
     cvec **retval = NULL;
     cvec **items = NULL;
-    struct db_pair *pairs;
+    cvec **tmp;
+    db_cursor *dc;
     
     *len = 0;
 
-    if ((npairs = db_regexp(db, rx, __FUNCTION__, &pairs, 0)) < 0)
+    if ((dc = db_cursor_open(db, rx, 0)) == NULL)
 	return NULL;
     
-    nkeys = 0;
-    for (i = 0; i < npairs; i++) {
-	
-	if(key_isvector_n(pairs[i].dp_key) || key_iskeycontent(pairs[i].dp_key))
-	    continue;
-	
-	nkeys++;
-    }
-
-    /* Allocate list. One extra to NULL terminate list */
-    if ((items = calloc(nkeys+1, sizeof(cvec *))) == NULL) { 
-	clicon_err(OE_UNIX, errno, "%s: calloc", __FUNCTION__);
-	goto quit;
-    }
-    memset(items, 0, (nkeys+1) * sizeof(cvec *));
-
+    /* Decode values directly from cursor, growing list geometrically.
+       One extra to NULL terminate list */
     n = 0;
-    for (i = 0; i < npairs; i++) {
+    maxitems = 0;
+    while ((ret = db_cursor_next(dc, &key, &val, &vlen)) == 1) {
 	
-	if(key_isvector_n(pairs[i].dp_key) || key_iskeycontent(pairs[i].dp_key))
+	if(key_isvector_n(key) || key_iskeycontent(key))
 	    continue;
 
-	if ((items[n] = lvec2cvec(pairs[i].dp_val, pairs[i].dp_vlen)) == NULL)
+	if (n+1 >= maxitems) {
+	    maxitems = maxitems ? maxitems*2 : 16;
+	    if ((tmp = realloc(items, maxitems*sizeof(cvec *))) == NULL) { 
+		clicon_err(OE_UNIX, errno, "%s: realloc", __FUNCTION__);
+		goto quit;
+	    }
+	    items = tmp;
+	}
+	items[n] = NULL;
+	if ((items[n] = lvec2cvec(val, vlen)) == NULL)
 	    goto quit;
-	if (cvec_name_set(items[n], pairs[i].dp_key) == NULL) {
+	n++;
+	if (cvec_name_set(items[n-1], key) == NULL) {
 	    clicon_err(OE_DB, 0, "%s: cvec_name_set", __FUNCTION__);
 	    goto quit;
 	}
-	
-	n++;
     }
+    if (ret < 0)
+	goto quit;
+    if (items == NULL &&
+	(items = malloc(sizeof(cvec *))) == NULL) { 
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	goto quit;
+    }
+    items[n] = NULL;
     
-    *len = nkeys;
+    *len = n;
     retval = items;
 
 quit:
-    unchunk_group(__FUNCTION__);
+    db_cursor_close(dc);
     if (retval == NULL) {
 	if (items) {
-	    for (i = 0; i < nkeys; i++)
-		if (items[n])
-		    cvec_free(items[n]);
+	    for (i = 0; i < n; i++)
+		if (items[i])
+		    cvec_free(items[i]);
 	    free(items);
 	}
     }
@@ -31,6 +31,7 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <ctype.h>
+#include <regex.h>
 #include <sys/types.h>
 #include <dirent.h>
 
@@ -68,6 +69,10 @@
 /* typecast macro */
 #define _YA ((db2txt_t *)_ya)
 
+/* Chunk label prefix of database snapshot. The label is unique per 
+   instance, since a callback may run db2txt while a snapshot is in use */
+#define DB2TXT_SNAPSHOT "db2txt-snapshot"
+
 /* add _yf to error paramaters */
 //#define YY_(msgid) _YA, msgid 
 #define YY_(msgid) msgid 
@@ -110,6 +115,7 @@ static int
 db2txt_out(void *_ya, char *str)
 {
     size_t len;
+    size_t size;
     char *new;
     code_stack_t *stack;
 
@@ -124,13 +130,21 @@ db2txt_out(void *_ya, char *str)
 	    return -1;
 #endif
     if (_YA->ya_ret) {
-	len = strlen(_YA->ya_ret);
-	if ((new = realloc(_YA->ya_ret, len + strlen(str) + 1)) == NULL) {
-	    clicon_err(OE_UNIX, errno, "realloc");
-	    return -1;
+	len = strlen(str);
+	/* Grow geometrically, output is mostly appended one char at a time */
+	if (_YA->ya_retlen + len + 1 > _YA->ya_retsize) {
+	    size = _YA->ya_retsize ? _YA->ya_retsize : 1;
+	    while (size < _YA->ya_retlen + len + 1)
+		size *= 2;
+	    if ((new = realloc(_YA->ya_ret, size)) == NULL) {
+		clicon_err(OE_UNIX, errno, "realloc");
+		return -1;
+	    }
+	    _YA->ya_ret = new;
+	    _YA->ya_retsize = size;
 	}
-	sprintf(new+len, "%s", str);	
-	_YA->ya_ret = new;
+	memcpy(_YA->ya_ret + _YA->ya_retlen, str, len + 1);
+	_YA->ya_retlen += len;
     }
 
     return 0;
@@ -156,6 +170,180 @@ parse_val(enum cv_type type, char *val)
 }
 
 
+/*
+ * Read all keys and values of the database once. Variable and vector 
+ * references are then resolved from this snapshot instead of opening
+ * and scanning the database for every reference.
+ */
+int
+db2txt_snapshot(db2txt_t *dbt)
+{
+    int                 i;
+    char               *key;
+    char               *p;
+    struct snap_vector  sv0 = {0, NULL};
+    struct snap_vector *sv;
+    char              **keys;
+
+    snprintf(dbt->ya_label, sizeof(dbt->ya_label), "%s-%p", 
+	     DB2TXT_SNAPSHOT, dbt);
+    if ((dbt->ya_npairs = db_regexp(dbt->ya_db, NULL, dbt->ya_label, 
+				    &dbt->ya_pairs, 0)) < 0) {
+	dbt->ya_npairs = 0;
+	return -1;
+    }
+    if ((dbt->ya_cvecs = calloc(dbt->ya_npairs+1, sizeof(cvec *))) == NULL) {
+	clicon_err(OE_UNIX, errno, "calloc");
+	return -1;
+    }
+    if ((dbt->ya_keys = hash_init()) == NULL ||
+	(dbt->ya_vectors = hash_init()) == NULL)
+	return -1;
+    for (i = 0; i < dbt->ya_npairs; i++) {
+	key = dbt->ya_pairs[i].dp_key;
+	if (hash_add(dbt->ya_keys, key, &i, sizeof(i)) == NULL)
+	    return -1;
+	/* Index vector entries, eg a.0.b.3, under their base key a.0.b */
+	if ((p = strrchr(key, '.')) == NULL || p[1] == '\0' ||
+	    strspn(p+1, "0123456789") != strlen(p+1))
+	    continue;
+	*p = '\0';
+	if ((sv = hash_value(dbt->ya_vectors, key, NULL)) == NULL) {
+	    if (hash_add(dbt->ya_vectors, key, &sv0, sizeof(sv0)) == NULL) {
+		*p = '.';
+		return -1;
+	    }
+	    sv = hash_value(dbt->ya_vectors, key, NULL);
+	}
+	*p = '.';
+	if ((keys = realloc(sv->sv_keys, (sv->sv_len+1)*sizeof(char *))) == NULL) {
+	    clicon_err(OE_UNIX, errno, "realloc");
+	    return -1;
+	}
+	sv->sv_keys = keys;
+	sv->sv_keys[sv->sv_len++] = key;
+    }
+    return 0;
+}
+
+void
+db2txt_snapshot_free(db2txt_t *dbt)
+{
+    int                 i;
+    char               *k;
+    struct snap_vector *sv;
+
+    if (dbt->ya_cvecs) {
+	for (i = 0; i < dbt->ya_npairs; i++)
+	    if (dbt->ya_cvecs[i])
+		cvec_free(dbt->ya_cvecs[i]);
+	free(dbt->ya_cvecs);
+	dbt->ya_cvecs = NULL;
+    }
+    if (dbt->ya_vectors) {
+	hash_each(dbt->ya_vectors, k) {
+	    sv = hash_value(dbt->ya_vectors, k, NULL);
+	    if (sv->sv_keys)
+		free(sv->sv_keys);
+	} hash_each_end();
+	hash_free(dbt->ya_vectors);
+	dbt->ya_vectors = NULL;
+    }
+    if (dbt->ya_keys) {
+	hash_free(dbt->ya_keys);
+	dbt->ya_keys = NULL;
+    }
+    dbt->ya_pairs = NULL;
+    dbt->ya_npairs = 0;
+    if (dbt->ya_label[0]) {
+	unchunk_group(dbt->ya_label);
+	dbt->ya_label[0] = '\0';
+    }
+}
+
+/*
+ * Snapshot version of dbvar2cv(). Values are decoded once per key.
+ */
+static cg_var *
+snap_dbvar2cv(void *_ya, char *key, char *variable)
+{
+    int            *idx;
+    cg_var         *cv;
+    struct db_pair *pair;
+
+    if (key_isvector_n(key) || key_iskeycontent(key))
+	return NULL;
+    if ((idx = hash_value(_YA->ya_keys, key, NULL)) == NULL)
+	return NULL;
+    if (_YA->ya_cvecs[*idx] == NULL) {
+	pair = &_YA->ya_pairs[*idx];
+	if ((_YA->ya_cvecs[*idx] = lvec2cvec(pair->dp_val, pair->dp_vlen)) == NULL)
+	    return NULL;
+    }
+    if ((cv = cvec_find(_YA->ya_cvecs[*idx], variable)) == NULL)
+	return NULL;
+    if ((cv = cv_dup(cv)) == NULL)
+	clicon_err(OE_UNIX, errno, "cv_dup");
+    return cv;
+}
+
+/*
+ * Snapshot version of dbvectorkeys(). Returned list must be freed, the 
+ * keys themselves belong to the snapshot.
+ */
+static char **
+snap_vectorkeys(void *_ya, char *basekey, size_t *len)
+{
+    char              **list = NULL;
+    char               *base;
+    char               *rx;
+    struct snap_vector *sv;
+    regex_t             re;
+    size_t              blen;
+    size_t              n = 0;
+    int                 i;
+
+    blen = strlen(basekey);
+    if (blen > 2 && strstr(basekey, "[]") == basekey+blen-2) {
+	/* Only last component is a vector, eg a.0.b[]: use index */
+	if ((base = strdup(basekey)) == NULL) {
+	    clicon_err(OE_UNIX, errno, "strdup");
+	    goto done;
+	}
+	base[blen-2] = '\0';
+	sv = hash_value(_YA->ya_vectors, base, NULL);
+	free(base);
+	n = sv ? sv->sv_len : 0;
+	if ((list = calloc(n+1, sizeof(char *))) == NULL) {
+	    clicon_err(OE_UNIX, errno, "calloc");
+	    goto done;
+	}
+	if (n)
+	    memcpy(list, sv->sv_keys, n*sizeof(char *));
+    }
+    else { /* Eg a[].b[]: match every key in snapshot */
+	if ((rx = db_gen_rxkey(basekey, __FUNCTION__)) == NULL)
+	    goto done;
+	if (regcomp(&re, rx, REG_EXTENDED|REG_NOSUB) != 0) {
+	    clicon_err(OE_DB, 0, "%s: regcomp(%s)", __FUNCTION__, rx);
+	    goto done;
+	}
+	if ((list = calloc(_YA->ya_npairs+1, sizeof(char *))) == NULL) {
+	    clicon_err(OE_UNIX, errno, "calloc");
+	    regfree(&re);
+	    goto done;
+	}
+	for (i = 0; i < _YA->ya_npairs; i++)
+	    if (regexec(&re, _YA->ya_pairs[i].dp_key, 0, NULL, 0) == 0)
+		list[n++] = _YA->ya_pairs[i].dp_key;
+	regfree(&re);
+    }
+    *len = n;
+  done:
+    unchunk_group(__FUNCTION__);
+    return list;
+}
+
 static cg_var *
 get_nullvar(void *_ya)
 {
@@ -253,7 +441,7 @@ get_dbvar(void *_ya, char *varstr)
 	key = new;
     }
 
-    cv = dbvar2cv(_YA->ya_db, key, var);
+    cv = snap_dbvar2cv(_ya, key, var);
     if (new)
 	free(new);
     if (cv == NULL && (cv = get_nullvar(_ya)) == NULL)
@@ -507,10 +695,10 @@ get_vector(void *_ya, char *basekey)
     if (key == NULL)
 	return NULL;
     
-    vec->vec = dbvectorkeys(_YA->ya_db, key, &vec->len);
+    vec->vec = snap_vectorkeys(_ya, key, &vec->len);
     free(key);
     if (vec->vec == NULL) {
-	clicon_db2txterror(_YA, "dbvectorkeys failed");
+	clicon_db2txterror(_YA, "vector keys failed");
 	free(vec);
 	return NULL;
     }
@@ -1137,8 +1325,6 @@ variable:
 	    /* db key only. Return key-name if exists or nil otherwise */
 	    else if(strstr($2, "->") == NULL) {  
 		char *key;
-		void *data;
-		size_t len;
 
 		if ((key = get_loopkey(_YA, $2)) == NULL) {
 		    if ((key = strdup($2)) == NULL) {
@@ -1147,11 +1333,9 @@ variable:
 			YYERROR;
 		    }
 		}
-		db_get_alloc(_YA->ya_db, key, (void**)&data, &len);
-		if (data == NULL)
+		if (hash_lookup(_YA->ya_keys, key) == NULL)
 		    $$ = get_nullvar(_YA);
 		else {
-		    free(data);
 		    if (($$ = cv_new(CGV_STRING)) == NULL)
 			clicon_err(OE_UNIX, errno, "cv_new");
 		    else if (cv_string_set($$, key) == NULL) {
@@ -67,6 +67,12 @@ struct file_stack {
 };
 typedef struct file_stack file_stack_t;
 
+/* Vector of snapshot keys sharing a vector base key, eg a.0 and a.1 for a[] */
+struct snap_vector {
+    size_t	sv_len;
+    char      **sv_keys;	/* Points into snapshot pairs */
+};
+
 struct db2txt {
     char	*ya_db;			/* DB filename */
     char	*ya_ret;		/* Retirned output */
@@ -81,6 +87,14 @@ struct db2txt {
     buffer_stack_t *ya_buffer_stack;	/* Parser buffer stack */
     cg_var	*ya_null; 		/* A null variable */
     cvec        *ya_vars;		/* db2txt global variables */
+    size_t	 ya_retlen;		/* Length of returned output */
+    size_t	 ya_retsize;		/* Allocated size of returned output */
+    struct db_pair *ya_pairs;		/* Snapshot of all DB keys and values */
+    int		 ya_npairs;		/* Length of snapshot */
+    cvec       **ya_cvecs;		/* Decoded snapshot values, on demand */
+    clicon_hash_t *ya_keys;		/* Snapshot key -> index in ya_pairs */
+    clicon_hash_t *ya_vectors;		/* Vector base key -> struct snap_vector */
+    char         ya_label[64];		/* Chunk label of snapshot */
 };
 typedef struct db2txt db2txt_t;
 
@@ -102,6 +116,8 @@ int clicon_db2txt_debug(int d);
 int db2txt_pushtxt(db2txt_t *dbt, char *txt);
 void *db2txt_popbuf(db2txt_t *dbt);
 int db2txt_parser_cleanup(void *_ya);
+int db2txt_snapshot(db2txt_t *dbt);
+void db2txt_snapshot_free(db2txt_t *dbt);
 file_stack_t *db2txt_file_new(char *file);
 #if 0
 char *db2txt_fread(void *_ya, const char *file);
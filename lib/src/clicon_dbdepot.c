@@ -0,0 +1,248 @@
+/*
+ *
+  Copyright (C) 2009-2015 Olof Hagsand and Benny Holmgren
+
+  This file is part of CLICON.
+
+  CLICON is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  CLICON is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with CLICON; see the file COPYING.  If not, see
+  <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * QDBM Depot storage engine, see clicon_dbengine.h.
+ * A database is one Depot hash database file. Readers and writers lock the
+ * whole file and fail instead of waiting if it is locked (DP_OLCKNB).
+ * Keys are iterated in hash order. There are no transactions.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "clicon_config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+
+#if defined(HAVE_DEPOT_H) || defined(HAVE_QDBM_DEPOT_H)
+#ifdef HAVE_DEPOT_H
+#include <depot.h> /* qdb api */
+#else /* HAVE_QDBM_DEPOT_H */
+#include <qdbm/depot.h> /* qdb api */
+#endif
+
+/* clicon */
+#include "clicon_log.h"
+#include "clicon_err.h"
+#include "clicon_file.h"
+#include "clicon_dbengine.h"
+
+static void *
+depot_open(char *file, int mode, int nkeys)
+{
+    DEPOT *dp;
+    int    omode = DP_OLCKNB;
+
+    omode |= (mode & DB_OWRITER) ? DP_OWRITER : DP_OREADER;
+    if (mode & DB_OCREAT)
+	omode |= DP_OCREAT;
+    if (mode & DB_OTRUNC)
+	omode |= DP_OTRUNC;
+    /* QDBM recommends 0.5 to 4 times the number of records as buckets */
+    if ((dp = dpopen(file, omode, nkeys > 0 ? 2*nkeys : 0)) == NULL){
+	clicon_err(OE_DB, 0, "dpopen(%s): %s", file, dperrmsg(dpecode));
+	return NULL;
+    }
+    return dp;
+}
+
+static int
+depot_close(void *eh)
+{
+    if (dpclose((DEPOT*)eh) == 0){
+	clicon_err(OE_DB, 0, "dpclose: %s", dperrmsg(dpecode));
+	return -1;
+    }
+    return 0;
+}
+
+static int
+depot_get(void *eh, char *key, char **val, int *vlen)
+{
+    DEPOT *dp = (DEPOT*)eh;
+    int    len;
+
+    if (val)
+	len = (*val = dpget(dp, key, -1, 0, -1, &len)) == NULL ? -1 : len;
+    else
+	len = dpvsiz(dp, key, -1);
+    if (len < 0){
+	if (dpecode == DP_ENOITEM)
+	    return 0;
+	clicon_err(OE_DB, 0, "dpget(%s): %s", key, dperrmsg(dpecode));
+	return -1;
+    }
+    if (vlen)
+	*vlen = len;
+    return 1;
+}
+
+static int
+depot_put(void *eh, char *key, void *val, int vlen)
+{
+    if (dpput((DEPOT*)eh, key, -1, val, vlen, DP_DOVER) == 0){
+	clicon_err(OE_DB, 0, "dpput(%s, %d): %s", key, vlen, dperrmsg(dpecode));
+	return -1;
+    }
+    return 0;
+}
+
+static int
+depot_del(void *eh, char *key)
+{
+    if (dpout((DEPOT*)eh, key, -1))
+	return 1;
+    if (dpecode == DP_ENOITEM)
+	return 0;
+    clicon_err(OE_DB, 0, "dpout(%s): %s", key, dperrmsg(dpecode));
+    return -1;
+}
+
+static int
+depot_count(void *eh)
+{
+    int n;
+
+    if ((n = dprnum((DEPOT*)eh)) < 0)
+	clicon_err(OE_DB, 0, "dprnum: %s", dperrmsg(dpecode));
+    return n;
+}
+
+static int
+depot_iterinit(void *eh, char *from)
+{
+    if (dpiterinit((DEPOT*)eh) == 0){
+	clicon_err(OE_DB, 0, "dpiterinit: %s", dperrmsg(dpecode));
+	return -1;
+    }
+    return 0;
+}
+
+static int
+depot_iternext(void *eh, char **key)
+{
+    if ((*key = dpiternext((DEPOT*)eh, NULL)) != NULL)
+	return 1;
+    if (dpecode == DP_ENOITEM)
+	return 0;
+    clicon_err(OE_DB, 0, "dpiternext: %s", dperrmsg(dpecode));
+    return -1;
+}
+
+/*
+ * Copy to a temporary file that replaces target, so that readers of target
+ * never see a partial copy. Target keeps its mode.
+ */
+static int
+depot_copy(char *src, char *target)
+{
+    char        tmp[MAXPATHLEN];
+    struct stat st;
+
+    snprintf(tmp, sizeof(tmp), "%s.%u", target, (unsigned)getpid());
+    if (file_cp(src, tmp) < 0){
+	clicon_err(OE_UNIX, errno, "copy %s to %s", src, tmp);
+	unlink(tmp);
+	return -1;
+    }
+    if (stat(target, &st) == 0)
+	chmod(tmp, st.st_mode & 07777);
+    if (rename(tmp, target) < 0){
+	clicon_err(OE_UNIX, errno, "rename(%s, %s)", tmp, target);
+	unlink(tmp);
+	return -1;
+    }
+    return 0;
+}
+
+static int
+depot_rename(char *src, char *target)
+{
+    if (rename(src, target) < 0){
+	clicon_err(OE_UNIX, errno, "rename(%s, %s)", src, target);
+	return -1;
+    }
+    return 0;
+}
+
+static int
+depot_remove(char *file)
+{
+    if (unlink(file) < 0 && errno != ENOENT){
+	clicon_err(OE_UNIX, errno, "unlink(%s)", file);
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * Depot writes in place, so a value overwritten by one of the same size only
+ * changes the modification time, see st_mtim resolution.
+ */
+static int
+depot_stamp(char *file, char *stamp)
+{
+    struct stat st;
+
+    if (stat(file, &st) < 0){
+	if (errno == ENOENT){
+	    stamp[0] = '\0';
+	    return 0;
+	}
+	clicon_err(OE_UNIX, errno, "stat(%s)", file);
+	return -1;
+    }
+    snprintf(stamp, DB_STAMPLEN, "%lu:%lu:%lld:%ld.%09ld:%ld.%09ld",
+	     (unsigned long)st.st_dev, (unsigned long)st.st_ino, 
+	     (long long)st.st_size,
+	     (long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec,
+	     (long)st.st_ctim.tv_sec, (long)st.st_ctim.tv_nsec);
+    return 0;
+}
+
+struct db_engine db_engine_depot = {
+    "depot",
+    0,                  /* hash order */
+    depot_open,
+    depot_close,
+    depot_get,
+    depot_put,
+    depot_del,
+    depot_count,
+    depot_iterinit,
+    depot_iternext,
+    NULL, NULL, NULL,   /* no transactions */
+    depot_copy,
+    depot_rename,
+    depot_remove,
+    depot_stamp
+};
+
+#endif /* DEPOT */
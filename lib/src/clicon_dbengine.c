@@ -0,0 +1,786 @@
+/*
+ *
+  Copyright (C) 2009-2015 Olof Hagsand and Benny Holmgren
+
+  This file is part of CLICON.
+
+  CLICON is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  CLICON is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with CLICON; see the file COPYING.  If not, see
+  <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Storage engine registry and dispatch, see clicon_dbengine.h.
+ * An open database handle carries its engine, so a handle opened before
+ * db_engine_set() is closed by the engine that opened it.
+ *
+ * Database images.
+ * A process that reads a database much more often than other processes 
+ * write it, such as the backend with running, can keep an image of it in 
+ * memory with db_image_open(). The image is a memory engine database without 
+ * files (DB_OMEMORY), ordered by key.
+ * - Readers of the file read only the image. 
+ * - Writers write to both the file and the image (write-through), and read 
+ *   the image. Transactions are applied to both if the engine has them.
+ * - The image is (re)loaded from the file at open if the change stamp of the
+ *   file (de_stamp) differs from the stamp when the image was last loaded or
+ *   written, ie when another process has changed the file. A writer checks 
+ *   this while it holds the write lock. A reload makes a new memory 
+ *   database, so handles open on the previous one, eg a cursor, keep 
+ *   reading the version they opened.
+ * - After a write in this process the stamp is taken when the file is 
+ *   closed. Every writer that changes a file also writes a new version to 
+ *   it (DB_VERSION_KEY), and the version is read back after the stamp: if 
+ *   another process changed the file before the stamp was taken, the 
+ *   version differs and the image is reloaded at next open. A change after
+ *   the stamp changes the stamp.
+ *
+ * Snapshots.
+ * With Depot, a reader fails while a writer has the file locked, eg while 
+ * the backend commits to running. A process that writes a database that 
+ * others read can write it as a series of snapshots with db_snapshot_open():
+ * a writer locks <file>.lock, which is never renamed or removed, copies the
+ * published version to <file>.next, writes there, and publishes it with 
+ * de_rename() when it is closed. Readers in any process 
+ * open the published version and keep it until they close it, so they 
+ * never see a writer's lock or changes. While the copy is written, the
+ * published version is open for reading, which keeps writers that do not
+ * use snapshots (eg clicon_dbctrl) from changing it meanwhile.
+ * The memory engine has lock-free readers already and needs no snapshots.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "clicon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/time.h>
+#include <sys/param.h>
+
+/* clicon */
+#include "clicon_log.h"
+#include "clicon_err.h"
+#include "clicon_dbengine.h"
+
+#define DB_ENGINE_MAX 8
+
+/* Size of version of file, see DB_VERSION_KEY */
+#define DB_VERSIONLEN  64
+
+/* Built-in engines */
+#if defined(HAVE_DEPOT_H) || defined(HAVE_QDBM_DEPOT_H)
+extern struct db_engine db_engine_depot;
+#endif
+extern struct db_engine db_engine_mem;
+
+static struct db_engine *_db_engines[DB_ENGINE_MAX] = {
+#if defined(HAVE_DEPOT_H) || defined(HAVE_QDBM_DEPOT_H)
+    &db_engine_depot,
+#endif
+    &db_engine_mem,
+};
+
+/* Selected engine, first registered engine if not set */
+static struct db_engine *_db_engine = NULL;
+
+/* Image of a database file */
+struct db_image {
+    struct db_image  *im_next;
+    char             *im_file;
+    char              im_name[MAXPATHLEN]; /* Memory database of image */
+    unsigned int      im_gen;   /* Loads of image, names memory database */
+    void             *im_eh;    /* Open image, keeps it in memory */
+    char              im_stamp[DB_STAMPLEN]; /* Of file at load, "" if stale */
+};
+
+static struct db_image *_db_images = NULL;
+
+/* Database file written as snapshots */
+struct db_snapshot {
+    struct db_snapshot *sn_next;
+    char               *sn_file;
+    char               *sn_newfile; /* Next version: <file>.next */
+    char               *sn_lockfile;/* Writer lock: <file>.lock */
+};
+
+static struct db_snapshot *_db_snapshots = NULL;
+
+/* Open database handle: engine and engine handle, and image if any */
+struct dbe_handle {
+    struct db_engine *dh_de;
+    void             *dh_eh;    /* Open file, NULL if reading from image */
+    struct db_image  *dh_im;    /* Image of file, or NULL */
+    void             *dh_ih;    /* Open image */
+    struct db_snapshot *dh_sn;  /* Writing next version of file, or NULL */
+    void             *dh_live;  /* Open published version while writing */
+    int               dh_lockfd;/* Locked next version */
+    int               dh_writer;/* Opened with DB_OWRITER */
+    int               dh_dirty; /* Writer has changed file */
+};
+
+/*
+ * db_engine_register
+ * Register an additional storage engine that can then be selected with
+ * db_engine_set(), eg from a plugin.
+ */
+int
+db_engine_register(struct db_engine *de)
+{
+    int i;
+
+    for (i=0; i<DB_ENGINE_MAX; i++){
+	if (_db_engines[i] == NULL){
+	    _db_engines[i] = de;
+	    return 0;
+	}
+	if (strcmp(_db_engines[i]->de_name, de->de_name) == 0){
+	    clicon_err(OE_DB, EEXIST, "%s: %s", __FUNCTION__, de->de_name);
+	    return -1;
+	}
+    }
+    clicon_err(OE_DB, ENOSPC, "%s: %s", __FUNCTION__, de->de_name);
+    return -1;
+}
+
+/*
+ * db_engine_set
+ * Select storage engine of all databases by name
+ */
+int
+db_engine_set(char *name)
+{
+    int i;
+
+    for (i=0; i<DB_ENGINE_MAX && _db_engines[i]; i++)
+	if (strcmp(_db_engines[i]->de_name, name) == 0){
+	    _db_engine = _db_engines[i];
+	    clicon_debug(1, "%s: %s", __FUNCTION__, name);
+	    return 0;
+	}
+    clicon_err(OE_DB, ENOENT, "%s: no such storage engine: %s",
+	       __FUNCTION__, name);
+    return -1;
+}
+
+/*
+ * db_engine_get
+ * Get selected storage engine
+ */
+struct db_engine *
+db_engine_get(void)
+{
+    if (_db_engine == NULL)
+	_db_engine = _db_engines[0];
+    return _db_engine;
+}
+
+static struct db_image *
+db_image_find(char *file)
+{
+    struct db_image *im;
+
+    for (im = _db_images; im; im = im->im_next)
+	if (strcmp(im->im_file, file) == 0)
+	    break;
+    return im;
+}
+
+/*
+ * Load all entries of open database file eh of engine de, or none if eh is
+ * NULL, into a new memory database and make it the image. Handles open on 
+ * the previous image keep reading it, and it is freed when the last of 
+ * them is closed.
+ */
+static int
+db_image_load(struct db_image *im, struct db_engine *de, void *eh)
+{
+    void  *ih;
+    char   name[MAXPATHLEN];
+    char  *key = NULL;
+    char  *val;
+    int    vlen;
+    int    ret = 0;
+    int    retval = -1;
+
+    clicon_debug(1, "%s: %s", __FUNCTION__, im->im_file);
+    im->im_stamp[0] = '\0';
+    snprintf(name, sizeof(name), "%s#%u", im->im_file, ++im->im_gen);
+    if ((ih = db_engine_mem.de_open(name, 
+			 DB_OWRITER | DB_OTRUNC | DB_OMEMORY, 0)) == NULL)
+	return -1;
+    if (eh == NULL)
+	goto loaded;
+    if (de->de_iterinit(eh, NULL) < 0)
+	goto done;
+    while ((ret = de->de_iternext(eh, &key)) == 1){
+	if (de->de_get(eh, key, &val, &vlen) != 1){
+	    clicon_err(OE_DB, 0, "%s: %s: no value", __FUNCTION__, key);
+	    goto done;
+	}
+	ret = db_engine_mem.de_put(ih, key, val, vlen);
+	free(val);
+	if (ret < 0)
+	    goto done;
+	free(key);
+	key = NULL;
+    }
+    if (ret < 0)
+	goto done;
+  loaded:
+    db_engine_mem.de_close(im->im_eh);
+    im->im_eh = ih;
+    ih = NULL;
+    strcpy(im->im_name, name);
+    retval = 0;
+  done:
+    if (key)
+	free(key);
+    if (ih)
+	db_engine_mem.de_close(ih);
+    return retval;
+}
+
+/*
+ * Open image of file, loading it if the file has changed. A writer has
+ * opened the file already.
+ */
+static int
+db_image_open1(struct dbe_handle *dh, char *file, int mode, int nkeys)
+{
+    struct db_engine *de = dh->dh_de;
+    struct db_image  *im = dh->dh_im;
+    char              stamp[DB_STAMPLEN];
+    void             *eh;
+
+    if (mode & DB_OWRITER){ 
+	/* Locked, so the file does not change while it is loaded */
+	if (mode & DB_OTRUNC){
+	    if (db_image_load(im, de, NULL) < 0)
+		return -1;
+	}
+	else{
+	    if (de->de_stamp(file, stamp) < 0)
+		return -1;
+	    if (strcmp(stamp, im->im_stamp) != 0 &&
+		db_image_load(im, de, dh->dh_eh) < 0)
+		return -1;
+	}
+	mode = DB_OWRITER | DB_OMEMORY;
+    }
+    else{
+	if (de->de_stamp(file, stamp) < 0)
+	    return -1;
+	if (stamp[0] == '\0'){ /* No file, let the engine fail */
+	    if ((dh->dh_eh = de->de_open(file, mode, nkeys)) == NULL)
+		return -1;
+	    dh->dh_im = NULL;
+	    return 0;
+	}
+	if (strcmp(stamp, im->im_stamp) != 0){
+	    /* Stamp before the file is read: a change meanwhile reloads again */
+	    if ((eh = de->de_open(file, mode, nkeys)) == NULL)
+		return -1;
+	    if (db_image_load(im, de, eh) < 0){
+		de->de_close(eh);
+		return -1;
+	    }
+	    if (de->de_close(eh) < 0)
+		return -1;
+	    strcpy(im->im_stamp, stamp);
+	}
+	mode = DB_OREADER | DB_OMEMORY;
+    }
+    if ((dh->dh_ih = db_engine_mem.de_open(im->im_name, mode, 0)) == NULL)
+	return -1;
+    return 0;
+}
+
+static struct db_snapshot *
+db_snapshot_find(char *file)
+{
+    struct db_snapshot *sn;
+
+    for (sn = _db_snapshots; sn; sn = sn->sn_next)
+	if (strcmp(sn->sn_file, file) == 0)
+	    break;
+    return sn;
+}
+
+/*
+ * Open writer of next version of snapshot file: lock the lock file, and 
+ * copy the published version to the next version unless truncated.
+ */
+static int
+db_snapshot_open1(struct dbe_handle *dh, char *file, int mode, int nkeys)
+{
+    struct db_engine   *de = dh->dh_de;
+    struct db_snapshot *sn = db_snapshot_find(file);
+    char                stamp[DB_STAMPLEN];
+    struct stat         st;
+    char               *key = NULL;
+    char               *val;
+    int                 vlen;
+    int                 ret;
+
+    if ((dh->dh_lockfd = open(sn->sn_lockfile, O_RDWR|O_CREAT, 0600)) < 0){
+	clicon_err(OE_UNIX, errno, "%s: open(%s)", __FUNCTION__, sn->sn_lockfile);
+	return -1;
+    }
+    if (flock(dh->dh_lockfd, LOCK_EX|LOCK_NB) < 0){
+	clicon_err(OE_DB, errno, "%s: %s is locked", __FUNCTION__, file);
+	close(dh->dh_lockfd);
+	dh->dh_lockfd = -1;
+	return -1;
+    }
+    dh->dh_sn = sn;
+    if (de->de_stamp(file, stamp) < 0)
+	return -1;
+    if (stamp[0] == '\0' && !(mode & DB_OCREAT)){
+	clicon_err(OE_DB, ENOENT, "%s: %s", __FUNCTION__, file);
+	return -1;
+    }
+    if (stamp[0] && !(mode & DB_OTRUNC)){
+	if ((dh->dh_live = de->de_open(file, DB_OREADER, 0)) == NULL)
+	    return -1;
+	if ((ret = de->de_count(dh->dh_live)) < 0)
+	    return -1;
+	nkeys = MAX(nkeys, ret);
+    }
+    if ((dh->dh_eh = de->de_open(sn->sn_newfile, 
+			 DB_OWRITER | DB_OCREAT | DB_OTRUNC, nkeys)) == NULL)
+	return -1;
+    if (stat(file, &st) == 0)
+	chmod(sn->sn_newfile, st.st_mode & 07777);
+    if (dh->dh_live == NULL)
+	return 0;
+    if (de->de_iterinit(dh->dh_live, NULL) < 0)
+	return -1;
+    while ((ret = de->de_iternext(dh->dh_live, &key)) == 1){
+	if (de->de_get(dh->dh_live, key, &val, &vlen) != 1){
+	    clicon_err(OE_DB, 0, "%s: %s: no value", __FUNCTION__, key);
+	    free(key);
+	    return -1;
+	}
+	ret = de->de_put(dh->dh_eh, key, val, vlen);
+	free(val);
+	free(key);
+	if (ret < 0)
+	    return -1;
+    }
+    return ret;
+}
+
+/*
+ * Publish (if publish is set) or remove next version of snapshot file, 
+ * after its writer is closed
+ */
+static int
+db_snapshot_close1(struct dbe_handle *dh, int publish)
+{
+    struct db_engine   *de = dh->dh_de;
+    struct db_snapshot *sn = dh->dh_sn;
+    int                 retval = 0;
+
+    if (publish && de->de_rename(sn->sn_newfile, sn->sn_file) < 0)
+	retval = -1;
+    if (!publish || retval < 0)
+	de->de_remove(sn->sn_newfile);
+    if (dh->dh_live)
+	de->de_close(dh->dh_live);
+    close(dh->dh_lockfd);
+    dh->dh_sn = NULL;
+    return retval;
+}
+
+/*
+ * dbe_open
+ * Open database file with the selected engine, see de_open.
+ */
+void *
+dbe_open(char *file, int mode, int nkeys)
+{
+    struct dbe_handle *dh;
+    int                ret = 0;
+
+    if ((dh = calloc(1, sizeof(*dh))) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: calloc", __FUNCTION__);
+	return NULL;
+    }
+    dh->dh_de = db_engine_get();
+    dh->dh_im = db_image_find(file);
+    dh->dh_lockfd = -1;
+    dh->dh_writer = (mode & DB_OWRITER) ? 1 : 0;
+    if ((mode & DB_OWRITER) && db_snapshot_find(file))
+	ret = db_snapshot_open1(dh, file, mode, nkeys);
+    else if ((mode & DB_OWRITER) || dh->dh_im == NULL)
+	ret = (dh->dh_eh = dh->dh_de->de_open(file, mode, nkeys)) ? 0 : -1;
+    if (ret == 0 && dh->dh_im)
+	ret = db_image_open1(dh, file, mode, nkeys);
+    if (ret < 0){
+	if (dh->dh_im)
+	    dh->dh_im->im_stamp[0] = '\0';
+	if (dh->dh_ih)
+	    db_engine_mem.de_close(dh->dh_ih);
+	if (dh->dh_eh)
+	    dh->dh_de->de_close(dh->dh_eh);
+	if (dh->dh_sn)
+	    db_snapshot_close1(dh, 0);
+	free(dh);
+	return NULL;
+    }
+    return dh;
+}
+
+/*
+ * Write a new version of file to writer, see DB_VERSION_KEY
+ */
+static int
+db_version_put(struct dbe_handle *dh, char *version)
+{
+    static unsigned int seq = 0;
+    struct timeval      tv;
+
+    gettimeofday(&tv, NULL);
+    snprintf(version, DB_VERSIONLEN, "%u.%ld.%06ld.%u", (unsigned)getpid(),
+	     (long)tv.tv_sec, (long)tv.tv_usec, ++seq);
+    if (dh->dh_de->de_put(dh->dh_eh, DB_VERSION_KEY, 
+			  version, strlen(version)+1) < 0)
+	return -1;
+    if (dh->dh_ih && db_engine_mem.de_put(dh->dh_ih, DB_VERSION_KEY, 
+					  version, strlen(version)+1) < 0)
+	dh->dh_im->im_stamp[0] = '\0';
+    return 0;
+}
+
+/*
+ * Return 1 if the version of (closed) file is version, 0 if not or if it 
+ * cannot be read, eg while another process writes it.
+ */
+static int
+db_version_check(struct db_engine *de, char *file, char *version)
+{
+    void  *eh;
+    char  *val = NULL;
+    int    vlen;
+    int    ret;
+
+    if ((eh = de->de_open(file, DB_OREADER, 0)) == NULL){
+	clicon_err_reset();
+	return 0;
+    }
+    ret = de->de_get(eh, DB_VERSION_KEY, &val, &vlen);
+    de->de_close(eh);
+    if (ret < 0)
+	clicon_err_reset();
+    if (ret != 1)
+	return 0;
+    ret = (vlen == strlen(version)+1 && memcmp(val, version, vlen) == 0);
+    free(val);
+    return ret;
+}
+
+/*
+ * dbe_close
+ * Close database, and publish it if it is the next version of a snapshot 
+ * file. After writing through to the image, its stamp is updated so that 
+ * this process's own changes do not reload it, unless another process has
+ * changed the file since, see DB_VERSION_KEY.
+ */
+int
+dbe_close(void *eh)
+{
+    struct dbe_handle *dh = (struct dbe_handle *)eh;
+    struct db_image   *im = dh->dh_im;
+    int                retval = 0;
+    char               version[DB_VERSIONLEN];
+
+    if (dh->dh_dirty && db_version_put(dh, version) < 0)
+	retval = -1;
+    if (dh->dh_eh && dh->dh_de->de_close(dh->dh_eh) < 0)
+	retval = -1;
+    if (dh->dh_sn && db_snapshot_close1(dh, retval == 0) < 0)
+	retval = -1;
+    if (dh->dh_ih){
+	db_engine_mem.de_close(dh->dh_ih);
+	if (retval < 0)
+	    im->im_stamp[0] = '\0';
+	else if (dh->dh_dirty){
+	    /* Stamp before version: a change by another process before the
+	       stamp changes the version, and a change after it the stamp */
+	    if (dh->dh_de->de_stamp(im->im_file, im->im_stamp) < 0){
+		im->im_stamp[0] = '\0';
+		retval = -1;
+	    }
+	    else if (!db_version_check(dh->dh_de, im->im_file, version))
+		im->im_stamp[0] = '\0';
+	}
+    }
+    free(dh);
+    return retval;
+}
+
+int
+dbe_get(void *eh, char *key, char **val, int *vlen)
+{
+    struct dbe_handle *dh = (struct dbe_handle *)eh;
+
+    if (dh->dh_ih)
+	return db_engine_mem.de_get(dh->dh_ih, key, val, vlen);
+    return dh->dh_de->de_get(dh->dh_eh, key, val, vlen);
+}
+
+int
+dbe_put(void *eh, char *key, void *val, int vlen)
+{
+    struct dbe_handle *dh = (struct dbe_handle *)eh;
+
+    if (dh->dh_de->de_put(dh->dh_eh, key, val, vlen) < 0)
+	return -1;
+    dh->dh_dirty = 1;
+    if (dh->dh_ih && db_engine_mem.de_put(dh->dh_ih, key, val, vlen) < 0)
+	dh->dh_im->im_stamp[0] = '\0'; /* Written to file: reload image */
+    return 0;
+}
+
+int
+dbe_del(void *eh, char *key)
+{
+    struct dbe_handle *dh = (struct dbe_handle *)eh;
+    int                ret;
+
+    if ((ret = dh->dh_de->de_del(dh->dh_eh, key)) < 0)
+	return -1;
+    if (ret)
+	dh->dh_dirty = 1;
+    if (dh->dh_ih && db_engine_mem.de_del(dh->dh_ih, key) != ret)
+	dh->dh_im->im_stamp[0] = '\0';
+    return ret;
+}
+
+int
+dbe_count(void *eh)
+{
+    struct dbe_handle *dh = (struct dbe_handle *)eh;
+
+    if (dh->dh_ih)
+	return db_engine_mem.de_count(dh->dh_ih);
+    return dh->dh_de->de_count(dh->dh_eh);
+}
+
+/*
+ * dbe_iterinit
+ * Start iteration at first key >= from if the engine is ordered. Returns 1
+ * if the iteration is ordered (and starts at from), 0 if all keys are
+ * iterated in engine order, and -1 on error. Images are ordered.
+ */
+int
+dbe_iterinit(void *eh, char *from)
+{
+    struct dbe_handle *dh = (struct dbe_handle *)eh;
+
+    if (dh->dh_ih){
+	if (db_engine_mem.de_iterinit(dh->dh_ih, from) < 0)
+	    return -1;
+	return 1;
+    }
+    if (dh->dh_de->de_iterinit(dh->dh_eh, from) < 0)
+	return -1;
+    return dh->dh_de->de_ordered ? 1 : 0;
+}
+
+int
+dbe_iternext(void *eh, char **key)
+{
+    struct dbe_handle *dh = (struct dbe_handle *)eh;
+
+    if (dh->dh_ih)
+	return db_engine_mem.de_iternext(dh->dh_ih, key);
+    return dh->dh_de->de_iternext(dh->dh_eh, key);
+}
+
+/*
+ * Transactions are no-ops for engines without them: dbe_txn_abort() then 
+ * returns 0 but the changes since dbe_txn_begin() remain, also in the image.
+ */
+int
+dbe_txn_begin(void *eh)
+{
+    struct dbe_handle *dh = (struct dbe_handle *)eh;
+
+    if (dh->dh_de->de_txn_begin == NULL)
+	return 0;
+    if (dh->dh_de->de_txn_begin(dh->dh_eh) < 0)
+	return -1;
+    if (dh->dh_ih && db_engine_mem.de_txn_begin(dh->dh_ih) < 0)
+	dh->dh_im->im_stamp[0] = '\0';
+    return 0;
+}
+
+int
+dbe_txn_commit(void *eh)
+{
+    struct dbe_handle *dh = (struct dbe_handle *)eh;
+
+    if (dh->dh_de->de_txn_commit == NULL)
+	return 0;
+    if (dh->dh_de->de_txn_commit(dh->dh_eh) < 0){
+	if (dh->dh_ih)
+	    dh->dh_im->im_stamp[0] = '\0';
+	return -1;
+    }
+    if (dh->dh_ih && db_engine_mem.de_txn_commit(dh->dh_ih) < 0)
+	dh->dh_im->im_stamp[0] = '\0';
+    return 0;
+}
+
+int
+dbe_txn_abort(void *eh)
+{
+    struct dbe_handle *dh = (struct dbe_handle *)eh;
+    int                retval;
+
+    if (dh->dh_de->de_txn_abort == NULL)
+	return 0;
+    retval = dh->dh_de->de_txn_abort(dh->dh_eh);
+    if (dh->dh_ih && 
+	(retval < 0 || db_engine_mem.de_txn_abort(dh->dh_ih) < 0))
+	dh->dh_im->im_stamp[0] = '\0';
+    return retval;
+}
+
+/*
+ * db_image_open
+ * Keep an image of database file in memory in this process, see Database 
+ * images above. Reads of the file, also as base of an overlay, are then
+ * served from memory. The image is loaded when the file is first opened.
+ * With the memory engine the database is in memory already and nothing is 
+ * done.
+ */
+int
+db_image_open(char *file)
+{
+    struct db_image *im;
+
+    if (db_engine_get() == &db_engine_mem || db_image_find(file))
+	return 0;
+    if ((im = calloc(1, sizeof(*im))) == NULL ||
+	(im->im_file = strdup(file)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: calloc", __FUNCTION__);
+	if (im)
+	    free(im);
+	return -1;
+    }
+    snprintf(im->im_name, sizeof(im->im_name), "%s#%u", file, im->im_gen);
+    if ((im->im_eh = db_engine_mem.de_open(im->im_name, 
+				DB_OREADER | DB_OMEMORY, 0)) == NULL){
+	free(im->im_file);
+	free(im);
+	return -1;
+    }
+    im->im_next = _db_images;
+    _db_images = im;
+    clicon_debug(1, "%s: %s", __FUNCTION__, file);
+    return 0;
+}
+
+/*
+ * db_snapshot_open
+ * Write database file in this process as snapshots, see Snapshots above.
+ * Every open for writing then copies the database, so this is for databases
+ * written in few large operations, such as running by commits. Other 
+ * writes of the file in this process should be batched, see db_batch(). 
+ * With the memory engine nothing is done.
+ */
+int
+db_snapshot_open(char *file)
+{
+    struct db_snapshot *sn;
+    int                 len;
+
+    if (db_engine_get() == &db_engine_mem || db_snapshot_find(file))
+	return 0;
+    len = strlen(file) + strlen(".next") + 1;
+    if ((sn = calloc(1, sizeof(*sn))) == NULL ||
+	(sn->sn_file = strdup(file)) == NULL ||
+	(sn->sn_newfile = malloc(len)) == NULL ||
+	(sn->sn_lockfile = malloc(len)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: calloc", __FUNCTION__);
+	if (sn){
+	    if (sn->sn_file)
+		free(sn->sn_file);
+	    if (sn->sn_newfile)
+		free(sn->sn_newfile);
+	    free(sn);
+	}
+	return -1;
+    }
+    snprintf(sn->sn_newfile, len, "%s.next", file);
+    snprintf(sn->sn_lockfile, len, "%s.lock", file);
+    sn->sn_next = _db_snapshots;
+    _db_snapshots = sn;
+    clicon_debug(1, "%s: %s", __FUNCTION__, file);
+    return 0;
+}
+
+/*
+ * db_snapshot_close
+ * Write database file in place again. The file must not be open for 
+ * writing in this process.
+ */
+int
+db_snapshot_close(char *file)
+{
+    struct db_snapshot **snp;
+    struct db_snapshot  *sn;
+
+    for (snp = &_db_snapshots; (sn = *snp) != NULL; snp = &sn->sn_next)
+	if (strcmp(sn->sn_file, file) == 0){
+	    *snp = sn->sn_next;
+	    free(sn->sn_file);
+	    free(sn->sn_newfile);
+	    free(sn->sn_lockfile);
+	    free(sn);
+	    break;
+	}
+    return 0;
+}
+
+/*
+ * db_image_close
+ * Free image of database file. The file must not be open in this process.
+ */
+int
+db_image_close(char *file)
+{
+    struct db_image **imp;
+    struct db_image  *im;
+
+    for (imp = &_db_images; (im = *imp) != NULL; imp = &im->im_next)
+	if (strcmp(im->im_file, file) == 0){
+	    *imp = im->im_next;
+	    db_engine_mem.de_close(im->im_eh);
+	    free(im->im_file);
+	    free(im);
+	    break;
+	}
+    return 0;
+}
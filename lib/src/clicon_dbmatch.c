@@ -62,6 +62,92 @@
 #include "clicon_dbmatch.h"
 #include "clicon_dbutil.h"
 
+/* Attribute and pattern used when matching database entries in a scan */
+struct dbmatch_arg {
+    char *dm_attr;     /* Variable name, or NULL for all */
+    char *dm_pattern;  /* Shell wildcard pattern (fnmatch) */
+    int   dm_max;      /* Stop scan after this many matches, 0 for all */
+    int   dm_n;        /* Number of matches so far */
+};
+
+/*! Match attribute value of an lvec against a shell-wildcard pattern
+ *
+ * The lvec is a sequence of name/value lvalue pairs as written by cvec2lvec().
+ * The value is matched without translating the whole lvec to a cvec.
+ * Unique variables are stored with a '!' prefix in the lvec.
+ * @retval  1  Match
+ * @retval  0  No match: no such variable, empty value or pattern mismatch
+ * @retval -1  Error
+ */
+static int
+dbmatch_lvec(char *lvec, int vlen, char *attr, char *pattern)
+{
+    struct lvalue *lvv;
+    char          *str = NULL;
+    int            retval = 0;
+
+    if ((lvv = lvec_find(lvec, vlen, attr)) == NULL)
+	return 0; /* no such variable for this key */
+    /* Strings are stored null-terminated and can be matched in place */
+    if (!cv_inline(lvv->lv_type) && lvv->lv_len && 
+	lvv->lv_val[lvv->lv_len-1] == '\0')
+	return (lvv->lv_val[0] && fnmatch(pattern, lvv->lv_val, 0) == 0);
+    if ((str = lv2str(lvv)) == NULL)
+	return -1;
+    /* If attr has no value (eg "") interpret it as no match */
+    if (strlen(str) && fnmatch(pattern, str, 0) == 0)
+	retval = 1;
+    free(str);
+    return retval;
+}
+
+/*! Filter function for db_regexp_filter() used by all dbmatch functions
+ *
+ * Skips vector meta keys, and evaluates the attribute predicate, if any,
+ * directly on the value read by the scan.
+ */
+static int
+dbmatch_filter(char *key, char *val, int vlen, void *arg)
+{
+    struct dbmatch_arg *dm = (struct dbmatch_arg *)arg;
+    int                 ret = 1;
+
+    if (key_isvector_n(key) || key_iskeycontent(key))
+	return 0;
+    if (dm->dm_attr)
+	if ((ret = dbmatch_lvec(val, vlen, dm->dm_attr, dm->dm_pattern)) != 1)
+	    return ret;
+    if (dm->dm_max && ++dm->dm_n >= dm->dm_max)
+	return 2; /* keep and stop */
+    return 1;
+}
+
+/*! Scan database once and return all entries matching key pattern and attribute
+ *
+ * All dbmatch functions use this scan. The matched pairs are allocated in chunk 
+ * group 'label'. If max is non-zero, the scan stops after max matches.
+ * @retval  n   Number of matching pairs
+ * @retval -1   Error
+ */
+static int
+dbmatch_scan(char            *dbname, 
+	     char            *keypattern, 
+	     char            *attr, 
+	     char            *pattern, 
+	     int              max,
+	     const char      *label,
+	     struct db_pair **pairs)
+{
+    struct dbmatch_arg dm;
+
+    dm.dm_attr    = attr;
+    dm.dm_pattern = pattern;
+    dm.dm_max     = max;
+    dm.dm_n       = 0;
+    return db_regexp_filter(dbname, keypattern, label, pairs, 0,
+			    dbmatch_filter, &dm);
+}
+
 /*
  * dbmatch_fn()
  * Look in the database and match entries according to a matching expression,
@@ -79,8 +165,8 @@
  * attr=NULL selects all
  * Note: The callback (fn) returns 0 on success, -1 on error (and break), 1 on
  * break.
+ * The database is read in one scan, the callback is called after the scan.
  * XXX: Extend pattern beyond attr=<pattern>
- * XXX: It is not assured if updating the database is occurred while the iteration.
  */
 int
 dbmatch_fn(void *handle,
@@ -95,60 +181,27 @@ dbmatch_fn(void *handle,
 {
     struct db_pair  *pairs;
     int              npairs;
-    char            *key;
     cvec            *vr = NULL;
-    cg_var          *cv;
     int              match=0;
     int              retval = -1;
-    char            *str;
-    int              len;
     int              ret;
     int              i;
 
-    /* Following can be done generic */
-    if ((npairs = db_regexp(dbname, keypattern, 
-			    __FUNCTION__, &pairs, 0)) < 0)
+    if ((npairs = dbmatch_scan(dbname, keypattern, attr, pattern, 0,
+			       __FUNCTION__, &pairs)) < 0)
 	goto done;
     for (i=0; i<npairs; i++) {
-	key = pairs[i].dp_key;
-	if (key_isvector_n(key) || key_iskeycontent(key))
-	    continue;
-	if ((vr = dbkey2cvec(dbname, key)) == NULL) /* get cvec of key */
-	    goto done;
-	/* match attribute value with corresponding variable in database */
-	if (attr){ /* attr and value given on command line */
-	    if ((cv = cvec_find_var(vr, attr)) == NULL){
-		cvec_free(vr);
-		vr=NULL;
-		continue; /* no such variable for this key */
-	    }
-	    if ((len = cv2str(cv, NULL, 0)) < 0)
-		goto done;
-	    if (len == 0){
-		cvec_free(vr);
-		vr=NULL;
-		continue; /* If attr has no value (eg "") interpret it as no match */
-	    }
-	    if ((str = cv2str_dup(cv)) == NULL)
-		goto done;
-	    if(fnmatch(pattern, str, 0) != 0) {
-		cvec_free(vr);
-		vr=NULL;
-		free(str);
-		continue; /* no match */
-	    }
-	    free(str);
-	    str = NULL;
-	}
 	match++;
 	if (fn){
-	    if ((ret = (*fn)(handle, dbname, key, vr, fnarg)) < 0)
+	    if ((vr = lvec2cvec(pairs[i].dp_val, pairs[i].dp_vlen)) == NULL)
+		goto done;
+	    if ((ret = (*fn)(handle, dbname, pairs[i].dp_key, vr, fnarg)) < 0)
 		goto done;
+	    cvec_free(vr);
+	    vr = NULL;
 	    if (ret == 1)
 		break; /* return value 0 -> continue */
 	}
-	cvec_free(vr);
-	vr = NULL;
     }
     if (matches)
 	*matches = match;
@@ -188,86 +241,50 @@ dbmatch_vec(void *handle,
 {
     struct db_pair  *pairs;
     int              npairs;
-    char            *key;
     char            **keyv = NULL;
     cvec            **cvecv = NULL;
-    cvec            *vr = NULL;
-    cg_var          *cv;
     int              match=0;
     int              retval = -1;
-    char            *str;
-    int              len;
     int              i;
 
-    /* Following can be done generic */
-    if ((npairs = db_regexp(dbname, keypattern, 
-			    __FUNCTION__, &pairs, 0)) < 0)
+    if ((npairs = dbmatch_scan(dbname, keypattern, attr, pattern, 0,
+			       __FUNCTION__, &pairs)) < 0)
 	goto done;
-    for (i=0; i<npairs; i++) {
-	key = pairs[i].dp_key;
-	if (key_isvector_n(key) || key_iskeycontent(key))
-	    continue;
-	if ((vr = dbkey2cvec(dbname, key)) == NULL) /* get cvec of key */
+    /* Number of matches is known: allocate result vectors once */
+    if (npairs){
+	if ((keyv = calloc(npairs, sizeof(char*))) == NULL){	
+	    clicon_err(OE_DB, errno, "%s: calloc", __FUNCTION__);
 	    goto done;
-	/* match attribute value with corresponding variable in database */
-	if (attr){ /* attr and value given on command line */
-	    if ((cv = cvec_find_var(vr, attr)) == NULL){
-		cvec_free(vr);
-		vr=NULL;
-		continue; /* no such variable for this key */
-	    }
-	    if ((len = cv2str(cv, NULL, 0)) < 0)
-		goto done;
-	    if (len == 0){
-		cvec_free(vr);
-		vr=NULL;
-		continue; /* If attr has no value (eg "") interpret it as no match */
-	    }
-	    if ((str = cv2str_dup(cv)) == NULL)
-		goto done;
-	    if(fnmatch(pattern, str, 0) != 0) {
-		cvec_free(vr);
-		vr=NULL;
-		free(str);
-		continue; /* no match */
-	    }
-	    free(str);
-	    str = NULL;
 	}
-	match++;
-	if ((keyv = realloc(keyv, sizeof(char*) * match)) == NULL){	
-	    clicon_err(OE_DB, errno, "%s: realloc", __FUNCTION__);
+	if ((cvecv = calloc(npairs, sizeof(cvec *))) == NULL){	
+	    clicon_err(OE_DB, errno, "%s: calloc", __FUNCTION__);
 	    goto done;
 	}
-	if ((keyv[match-1] = strdup4(key)) == NULL){
-	    clicon_err(OE_DB, errno, "%s: strdup", __FUNCTION__);
+    }
+    for (i=0; i<npairs; i++) {
+	if ((cvecv[match] = lvec2cvec(pairs[i].dp_val, pairs[i].dp_vlen)) == NULL)
 	    goto done;
-	}
-	if ((cvecv = realloc(cvecv, sizeof(cvec *) * match)) == NULL){	
-	    clicon_err(OE_DB, errno, "%s: realloc", __FUNCTION__);
+	if ((keyv[match] = strdup4(pairs[i].dp_key)) == NULL){
+	    clicon_err(OE_DB, errno, "%s: strdup", __FUNCTION__);
+	    cvec_free(cvecv[match]);
 	    goto done;
 	}
-	cvecv[match-1] = vr;
-	vr = NULL;
+	match++;
     }
     if (lenp)
 	*lenp = match;
     if (cvecp){
 	*cvecp = cvecv;
-	cvecp = NULL;
+	cvecv = NULL;
     }
     if (keyp){
 	*keyp = keyv;
-	keyp = NULL;
+	keyv = NULL;
     }
     retval = 0;
   done:
-    if (vr)
-	cvec_free(vr);
-    if (cvecp)
-	free(cvecp);
-    if (keyp)
-	free(keyp);
+    if (keyv || cvecv)
+	dbmatch_vec_free(keyv, cvecv, match);
     unchunk_group(__FUNCTION__);
     return retval;
 }
@@ -280,11 +297,15 @@ dbmatch_vec_free(char **keyv, cvec **cvecv, int len)
     int i;
 
     for (i=0; i<len; i++){
-	cvec_free(cvecv[i]);
-	free(keyv[i]);
+	if (cvecv)
+	    cvec_free(cvecv[i]);
+	if (keyv)
+	    free(keyv[i]);
     }
-    free(cvecv);
-    free(keyv);
+    if (cvecv)
+	free(cvecv);
+    if (keyv)
+	free(keyv);
     return 0;
 }
 
@@ -320,57 +341,20 @@ dbmatch_one(void *handle,
 {
     struct db_pair  *pairs;
     int              npairs;
-    char            *key;
-    cvec            *vr = NULL;
-    cg_var          *cv;
-    char            *str;
-    int              len;
     int              retval = -1;
-    int              i;
 
-    /* Following can be done generic */
-    if ((npairs = db_regexp(dbname, keypattern, 
-			    __FUNCTION__, &pairs, 0)) < 0)
+    if ((npairs = dbmatch_scan(dbname, keypattern, attr, pattern, 1,
+			       __FUNCTION__, &pairs)) < 0)
 	goto done;
-    for (i=0; i<npairs; i++) {
-	key = pairs[i].dp_key;
-	if (key_isvector_n(key) || key_iskeycontent(key))
-	    continue;
-	if ((vr = dbkey2cvec(dbname, key)) == NULL) /* get cvec of key */
-	    goto done;
-	/* match attribute value with corresponding variable in database */
-	if (attr){ /* attr and value given on command line */
-	    if ((cv = cvec_find_var(vr, attr)) == NULL){
-		cvec_free(vr); vr=NULL;
-		continue; /* no such variable for this key */
-	    }
-	    if ((len = cv2str(cv, NULL, 0)) < 0)
-		goto done;
-	    if (len == 0){
-		cvec_free(vr); vr=NULL;
-		continue; /* If attr has no value (eg "") interpret it as no match */
-	    }
-	    if ((str = cv2str_dup(cv)) == NULL)
-		goto done;
-	    if(fnmatch(pattern, str, 0) != 0) {
-		cvec_free(vr); vr=NULL;
-		free(str);
-		continue; /* no match */
-	    }
-	    free(str);
-	    str = NULL;
-	}
+    if (npairs > 0){ /* found */
 	if (cvecp)
-	    *cvecp = vr;
-	else{
-	    cvec_free(vr); vr=NULL;
-	}
+	    if ((*cvecp = lvec2cvec(pairs[0].dp_val, pairs[0].dp_vlen)) == NULL)
+		goto done;
 	if (keyp)
-	    if ((*keyp = strdup4(key)) == NULL){
+	    if ((*keyp = strdup4(pairs[0].dp_key)) == NULL){
 		clicon_err(OE_DB, errno, "%s: strdup", __FUNCTION__);
 		goto done;
 	    }
-	break; /* found */
     }
     retval = 0;
   done:
@@ -0,0 +1,1204 @@
+/*
+ *
+  Copyright (C) 2009-2015 Olof Hagsand and Benny Holmgren
+
+  This file is part of CLICON.
+
+  CLICON is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  CLICON is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with CLICON; see the file COPYING.  If not, see
+  <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * In-memory ordered storage engine, see clicon_dbengine.h.
+ * A database is held in memory as a skiplist ordered by key (strcmp), and
+ * on disk in two files:
+ *   <file>      checkpoint: all entries in key order
+ *   <file>.wal  write-ahead log: changes made after the checkpoint
+ * A writer appends its changes to the log when it commits (de_txn_commit or
+ * close), ending with a commit record. When the log grows beyond
+ * DBMEM_WAL_MAX, a new checkpoint is written to <file>.ckpt, renamed to
+ * <file>, and the log is emptied. Each checkpoint has a new generation
+ * number which is also written in the log header, so a log left from an
+ * earlier checkpoint (eg after a crash, or if <file> was removed) is ignored.
+ * Writers lock the log and fail if another writer has it locked. Readers
+ * take no lock: they read the checkpoint and the log up to the last commit
+ * record, so readers in other processes never block writers or see 
+ * uncommitted changes. Handles in the same process share the loaded 
+ * database, so a reader there sees the changes of an open writer before 
+ * they are committed (or undone by de_txn_abort).
+ * A commit is synced to disk (fdatasync of the log) before it returns, and
+ * a checkpoint (and its directory entry) before the log is emptied.
+ * A database stays loaded while open, and up to DBMEM_CACHE_MAX closed
+ * databases are cached so that a new open only reads new log records.
+ * A database opened with DB_OMEMORY has no files and is only kept while it
+ * is open, eg as an image of a database of another engine, see 
+ * db_image_open().
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "clicon_config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/time.h>
+#include <sys/param.h>
+
+/* clicon */
+#include "clicon_log.h"
+#include "clicon_err.h"
+#include "clicon_dbengine.h"
+
+#define DBMEM_MAGIC     "CLICON-MEMDB 1\n"   /* Checkpoint header */
+#define DBMEM_WAL_MAGIC "CLICON-MEMWAL 1\n"  /* Log header */
+#define DBMEM_WAL_HDRLEN (sizeof(DBMEM_WAL_MAGIC) - 1 + sizeof(uint64_t))
+
+#define DBMEM_LEVELS    24           /* Max skiplist levels */
+#define DBMEM_WAL_MAX   (1024*1024)  /* Checkpoint when log is larger */
+#define DBMEM_CACHE_MAX 8            /* Closed databases kept in memory */
+#define DBMEM_RETRY     16           /* Reads racing with checkpoints */
+
+/* Log records: type, key length (with NUL), value length, key, value */
+#define DBMEM_PUT    'P'
+#define DBMEM_DEL    'D'
+#define DBMEM_COMMIT 'C'  /* Records since previous commit are committed */
+#define DBMEM_RECLEN (1 + 2*sizeof(uint32_t))
+
+struct mem_node {
+    char            *mn_key;
+    char            *mn_val;
+    int              mn_vlen;
+    int              mn_level;
+    struct mem_node *mn_next[1];  /* mn_level forward pointers */
+};
+
+/* Database loaded in memory, shared by all handles of the process */
+struct mem_db {
+    struct mem_db   *md_next;
+    char            *md_file;
+    struct mem_node *md_head;     /* DBMEM_LEVELS forward pointers, no key */
+    int              md_count;    /* Number of entries */
+    unsigned int     md_version;  /* Changed when nodes are added or removed */
+    uint64_t         md_gen;      /* Generation of checkpoint, 0 if none */
+    off_t            md_waloff;   /* Log is applied up to here */
+    int              md_walok;    /* Log belongs to checkpoint */
+    int              md_refs;     /* Open handles */
+    int              md_nofile;   /* DB_OMEMORY: no checkpoint or log */
+};
+
+/* Previous value of a key changed in a transaction */
+struct mem_undo {
+    struct mem_undo *mu_next;
+    char            *mu_key;
+    char            *mu_val;      /* NULL if key did not exist */
+    int              mu_vlen;
+};
+
+struct mem_handle {
+    struct mem_db   *mh_md;
+    int              mh_writer;   /* Opened with DB_OWRITER */
+    int              mh_fd;       /* Writer: locked log, otherwise -1 */
+    char            *mh_buf;      /* Writer: log records not yet written */
+    size_t           mh_len;
+    size_t           mh_size;
+    int              mh_txn;      /* In transaction */
+    struct mem_undo *mh_undo;     /* Undo records, latest first */
+    struct mem_node *mh_it;       /* Iterator: next node */
+    unsigned int     mh_itversion;/* md_version when mh_it was found */
+    char            *mh_itkey;    /* Iterator: last key returned, or start */
+    int              mh_itfirst;  /* mh_itkey is start key, not returned */
+};
+
+static struct mem_db *_mem_dbs = NULL;
+
+static uint32_t _mem_seed = 2463534242U;
+
+static int
+mem_random_level(void)
+{
+    int level = 1;
+
+    /* xorshift, each level with probability 1/4 */
+    for (;;){
+	_mem_seed ^= _mem_seed << 13;
+	_mem_seed ^= _mem_seed >> 17;
+	_mem_seed ^= _mem_seed << 5;
+	if (level == DBMEM_LEVELS || (_mem_seed & 3) != 0)
+	    break;
+	level++;
+    }
+    return level;
+}
+
+/*
+ * Return first node with key >= key (> key if gt is set). If update is
+ * given it is set to the last node before it on each level.
+ */
+static struct mem_node *
+mem_seek(struct mem_db *md, char *key, int gt, struct mem_node **update)
+{
+    struct mem_node *n = md->md_head;
+    int              i;
+    int              c;
+
+    for (i=DBMEM_LEVELS-1; i>=0; i--){
+	while (n->mn_next[i] &&
+	       ((c = strcmp(n->mn_next[i]->mn_key, key)) < 0 || (gt && c == 0)))
+	    n = n->mn_next[i];
+	if (update)
+	    update[i] = n;
+    }
+    return n->mn_next[0];
+}
+
+static struct mem_node *
+mem_lookup(struct mem_db *md, char *key)
+{
+    struct mem_node *n;
+
+    if ((n = mem_seek(md, key, 0, NULL)) != NULL && strcmp(n->mn_key, key) == 0)
+	return n;
+    return NULL;
+}
+
+/*
+ * Insert new node with key after the nodes in update. Value is copied.
+ */
+static struct mem_node *
+mem_insert(struct mem_db *md, struct mem_node **update,
+	   char *key, char *val, int vlen)
+{
+    struct mem_node *n;
+    int              level = mem_random_level();
+    int              i;
+
+    if ((n = malloc(sizeof(*n) + (level-1)*sizeof(n->mn_next[0]) +
+		    strlen(key) + 1)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	return NULL;
+    }
+    if ((n->mn_val = malloc(vlen ? vlen : 1)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	free(n);
+	return NULL;
+    }
+    memcpy(n->mn_val, val, vlen);
+    n->mn_vlen = vlen;
+    n->mn_key = (char*)&n->mn_next[level];
+    strcpy(n->mn_key, key);
+    n->mn_level = level;
+    for (i=0; i<level; i++){
+	n->mn_next[i] = update[i]->mn_next[i];
+	update[i]->mn_next[i] = n;
+    }
+    md->md_count++;
+    md->md_version++;
+    return n;
+}
+
+/*
+ * Set key to a copy of value
+ */
+static int
+mem_set(struct mem_db *md, char *key, char *val, int vlen)
+{
+    struct mem_node *update[DBMEM_LEVELS];
+    struct mem_node *n;
+    char            *v;
+
+    n = mem_seek(md, key, 0, update);
+    if (n == NULL || strcmp(n->mn_key, key) != 0)
+	return mem_insert(md, update, key, val, vlen) ? 0 : -1;
+    if ((v = malloc(vlen ? vlen : 1)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	return -1;
+    }
+    memcpy(v, val, vlen);
+    free(n->mn_val);
+    n->mn_val = v;
+    n->mn_vlen = vlen;
+    return 0;
+}
+
+/*
+ * Remove key. Returns 1 if removed, 0 if not found.
+ */
+static int
+mem_unset(struct mem_db *md, char *key)
+{
+    struct mem_node *update[DBMEM_LEVELS];
+    struct mem_node *n;
+    int              i;
+
+    n = mem_seek(md, key, 0, update);
+    if (n == NULL || strcmp(n->mn_key, key) != 0)
+	return 0;
+    for (i=0; i<n->mn_level; i++)
+	update[i]->mn_next[i] = n->mn_next[i];
+    free(n->mn_val);
+    free(n);
+    md->md_count--;
+    md->md_version++;
+    return 1;
+}
+
+static void
+mem_clear(struct mem_db *md)
+{
+    struct mem_node *n;
+    int              i;
+
+    while ((n = md->md_head->mn_next[0]) != NULL){
+	md->md_head->mn_next[0] = n->mn_next[0];
+	free(n->mn_val);
+	free(n);
+    }
+    for (i=0; i<DBMEM_LEVELS; i++)
+	md->md_head->mn_next[i] = NULL;
+    md->md_count = 0;
+    md->md_version++;
+    md->md_gen = 0;
+    md->md_waloff = 0;
+    md->md_walok = 0;
+}
+
+static uint64_t
+mem_newgen(uint64_t old)
+{
+    static uint32_t n = 0;
+    struct timeval  tv;
+    uint64_t        gen;
+
+    gettimeofday(&tv, NULL);
+    gen = ((uint64_t)tv.tv_sec << 32) |
+	(((uint32_t)tv.tv_usec << 12) ^ ((uint32_t)getpid() << 8) ^ ++n);
+    if (gen == 0 || gen == old)
+	gen++;
+    return gen;
+}
+
+/*
+ * Read checkpoint generation from open checkpoint file
+ */
+static int
+mem_ckpt_gen(FILE *f, char *file, uint64_t *gen)
+{
+    char magic[sizeof(DBMEM_MAGIC)];
+
+    if (fread(magic, 1, strlen(DBMEM_MAGIC), f) != strlen(DBMEM_MAGIC) ||
+	memcmp(magic, DBMEM_MAGIC, strlen(DBMEM_MAGIC)) != 0 ||
+	fread(gen, sizeof(*gen), 1, f) != 1){
+	clicon_err(OE_DB, 0, "%s: not a memory database", file);
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * Load entries of checkpoint file, positioned after generation, into empty
+ * database. Entries are in key order so they are appended.
+ */
+static int
+mem_ckpt_read(struct mem_db *md, FILE *f)
+{
+    struct mem_node *tail[DBMEM_LEVELS];
+    struct mem_node *n;
+    uint32_t         count;
+    uint32_t         klen;
+    uint32_t         vlen;
+    char            *key = NULL;
+    char            *val = NULL;
+    char            *p;
+    size_t           ksize = 0;
+    size_t           vsize = 0;
+    int              retval = -1;
+    int              i;
+
+    for (i=0; i<DBMEM_LEVELS; i++)
+	tail[i] = md->md_head;
+    if (fread(&count, sizeof(count), 1, f) != 1)
+	goto corrupt;
+    while (count--){
+	if (fread(&klen, sizeof(klen), 1, f) != 1 ||
+	    fread(&vlen, sizeof(vlen), 1, f) != 1 || klen == 0)
+	    goto corrupt;
+	if (klen > ksize){
+	    if ((p = realloc(key, klen)) == NULL)
+		goto merr;
+	    key = p;
+	    ksize = klen;
+	}
+	if (vlen > vsize){
+	    if ((p = realloc(val, vlen)) == NULL)
+		goto merr;
+	    val = p;
+	    vsize = vlen;
+	}
+	if (fread(key, 1, klen, f) != klen || fread(val, 1, vlen, f) != vlen ||
+	    key[klen-1] != '\0')
+	    goto corrupt;
+	if (tail[0] != md->md_head && strcmp(tail[0]->mn_key, key) >= 0)
+	    goto corrupt;
+	if ((n = mem_insert(md, tail, key, val, vlen)) == NULL)
+	    goto done;
+	for (i=0; i<n->mn_level; i++)
+	    tail[i] = n;
+    }
+    retval = 0;
+    goto done;
+  merr:
+    clicon_err(OE_UNIX, errno, "%s: realloc", __FUNCTION__);
+    goto done;
+  corrupt:
+    clicon_err(OE_DB, 0, "%s: %s: truncated or corrupt checkpoint",
+	       __FUNCTION__, md->md_file);
+  done:
+    if (key)
+	free(key);
+    if (val)
+	free(val);
+    return retval;
+}
+
+/*
+ * Sync directory of file, so that a file renamed into it is on disk
+ */
+static int
+mem_fsync_dir(char *file)
+{
+    char  dir[MAXPATHLEN];
+    char *p;
+    int   fd;
+    int   retval = -1;
+
+    strncpy(dir, file, sizeof(dir)-1);
+    dir[sizeof(dir)-1] = '\0';
+    if ((p = strrchr(dir, '/')) == NULL)
+	strcpy(dir, ".");
+    else if (p == dir)
+	p[1] = '\0';
+    else
+	*p = '\0';
+    if ((fd = open(dir, O_RDONLY)) < 0){
+	clicon_err(OE_UNIX, errno, "%s: open(%s)", __FUNCTION__, dir);
+	return -1;
+    }
+    if (fsync(fd) < 0){
+	clicon_err(OE_UNIX, errno, "%s: fsync(%s)", __FUNCTION__, dir);
+	goto done;
+    }
+    retval = 0;
+  done:
+    close(fd);
+    return retval;
+}
+
+/*
+ * Write all entries of database to a new checkpoint of file with generation
+ * gen. The checkpoint is written to <file>.ckpt, synced and renamed.
+ */
+static int
+mem_ckpt_write(struct mem_db *md, char *file, uint64_t gen)
+{
+    struct mem_node *n;
+    char             tmp[MAXPATHLEN];
+    FILE            *f = NULL;
+    int              fd;
+    uint32_t         count = md->md_count;
+    uint32_t         klen;
+    uint32_t         vlen;
+
+    snprintf(tmp, sizeof(tmp), "%s.ckpt", file);
+    if ((fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0 ||
+	(f = fdopen(fd, "w")) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: open(%s)", __FUNCTION__, tmp);
+	if (fd >= 0)
+	    close(fd);
+	return -1;
+    }
+    setvbuf(f, NULL, _IOFBF, 64*1024);
+    if (fwrite(DBMEM_MAGIC, 1, strlen(DBMEM_MAGIC), f) != strlen(DBMEM_MAGIC) ||
+	fwrite(&gen, sizeof(gen), 1, f) != 1 ||
+	fwrite(&count, sizeof(count), 1, f) != 1)
+	goto werr;
+    for (n = md->md_head->mn_next[0]; n; n = n->mn_next[0]){
+	klen = strlen(n->mn_key) + 1;
+	vlen = n->mn_vlen;
+	if (fwrite(&klen, sizeof(klen), 1, f) != 1 ||
+	    fwrite(&vlen, sizeof(vlen), 1, f) != 1 ||
+	    fwrite(n->mn_key, 1, klen, f) != klen ||
+	    fwrite(n->mn_val, 1, vlen, f) != vlen)
+	    goto werr;
+    }
+    if (fflush(f) == EOF || fsync(fileno(f)) < 0)
+	goto werr;
+    if (fclose(f) == EOF){
+	f = NULL;
+	goto werr;
+    }
+    if (rename(tmp, file) < 0){
+	clicon_err(OE_UNIX, errno, "%s: rename(%s, %s)", __FUNCTION__, tmp, file);
+	unlink(tmp);
+	return -1;
+    }
+    return mem_fsync_dir(file);
+  werr:
+    clicon_err(OE_UNIX, errno, "%s: write %s", __FUNCTION__, tmp);
+    if (f)
+	fclose(f);
+    unlink(tmp);
+    return -1;
+}
+
+/*
+ * Apply committed log records after md_waloff. fd is the log if open
+ * (writer), otherwise the log is opened here.
+ * Sets md_walok if the log belongs to the loaded checkpoint.
+ */
+static int
+mem_wal_read(struct mem_db *md, int fd)
+{
+    char        walfile[MAXPATHLEN];
+    char        hdr[DBMEM_WAL_HDRLEN];
+    uint64_t    gen;
+    struct stat st;
+    char       *buf = NULL;
+    size_t      len;
+    size_t      p;
+    size_t      group;
+    uint32_t    klen;
+    uint32_t    vlen;
+    char        op;
+    int         myfd = -1;
+    int         retval = -1;
+
+    md->md_walok = 0;
+    if (fd < 0){
+	snprintf(walfile, sizeof(walfile), "%s.wal", md->md_file);
+	if ((fd = myfd = open(walfile, O_RDONLY)) < 0){
+	    if (errno == ENOENT)
+		return 0;
+	    clicon_err(OE_UNIX, errno, "%s: open(%s)", __FUNCTION__, walfile);
+	    return -1;
+	}
+    }
+    if (pread(fd, hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	memcmp(hdr, DBMEM_WAL_MAGIC, strlen(DBMEM_WAL_MAGIC)) != 0){
+	retval = 0; /* Empty or no log */
+	goto done;
+    }
+    memcpy(&gen, hdr + strlen(DBMEM_WAL_MAGIC), sizeof(gen));
+    if (gen != md->md_gen){
+	retval = 0; /* Stale log */
+	goto done;
+    }
+    md->md_walok++;
+    if (md->md_waloff < sizeof(hdr))
+	md->md_waloff = sizeof(hdr);
+    if (fstat(fd, &st) < 0){
+	clicon_err(OE_UNIX, errno, "%s: fstat", __FUNCTION__);
+	goto done;
+    }
+    if (st.st_size <= md->md_waloff){
+	retval = 0;
+	goto done;
+    }
+    len = st.st_size - md->md_waloff;
+    if ((buf = malloc(len)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	goto done;
+    }
+    if ((len = pread(fd, buf, len, md->md_waloff)) == (size_t)-1){
+	clicon_err(OE_UNIX, errno, "%s: read", __FUNCTION__);
+	goto done;
+    }
+    /* Apply each group of records ending with a commit record. A partial
+       record or group at the end is being written, or left by a failed
+       writer */
+    p = group = 0;
+    while (p + DBMEM_RECLEN <= len){
+	op = buf[p];
+	memcpy(&klen, buf + p + 1, sizeof(klen));
+	memcpy(&vlen, buf + p + 1 + sizeof(klen), sizeof(vlen));
+	if (klen + vlen > len - p - DBMEM_RECLEN)
+	    break;
+	p += DBMEM_RECLEN + klen + vlen;
+	if (op != DBMEM_COMMIT)
+	    continue;
+	while (group < p){
+	    op = buf[group];
+	    memcpy(&klen, buf + group + 1, sizeof(klen));
+	    memcpy(&vlen, buf + group + 1 + sizeof(klen), sizeof(vlen));
+	    group += DBMEM_RECLEN;
+	    if (op == DBMEM_PUT &&
+		mem_set(md, buf + group, buf + group + klen, vlen) < 0)
+		goto done;
+	    if (op == DBMEM_DEL)
+		mem_unset(md, buf + group);
+	    group += klen + vlen;
+	}
+    }
+    md->md_waloff += group;
+    retval = 0;
+  done:
+    if (buf)
+	free(buf);
+    if (myfd >= 0)
+	close(myfd);
+    return retval;
+}
+
+/*
+ * Empty the log (locked by writer) and set it to the loaded checkpoint
+ */
+static int
+mem_wal_reset(struct mem_db *md, int fd)
+{
+    char hdr[DBMEM_WAL_HDRLEN];
+
+    memcpy(hdr, DBMEM_WAL_MAGIC, strlen(DBMEM_WAL_MAGIC));
+    memcpy(hdr + strlen(DBMEM_WAL_MAGIC), &md->md_gen, sizeof(md->md_gen));
+    if (ftruncate(fd, 0) < 0 || pwrite(fd, hdr, sizeof(hdr), 0) != sizeof(hdr)){
+	clicon_err(OE_UNIX, errno, "%s: %s.wal", __FUNCTION__, md->md_file);
+	return -1;
+    }
+    md->md_waloff = sizeof(hdr);
+    md->md_walok = 1;
+    return 0;
+}
+
+/*
+ * Bring database up to date with checkpoint and log. fd is the log if
+ * locked by a writer, otherwise -1.
+ * Returns 1 if OK, 0 if there is no checkpoint, and -1 on error.
+ */
+static int
+mem_sync(struct mem_db *md, int fd)
+{
+    FILE    *f;
+    uint64_t gen;
+    int      retry;
+
+    for (retry=0; retry<DBMEM_RETRY; retry++){
+	if ((f = fopen(md->md_file, "r")) == NULL){
+	    if (errno != ENOENT){
+		clicon_err(OE_UNIX, errno, "%s: fopen(%s)",
+			   __FUNCTION__, md->md_file);
+		return -1;
+	    }
+	    if (md->md_gen)
+		mem_clear(md);
+	    return 0;
+	}
+	if (mem_ckpt_gen(f, md->md_file, &gen) < 0){
+	    fclose(f);
+	    return -1;
+	}
+	if (gen != md->md_gen){ /* New checkpoint */
+	    mem_clear(md);
+	    setvbuf(f, NULL, _IOFBF, 64*1024);
+	    if (mem_ckpt_read(md, f) < 0){
+		mem_clear(md);
+		fclose(f);
+		return -1;
+	    }
+	    md->md_gen = gen;
+	}
+	fclose(f);
+	if (mem_wal_read(md, fd) < 0){
+	    mem_clear(md);
+	    return -1;
+	}
+	if (fd >= 0) /* Locked: no checkpoint can be written meanwhile */
+	    return 1;
+	/* The log may have been reset for a new checkpoint while reading */
+	if ((f = fopen(md->md_file, "r")) != NULL){
+	    if (mem_ckpt_gen(f, md->md_file, &gen) < 0)
+		gen = 0;
+	    fclose(f);
+	    if (gen == md->md_gen)
+		return 1;
+	}
+    }
+    clicon_err(OE_DB, EAGAIN, "%s: %s: changed during read",
+	       __FUNCTION__, md->md_file);
+    return -1;
+}
+
+static void
+mem_db_free(struct mem_db *md)
+{
+    mem_clear(md);
+    free(md->md_head);
+    free(md->md_file);
+    free(md);
+}
+
+/*
+ * Get database of file from cache or create it, and reference it
+ */
+static struct mem_db *
+mem_db_get(char *file, int nofile)
+{
+    struct mem_db **mdp;
+    struct mem_db  *md;
+
+    for (mdp = &_mem_dbs; (md = *mdp) != NULL; mdp = &md->md_next)
+	if (md->md_nofile == nofile && strcmp(md->md_file, file) == 0){
+	    *mdp = md->md_next;
+	    break;
+	}
+    if (md == NULL){
+	if ((md = calloc(1, sizeof(*md))) == NULL ||
+	    (md->md_file = strdup(file)) == NULL ||
+	    (md->md_head = calloc(1, sizeof(*md->md_head) +
+				  (DBMEM_LEVELS-1)*sizeof(md->md_head->mn_next[0]))) == NULL){
+	    clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	    if (md){
+		if (md->md_file)
+		    free(md->md_file);
+		free(md);
+	    }
+	    return NULL;
+	}
+	md->md_head->mn_level = DBMEM_LEVELS;
+	md->md_nofile = nofile;
+    }
+    /* Most recently used first */
+    md->md_next = _mem_dbs;
+    _mem_dbs = md;
+    md->md_refs++;
+    return md;
+}
+
+/*
+ * Release reference of database, and free least recently used closed
+ * databases if too many are cached
+ */
+static void
+mem_db_put(struct mem_db *md)
+{
+    struct mem_db **mdp;
+    int             n = 0;
+
+    md->md_refs--;
+    for (mdp = &_mem_dbs; (md = *mdp) != NULL; )
+	if (md->md_refs == 0 && (md->md_nofile || ++n > DBMEM_CACHE_MAX)){
+	    *mdp = md->md_next;
+	    mem_db_free(md);
+	}
+	else
+	    mdp = &md->md_next;
+}
+
+/*
+ * Forget cached contents of file, eg when it is removed
+ */
+static void
+mem_db_drop(char *file)
+{
+    struct mem_db **mdp;
+    struct mem_db  *md;
+
+    for (mdp = &_mem_dbs; (md = *mdp) != NULL; mdp = &md->md_next)
+	if (!md->md_nofile && strcmp(md->md_file, file) == 0){
+	    if (md->md_refs)
+		mem_clear(md);
+	    else{
+		*mdp = md->md_next;
+		mem_db_free(md);
+	    }
+	    break;
+	}
+}
+
+static void *
+mem_open(char *file, int mode, int nkeys)
+{
+    struct mem_handle *mh;
+    char               walfile[MAXPATHLEN];
+    int                ret;
+
+    if ((mh = calloc(1, sizeof(*mh))) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: calloc", __FUNCTION__);
+	return NULL;
+    }
+    mh->mh_fd = -1;
+    mh->mh_writer = (mode & DB_OWRITER) != 0;
+    if ((mh->mh_md = mem_db_get(file, (mode & DB_OMEMORY) != 0)) == NULL)
+	goto err;
+    if (mode & DB_OMEMORY){
+	if (mh->mh_writer && (mode & DB_OTRUNC))
+	    mem_clear(mh->mh_md);
+	return mh;
+    }
+    if (mode & DB_OWRITER){
+	snprintf(walfile, sizeof(walfile), "%s.wal", file);
+	if ((mh->mh_fd = open(walfile, O_RDWR|O_CREAT, 0644)) < 0){
+	    clicon_err(OE_UNIX, errno, "%s: open(%s)", __FUNCTION__, walfile);
+	    goto err;
+	}
+	if (flock(mh->mh_fd, LOCK_EX|LOCK_NB) < 0){
+	    clicon_err(OE_DB, errno, "%s: %s is locked", __FUNCTION__, file);
+	    goto err;
+	}
+    }
+    if ((ret = mem_sync(mh->mh_md, mh->mh_fd)) < 0)
+	goto err;
+    if (ret == 0 && !(mode & DB_OCREAT)){
+	clicon_err(OE_DB, ENOENT, "%s: %s", __FUNCTION__, file);
+	goto err;
+    }
+    if (mh->mh_fd < 0)
+	return mh;
+    if (ret == 0 || (mode & DB_OTRUNC)){ /* New empty checkpoint */
+	mem_clear(mh->mh_md);
+	mh->mh_md->md_gen = mem_newgen(0);
+	if (mem_ckpt_write(mh->mh_md, file, mh->mh_md->md_gen) < 0 ||
+	    mem_wal_reset(mh->mh_md, mh->mh_fd) < 0)
+	    goto err;
+    }
+    else if (!mh->mh_md->md_walok){
+	if (mem_wal_reset(mh->mh_md, mh->mh_fd) < 0)
+	    goto err;
+    }
+    else /* Remove partial records of a failed writer */
+	if (ftruncate(mh->mh_fd, mh->mh_md->md_waloff) < 0){
+	    clicon_err(OE_UNIX, errno, "%s: ftruncate(%s)", __FUNCTION__, walfile);
+	    goto err;
+	}
+    return mh;
+  err:
+    if (mh->mh_md){
+	if (mh->mh_fd >= 0) /* Do not trust partially synced database */
+	    mh->mh_md->md_gen = 0;
+	mem_db_put(mh->mh_md);
+    }
+    if (mh->mh_fd >= 0)
+	close(mh->mh_fd);
+    free(mh);
+    return NULL;
+}
+
+/*
+ * Append record to log buffer of writer
+ */
+static int
+mem_log(struct mem_handle *mh, int op, char *key, char *val, int vlen)
+{
+    uint32_t klen = key ? strlen(key) + 1 : 0;
+    uint32_t len = vlen;
+    size_t   need = mh->mh_len + DBMEM_RECLEN + klen + vlen;
+    char    *p;
+
+    if (need > mh->mh_size){
+	if ((p = realloc(mh->mh_buf, need*2)) == NULL){
+	    clicon_err(OE_UNIX, errno, "%s: realloc", __FUNCTION__);
+	    return -1;
+	}
+	mh->mh_buf = p;
+	mh->mh_size = need*2;
+    }
+    p = mh->mh_buf + mh->mh_len;
+    *p++ = op;
+    memcpy(p, &klen, sizeof(klen));
+    p += sizeof(klen);
+    memcpy(p, &len, sizeof(len));
+    p += sizeof(len);
+    memcpy(p, key, klen);
+    memcpy(p + klen, val, vlen);
+    mh->mh_len = need;
+    return 0;
+}
+
+static void
+mem_undo_free(struct mem_handle *mh)
+{
+    struct mem_undo *mu;
+
+    while ((mu = mh->mh_undo) != NULL){
+	mh->mh_undo = mu->mu_next;
+	if (mu->mu_val)
+	    free(mu->mu_val);
+	free(mu);
+    }
+}
+
+/*
+ * Save current value of key for mem_txn_abort()
+ */
+static int
+mem_undo_add(struct mem_handle *mh, char *key)
+{
+    struct mem_undo *mu;
+    struct mem_node *n;
+
+    if ((mu = calloc(1, sizeof(*mu) + strlen(key) + 1)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: calloc", __FUNCTION__);
+	return -1;
+    }
+    mu->mu_key = (char*)(mu + 1);
+    strcpy(mu->mu_key, key);
+    if ((n = mem_lookup(mh->mh_md, key)) != NULL){
+	if ((mu->mu_val = malloc(n->mn_vlen ? n->mn_vlen : 1)) == NULL){
+	    clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	    free(mu);
+	    return -1;
+	}
+	memcpy(mu->mu_val, n->mn_val, n->mn_vlen);
+	mu->mu_vlen = n->mn_vlen;
+    }
+    mu->mu_next = mh->mh_undo;
+    mh->mh_undo = mu;
+    return 0;
+}
+
+/*
+ * Write log records of writer, ending with a commit record. If the log is
+ * then large, write a new checkpoint.
+ */
+static int
+mem_commit(struct mem_handle *mh)
+{
+    struct mem_db *md = mh->mh_md;
+    size_t         p;
+    ssize_t        n;
+
+    mem_undo_free(mh);
+    if (mh->mh_len == 0)
+	return 0;
+    if (mem_log(mh, DBMEM_COMMIT, NULL, NULL, 0) < 0)
+	goto err;
+    for (p = 0; p < mh->mh_len; p += n)
+	if ((n = pwrite(mh->mh_fd, mh->mh_buf + p, mh->mh_len - p,
+			md->md_waloff + p)) < 0){
+	    clicon_err(OE_UNIX, errno, "%s: write %s.wal",
+		       __FUNCTION__, md->md_file);
+	    goto err;
+	}
+    if (fdatasync(mh->mh_fd) < 0){
+	clicon_err(OE_UNIX, errno, "%s: fdatasync %s.wal",
+		   __FUNCTION__, md->md_file);
+	goto err;
+    }
+    md->md_waloff += mh->mh_len;
+    mh->mh_len = 0;
+    if (md->md_waloff > DBMEM_WAL_MAX){
+	clicon_debug(1, "%s: checkpoint %s", __FUNCTION__, md->md_file);
+	md->md_gen = mem_newgen(md->md_gen);
+	if (mem_ckpt_write(md, md->md_file, md->md_gen) < 0 ||
+	    mem_wal_reset(md, mh->mh_fd) < 0)
+	    goto err;
+    }
+    return 0;
+  err:
+    /* Memory has changes that are not on disk: reload at next open */
+    mh->mh_len = 0;
+    md->md_gen = 0;
+    return -1;
+}
+
+static int
+mem_close(void *eh)
+{
+    struct mem_handle *mh = (struct mem_handle *)eh;
+    int                retval = 0;
+
+    if (mh->mh_fd >= 0){
+	retval = mem_commit(mh);
+	close(mh->mh_fd);
+    }
+    mem_db_put(mh->mh_md);
+    if (mh->mh_buf)
+	free(mh->mh_buf);
+    if (mh->mh_itkey)
+	free(mh->mh_itkey);
+    free(mh);
+    return retval;
+}
+
+static int
+mem_get(void *eh, char *key, char **val, int *vlen)
+{
+    struct mem_handle *mh = (struct mem_handle *)eh;
+    struct mem_node   *n;
+
+    if ((n = mem_lookup(mh->mh_md, key)) == NULL)
+	return 0;
+    if (val){
+	if ((*val = malloc(n->mn_vlen + 1)) == NULL){
+	    clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	    return -1;
+	}
+	memcpy(*val, n->mn_val, n->mn_vlen);
+	(*val)[n->mn_vlen] = '\0';
+    }
+    if (vlen)
+	*vlen = n->mn_vlen;
+    return 1;
+}
+
+static int
+mem_put(void *eh, char *key, void *val, int vlen)
+{
+    struct mem_handle *mh = (struct mem_handle *)eh;
+
+    if (!mh->mh_writer){
+	clicon_err(OE_DB, EBADF, "%s: %s not open for writing",
+		   __FUNCTION__, mh->mh_md->md_file);
+	return -1;
+    }
+    if (mh->mh_txn && mem_undo_add(mh, key) < 0)
+	return -1;
+    if (!mh->mh_md->md_nofile && mem_log(mh, DBMEM_PUT, key, val, vlen) < 0)
+	return -1;
+    return mem_set(mh->mh_md, key, val, vlen);
+}
+
+static int
+mem_del(void *eh, char *key)
+{
+    struct mem_handle *mh = (struct mem_handle *)eh;
+
+    if (!mh->mh_writer){
+	clicon_err(OE_DB, EBADF, "%s: %s not open for writing",
+		   __FUNCTION__, mh->mh_md->md_file);
+	return -1;
+    }
+    if (mem_lookup(mh->mh_md, key) == NULL)
+	return 0;
+    if (mh->mh_txn && mem_undo_add(mh, key) < 0)
+	return -1;
+    if (!mh->mh_md->md_nofile && mem_log(mh, DBMEM_DEL, key, NULL, 0) < 0)
+	return -1;
+    return mem_unset(mh->mh_md, key);
+}
+
+static int
+mem_count(void *eh)
+{
+    return ((struct mem_handle *)eh)->mh_md->md_count;
+}
+
+static int
+mem_iterinit(void *eh, char *from)
+{
+    struct mem_handle *mh = (struct mem_handle *)eh;
+
+    if (mh->mh_itkey)
+	free(mh->mh_itkey);
+    if ((mh->mh_itkey = strdup(from ? from : "")) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: strdup", __FUNCTION__);
+	return -1;
+    }
+    mh->mh_itfirst = 1;
+    mh->mh_it = mem_seek(mh->mh_md, mh->mh_itkey, 0, NULL);
+    mh->mh_itversion = mh->mh_md->md_version;
+    return 0;
+}
+
+/*
+ * Next key after the last returned. If nodes were added or removed since,
+ * the position is looked up again by key.
+ */
+static int
+mem_iternext(void *eh, char **key)
+{
+    struct mem_handle *mh = (struct mem_handle *)eh;
+    struct mem_node   *n;
+
+    if (mh->mh_itkey == NULL)
+	return 0;
+    if (mh->mh_itversion != mh->mh_md->md_version){
+	mh->mh_it = mem_seek(mh->mh_md, mh->mh_itkey, !mh->mh_itfirst, NULL);
+	mh->mh_itversion = mh->mh_md->md_version;
+    }
+    if ((n = mh->mh_it) == NULL)
+	return 0;
+    if ((*key = strdup(n->mn_key)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: strdup", __FUNCTION__);
+	return -1;
+    }
+    free(mh->mh_itkey);
+    if ((mh->mh_itkey = strdup(n->mn_key)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: strdup", __FUNCTION__);
+	free(*key);
+	return -1;
+    }
+    mh->mh_itfirst = 0;
+    mh->mh_it = n->mn_next[0];
+    return 1;
+}
+
+static int
+mem_txn_begin(void *eh)
+{
+    struct mem_handle *mh = (struct mem_handle *)eh;
+
+    if (!mh->mh_writer)
+	return 0;
+    if (mem_commit(mh) < 0) /* Changes before transaction */
+	return -1;
+    mh->mh_txn = 1;
+    return 0;
+}
+
+static int
+mem_txn_commit(void *eh)
+{
+    struct mem_handle *mh = (struct mem_handle *)eh;
+
+    if (!mh->mh_writer)
+	return 0;
+    mh->mh_txn = 0;
+    return mem_commit(mh);
+}
+
+/*
+ * Restore values changed in transaction, latest first, and drop its log
+ * records
+ */
+static int
+mem_txn_abort(void *eh)
+{
+    struct mem_handle *mh = (struct mem_handle *)eh;
+    struct mem_undo   *mu;
+    int                retval = 0;
+
+    for (mu = mh->mh_undo; mu; mu = mu->mu_next)
+	if (mu->mu_val){
+	    if (mem_set(mh->mh_md, mu->mu_key, mu->mu_val, mu->mu_vlen) < 0)
+		retval = -1;
+	}
+	else
+	    mem_unset(mh->mh_md, mu->mu_key);
+    mem_undo_free(mh);
+    mh->mh_len = 0;
+    mh->mh_txn = 0;
+    if (retval < 0) /* Reload at next open */
+	mh->mh_md->md_gen = 0;
+    return retval;
+}
+
+/*
+ * Copy database: write a checkpoint of src as target. A log of target
+ * belongs to an earlier checkpoint and is ignored.
+ */
+static int
+mem_copy(char *src, char *target)
+{
+    struct mem_handle *mh;
+    int                retval;
+
+    if ((mh = mem_open(src, DB_OREADER, 0)) == NULL)
+	return -1;
+    mem_db_drop(target);
+    retval = mem_ckpt_write(mh->mh_md, target, mem_newgen(mh->mh_md->md_gen));
+    mem_close(mh);
+    return retval;
+}
+
+static int
+mem_remove(char *file)
+{
+    char walfile[MAXPATHLEN];
+
+    snprintf(walfile, sizeof(walfile), "%s.wal", file);
+    mem_db_drop(file);
+    if ((unlink(file) < 0 && errno != ENOENT) ||
+	(unlink(walfile) < 0 && errno != ENOENT)){
+	clicon_err(OE_UNIX, errno, "%s: unlink(%s)", __FUNCTION__, file);
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * Rename database: target is replaced atomically by a checkpoint of src
+ */
+static int
+mem_rename(char *src, char *target)
+{
+    if (mem_copy(src, target) < 0)
+	return -1;
+    return mem_remove(src);
+}
+
+/*
+ * Change stamp: checkpoint generation, and log file, size and time. Commits
+ * only append to the log, and the log is only emptied for a new checkpoint.
+ */
+static int
+mem_stamp(char *file, char *stamp)
+{
+    char        walfile[MAXPATHLEN];
+    FILE       *f;
+    uint64_t    gen;
+    struct stat st;
+
+    stamp[0] = '\0';
+    if ((f = fopen(file, "r")) == NULL){
+	if (errno == ENOENT)
+	    return 0;
+	clicon_err(OE_UNIX, errno, "%s: fopen(%s)", __FUNCTION__, file);
+	return -1;
+    }
+    if (mem_ckpt_gen(f, file, &gen) < 0){
+	fclose(f);
+	return -1;
+    }
+    fclose(f);
+    snprintf(walfile, sizeof(walfile), "%s.wal", file);
+    if (stat(walfile, &st) < 0){
+	if (errno != ENOENT){
+	    clicon_err(OE_UNIX, errno, "%s: stat(%s)", __FUNCTION__, walfile);
+	    return -1;
+	}
+	memset(&st, 0, sizeof(st));
+    }
+    snprintf(stamp, DB_STAMPLEN, "%llx:%lu:%lld:%ld.%09ld",
+	     (unsigned long long)gen, (unsigned long)st.st_ino,
+	     (long long)st.st_size,
+	     (long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+    return 0;
+}
+
+struct db_engine db_engine_mem = {
+    "memory",
+    1,                  /* key order */
+    mem_open,
+    mem_close,
+    mem_get,
+    mem_put,
+    mem_del,
+    mem_count,
+    mem_iterinit,
+    mem_iternext,
+    mem_txn_begin,
+    mem_txn_commit,
+    mem_txn_abort,
+    mem_copy,
+    mem_rename,
+    mem_remove,
+    mem_stamp
+};
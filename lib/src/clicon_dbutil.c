@@ -544,6 +544,40 @@ lv2str(struct lvalue *lv)
 }
 
 
+/*
+ * lvec_find
+ * Find the value of variable 'name' in an lvec, without decoding the lvec.
+ * A leading '!' (unique variable) in the lvec name is ignored.
+ * Returns a pointer to the value lvalue within lvec, or NULL if not found.
+ */
+struct lvalue *
+lvec_find(char *lvec, int vlen, char *name)
+{
+    struct lvalue *lv;
+    struct lvalue *lvv;
+    int            hlen;
+    char          *n;
+
+    if (lvec == NULL)
+	return NULL;
+    hlen = (void*)((struct lvalue *)lvec)->lv_val - (void*)lvec;
+    lv = (struct lvalue *)lvec;
+    while ((void*)lv < (void*)lvec+vlen){
+	lvv = (struct lvalue *)((void*)lv + hlen + lv->lv_len); /* value */
+	if ((void*)lvv >= (void*)lvec+vlen)
+	    break;
+	if (lv->lv_type != CGV_STRING)
+	    break; /* Not a name/value lvec */
+	n = lv->lv_val;
+	if (n[0] == '!')
+	    n++;
+	if (strcmp(n, name) == 0)
+	    return lvv; /* found */
+	lv = (struct lvalue *)((void*)lvv + hlen + lvv->lv_len); /* next name */
+    }
+    return NULL;
+}
+
 /*
  * Given a basekey in spec-format, generate a regexp key to be
  * used for matching real database keys.
@@ -0,0 +1,400 @@
+/*
+ *
+  Copyright (C) 2009-2015 Olof Hagsand and Benny Holmgren
+
+  This file is part of CLICON.
+
+  CLICON is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  CLICON is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with CLICON; see the file COPYING.  If not, see
+  <http://www.gnu.org/licenses/>.
+
+ */
+
+/*
+ * Line based difference of two texts, typically two configurations printed
+ * as xml or text. The difference is computed in-process using the Myers
+ * O(ND) algorithm in linear space and printed as a unified diff without
+ * headers, ie lines prefixed with ' ' (context), '-' (removed) or '+' (added).
+ * This is the same output as:
+ *    diff -dU <context> file1 file2 | grep -v @@ | sed 1,2d
+ *
+ * Example:
+ *    clicon_diff_buf(stdout, running_txt, candidate_txt, 1);
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "clicon_config.h" /* generated by config & autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+/* clicon */
+#include "clicon_err.h"
+#include "clicon_diff.h"
+
+/*
+ * Diff context, shared by all levels of recursion
+ */
+struct diff_ctx {
+    char     **dc_l1;   /* Lines of text 1 */
+    char     **dc_l2;   /* Lines of text 2 */
+    uint32_t  *dc_h1;   /* Line hashes of text 1 */
+    uint32_t  *dc_h2;   /* Line hashes of text 2 */
+    char      *dc_del;  /* Set if line in text 1 is removed */
+    char      *dc_ins;  /* Set if line in text 2 is added */
+    int       *dc_v1;   /* Forward furthest reaching paths */
+    int       *dc_v2;   /* Reverse furthest reaching paths */
+};
+
+/*
+ * FNV-1a hash of a line, to avoid most string compares
+ */
+static uint32_t
+diff_hash(const char *str)
+{
+    uint32_t h = 2166136261U;
+
+    while (*str){
+	h ^= (uint8_t)*str++;
+	h *= 16777619U;
+    }
+    return h;
+}
+
+static inline int
+diff_eq(struct diff_ctx *dc, int i, int j)
+{
+    return dc->dc_h1[i] == dc->dc_h2[j] &&
+	strcmp(dc->dc_l1[i], dc->dc_l2[j]) == 0;
+}
+
+static void diff_compare(struct diff_ctx *dc, int x0, int x1, int y0, int y1);
+
+/*
+ * Find the middle snake of lines [x0,x1) and [y0,y1) and split the problem
+ * in two halves there. Prefix and suffix are already stripped.
+ */
+static void
+diff_bisect(struct diff_ctx *dc, int x0, int x1, int y0, int y1)
+{
+    int  n = x1 - x0;
+    int  m = y1 - y0;
+    int  maxd = (n + m + 1) / 2;
+    int  voff = maxd;
+    int  vlen = 2 * maxd + 2;
+    int  delta = n - m;
+    int  front = (delta % 2 != 0);
+    int  k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+    int *v1 = dc->dc_v1;
+    int *v2 = dc->dc_v2;
+    int  d, k1, k2, k1off, k2off;
+    int  xa, ya, xb, yb;
+
+    for (k1 = 0; k1 < vlen; k1++)
+	v1[k1] = v2[k1] = -1;
+    v1[voff + 1] = 0;
+    v2[voff + 1] = 0;
+    for (d = 0; d < maxd; d++){
+	/* Forward path one step */
+	for (k1 = -d + k1start; k1 <= d - k1end; k1 += 2){
+	    k1off = voff + k1;
+	    if (k1 == -d || (k1 != d && v1[k1off - 1] < v1[k1off + 1]))
+		xa = v1[k1off + 1];
+	    else
+		xa = v1[k1off - 1] + 1;
+	    ya = xa - k1;
+	    while (xa < n && ya < m && diff_eq(dc, x0 + xa, y0 + ya)){
+		xa++;
+		ya++;
+	    }
+	    v1[k1off] = xa;
+	    if (xa > n)
+		k1end += 2;     /* Ran off the right */
+	    else if (ya > m)
+		k1start += 2;   /* Ran off the bottom */
+	    else if (front){
+		k2off = voff + delta - k1;
+		if (k2off >= 0 && k2off < vlen && v2[k2off] != -1 &&
+		    xa >= n - v2[k2off])
+		    goto split;
+	    }
+	}
+	/* Reverse path one step */
+	for (k2 = -d + k2start; k2 <= d - k2end; k2 += 2){
+	    k2off = voff + k2;
+	    if (k2 == -d || (k2 != d && v2[k2off - 1] < v2[k2off + 1]))
+		xb = v2[k2off + 1];
+	    else
+		xb = v2[k2off - 1] + 1;
+	    yb = xb - k2;
+	    while (xb < n && yb < m &&
+		   diff_eq(dc, x0 + n - xb - 1, y0 + m - yb - 1)){
+		xb++;
+		yb++;
+	    }
+	    v2[k2off] = xb;
+	    if (xb > n)
+		k2end += 2;
+	    else if (yb > m)
+		k2start += 2;
+	    else if (!front){
+		k1off = voff + delta - k2;
+		if (k1off >= 0 && k1off < vlen && v1[k1off] != -1){
+		    xa = v1[k1off];
+		    ya = voff + xa - k1off;
+		    if (xa >= n - xb)
+			goto split;
+		}
+	    }
+	}
+    }
+    /* No common lines */
+    memset(&dc->dc_del[x0], 1, n);
+    memset(&dc->dc_ins[y0], 1, m);
+    return;
+  split:
+    diff_compare(dc, x0, x0 + xa, y0, y0 + ya);
+    diff_compare(dc, x0 + xa, x1, y0 + ya, y1);
+}
+
+/*
+ * Compute difference of lines [x0,x1) in text 1 and [y0,y1) in text 2,
+ * and mark removed and added lines.
+ */
+static void
+diff_compare(struct diff_ctx *dc, int x0, int x1, int y0, int y1)
+{
+    /* Strip common prefix and suffix */
+    while (x0 < x1 && y0 < y1 && diff_eq(dc, x0, y0)){
+	x0++;
+	y0++;
+    }
+    while (x0 < x1 && y0 < y1 && diff_eq(dc, x1 - 1, y1 - 1)){
+	x1--;
+	y1--;
+    }
+    if (x0 == x1)
+	memset(&dc->dc_ins[y0], 1, y1 - y0);
+    else if (y0 == y1)
+	memset(&dc->dc_del[x0], 1, x1 - x0);
+    else
+	diff_bisect(dc, x0, x1, y0, y1);
+}
+
+/*
+ * Print the edit script. Removed lines of a change are printed before the
+ * added lines. Unchanged lines are only printed if they are within 'context'
+ * lines of a change, or all of them if context is negative.
+ */
+static int
+diff_print(FILE *f, struct diff_ctx *dc, int n1, int n2, int context)
+{
+    int  *ops;     /* Edit script: 0 unchanged, 1 removed, 2 added */
+    int  *idx;     /* Line index of op in text 1 or text 2 */
+    int  *dist;    /* Distance of unchanged line to closest change */
+    int   nops = 0;
+    int   i = 0, j = 0;
+    int   i0, j0;
+    int   k, d;
+
+    if ((ops = malloc((n1+n2+1)*3*sizeof(int))) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	return -1;
+    }
+    idx = ops + (n1+n2+1);
+    dist = idx + (n1+n2+1);
+    while (i < n1 || j < n2){
+	if (i < n1 && j < n2 && !dc->dc_del[i] && !dc->dc_ins[j]){
+	    ops[nops] = 0;
+	    idx[nops++] = i;
+	    i++;
+	    j++;
+	    continue;
+	}
+	i0 = i;
+	j0 = j;
+	while ((i < n1 && dc->dc_del[i]) || (j < n2 && dc->dc_ins[j])){
+	    if (i < n1 && dc->dc_del[i])
+		i++;
+	    else
+		j++;
+	}
+	for (; i0 < i; i0++){
+	    ops[nops] = 1;
+	    idx[nops++] = i0;
+	}
+	for (; j0 < j; j0++){
+	    ops[nops] = 2;
+	    idx[nops++] = j0;
+	}
+    }
+    /* Distance to previous and next change */
+    d = n1 + n2 + 1;
+    for (k = 0; k < nops; k++){
+	d = ops[k] ? 0 : d + 1;
+	dist[k] = d;
+    }
+    d = n1 + n2 + 1;
+    for (k = nops-1; k >= 0; k--){
+	d = ops[k] ? 0 : d + 1;
+	if (d < dist[k])
+	    dist[k] = d;
+    }
+    for (k = 0; k < nops; k++)
+	switch (ops[k]){
+	case 0:
+	    if (context < 0 || dist[k] <= context)
+		fprintf(f, " %s\n", dc->dc_l1[idx[k]]);
+	    break;
+	case 1:
+	    fprintf(f, "-%s\n", dc->dc_l1[idx[k]]);
+	    break;
+	case 2:
+	    fprintf(f, "+%s\n", dc->dc_l2[idx[k]]);
+	    break;
+	}
+    free(ops);
+    return 0;
+}
+
+/*! Print difference between two vectors of lines as unified diff
+ *
+ * @param[in]  f        Output file
+ * @param[in]  lines1   Lines of text 1 (original), without newlines
+ * @param[in]  n1       Number of lines in text 1
+ * @param[in]  lines2   Lines of text 2 (new), without newlines
+ * @param[in]  n2       Number of lines in text 2
+ * @param[in]  context  Number of unchanged lines around each change. -1: all
+ * @retval     0        OK
+ * @retval    -1        Error
+ */
+int
+clicon_diff_lines(FILE  *f,
+		  char **lines1,
+		  int    n1,
+		  char **lines2,
+		  int    n2,
+		  int    context)
+{
+    struct diff_ctx dc;
+    int             i;
+    int             retval = -1;
+
+    memset(&dc, 0, sizeof(dc));
+    dc.dc_l1 = lines1;
+    dc.dc_l2 = lines2;
+    if ((dc.dc_h1 = malloc((n1+1)*sizeof(uint32_t))) == NULL ||
+	(dc.dc_h2 = malloc((n2+1)*sizeof(uint32_t))) == NULL ||
+	(dc.dc_del = calloc(n1+1, 1)) == NULL ||
+	(dc.dc_ins = calloc(n2+1, 1)) == NULL ||
+	(dc.dc_v1 = malloc((n1+n2+4)*sizeof(int))) == NULL ||
+	(dc.dc_v2 = malloc((n1+n2+4)*sizeof(int))) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	goto done;
+    }
+    for (i = 0; i < n1; i++)
+	dc.dc_h1[i] = diff_hash(lines1[i]);
+    for (i = 0; i < n2; i++)
+	dc.dc_h2[i] = diff_hash(lines2[i]);
+    diff_compare(&dc, 0, n1, 0, n2);
+    retval = diff_print(f, &dc, n1, n2, context);
+  done:
+    if (dc.dc_h1)
+	free(dc.dc_h1);
+    if (dc.dc_h2)
+	free(dc.dc_h2);
+    if (dc.dc_del)
+	free(dc.dc_del);
+    if (dc.dc_ins)
+	free(dc.dc_ins);
+    if (dc.dc_v1)
+	free(dc.dc_v1);
+    if (dc.dc_v2)
+	free(dc.dc_v2);
+    return retval;
+}
+
+/*
+ * Split a copy of buf into lines. Returns vector of lines pointing into
+ * the copy which is placed after the vector in the same malloced block.
+ */
+static char **
+diff_split(char *buf, int *nlines)
+{
+    char  **vec;
+    char   *s;
+    char   *p;
+    size_t  len = strlen(buf);
+    int     n = 0;
+    int     i;
+
+    for (p = buf; *p; p++)
+	if (*p == '\n')
+	    n++;
+    if (len && buf[len-1] != '\n')
+	n++;
+    if ((vec = malloc((n+1)*sizeof(char *) + len + 1)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	return NULL;
+    }
+    s = (char *)&vec[n+1];
+    memcpy(s, buf, len + 1);
+    for (i = 0; i < n; i++){
+	vec[i] = s;
+	if ((p = strchr(s, '\n')) == NULL)
+	    break;
+	*p = '\0';
+	s = p + 1;
+    }
+    vec[n] = NULL;
+    *nlines = n;
+    return vec;
+}
+
+/*! Print difference between two texts as unified diff
+ *
+ * @param[in]  f        Output file
+ * @param[in]  buf1     Text 1 (original), newline separated lines
+ * @param[in]  buf2     Text 2 (new), newline separated lines
+ * @param[in]  context  Number of unchanged lines around each change. -1: all
+ * @retval     0        OK
+ * @retval    -1        Error
+ * @see clicon_diff_lines
+ */
+int
+clicon_diff_buf(FILE *f,
+		char *buf1,
+		char *buf2,
+		int   context)
+{
+    char **v1 = NULL;
+    char **v2 = NULL;
+    int    n1, n2;
+    int    retval = -1;
+
+    if ((v1 = diff_split(buf1, &n1)) == NULL)
+	goto done;
+    if ((v2 = diff_split(buf2, &n2)) == NULL)
+	goto done;
+    retval = clicon_diff_lines(f, v1, n1, v2, n2, context);
+  done:
+    if (v1)
+	free(v1);
+    if (v2)
+	free(v2);
+    return retval;
+}
@@ -53,7 +53,7 @@
 struct event_data{
     struct event_data *e_next;     /* next in list */
     int (*e_fn)(int, void*);            /* function */
-    enum {EVENT_FD, EVENT_TIME} e_type;        /* type of event */
+    enum {EVENT_FD, EVENT_FD_WRITE, EVENT_TIME} e_type; /* type of event */
     int e_fd;                      /* File descriptor */
     struct timeval e_time;         /* Timeout */
     void *e_arg;                   /* function argument */
@@ -124,11 +124,44 @@ event_reg_fd(int fd, int (*fn)(int, void*), void *arg, char *str)
     return 0;
 }
 
+/*! Register a callback function to be called when a file descriptor is writable.
+ *
+ * Used to drain buffered output without blocking. Deregister with 
+ * event_unreg_fd() when there is nothing more to write, otherwise fn is 
+ * called in every turn of the event loop.
+ * @param[in]  fd  File descriptor
+ * @param[in]  fn  Function to call when fd is writable
+ * @param[in]  arg Argument to function fn
+ * @param[in]  str Describing string for logging
+ * @see event_reg_fd
+ */
+int
+event_reg_fd_write(int fd, int (*fn)(int, void*), void *arg, char *str)
+{
+    struct event_data *e;
+
+    if ((e = (struct event_data *)malloc(sizeof(struct event_data))) == NULL){
+	clicon_err(OE_EVENTS, errno, "malloc");
+	return -1;
+    }
+    memset(e, 0, sizeof(struct event_data));
+    strncpy(e->e_string, str, EVENT_STRLEN);
+    e->e_fd = fd;
+    e->e_fn = fn;
+    e->e_arg = arg;
+    e->e_type = EVENT_FD_WRITE;
+    e->e_next = ee;
+    ee = e;
+    clicon_debug(2, "%s, registering %s", __FUNCTION__, e->e_string);
+    return 0;
+}
+
 /*! Deregister a file descriptor callback
  * @param[in]  s   File descriptor
  * @param[in]  fn  Function to call when input available on fd
  * Note: deregister when exactly function and socket match, not argument
  * @see event_reg_fd
+ * @see event_reg_fd_write
  * @see event_unreg_timeout
  */
 int
@@ -242,23 +275,27 @@ event_loop(void)
     int n;
     struct timeval t, t0, tnull={0,};
     fd_set fdset;
+    fd_set wrset;
     int retval = -1;
 
     while (!clicon_exit_get()){
 	FD_ZERO(&fdset);
+	FD_ZERO(&wrset);
 	for (e=ee; e; e=e->e_next)
 	    if (e->e_type == EVENT_FD)
 		FD_SET(e->e_fd, &fdset);
+	    else if (e->e_type == EVENT_FD_WRITE)
+		FD_SET(e->e_fd, &wrset);
 	if (ee_timers != NULL){
 	    gettimeofday(&t0, NULL);
 	    timersub(&ee_timers->e_time, &t0, &t); 
 	    if (t.tv_sec < 0)
-		n = select(FD_SETSIZE, &fdset, NULL, NULL, &tnull); 
+		n = select(FD_SETSIZE, &fdset, &wrset, NULL, &tnull); 
 	    else
-		n = select(FD_SETSIZE, &fdset, NULL, NULL, &t); 
+		n = select(FD_SETSIZE, &fdset, &wrset, NULL, &t); 
 	}
 	else
-	    n = select(FD_SETSIZE, &fdset, NULL, NULL, NULL); 
+	    n = select(FD_SETSIZE, &fdset, &wrset, NULL, NULL); 
 	if (clicon_exit_get())
 	    break;
 	if (n == -1) {
@@ -288,7 +325,8 @@ event_loop(void)
 	    if (clicon_exit_get())
 		break;
 	    e_next = e->e_next;
-	    if(e->e_type == EVENT_FD && FD_ISSET(e->e_fd, &fdset)){
+	    if((e->e_type == EVENT_FD && FD_ISSET(e->e_fd, &fdset)) ||
+	       (e->e_type == EVENT_FD_WRITE && FD_ISSET(e->e_fd, &wrset))){
 		clicon_debug(2, "%s: FD_ISSET: %s[%x]", 
 			__FUNCTION__, e->e_string, e->e_arg);
 		if ((*e->e_fn)(e->e_fd, e->e_arg) < 0)
@@ -26,6 +26,14 @@
  * are always strings while values can be some arbitrary data referenced
  * by void*.
  *
+ * The table is open addressing with linear probing over a power of two 
+ * number of slots. Each slot holds the 64-bit hash of its key and a pointer 
+ * to the entry, so entries stay where they are when the table grows, and 
+ * keys are only compared when their hashes are equal. The table is grown
+ * (doubled) when more than 3/4 of the slots are used by entries or by 
+ * deleted slots, so lookups and inserts are O(1) amortized.
+ * Iterate without allocation with hash_next() or hash_each().
+ *
  * XXX: functions such as hash_keys(), hash_value() etc are currently returning
  * pointers to the actual data storage. Should probably make copies.
  *
@@ -80,20 +88,105 @@
 #include "clicon_err.h"
 #include "clicon_hash.h"
 
-#define HASH_SIZE	1031	/* Number of hash buckets. Should be a prime */ 
+#define HASH_SIZE	16	/* Initial number of slots. Power of 2 */ 
+
+#define HASH_M1 0x9e3779b97f4a7c15ULL
+#define HASH_M2 0xbf58476d1ce4e5b9ULL
+#define HASH_M3 0x94d049bb133111ebULL
+
+/* Slot of deleted entry. Lookups continue past it */
+static struct clicon_hash hash_deleted;
+#define HASH_DELETED (&hash_deleted)
+
+struct hash_slot {
+    uint64_t       hs_hash;
+    clicon_hash_t  hs_ent;   /* NULL if free, HASH_DELETED if deleted */
+};
+
+/* The hash table, clicon_hash_t * of the API */
+struct hash_table {
+    size_t            ht_size;  /* Number of slots, power of 2 */
+    size_t            ht_count; /* Number of entries */
+    size_t            ht_used;  /* Number of entries and deleted slots */
+    struct hash_slot *ht_slots;
+};
 
 /*
- * A very simplistic algorithm to calculate a hash bucket index
+ * Hash of string, eight bytes at a time (multiply and xorshift), with a 
+ * final mix so that all bits of the hash depend on all bytes of the key.
  */
-static uint32_t
-hash_bucket(const char *str)
+static uint64_t
+hash_string(const char *str, size_t len)
 {
-    uint32_t n = 0;
+    uint64_t h = HASH_M1 ^ (len * HASH_M2);
+    uint64_t v;
 
-    while(*str)
-	n += (uint32_t)*str++;
-    
-    return n % HASH_SIZE;
+    for (; len >= 8; str += 8, len -= 8){
+	memcpy(&v, str, 8);
+	h = (h ^ v) * HASH_M2;
+	h ^= h >> 29;
+    }
+    v = 0;
+    memcpy(&v, str, len);
+    h = (h ^ v) * HASH_M2;
+    h ^= h >> 32;
+    h *= HASH_M3;
+    h ^= h >> 29;
+    return h;
+}
+
+/*
+ * Find slot of key, or the slot where it would be added: the first deleted
+ * slot on the way, or the free slot that ends the probe.
+ */
+static struct hash_slot *
+hash_slot(struct hash_table *ht, const char *key, uint64_t hv)
+{
+    size_t            mask = ht->ht_size - 1;
+    size_t            i;
+    struct hash_slot *hs;
+    struct hash_slot *del = NULL;
+
+    for (i = hv & mask; ; i = (i + 1) & mask){
+	hs = &ht->ht_slots[i];
+	if (hs->hs_ent == NULL)
+	    return del ? del : hs;
+	if (hs->hs_ent == HASH_DELETED){
+	    if (del == NULL)
+		del = hs;
+	}
+	else if (hs->hs_hash == hv && strcmp(hs->hs_ent->h_key, key) == 0)
+	    return hs;
+    }
+}
+
+/*
+ * Move all entries to a table of size slots, dropping deleted slots
+ */
+static int
+hash_resize(struct hash_table *ht, size_t size)
+{
+    struct hash_slot *old = ht->ht_slots;
+    size_t            osize = ht->ht_size;
+    size_t            i;
+    size_t            j;
+
+    if ((ht->ht_slots = calloc(size, sizeof(struct hash_slot))) == NULL){
+	clicon_err(OE_UNIX, errno, "calloc: %s", strerror(errno));
+	ht->ht_slots = old;
+	return -1;
+    }
+    ht->ht_size = size;
+    for (i = 0; i < osize; i++)
+	if (old[i].hs_ent && old[i].hs_ent != HASH_DELETED){
+	    for (j = old[i].hs_hash & (size - 1); ht->ht_slots[j].hs_ent;
+		 j = (j + 1) & (size - 1))
+		;
+	    ht->ht_slots[j] = old[i];
+	}
+    ht->ht_used = ht->ht_count;
+    free(old);
+    return 0;
 }
 
 /*
@@ -106,14 +199,17 @@ hash_bucket(const char *str)
 clicon_hash_t *
 hash_init (void)
 {
-  clicon_hash_t *hash;
-
-  if ((hash = (clicon_hash_t *)malloc (sizeof (clicon_hash_t) * HASH_SIZE)) == NULL){
-      clicon_err(OE_UNIX, errno, "malloc: %s", strerror(errno));
-      return NULL;
-  }
-  memset (hash, 0, sizeof(clicon_hash_t)*HASH_SIZE);
-  return hash;
+    struct hash_table *ht;
+
+    if ((ht = calloc(1, sizeof(*ht))) == NULL ||
+	(ht->ht_slots = calloc(HASH_SIZE, sizeof(struct hash_slot))) == NULL){
+	clicon_err(OE_UNIX, errno, "malloc: %s", strerror(errno));
+	if (ht)
+	    free(ht);
+	return NULL;
+    }
+    ht->ht_size = HASH_SIZE;
+    return (clicon_hash_t *)ht;
 }
 
 /*
@@ -127,18 +223,19 @@ hash_init (void)
 void
 hash_free (clicon_hash_t *hash)
 {
-    int i;
-    clicon_hash_t tmp;
-    for (i = 0; i < HASH_SIZE; i++) {
-	while (hash[i]) {
-	    tmp = hash[i];
-	    DELQ(tmp, hash[i], clicon_hash_t);
-	    free(tmp->h_key);
-	    free(tmp->h_val);
-	    free(tmp);
+    struct hash_table *ht = (struct hash_table *)hash;
+    clicon_hash_t      h;
+    size_t             i;
+
+    for (i = 0; i < ht->ht_size; i++) {
+	h = ht->ht_slots[i].hs_ent;
+	if (h && h != HASH_DELETED){
+	    free(h->h_val);
+	    free(h);
 	}
     }
-    free(hash);
+    free(ht->ht_slots);
+    free(ht);
 }
 
 
@@ -152,20 +249,13 @@ hash_free (clicon_hash_t *hash)
 clicon_hash_t
 hash_lookup (clicon_hash_t *hash, const char *key)
 {
-    uint32_t bkt;
-    clicon_hash_t h;
+    struct hash_table *ht = (struct hash_table *)hash;
+    struct hash_slot  *hs;
 
-    bkt = hash_bucket(key);
-    h = hash[bkt];
-    if (h) {
-	do {
-	    if (!strcmp (h->h_key, key))
-		return h;
-	    h = NEXTQ(clicon_hash_t, h);
-	} while (h != hash[bkt]);
-    }
-    
-    return NULL;
+    hs = hash_slot(ht, key, hash_string(key, strlen(key)));
+    if (hs->hs_ent == NULL || hs->hs_ent == HASH_DELETED)
+	return NULL;
+    return hs->hs_ent;
 }
 
 /*
@@ -199,24 +289,32 @@ hash_value(clicon_hash_t *hash, const char *key, size_t *vlen)
 clicon_hash_t
 hash_add (clicon_hash_t *hash, const char *key, void *val, size_t vlen)
 {
-    void *newval;
-    clicon_hash_t h, new = NULL;
+    struct hash_table *ht = (struct hash_table *)hash;
+    struct hash_slot  *hs;
+    void              *newval;
+    clicon_hash_t      h;
+    clicon_hash_t      new = NULL;
+    size_t             klen = strlen(key);
+    uint64_t           hv = hash_string(key, klen);
     
     /* If variable exist, don't allocate a new. just replace value */
-    h = hash_lookup (hash, key);
-    if (h == NULL) {
-	if ((new = (clicon_hash_t)malloc (sizeof (*new))) == NULL){
+    hs = hash_slot(ht, key, hv);
+    if ((h = hs->hs_ent) == NULL || h == HASH_DELETED) {
+	/* Grow, or drop deleted slots, before the table gets full */
+	if (hs->hs_ent == NULL && (ht->ht_used + 1) * 4 > ht->ht_size * 3){
+	    if (hash_resize(ht, (ht->ht_count + 1) * 2 > ht->ht_size ?
+			    ht->ht_size * 2 : ht->ht_size) < 0)
+		return NULL;
+	    hs = hash_slot(ht, key, hv);
+	}
+	/* Entry and key in one allocation */
+	if ((new = (clicon_hash_t)malloc (sizeof (*new) + klen + 1)) == NULL){
 	    clicon_err(OE_UNIX, errno, "malloc: %s", strerror(errno));
-	    goto catch;
+	    return NULL;
 	}
 	memset (new, 0, sizeof (*new));
-	
-	new->h_key = strdup (key);
-	if (new->h_key == NULL){
-	    clicon_err(OE_UNIX, errno, "strdup: %s", strerror(errno));
-	    goto catch;
-	}
-	
+	new->h_key = (char *)(new + 1);
+	memcpy(new->h_key, key, klen + 1);
 	h = new;
     }
     
@@ -224,7 +322,9 @@ hash_add (clicon_hash_t *hash, const char *key, void *val, size_t vlen)
     newval = malloc (vlen+3); /* XXX: qdbm needs aligned mallocs? */
     if (newval == NULL){
 	clicon_err(OE_UNIX, errno, "malloc: %s", strerror(errno));
-	goto catch;
+	if (new)
+	    free (new);
+	return NULL;
     }
     memcpy (newval, val, vlen);
     
@@ -234,24 +334,21 @@ hash_add (clicon_hash_t *hash, const char *key, void *val, size_t vlen)
     h->h_val = newval;
     h->h_vlen =  vlen;
 
-    /* Add to list only if new variable */
-    if (new)
-	INSQ(h, hash[hash_bucket(key)]);
-
-    return h;
-
-catch:
-    if (new) {
-	if (new->h_key)
-	    free (new->h_key);
-	free (new);
+    /* Add to table only if new variable */
+    if (new){
+	if (hs->hs_ent == NULL)
+	    ht->ht_used++;
+	hs->hs_hash = hv;
+	hs->hs_ent = h;
+	ht->ht_count++;
     }
 
-    return NULL;
+    return h;
 }
 
 /*
- * Delete entry.
+ * Delete entry. The slot is marked as deleted, so entries may be deleted
+ * while iterating with hash_next().
  *
  * Arguments:
  *	hash	  	- Hash structure
@@ -262,52 +359,68 @@ catch:
 int
 hash_del (clicon_hash_t *hash, const char *key)
 {
-    clicon_hash_t h;
+    struct hash_table *ht = (struct hash_table *)hash;
+    struct hash_slot  *hs;
+    clicon_hash_t      h;
 
-    h = hash_lookup (hash, key);
-    if (h == NULL)
+    hs = hash_slot(ht, key, hash_string(key, strlen(key)));
+    if ((h = hs->hs_ent) == NULL || h == HASH_DELETED)
 	return -1;
-    
-    DELQ(h, hash[hash_bucket(key)], clicon_hash_t);
+    hs->hs_ent = HASH_DELETED;
+    ht->ht_count--;
   
-    free (h->h_key);
     free (h->h_val);
     free (h);
 
     return 0;
 }
 
+/*
+ * Return vector of all keys, nkeys is set to its length. The vector is 
+ * malloced (NULL if there are no keys) and freed by the caller, the keys 
+ * are not copied. See hash_next() for iterating without allocation.
+ */
 char **
 hash_keys(clicon_hash_t *hash, size_t *nkeys)
 {
-    int bkt;
-    clicon_hash_t h;
-    char **tmp;
-    char **keys = NULL;
+    struct hash_table *ht = (struct hash_table *)hash;
+    clicon_hash_t      h;
+    size_t             iter = 0;
+    char             **keys;
 
     *nkeys = 0;
-    for (bkt = 0; bkt < HASH_SIZE; bkt++) {
-	h = hash[bkt];
-	do {
-	    if (h == NULL)
-		break;
-	    tmp = realloc(keys, ((*nkeys)+1) * sizeof(char *));
-	    if (tmp == NULL){
-		clicon_err(OE_UNIX, errno, "realloc: %s", strerror(errno));
-		goto catch;
-	    }
-	    keys = tmp;
-	    keys[*nkeys] = h->h_key;
-	    (*nkeys)++;
-	    h = NEXTQ(clicon_hash_t, h);
-	} while (h != hash[bkt]);
+    if (ht->ht_count == 0)
+	return NULL;
+    if ((keys = malloc(ht->ht_count * sizeof(char *))) == NULL){
+	clicon_err(OE_UNIX, errno, "malloc: %s", strerror(errno));
+	return NULL;
     }
-
+    while ((h = hash_next(hash, &iter)) != NULL)
+	keys[(*nkeys)++] = h->h_key;
     return keys;
+}
 
-catch:
-    if (keys)
-	free(keys);
+/*
+ * Iterate over all entries. iter is set to 0 before the first call. 
+ * Entries may be deleted while iterating, but not added.
+ * Returns next entry, or NULL when all entries are returned.
+ * Example:
+ *   size_t        iter = 0;
+ *   clicon_hash_t h;
+ *   while ((h = hash_next(hash, &iter)) != NULL)
+ *      printf("%s\n", h->h_key);
+ */
+clicon_hash_t
+hash_next(clicon_hash_t *hash, size_t *iter)
+{
+    struct hash_table *ht = (struct hash_table *)hash;
+    clicon_hash_t      h;
+
+    while (*iter < ht->ht_size){
+	h = ht->ht_slots[(*iter)++].hs_ent;
+	if (h && h != HASH_DELETED)
+	    return h;
+    }
     return NULL;
 }
 
@@ -323,21 +436,11 @@ catch:
 void
 hash_dump(clicon_hash_t *hash, FILE *f)
 {
-    int i;
-    char **keys;
-    void *val;
-    size_t klen;
-    size_t vlen;
+    clicon_hash_t h;
+    size_t        iter = 0;
     
     if (hash == NULL)
 	return;
-    keys = hash_keys(hash, &klen);
-    if (keys == NULL)
-	return;
-	
-    for(i = 0; i < klen; i++) {
-	val = hash_value(hash, keys[i], &vlen);
-	printf("%s =\t 0x%p , length %zu\n", keys[i], val, vlen);
-    }
-    free(keys);
+    while ((h = hash_next(hash, &iter)) != NULL)
+	fprintf(f, "%s =\t 0x%p , length %zu\n", h->h_key, h->h_val, h->h_vlen);
 }
@@ -91,51 +91,66 @@ clicon_log_register_callback(clicon_log_notify_t *cb, void *arg)
 }
 
 /*
- * Mimic syslog and print a time on file f
+ * Mimic syslog and return a time string, eg "Apr 14 11:30:52: ".
+ * The string is static and only recomputed when the second changes.
  */
-static int
-flogtime(FILE *f)
+static char *
+logtime(void)
 {
-    struct timeval tv;
-    struct tm *tm;
-
-    gettimeofday(&tv, NULL);
-    tm = localtime((time_t*)&tv.tv_sec);
-    fprintf(f, "%s %2d %02d:%02d:%02d: ", 
-	    mon2name(tm->tm_mon), tm->tm_mday,
-	    tm->tm_hour, tm->tm_min, tm->tm_sec);
-    return 0;
+    static char   str[32];
+    static time_t sec = -1;
+    struct tm    *tm;
+    time_t        now;
+
+    now = time(NULL);
+    if (now != sec){
+	tm = localtime(&now);
+	snprintf(str, sizeof(str), "%s %2d %02d:%02d:%02d: ", 
+		 mon2name(tm->tm_mon), tm->tm_mday,
+		 tm->tm_hour, tm->tm_min, tm->tm_sec);
+	sec = now;
+    }
+    return str;
 }
 
 /*
- * Mimic syslog and print a time on string s
- * String returned needs to be freed.
+ * Format a log message into buf if it fits, otherwise into a malloced 
+ * string. Returns buf, the malloced string (which needs to be freed) or 
+ * NULL on error.
  */
 static char *
-slogtime(void)
+logfmt(char *buf, size_t buflen, char *format, va_list args)
 {
-    struct timeval tv;
-    struct tm     *tm;
-    char           *str;
+    va_list ap;
+    int     len;
+    char   *msg;
 
-    /* Example: "Apr 14 11:30:52: " len=17+1 */
-    if ((str = malloc(18)) == NULL){
-	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+    va_copy(ap, args);
+    len = vsnprintf(buf, buflen, format, ap);
+    va_end(ap);
+    if (len < 0){
+	fprintf(stderr, "vsnprintf: %s\n", strerror(errno)); /* dont use clicon_err here due to recursion */
 	return NULL;
     }
-    gettimeofday(&tv, NULL);
-    tm = localtime((time_t*)&tv.tv_sec);
-    snprintf(str, 18, "%s %2d %02d:%02d:%02d: ", 
-	     mon2name(tm->tm_mon), tm->tm_mday,
-	     tm->tm_hour, tm->tm_min, tm->tm_sec);
-    return str;
+    if (len < buflen)
+	return buf;
+    /* Message does not fit: allocate a string exactly fitting it */
+    if ((msg = malloc(len+1)) == NULL){
+	fprintf(stderr, "malloc: %s\n", strerror(errno)); /* dont use clicon_err here due to recursion */
+	return NULL;
+    }
+    va_copy(ap, args);
+    vsnprintf(msg, len+1, format, ap);
+    va_end(ap);
+    return msg;
 }
 
-
 /*! Make a logging call to syslog.
  *
  * This is the _only_ place the actual syslog (or stderr) logging is made in clicon,..
  * See also clicon_log()
+ * Each line is written with one call, and the notify callback gets the 
+ * message with time prepended in a stack buffer unless it is very long.
  *
  * @param[in]   level    log level, eg LOG_DEBUG,LOG_INFO,...,LOG_EMERG. Thisis OR:d with facility == LOG_USER
  * @param[in]   format   Message to print as argv.
@@ -145,35 +160,34 @@ clicon_log_str(int level, char *msg)
 {
     if (_logflags & CLICON_LOG_SYSLOG)
 	syslog(LOG_MAKEPRI(LOG_USER, level), "%s", msg);
-    if (_logflags & CLICON_LOG_STDERR){
-	flogtime(stderr);
-	fprintf(stderr, "%s\n", msg);
-    }
-    if (_logflags & CLICON_LOG_STDOUT){
-	flogtime(stdout);
-	fprintf(stdout, "%s\n", msg);
-    }
+    if (_logflags & CLICON_LOG_STDERR)
+	fprintf(stderr, "%s%s\n", logtime(), msg);
+    if (_logflags & CLICON_LOG_STDOUT)
+	fprintf(stdout, "%s%s\n", logtime(), msg);
     if (_log_notify_cb){
 	static int  cb = 0;
+	char        buf[CLICON_LOG_BUFLEN];
 	char       *d, *msg2;
-	int         len;
+	size_t      len;
 
 	if (cb++ == 0){
 	    /* Here there is danger of recursion: if callback in turn logs, therefore
 	       make static check (should be stack-based - now global) 
 	    */
-	    if ((d = slogtime()) == NULL)
-		return -1;
+	    d = logtime();
 	    len = strlen(d) + strlen(msg) + 1;
-	    if ((msg2 = malloc(len)) == NULL){
+	    if (len <= sizeof(buf))
+		msg2 = buf;
+	    else if ((msg2 = malloc(len)) == NULL){
 		fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+		cb--;
 		return -1;
 	    }
 	    snprintf(msg2, len, "%s%s", d, msg);
 	    assert(_log_notify_arg);
 	    _log_notify_cb(level, msg2, _log_notify_arg);
-	    free(d);
-	    free(msg2);
+	    if (msg2 != buf)
+		free(msg2);
 	}
 	cb--;
     }
@@ -194,37 +208,19 @@ int
 clicon_log(int level, char *format, ...)
 {
     va_list args;
-    int     len;
-    char   *msg    = NULL;
-    int     retval = -1;
+    char    buf[CLICON_LOG_BUFLEN];
+    char   *msg;
 
-    /* first round: compute length of debug message */
     va_start(args, format);
-    len = vsnprintf(NULL, 0, format, args);
-    va_end(args);
-
-    /* allocate a message string exactly fitting the message length */
-    if ((msg = malloc(len+1)) == NULL){
-	fprintf(stderr, "malloc: %s\n", strerror(errno)); /* dont use clicon_err here due to recursion */
-	goto done;
-    }
-
-    /* second round: compute write message from format and args */
-    va_start(args, format);
-    if (vsnprintf(msg, len+1, format, args) < 0){
-	va_end(args);
-	fprintf(stderr, "vsnprintf: %s\n", strerror(errno)); /* dont use clicon_err here due to recursion */
-	goto done;
-    }
+    msg = logfmt(buf, sizeof(buf), format, args);
     va_end(args);
+    if (msg == NULL)
+	return -1;
     /* Actually log it */
     clicon_log_str(level, msg);
-
-    retval = 0;
-  done:
-    if (msg)
+    if (msg != buf)
 	free(msg);
-    return retval;
+    return 0;
 }
 
 
@@ -248,6 +244,7 @@ int
 clicon_debug_init(int dbglevel, FILE *f)
 {
     debug = dbglevel; /* Global variable */
+    _debugfile = f;
     return 0;
 }
 
@@ -268,42 +265,23 @@ int
 clicon_debug(int dbglevel, char *format, ...)
 {
     va_list args;
-    int     len;
-    char   *msg    = NULL;
-    int     retval = -1;
+    char    buf[CLICON_LOG_BUFLEN];
+    char   *msg;
 
     if (dbglevel > debug) /* debug mask */
 	return 0;
-    /* first round: compute length of debug message */
     va_start(args, format);
-    len = vsnprintf(NULL, 0, format, args);
+    msg = logfmt(buf, sizeof(buf), format, args);
     va_end(args);
-
-    /* allocate a message string exactly fitting the messgae length */
-    if ((msg = malloc(len+1)) == NULL){
-	clicon_err(OE_UNIX, errno, "malloc");
-	goto done;
-    }
-    /* second round: compute write message from format and args */
-    va_start(args, format);
-    if (vsnprintf(msg, len+1, format, args) < 0){
-	va_end(args);
-	clicon_err(OE_UNIX, errno, "vsnprintf");
-	goto done;
-    }
-    va_end(args);
-    if (_debugfile != NULL){ /* Bypass syslog altogether */
-	/* XXX: Here use date sub-routine as found in err_print1 */
-	flogtime(_debugfile);
-	fprintf(_debugfile, "%s\n", msg);
-    }
+    if (msg == NULL)
+	return -1;
+    if (_debugfile != NULL) /* Bypass syslog altogether */
+	fprintf(_debugfile, "%s%s\n", logtime(), msg);
     else
 	clicon_log_str(LOG_DEBUG, msg);
-    retval = 0;
-  done:
-    if (msg)
+    if (msg != buf)
 	free(msg);
-    return retval;
+    return 0;
 }
 
 /*! Translate month number (0..11) to a three letter month name
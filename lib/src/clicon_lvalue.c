@@ -463,10 +463,11 @@ lv_matchvar (cvec *vec1, cvec *vec2, int cmpall)
 #endif
 
 /*
- * Get next _SEQ value for a vector.
+ * Scan all entries of a vector for the max value of a sequence variable.
+ * Only used to initialize the sequence counter of a vector, see lv_next_seq().
  */
-int
-lv_next_seq(char *dbname, char *basekey, char *varname, int increment)
+static int
+lv_seq_scan(char *dbname, char *basekey, char *varname)
 {
   int i;
   int seq = 0;
@@ -493,7 +494,7 @@ lv_next_seq(char *dbname, char *basekey, char *varname, int increment)
     if ((vr = lvec2cvec (pairs[i].dp_val, pairs[i].dp_vlen)) == NULL)
       goto catch;
       
-    if ((cv = cvec_find (vr, varname[0]=='!'?varname+1:varname)) && cv_type_get(cv) == CGV_INT32) {
+    if ((cv = cvec_find (vr, varname)) && cv_type_get(cv) == CGV_INT32) {
       val = cv_int_get(cv);
       if (val > seq)
 	seq = val;
@@ -502,7 +503,7 @@ lv_next_seq(char *dbname, char *basekey, char *varname, int increment)
     vr = NULL;
   }
 
-  retval = seq - (seq % increment) + increment;
+  retval = seq;
 
   /* Fall through */
  catch:
@@ -512,6 +513,48 @@ lv_next_seq(char *dbname, char *basekey, char *varname, int increment)
   return retval;
 }
 
+/*
+ * Get next _SEQ value for a vector.
+ * The max sequence value of each vector variable is kept in a meta key 
+ * 'basekey.n.#seq.varname' (filtered as a keycontent key, see key_iskeycontent)
+ * which is allocated from in one database operation. Entries written with 
+ * explicit values raise the counter, see db_set(). The counter is a high
+ * water mark: it is not decreased when entries are deleted, but it is removed
+ * together with the vector when the vector is deleted with a regexp key.
+ * If the counter does not exist, eg in an old database, it is initialized by
+ * scanning the vector once.
+ */
+int
+lv_next_seq(char *dbname, char *basekey, char *varname, int increment)
+{
+  int   retval = -1;
+  int   seq = 0;
+  int   len;
+  char *seqkey;
+  char *var;
+
+  var = varname[0]=='!'?varname+1:varname;
+  len = strlen(basekey);
+  if (key_isvector(basekey))
+      len -= 2;
+  if ((seqkey = chunk_sprintf(__FUNCTION__, "%.*s.n.#seq.%s", 
+			      len, basekey, var)) == NULL){
+      clicon_err(OE_UNIX, errno, "chunk");
+      goto catch;
+  }
+  switch (db_exists(dbname, seqkey)){
+  case -1:
+      goto catch;
+  case 0: /* No counter yet: initialize from existing entries */
+      if ((seq = lv_seq_scan(dbname, basekey, var)) < 0)
+	  goto catch;
+      break;
+  }
+  retval = db_seq_next(dbname, seqkey, seq, increment);
+ catch:
+  unchunk_group (__FUNCTION__);
+  return retval;
+}
 
 
 #ifdef DB_KEYCONTENT
@@ -140,47 +140,76 @@ lvmap_get_dbsingle(char *dbname,
 }
 
 
+/*
+ * lvmap_key_cmp
+ * Compare two keys in "natural" order without allocating memory.
+ * Normal string compare will not sort "numbered keys" properly. For example
+ * "my.key.10" will come before "my.key.2". This function compares the keys 
+ * section by section, delimited by '.'. If a section does not match, 
+ * it will compare the section without any trailing digits and if it 
+ * matches, then compare trailing digits as numbers.
+ * If all common sections are equal, the key with fewest sections is first.
+ */
+int
+lvmap_key_cmp(const char *k1, const char *k2)
+{
+  const char *e1, *e2;	/* End of section */
+  const char *d1, *d2;	/* Start of trailing digits of section */
+  size_t len1, len2;
+  int retval;
+
+  for (;;) {
+    e1 = k1 + strcspn (k1, ".");
+    e2 = k2 + strcspn (k2, ".");
+    len1 = e1 - k1;
+    len2 = e2 - k2;
+    if (len1 != len2 || strncmp (k1, k2, len1) != 0)
+      break;
+    /* Sections equal */
+    if (*e1 == '\0' || *e2 == '\0')
+      return (*e1 != '\0') - (*e2 != '\0');
+    k1 = e1 + 1;
+    k2 = e2 + 1;
+  }
+  /* First non-equal section */
+  for (d1 = e1; d1 > k1 && isdigit((int)d1[-1]); d1--)
+    ;
+  for (d2 = e2; d2 > k2 && isdigit((int)d2[-1]); d2--)
+    ;
+  if (d1 - k1 == d2 - k2 && strncmp (k1, k2, d1 - k1) == 0)
+    return atoi (d1) - atoi (d2);
+  /* Plain compare of the sections */
+  if ((retval = strncmp (k1, k2, len1 < len2 ? len1 : len2)) != 0)
+    return retval;
+  return (len1 < len2) ? -(int)(unsigned char)k2[len1] : (int)(unsigned char)k1[len2];
+}
+
+/* 
+ * Sort entry for lvmap_get_dbvector. Sort key is computed once per db entry.
+ */
+struct lvmap_vecent {
+  int             ve_hasseq;	/* _SEQ variable exists */
+  int             ve_seq;	/* Value of _SEQ */
+  struct db_pair *ve_pair;
+};
+
 /* 
  * lvmap_get_dbvector_sort
  * qsort function for lvmap_get_dbvector.
- * Sorts vector values based on the "_SEQ" variable if it exist. 
+ * Sorts vector values based on the "_SEQ" variable if it exist. Entries 
+ * without _SEQ are placed last, and equal entries are sorted in key order.
  */
 static int
 lvmap_get_dbvector_sort(const void *p1, const void *p2)
 {
-  int retval = 0;
-  int seq1;
-  int seq2;
-  cg_var *v1;
-  cg_var *v2;
-  cvec *vh1 = NULL;
-  cvec *vh2 = NULL;
-  struct db_pair *dp1 = (struct db_pair *)p1;
-  struct db_pair *dp2 = (struct db_pair *)p2;
-
-  if ((vh1 = lvec2cvec (dp1->dp_val, dp1->dp_vlen)) == NULL)
-    goto catch;
-  if ((vh2 = lvec2cvec (dp2->dp_val, dp2->dp_vlen)) == NULL)
-    goto catch;
-
-  if ((v1 = cvec_find (vh1, "_SEQ")) == NULL)
-    goto catch;
-  if ((v2 = cvec_find (vh2, "_SEQ")) == NULL)
-    goto catch;
-
-  seq1 = cv_int_get(v1);
-  seq2 = cv_int_get(v2);
-  retval = seq1 - seq2;
-  
-  /* Fall through */
-    
- catch:
-  if (vh1)
-    cvec_free(vh1);
-  if (vh2)
-    cvec_free(vh2);
-
-  return retval;
+  struct lvmap_vecent *ve1 = (struct lvmap_vecent *)p1;
+  struct lvmap_vecent *ve2 = (struct lvmap_vecent *)p2;
+
+  if (ve1->ve_hasseq != ve2->ve_hasseq)
+    return ve2->ve_hasseq - ve1->ve_hasseq;
+  if (ve1->ve_hasseq && ve1->ve_seq != ve2->ve_seq)
+    return (ve1->ve_seq < ve2->ve_seq) ? -1 : 1;
+  return lvmap_key_cmp (ve1->ve_pair->dp_key, ve2->ve_pair->dp_key);
 }
 
 int
@@ -198,7 +227,9 @@ lvmap_get_dbvector(char *dbname,
   char *vkey;
   int npairs;
   struct db_pair *pairs;
-
+  struct lvmap_vecent *vents = NULL;
+  cvec *vh;
+  cg_var *v;
 
   assert (key_isanyvector(basekey));
   
@@ -220,12 +251,32 @@ lvmap_get_dbvector(char *dbname,
     goto done;
   }
   
+  /* Compute sort keys, decoding each value once */
+  if ((vents = chunk (npairs * sizeof (struct lvmap_vecent), __FUNCTION__)) == NULL){
+    clicon_err(OE_UNIX, errno, "%s: chunk", __FUNCTION__);
+    goto quit;
+  }
+  for (i = 0; i < npairs; i++) {
+    vents[i].ve_pair = &pairs[i];
+    vents[i].ve_hasseq = 0;
+    if ((vh = lvec2cvec (pairs[i].dp_val, pairs[i].dp_vlen)) == NULL){
+      clicon_err(OE_DB, 0, "%s: %s: bad value", __FUNCTION__, pairs[i].dp_key);
+      goto quit;
+    }
+    if ((v = cvec_find (vh, "_SEQ")) != NULL) {
+      vents[i].ve_hasseq = 1;
+      vents[i].ve_seq = cv_int_get(v);
+    }
+    cvec_free (vh);
+  }
+
   /* Sort vector */
-  qsort (pairs, npairs, sizeof (struct db_pair), lvmap_get_dbvector_sort);
+  qsort (vents, npairs, sizeof (struct lvmap_vecent), lvmap_get_dbvector_sort);
   
   /* Loop through list and pass on to lvmap_get_dbsingle() */
   for (i = 0; i < npairs; i++) {
-      if (lvmap_get_dbsingle(dbname, lm, pairs[i].dp_key, pairs[i].dp_matched, label, keys, nkeys, addempty) < 0)
+      if (lvmap_get_dbsingle(dbname, lm, vents[i].ve_pair->dp_key, 
+			     vents[i].ve_pair->dp_matched, label, keys, nkeys, addempty) < 0)
       goto quit;
   }
   
@@ -242,63 +293,14 @@ lvmap_get_dbvector(char *dbname,
 
 /*
  * lvmap_get_dbregex_sort
- * qsort function for lvmap_get_dbregex. 
- * Normal string compare will not sort "numbered keys" properly. For example
- * "my.key.10" will come before "my.key.2". This sort function uses the
- * following logic to solve that. It splits the keys delimited by '.'
- * and compares each section individually. If a section does not match, 
- * it will compare the section without any trailing digits and if it 
- * matches, then compare trailing digits as numbers.
+ * qsort function for lvmap_get_dbregex, sorting db_pair entries on key 
+ * in natural order. See lvmap_key_cmp().
  */
 int
 lvmap_get_dbregex_sort (const void *p1, const void *p2)
 {
-  int i;
-  int retval = 0;
-  int nv1, nv2;
-  char *ptr1, *ptr2;
-  char **v1 = NULL;
-  char **v2 = NULL;
-  char *s1 = ((struct db_pair *)p1)->dp_key;
-  char *s2 = ((struct db_pair *)p2)->dp_key;
-  
-  if ((v1 = clicon_sepsplit (s1, ".", &nv1, __FUNCTION__)) == NULL)
-    goto catch;
-  if ((v2 = clicon_sepsplit (s2, ".", &nv2, __FUNCTION__)) == NULL)
-    goto catch;
-
-  for (i = 0; i < ((nv1 < nv2) ? nv2 : nv1); i++) {
-
-    if (i >= nv1 || i >= nv2) {
-      retval = nv1 - nv2;
-      break;
-    }
-    
-    if (strcmp (v1[i], v2[i]) == 0)
-      continue;
-
-    ptr1 = v1[i] + strlen(v1[i])-1;
-    while (ptr1 >= v1[i] && isdigit(*ptr1))
-      ptr1--;
-    ptr1++;
-
-    ptr2 = v2[i] + strlen(v2[i])-1;
-    while (ptr2 >= v2[i] && isdigit(*ptr2))
-      ptr2--;
-    ptr2++;
-
-    if ((ptr1-v1[i]) == (ptr2-v2[i]) && !strncmp(v1[i], v2[i], (ptr1-v1[i])))
-      retval = atoi(ptr1) - atoi(ptr2);
-    else
-      retval = strcmp (v1[i], v2[i]);
-    break;
-  }
-
-  /* Fall through */
- catch:
-  unchunk_group (__FUNCTION__);
-
-  return retval;
+  return lvmap_key_cmp (((struct db_pair *)p1)->dp_key,
+			((struct db_pair *)p2)->dp_key);
 }
 
 /*
@@ -31,6 +31,7 @@
  * CLICON_CANDIDATE_DB     $APPDIR/db/candidate_db
  * CLICON_RUNNING_DB       $APPDIR/db/running_db
  * CLICON_ARCHIVE_DIR      $APPDIR/archive    # Archive dir (rollback)
+ * CLICON_DB_ENGINE        depot # Storage engine of databases: depot|memory
  * CLICON_STARTUP_CONFIG   $APPDIR/startup-config # Startup config-file
  * CLICON_SOCK             $APPDIR/clicon.sock # Unix domain socket
  * CLICON_SOCK_GROUP       clicon # Unix group for clicon socket group access
@@ -40,6 +41,8 @@
  * CLICON_MASTER_PLUGIN    master.so # Master plugin name. backend and CLI
  * CLICON_BACKEND_DIR      $APPDIR/backend/<group> # Dirs of all backend plugins
  * CLICON_BACKEND_PIDFILE  $APPDIR/clicon.pidfile
+ * CLICON_BACKEND_DB_IMAGE 1 # Backend keeps running and candidate in memory
+ * CLICON_BACKEND_DB_SNAPSHOT 1 # Backend writes running as snapshots
  * CLICON_CLI_DIR          $APPDIR/frontend   # Dir of all CLI plugins/ syntax group dirs
  * CLICON_CLI_MODE         base # Initial cli syntax mode to start in clicon_cli.
  * CLICON_CLI_GENMODEL     1 # Generate CLIgen syntax from model
@@ -80,6 +83,7 @@
 #include "clicon_dbspec_key.h"
 #include "clicon_yang.h"
 #include "clicon_options.h"
+#include "clicon_dbengine.h"
 
 /*
  * clicon_option_dump
@@ -89,30 +93,22 @@ void
 clicon_option_dump(clicon_handle h, int dbglevel)
 {
     clicon_hash_t *hash = clicon_options(h);
-    int            i;
-    char         **keys;
-    void          *val;
-    size_t         klen;
-    size_t         vlen;
+    clicon_hash_t  e;
+    size_t         iter = 0;
     
     if (hash == NULL)
 	return;
-    keys = hash_keys(hash, &klen);
-    if (keys == NULL)
-	return;
-	
-    for(i = 0; i < klen; i++) {
-	val = hash_value(hash, keys[i], &vlen);
-	if (vlen){
-	    if (((char*)val)[vlen-1]=='\0') /* assume string */
-		clicon_debug(dbglevel, "%s =\t \"%s\"", keys[i], (char*)val);
+    while ((e = hash_next(hash, &iter)) != NULL) {
+	if (e->h_vlen){
+	    if (((char*)e->h_val)[e->h_vlen-1]=='\0') /* assume string */
+		clicon_debug(dbglevel, "%s =\t \"%s\"", e->h_key, (char*)e->h_val);
 	    else
-		clicon_debug(dbglevel, "%s =\t 0x%p , length %zu", keys[i], val, vlen);
+		clicon_debug(dbglevel, "%s =\t 0x%p , length %zu", 
+			     e->h_key, e->h_val, e->h_vlen);
 	}
 	else
-	    clicon_debug(dbglevel, "%s = NULL", keys[i]);
+	    clicon_debug(dbglevel, "%s = NULL", e->h_key);
     }
-    free(keys);
 
 }
 
@@ -388,6 +384,9 @@ clicon_options_main(clicon_handle h, int argc, char **argv)
     /* Read configfile */
     if (clicon_option_readfile(copt, configfile) < 0)
 	return -1;
+    /* Storage engine of all databases */
+    if (clicon_db_engine(h) && db_engine_set(clicon_db_engine(h)) < 0)
+	return -1;
     return 0;
 }
 
@@ -575,6 +574,14 @@ clicon_archive_dir(clicon_handle h)
     return clicon_option_str(h, "CLICON_ARCHIVE_DIR");
 }
 
+/*! Name of database storage engine, or NULL for default, see db_engine_set()
+ */
+char *
+clicon_db_engine(clicon_handle h)
+{
+    return clicon_option_str(h, "CLICON_DB_ENGINE");
+}
+
 char *
 clicon_startup_config(clicon_handle h)
 {
@@ -687,6 +694,35 @@ clicon_commit_order(clicon_handle h)
 	return 0;
 }
 
+/*! Backend keeps images of running and candidate in memory, see db_image_open()
+ */
+int
+clicon_backend_db_image(clicon_handle h)
+{
+    char const *opt = "CLICON_BACKEND_DB_IMAGE";
+
+    if (clicon_option_exists(h, opt))
+	return clicon_option_int(h, opt);
+    else
+	return 1;
+}
+
+/*! Backend writes running as snapshots, see db_snapshot_open()
+ * Every open of running for writing then copies all of it, so plugins that 
+ * write running, eg in their commit end callbacks, should batch the writes 
+ * with db_batch() instead of one db_set() per key.
+ */
+int
+clicon_backend_db_snapshot(clicon_handle h)
+{
+    char const *opt = "CLICON_BACKEND_DB_SNAPSHOT";
+
+    if (clicon_option_exists(h, opt))
+	return clicon_option_int(h, opt);
+    else
+	return 1;
+}
+
 
 /*! Dont include keys in cvec in cli vars callbacks
  */
@@ -84,6 +84,7 @@ static const struct map_type2str msgmap[] = {
     {CLICON_MSG_OK,           "ok"},
     {CLICON_MSG_NOTIFY,       "notify"},
     {CLICON_MSG_ERR,          "err"},
+    {CLICON_MSG_ROLLBACK,     "rollback"},
     {-1,                      NULL}, 
 };
 
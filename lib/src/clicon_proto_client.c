@@ -228,6 +228,27 @@ clicon_proto_load(char *spath, int replace, char *db, char *filename)
     return retval;
 }
 
+/*
+ * clicon_proto_rollback
+ * Send a request to the config_daemon to restore snapshot into db
+ */
+int
+clicon_proto_rollback(char *spath, int snapshot, char *db)
+{
+    struct clicon_msg *msg;
+    int                retval = -1;
+
+    if ((msg=clicon_msg_rollback_encode(db, snapshot,
+				       __FUNCTION__)) == NULL)
+	return -1;
+    if (clicon_rpc_connect(msg, spath, NULL, 0, __FUNCTION__) < 0)
+	goto done;
+    retval = 0;
+  done:
+    unchunk_group(__FUNCTION__);
+    return retval;
+}
+
 /*
  * clicon_proto_initdb
  * Let configure daemon initialize database
@@ -289,48 +310,56 @@ clicon_proto_rm(char *spath, char *filename)
  */
 int
 clicon_proto_lock(char *spath, char *db)
+{
+    return clicon_proto_partial_lock(spath, db, NULL);
+}
+
+/*
+ * clicon_proto_unlock
+ * Unlock a database
+ */
+int
+clicon_proto_unlock(char *spath, char *db)
+{
+    return clicon_proto_partial_unlock(spath, db, NULL);
+}
+
+/*! Lock a subtree of a database, cf NETCONF partial-lock
+ * Other sessions can not change keys in the subtree, but may lock and change
+ * disjoint subtrees. 
+ * @param[in]  spath  Socket path of backend
+ * @param[in]  db     Database
+ * @param[in]  key    Database key of subtree, eg "interface.0", or NULL for
+ *                    whole database
+ */
+int
+clicon_proto_partial_lock(char *spath, char *db, char *key)
 {
     struct clicon_msg *msg;
     int                retval = -1;
 
-    if ((msg=clicon_msg_lock_encode(db, __FUNCTION__)) == NULL)
+    if ((msg=clicon_msg_lock_encode(db, key, __FUNCTION__)) == NULL)
 	return -1;
-    if (clicon_rpc_connect(msg, spath, NULL, 0, __FUNCTION__) < 0){
-#if 0
-	if (errno == ESHUTDOWN)
-	    /* Maybe could reconnect on a higher layer, but lets fail
-	       loud and proud */
-	    cli_set_exiting(1);
-#endif
+    if (clicon_rpc_connect(msg, spath, NULL, 0, __FUNCTION__) < 0)
 	goto done;
-    }
     retval = 0;
   done:
     unchunk_group(__FUNCTION__);
     return retval;
 }
 
-/*
- * clicon_proto_unlock
- * Unlock a database
+/*! Unlock a subtree of a database locked with clicon_proto_partial_lock()
  */
 int
-clicon_proto_unlock(char *spath, char *db)
+clicon_proto_partial_unlock(char *spath, char *db, char *key)
 {
     struct clicon_msg *msg;
     int                retval = -1;
 
-    if ((msg=clicon_msg_unlock_encode(db, __FUNCTION__)) == NULL)
+    if ((msg=clicon_msg_unlock_encode(db, key, __FUNCTION__)) == NULL)
 	return -1;
-    if (clicon_rpc_connect(msg, spath, NULL, 0, __FUNCTION__) < 0){
-#if 0
-	if (errno == ESHUTDOWN)
-	    /* Maybe could reconnect on a higher layer, but lets fail
-	       loud and proud */
-	    cli_set_exiting(1);
-#endif
+    if (clicon_rpc_connect(msg, spath, NULL, 0, __FUNCTION__) < 0)
 	goto done;
-    }
     retval = 0;
   done:
     unchunk_group(__FUNCTION__);
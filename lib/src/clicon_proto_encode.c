@@ -550,42 +550,105 @@ clicon_msg_copy_decode(struct clicon_msg *msg,
     return 0;
 }
 
+/*! Encode lock or unlock message: database and key of subtree
+ * The key is empty if the whole database is locked.
+ */
+static struct clicon_msg *
+clicon_msg_lock_encode0(char *db, char *key, enum clicon_msg_type op, 
+			const char *label)
+{
+    struct clicon_msg *msg;
+    int hdrlen = sizeof(*msg);
+    int len;
+    int p;
+
+    if (key == NULL)
+	key = "";
+    clicon_debug(2, "%s: db: %s key: %s", __FUNCTION__, db, key);
+    p = 0;
+    len = hdrlen + strlen(db) + 1 + strlen(key) + 1;
+    if ((msg = (struct clicon_msg *)chunk(len, label)) == NULL){
+	clicon_err(OE_PROTO, errno, "%s: chunk", __FUNCTION__);
+	return NULL;
+    }
+    memset(msg, 0, len);
+    /* hdr */
+    msg->op_type = op;
+    msg->op_len = len;
+    /* body */
+    strncpy(msg->op_body+p, db, len-p-hdrlen);
+    p += strlen(db)+1;
+    strncpy(msg->op_body+p, key, len-p-hdrlen);
+    p += strlen(key)+1;
+    return msg;
+}
+
+/*! Decode lock or unlock message
+ * Messages without key (older clients) lock the whole database.
+ */
+static int
+clicon_msg_lock_decode0(struct clicon_msg *msg, 
+			char **db, 
+			char **key,
+			const char *label)
+{
+    int p;
+
+    p = 0;
+    /* body */
+    if ((*db = chunk_sprintf(label, "%s", msg->op_body+p)) == NULL){
+	clicon_err(OE_PROTO, errno, "%s: chunk_sprintf", 
+		__FUNCTION__);
+	return -1;
+    }
+    p += strlen(*db)+1;
+    if (sizeof(*msg) + p < msg->op_len)
+	*key = chunk_sprintf(label, "%s", msg->op_body+p);
+    else
+	*key = chunk_sprintf(label, "%s", "");
+    if (*key == NULL){
+	clicon_err(OE_PROTO, errno, "%s: chunk_sprintf", 
+		__FUNCTION__);
+	return -1;
+    }
+    p += strlen(*key)+1;
+    clicon_debug(2, "%s: db: %s key: %s",  __FUNCTION__, *db, *key);
+    return 0;
+}
+
+/*! Encode lock message
+ * @param[in]  db    Database
+ * @param[in]  key   Database key of subtree to lock, or NULL for whole database
+ * @param[in]  label Chunk label
+ */
 struct clicon_msg *
-clicon_msg_lock_encode(char *db, const char *label)
+clicon_msg_lock_encode(char *db, char *key, const char *label)
 {
-    clicon_debug(2, "%s: db: %s", __FUNCTION__, db);
-    return clicon_msg_1str_encode(db, CLICON_MSG_LOCK, label);
+    return clicon_msg_lock_encode0(db, key, CLICON_MSG_LOCK, label);
 }
 
 int
 clicon_msg_lock_decode(struct clicon_msg *msg, 
-		      char **db, 
-		      const char *label)
+		       char **db, 
+		       char **key,
+		       const char *label)
 {
-    int retval;
-
-    retval = clicon_msg_1str_decode(msg, db, label);
-    clicon_debug(2, "%s: db: %s",  __FUNCTION__, *db);
-    return retval;
+    return clicon_msg_lock_decode0(msg, db, key, label);
 }
 
 struct clicon_msg *
-clicon_msg_unlock_encode(char *db, const char *label)
+clicon_msg_unlock_encode(char *db, char *key, const char *label)
 {
-    clicon_debug(2, "%s: db: %s", __FUNCTION__, db);
-    return clicon_msg_1str_encode(db, CLICON_MSG_UNLOCK, label);
+    return clicon_msg_lock_encode0(db, key, CLICON_MSG_UNLOCK, label);
 }
 
 int
 clicon_msg_unlock_decode(struct clicon_msg *msg, 
-		      char **db, 
-		      const char *label)
+			 char **db, 
+			 char **key,
+			 const char *label)
 {
-    int retval;
-
-    retval = clicon_msg_1str_decode(msg, db, label);
-    clicon_debug(2, "%s: db: %s",  __FUNCTION__, *db);
-    return retval;
+    return clicon_msg_lock_decode0(msg, db, key, label);
 }
 
 struct clicon_msg *
@@ -828,6 +891,59 @@ clicon_msg_subscription_decode(struct clicon_msg *msg,
     return 0;
 }
 
+struct clicon_msg *
+clicon_msg_rollback_encode(char *db, uint32_t snapshot, const char *label)
+{
+    struct clicon_msg *msg;
+    int len;
+    int hdrlen = sizeof(*msg);
+    int p;
+    uint32_t tmp;
+
+    clicon_debug(2, "%s: snapshot: %d db: %s", __FUNCTION__, snapshot, db);
+    p = 0;
+    len = hdrlen + sizeof(uint32_t) + strlen(db) + 1;
+    if ((msg = (struct clicon_msg *)chunk(len, label)) == NULL){
+	clicon_err(OE_PROTO, errno, "%s: chunk", __FUNCTION__);
+	return NULL;
+    }
+    memset(msg, 0, len);
+    /* hdr */
+    msg->op_type = CLICON_MSG_ROLLBACK;
+    msg->op_len = len;
+    /* body */
+    tmp = htonl(snapshot);
+    memcpy(msg->op_body+p, &tmp, sizeof(uint32_t));
+    p += sizeof(uint32_t);
+
+    strncpy(msg->op_body+p, db, len-p-hdrlen);
+    p += strlen(db)+1;
+    return msg;
+}
+
+int
+clicon_msg_rollback_decode(struct clicon_msg *msg, 
+			   char **db, uint32_t *snapshot, const char *label)
+{
+    int p;
+    uint32_t tmp;
+
+    p = 0;
+    /* body */
+    memcpy(&tmp, msg->op_body+p, sizeof(uint32_t));
+    *snapshot = ntohl(tmp);
+    p += sizeof(uint32_t);
+
+    if ((*db = chunk_sprintf(label, "%s", msg->op_body+p)) == NULL){
+	clicon_err(OE_PROTO, errno, "%s: chunk_sprintf", 
+		__FUNCTION__);
+	return -1;
+    }
+    p += strlen(*db)+1;
+    clicon_debug(2, "%s: snapshot: %d db: %s", __FUNCTION__, *snapshot, *db);
+    return 0;
+}
+
 struct clicon_msg *
 clicon_msg_notify_encode(int level, char *event, const char *label)
 {
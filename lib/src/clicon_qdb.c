@@ -32,19 +32,14 @@
 #include <string.h>
 #include <errno.h>
 #include <syslog.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <limits.h>
 #include <regex.h>
+#include <dirent.h>
 #include <sys/stat.h>
 #include <sys/param.h>
 
-#if defined(HAVE_DEPOT_H) || defined(HAVE_QDBM_DEPOT_H)
-#ifdef HAVE_DEPOT_H
-#include <depot.h> /* qdb api */
-#else /* HAVE_QDBM_DEPOT_H */
-#include <qdbm/depot.h> /* qdb api */
-#endif 
-
 #include <cligen/cligen.h>
 
 /* clicon */
@@ -52,28 +47,47 @@
 #include "clicon_err.h"
 #include "clicon_queue.h"
 #include "clicon_chunk.h"
+#include "clicon_file.h"
+#include "clicon_hash.h"
+#include "clicon_handle.h"
+#include "clicon_dbengine.h"
 #include "clicon_db.h" 
+#include "clicon_dbspec_key.h"
+#include "clicon_lvalue.h"
+
+/*
+ * Overlay databases.
+ * An overlay is a database holding only the differences to a base database,
+ * eg a candidate on top of running. Reads of keys not in the overlay fall 
+ * through to the base, and writes only go to the overlay. Deleted base keys 
+ * are marked with a tombstone key in the overlay. The base is not copied, so 
+ * changes to the base are seen through the overlay unless the overlay has 
+ * overwritten or deleted the key. The change stamp of the base is saved when
+ * the overlay is created, and the overlay is not applied to a base that has 
+ * changed since, see db_overlay_current().
+ * The reserved keys below start with control characters and are never 
+ * returned to callers.
+ */
+#define DB_OVERLAY_BASE "\001base" /* Key with name of base database file */
+#define DB_OVERLAY_STAMP "\001stamp" /* Key with change stamp of base */
+#define DB_OVERLAY_DEL  '\002'     /* Prefix of tombstone keys */
+
+#define db_reserved_key(k) ((k)[0] == '\001' || (k)[0] == DB_OVERLAY_DEL)
 
 /*
  * db_init_mode
  */
 static int 
-db_init_mode(char *file, int omode)
+db_init_mode(char *file, int omode, int nkeys)
 {
-    DEPOT *dp;
+    void *dh;
 
     /* Open database for writing */
-    if ((dp = dpopen(file, omode | DP_OLCKNB, 0)) == NULL){
-	clicon_err(OE_DB, 0, "db_init: dpopen(%s): %s", 
-		file,
-		dperrmsg(dpecode));
+    if ((dh = dbe_open(file, omode, nkeys)) == NULL)
 	return -1;
-    }
     clicon_debug(1, "db_init(%s)", file);
-    if (dpclose(dp) == 0){
-	clicon_err(OE_DB, 0, "db_set: dpclose: %s", dperrmsg(dpecode));
+    if (dbe_close(dh) < 0)
 	return -1;
-    }
     return 0;
 }
 
@@ -84,36 +98,306 @@ db_init_mode(char *file, int omode)
 int 
 db_init(char *file)
 {
-    return db_init_mode(file, DP_OWRITER | DP_OCREAT ); /* DP_OTRUNC? */
+    return db_init_mode(file, DB_OWRITER | DB_OCREAT, 0); /* DB_OTRUNC? */
 }
 
+/*
+ * db_init_size
+ * Create a new empty database (truncate if it exists) sized for nkeys 
+ * entries. The bucket array of a hash database (Depot) is fixed when it is
+ * created, so when loading many entries, eg restoring a dump, this avoids 
+ * long collision chains.
+ */
 int 
-db_set(char *file, char *key, void *data, size_t datalen)
+db_init_size(char *file, int nkeys)
 {
-    DEPOT *dp;
+    return db_init_mode(file, DB_OWRITER | DB_OCREAT | DB_OTRUNC, nkeys);
+}
 
-    /* Open database for writing */
-    if ((dp = dpopen(file, DP_OWRITER | DP_OLCKNB, 0)) == NULL){
-	clicon_err(OE_DB, 0, "db_set: dpopen(%s): %s", 
-		file,
-		dperrmsg(dpecode));
+/*
+ * db_overlay_base
+ * Get name of base database if dh is an overlay database.
+ * base is set to malloced name of base database, or NULL if dh is not an 
+ * overlay.
+ * returns:
+ *   0 if OK
+ *  -1 on error
+ */
+static int
+db_overlay_base(void *dh, char **base)
+{
+    int ret;
+
+    if ((ret = dbe_get(dh, DB_OVERLAY_BASE, base, NULL)) < 0)
+	return -1;
+    if (ret == 0)
+	*base = NULL;
+    return 0;
+}
+
+/*
+ * Overlay of an open database during one operation: the name of its base,
+ * and the base opened for reading at the first key not in the overlay and 
+ * kept open until the operation is done, see db_overlay_get().
+ */
+struct db_overlay {
+    char  *ov_base;  /* Name of base database, NULL if not an overlay */
+    void  *ov_bdh;   /* Open base database, or NULL */
+};
+
+/*
+ * Get overlay of open database dh, see db_overlay_base()
+ */
+static int
+db_overlay_open(void *dh, struct db_overlay *ov)
+{
+    memset(ov, 0, sizeof(*ov));
+    return db_overlay_base(dh, &ov->ov_base);
+}
+
+/*
+ * Close base database of overlay, if opened, and free overlay
+ */
+static void
+db_overlay_close(struct db_overlay *ov)
+{
+    if (ov->ov_bdh)
+	dbe_close(ov->ov_bdh);
+    if (ov->ov_base)
+	free(ov->ov_base);
+    memset(ov, 0, sizeof(*ov));
+}
+
+/*
+ * db_size
+ * Return number of entries stored in database file. If the database is an
+ * overlay, entries in its base database are also counted, so the number is
+ * an upper bound of the entries returned by a cursor.
+ * returns: number of entries, or -1 on error
+ */
+int
+db_size(char *file)
+{
+    void  *dh;
+    char  *base = NULL;
+    int    n;
+    int    nb = 0;
+    int    nv;
+
+    if ((dh = dbe_open(file, DB_OREADER, 0)) == NULL)
+	return -1;
+    if ((n = dbe_count(dh)) < 0 || 
+	(nv = dbe_get(dh, DB_VERSION_KEY, NULL, NULL)) < 0 ||
+	db_overlay_base(dh, &base) < 0){
+	dbe_close(dh);
 	return -1;
     }
+    dbe_close(dh);
+    n -= nv; /* Not an entry */
+    if (base){
+	nb = db_size(base);
+	free(base);
+	if (nb < 0)
+	    return -1;
+    }
+    return n + nb;
+}
+
+/*
+ * Return malloced tombstone key of key
+ */
+static char *
+db_overlay_delkey(char *key)
+{
+    char *dkey;
+    int   len = strlen(key);
+
+    if ((dkey = malloc(len+2)) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	return NULL;
+    }
+    dkey[0] = DB_OVERLAY_DEL;
+    memcpy(dkey+1, key, len+1);
+    return dkey;
+}
+
+/*
+ * db_overlay_get
+ * Look up key in overlay database dh and, if not found or deleted there, in 
+ * its base database, which is opened once per overlay ov. If val is NULL 
+ * only existence is checked, otherwise a malloced value is returned in val 
+ * and vlen.
+ * returns:
+ *   1 if found
+ *   0 if not found
+ *  -1 on error
+ */
+static int
+db_overlay_get(void *dh, struct db_overlay *ov, char *key, char **val, 
+	       int *vlen)
+{
+    char  *dkey;
+    int    ret;
+
+    if ((ret = dbe_get(dh, key, val, vlen)) != 0)
+	return ret;
+    /* Not in overlay, deleted in overlay? */
+    if ((dkey = db_overlay_delkey(key)) == NULL)
+	return -1;
+    ret = dbe_get(dh, dkey, NULL, NULL);
+    free(dkey);
+    if (ret != 0)
+	return ret < 0 ? -1 : 0;
+    /* Fall through to base */
+    if (ov->ov_bdh == NULL &&
+	(ov->ov_bdh = dbe_open(ov->ov_base, DB_OREADER, 0)) == NULL)
+	return -1;
+    return dbe_get(ov->ov_bdh, key, val, vlen);
+}
+
+/*! Put key in open database dh with overlay ov
+ */
+static int 
+db_put1(void *dh, struct db_overlay *ov, char *key, void *data, size_t datalen)
+{
+    char  *dkey;
+    int    ret;
+
+    if (dbe_put(dh, key, data, datalen) < 0)
+	return -1;
+    /* Key is no longer deleted in overlay */
+    if (ov->ov_base){
+	if ((dkey = db_overlay_delkey(key)) == NULL)
+	    return -1;
+	ret = dbe_del(dh, dkey);
+	free(dkey);
+	if (ret < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*
+ * Read integer counter at key of open database dh with overlay ov. 
+ * Returns 1 and counter in seq if found, 0 if not found, -1 on error.
+ */
+static int
+db_seq_get(void *dh, struct db_overlay *ov, char *key, int *seq)
+{
+    char  *val = NULL;
+    int    vlen;
+    int    ret;
+
+    if (ov->ov_base) /* overlay: read from overlay or base */
+	ret = db_overlay_get(dh, ov, key, &val, &vlen);
+    else
+	ret = dbe_get(dh, key, &val, &vlen);
+    if (ret == 1){
+	if (vlen != sizeof(*seq)){
+	    clicon_err(OE_DB, 0, "%s: %s: bad counter length %d",
+		       __FUNCTION__, key, vlen);
+	    ret = -1;
+	}
+	else
+	    memcpy(seq, val, sizeof(*seq));
+    }
+    if (val)
+	free(val);
+    return ret;
+}
+
+/*
+ * Raise the sequence counters of a vector entry written to an open database,
+ * see lv_next_seq(). If key is a vector entry 'base.<i>', the counter 
+ * 'base.n.#seq.<var>' of each 32-bit integer variable <var> in the lvec val
+ * is raised to the value of the variable. Missing counters are left alone,
+ * they are initialized from the entries when first used.
+ * Done by every write of db_set() and db_batch() under the same writer open,
+ * so that a sequence number in use is never allocated.
+ */
+static int
+db_seq_raise(void *dh, struct db_overlay *ov, char *key, char *val, 
+	     size_t vlen)
+{
+    struct lvalue *lv;
+    struct lvalue *lvv;
+    char          *end = val + vlen;
+    char          *p;
+    char          *name;
+    char          *seqkey;
+    int            hlen;
+    int32_t        n;
+    int            seq;
+    int            ret;
+
+    if (val == NULL || 
+	(p = strrchr(key, '.')) == NULL || p[1] == '\0' ||
+	strspn(p+1, "0123456789") != strlen(p+1) || key_iskeycontent(key))
+	return 0;
+    /* Name and value lvalue pairs, see cvec2lvec() */
+    lv = (struct lvalue *)val;
+    hlen = (void*)lv->lv_val - (void*)lv;
+    while ((char*)lv + hlen <= end){
+	lvv = (struct lvalue *)(lv->lv_val + lv->lv_len);
+	if (lv->lv_type != CGV_STRING || lv->lv_len == 0 ||
+	    (char*)lvv + hlen > end || lvv->lv_val + lvv->lv_len > end)
+	    break; /* Not a name/value lvec */
+	if (lvv->lv_type == CGV_INT32 && lvv->lv_len == sizeof(n)){
+	    name = lv->lv_val;
+	    if (name[0] == '!')
+		name++;
+	    if ((seqkey = malloc((p-key) + strlen(name) + 10)) == NULL){
+		clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+		return -1;
+	    }
+	    sprintf(seqkey, "%.*s.n.#seq.%s", (int)(p-key), key, name);
+	    memcpy(&n, lvv->lv_val, sizeof(n));
+	    if ((ret = db_seq_get(dh, ov, seqkey, &seq)) == 1 && seq < n)
+		ret = db_put1(dh, ov, seqkey, &n, sizeof(n));
+	    free(seqkey);
+	    if (ret < 0)
+		return -1;
+	}
+	lv = (struct lvalue *)(lvv->lv_val + lvv->lv_len);
+    }
+    return 0;
+}
+
+/*! Set key in open database dh with overlay ov
+ */
+static int 
+db_set1(char *file, void *dh, struct db_overlay *ov, char *key, void *data, 
+	size_t datalen)
+{
     clicon_debug(2, "%s: db_put(%s, len:%d)", 
-		file, key, (int)datalen);
-    if (dpput(dp, key, -1, data, datalen, DP_DOVER) == 0){
-	clicon_err(OE_DB, 0, "%s: db_set: dpput(%s, %d): %s", 
-		file,
-		key,
-		datalen,
-		dperrmsg(dpecode));
-	dpclose(dp);
+		 file, key, (int)datalen);
+    if (db_put1(dh, ov, key, data, datalen) < 0)
+	return -1;
+    /* Sequence counters of vector entry */
+    return db_seq_raise(dh, ov, key, data, datalen);
+}
+
+int 
+db_set(char *file, char *key, void *data, size_t datalen)
+{
+    void              *dh;
+    struct db_overlay  ov;
+
+    /* Open database for writing */
+    if ((dh = dbe_open(file, DB_OWRITER, 0)) == NULL)
+	return -1;
+    if (db_overlay_open(dh, &ov) < 0){
+	dbe_close(dh);
 	return -1;
     }
-    if (dpclose(dp) == 0){
-	clicon_err(OE_DB, 0, "db_set: dpclose: %s", dperrmsg(dpecode));
+    if (db_set1(file, dh, &ov, key, data, datalen) < 0){
+	db_overlay_close(&ov);
+	dbe_close(dh);
 	return -1;
     }
+    db_overlay_close(&ov);
+    if (dbe_close(dh) < 0)
+	return -1;
     return 0;
 }
 
@@ -126,38 +410,40 @@ db_set(char *file, char *key, void *data, size_t datalen)
 int 
 db_get(char *file, char *key, void *data, size_t *datalen)
 {
-    DEPOT *dp;
-    int len;
+    void              *dh;
+    int                len;
+    struct db_overlay  ov;
+    char              *val = NULL;
+    int                ret;
 
-    /* Open database for readinf */
-    if ((dp = dpopen(file, DP_OREADER | DP_OLCKNB, 0)) == NULL){
-	clicon_err(OE_DB, dpecode, "%s: db_get(%s, %d): dpopen: %s", 
-		file,
-		key,
-		datalen,
-		dperrmsg(dpecode));
+    /* Open database for reading */
+    if ((dh = dbe_open(file, DB_OREADER, 0)) == NULL)
+	return -1;
+    if (db_overlay_open(dh, &ov) < 0){
+	dbe_close(dh);
 	return -1;
     }
-    len = dpgetwb(dp, key, -1, 0, *datalen, data);
-    if (len < 0){
-	if (dpecode == DP_ENOITEM){
-	    data = NULL;
-	    *datalen = 0;
-	}
-	else{
-	    clicon_err(OE_DB, 0, "db_get: dpgetwb: %s (%d)", 
-		    dperrmsg(dpecode), dpecode);
-	    dpclose(dp);
-	    return -1;
-	}
-    }
+    if (ov.ov_base) /* overlay: lookup in overlay and base */
+	ret = db_overlay_get(dh, &ov, key, &val, &len);
     else
-	*datalen = len;	
-    clicon_debug(2, "db_get(%s, %s)=%s", file, key, (char*)data);
-    if (dpclose(dp) == 0){
-	clicon_err(OE_DB, 0, "db_get: dpclose: %s", dperrmsg(dpecode));
+	ret = dbe_get(dh, key, &val, &len);
+    db_overlay_close(&ov);
+    if (ret < 0){
+	dbe_close(dh);
 	return -1;
     }
+    if (ret == 0)
+	*datalen = 0;
+    else{
+	if (len > *datalen)
+	    len = *datalen;
+	memcpy(data, val, len);
+	free(val);
+	*datalen = len;	
+    }
+    clicon_debug(2, "db_get(%s, %s)=%s", file, key, ret ? (char*)data : "");
+    if (dbe_close(dh) < 0)
+	return -1;
     return 0;
 }
 
@@ -179,39 +465,67 @@ db_get(char *file, char *key, void *data, size_t *datalen)
 int 
 db_get_alloc(char *file, char *key, void **data, size_t *datalen)
 {
-    DEPOT *dp;
-    int len;
+    void              *dh;
+    int                len = 0;
+    struct db_overlay  ov;
+    int                ret;
 
-    /* Open database for writing */
-    if ((dp = dpopen(file, DP_OREADER | DP_OLCKNB, 0)) == NULL){
-	clicon_err(OE_DB, 0, "%s: dpopen(%s): %s", 
-		   __FUNCTION__,
-		   file,
-		   dperrmsg(dpecode));
-	return -1;
-    }
-    if ((*data = dpget(dp, key, -1, 0, -1, &len)) == NULL){
-	if (dpecode == DP_ENOITEM){
-	    *datalen = 0;
-	    *data = NULL;
-	    len = 0;
-	}
-	else{
-	    /* No entry vs error? */
-	    clicon_err(OE_DB, 0, "db_get_alloc: dpgetwb: %s (%d)", 
-		    dperrmsg(dpecode), dpecode);
-	    dpclose(dp);
-	    return -1;
-	}
+    /* Open database for reading */
+    if ((dh = dbe_open(file, DB_OREADER, 0)) == NULL)
+	return -1;
+    if (db_overlay_open(dh, &ov) < 0){
+	dbe_close(dh);
+	return -1;
     }
-    *datalen = len;
-    if (dpclose(dp) == 0){
-	clicon_err(OE_DB, 0, "db_get_alloc: dpclose: %s", dperrmsg(dpecode));
+    if (ov.ov_base) /* overlay: lookup in overlay and base */
+	ret = db_overlay_get(dh, &ov, key, (char**)data, &len);
+    else
+	ret = dbe_get(dh, key, (char**)data, &len);
+    db_overlay_close(&ov);
+    if (ret < 0){
+	dbe_close(dh);
 	return -1;
     }
+    if (ret == 0){
+	*data = NULL;
+	len = 0;
+    }
+    *datalen = len;
+    if (dbe_close(dh) < 0)
+	return -1;
     return 0;
 }
 
+/*! Delete key in open database dh with overlay ov
+ * Returns -1 on failure, 0 if key did not exist and 1 if successful.
+ */
+static int 
+db_del1(void *dh, struct db_overlay *ov, char *key)
+{
+    int    retval = 0;
+    char  *dkey = NULL;
+    int    ret;
+
+    if (ov->ov_base){ 
+	/* overlay: remove from overlay, and mark as deleted if in base */
+	if ((ret = db_overlay_get(dh, ov, key, NULL, NULL)) < 0 ||
+	    (dkey = db_overlay_delkey(key)) == NULL)
+	    return -1;
+	retval = ret;
+	if (dbe_del(dh, key) < 0)
+	    ret = -1;
+	else if ((ret = db_overlay_get(dh, ov, key, NULL, NULL)) == 1 &&
+		 dbe_put(dh, dkey, "", 0) < 0)
+	    ret = -1;
+	free(dkey);
+	if (ret < 0)
+	    return -1;
+    }
+    else 
+	retval = dbe_del(dh, key);
+    return retval;
+}
+
 /*
  * Delete database entry
  * Returns -1 on failure, 0 if key did not exist and 1 if successful.
@@ -219,26 +533,78 @@ db_get_alloc(char *file, char *key, void **data, size_t *datalen)
 int 
 db_del(char *file, char *key)
 {
-    int retval = 0;
-    DEPOT *dp;
+    int                retval = 0;
+    void              *dh;
+    struct db_overlay  ov;
 
     /* Open database for writing */
-    if ((dp = dpopen(file, DP_OWRITER | DP_OLCKNB, 0)) == NULL){
-	clicon_err(OE_DB, 0, "db_del: dpopen(%s): %s", 
-		file,
-		dperrmsg(dpecode));
+    if ((dh = dbe_open(file, DB_OWRITER, 0)) == NULL)
+	return -1;
+    if (db_overlay_open(dh, &ov) < 0){
+	dbe_close(dh);
 	return -1;
     }
-    if (dpout(dp, key, -1)) {
-        retval = 1;
-    }
-    if (dpclose(dp) == 0){
-	clicon_err(OE_DB, 0, "db_del: dpclose: %s", dperrmsg(dpecode));
+    retval = db_del1(dh, &ov, key);
+    db_overlay_close(&ov);
+    if (retval < 0){
+	dbe_close(dh);
 	return -1;
     }
+    if (dbe_close(dh) < 0)
+	return -1;
     return retval;
 }
 
+/*
+ * db_batch
+ * Apply a batch of set and delete operations to a database, in order, with
+ * the database opened once, as one transaction of the storage engine.
+ * If an operation fails, the batch is aborted. With an engine that has 
+ * transactions the earlier operations of the batch are then undone, 
+ * otherwise (Depot) they remain.
+ * Example:
+ *  struct db_batch_op ops[2] = {{"a.0", lvec, lveclen}, {"a.1", NULL, 0}};
+ *  if (db_batch(dbname, ops, 2) < 0)
+ *     goto err;
+ * returns: number of operations applied, or -1 on error
+ */
+int
+db_batch(char *file, struct db_batch_op *ops, int nops)
+{
+    void              *dh;
+    struct db_overlay  ov;
+    int                i = 0;
+
+    /* Open database for writing */
+    if ((dh = dbe_open(file, DB_OWRITER, 0)) == NULL)
+	return -1;
+    if (db_overlay_open(dh, &ov) < 0){
+	dbe_close(dh);
+	return -1;
+    }
+    if (dbe_txn_begin(dh) < 0){
+	db_overlay_close(&ov);
+	dbe_close(dh);
+	return -1;
+    }
+    for (i=0; i<nops; i++)
+	if (ops[i].bo_val != NULL){
+	    if (db_set1(file, dh, &ov, ops[i].bo_key, 
+			ops[i].bo_val, ops[i].bo_vlen) < 0)
+		break;
+	}
+	else
+	    if (db_del1(dh, &ov, ops[i].bo_key) < 0)
+		break;
+    db_overlay_close(&ov);
+    if (i < nops)
+	dbe_txn_abort(dh);
+    else if (dbe_txn_commit(dh) < 0)
+	i = -1;
+    if (dbe_close(dh) < 0)
+	return -1;
+    return i < nops ? -1 : i;
+}
 
 /*
  * db_exists
@@ -248,145 +614,925 @@ db_del(char *file, char *key)
 int 
 db_exists(char *file, char *key)
 {
-    DEPOT *dp;
-    int len;
+    void              *dh;
+    int                ret;
+    struct db_overlay  ov;
 
     /* Open database for reading */
-    if ((dp = dpopen(file, DP_OREADER | DP_OLCKNB, 0)) == NULL){
-	clicon_err(OE_DB, dpecode, "%s: dpopen: %s", 
-		   __FUNCTION__, dperrmsg(dpecode));
+    if ((dh = dbe_open(file, DB_OREADER, 0)) == NULL)
+	return -1;
+    if (db_overlay_open(dh, &ov) < 0){
+	dbe_close(dh);
 	return -1;
     }
+    if (ov.ov_base) /* overlay: lookup in overlay and base */
+	ret = db_overlay_get(dh, &ov, key, NULL, NULL);
+    else
+	ret = dbe_get(dh, key, NULL, NULL);
+    db_overlay_close(&ov);
+    if (dbe_close(dh) < 0)
+	return -1;
+    return (ret == 1) ? 1 : 0;
+}
 
-    len = dpvsiz(dp, key, -1);
-    if (len < 0 && dpecode != DP_ENOITEM)
-	clicon_err(OE_DB, 0, "^s: dpvsiz: %s (%d)", 
-		   __FUNCTION__, dperrmsg(dpecode), dpecode);
+/*
+ * db_seq_next
+ * Allocate next value of an integer counter stored at key. The counter is
+ * read, rounded down to a multiple of increment, incremented and written back
+ * under a single writer open, ie the database lock protects the update.
+ * If the key does not exist, 'init' is used as current value.
+ * returns:
+ *   new counter value (>= 0) if OK
+ *   -1 on error
+ */
+int
+db_seq_next(char *file, char *key, int init, int increment)
+{
+    void              *dh;
+    struct db_overlay  ov;
+    int                seq;
+    int                ret;
 
-    if (dpclose(dp) == 0) {
-	clicon_err(OE_DB, 0, "%s: dpclose: %s", dperrmsg(dpecode),__FUNCTION__);
+    if (increment <= 0)
+	increment = 1;
+    /* Open database for writing */
+    if ((dh = dbe_open(file, DB_OWRITER, 0)) == NULL)
+	return -1;
+    if (db_overlay_open(dh, &ov) < 0){
+	dbe_close(dh);
 	return -1;
     }
+    if ((ret = db_seq_get(dh, &ov, key, &seq)) < 0)
+	goto err;
+    if (ret == 0)
+	seq = init;
+    seq = seq - (seq % increment) + increment;
+    if (db_put1(dh, &ov, key, (char*)&seq, sizeof(seq)) < 0)
+	goto err;
+    db_overlay_close(&ov);
+    if (dbe_close(dh) < 0)
+	return -1;
+    return seq;
+  err:
+    db_overlay_close(&ov);
+    dbe_close(dh);
+    return -1;
+}
+
+/*
+ * Database cursor. Iterates over the entries of a database whose keys match
+ * a regexp, with one open database handle.
+ */
+struct db_cursor {
+    void      *dc_dh;       /* Open database (reader) */
+    char      *dc_basename; /* Base database if dc_dh is an overlay */
+    void      *dc_base;     /* Open base database, when overlay is done */
+    int        dc_inbase;   /* Overlay done, iterating base database */
+    char      *dc_prefix;   /* Ordered handle: only keys with this prefix */
+    int        dc_ordered;  /* dc_dh iterates in key order from dc_prefix */
+    int        dc_bordered; /* dc_base iterates in key order from dc_prefix */
+    int        dc_rx;       /* Set if dc_re is compiled */
+    regex_t    dc_re;       /* Compiled key regexp */
+    regmatch_t dc_pmatch[1];/* Match of last key */
+    int        dc_noval;    /* Dont read values */
+    char      *dc_key;      /* Current key */
+    char      *dc_val;      /* Current value */
+    int        dc_vlen;     /* Length of current value */
+};
+
+/*
+ * db_regexp_prefix
+ * Return malloced literal prefix of all keys matching regexp if it starts 
+ * with ^, eg "a.b" for "^a\.b\.[0-9]+$", or NULL if there is no prefix.
+ */
+static char *
+db_regexp_prefix(char *regexp)
+{
+    char *meta = ".[]()*+?{}|\\$^";
+    char *prefix;
+    char *p;
+    char  c;
+    int   i = 0;
 
-    return (len < 0) ? 0 : 1;
+    if (regexp == NULL || regexp[0] != '^' || strchr(regexp, '|') ||
+	(prefix = malloc(strlen(regexp))) == NULL)
+	return NULL;
+    for (p = regexp+1; *p; p++){
+	if (*p == '\\' && p[1] && strchr(meta, p[1]))
+	    c = *++p;
+	else if (strchr(meta, *p))
+	    break;
+	else
+	    c = *p;
+	if (p[1] && strchr("*?{", p[1])) /* Optional or repeated */
+	    break;
+	prefix[i++] = c;
+    }
+    prefix[i] = '\0';
+    if (i == 0){
+	free(prefix);
+	return NULL;
+    }
+    return prefix;
 }
 
-int
-db_regexp(char *file,
-	  char *regexp, 
-	  const char *label, 
-	  struct db_pair **pairs,
-	  int noval)
+/*
+ * db_cursor_open
+ * Open a cursor over all entries in database whose keys match regexp 
+ * (all if NULL). If noval is set only keys are read.
+ * The database is kept open for reading until db_cursor_close(). With the
+ * Depot engine writers fail meanwhile: iterate and close, do not write 
+ * while the cursor is open.
+ * If the storage engine is ordered and regexp starts with ^ and a literal
+ * prefix, only the range of keys with that prefix is scanned.
+ * If the database is an overlay, the entries of the overlay are returned 
+ * first, then the entries of the base database not overwritten or deleted 
+ * in the overlay. The base database is opened when the overlay is done, and
+ * is then kept open too.
+ * Example:
+ *  db_cursor *dc;
+ *  char      *key, *val;
+ *  int        vlen;
+ *  if ((dc = db_cursor_open(dbname, "^a.*$", 0)) == NULL)
+ *     goto err;
+ *  while ((ret = db_cursor_next(dc, &key, &val, &vlen)) == 1)
+ *     ...
+ *  db_cursor_close(dc);
+ *  if (ret < 0)
+ *     goto err;
+ */
+db_cursor *
+db_cursor_open(char *file, char *regexp, int noval)
 {
-    int npairs;
-    int status;
-    int retval = -1;
-    int vlen = 0;
-    char *key = NULL;
-    void *val = NULL;
-    char errbuf[512];
-    struct db_pair *pair;
-    struct db_pair *newpairs;
-    regex_t iterre;
-    DEPOT *iterdp = NULL;
-    regmatch_t pmatch[1];
-    size_t nmatch = 1;
-    
-    npairs = 0;
-    *pairs = NULL;
-    
+    db_cursor *dc;
+    int        status;
+    char       errbuf[512];
+
+    if ((dc = malloc(sizeof(*dc))) == NULL){
+	clicon_err(OE_UNIX, errno, "%s: malloc", __FUNCTION__);
+	return NULL;
+    }
+    memset(dc, 0, sizeof(*dc));
+    dc->dc_noval = noval;
     if (regexp) {
-	if ((status = regcomp(&iterre, regexp, REG_EXTENDED)) != 0) {
-	    regerror(status, &iterre, errbuf, sizeof(errbuf));
+	if ((status = regcomp(&dc->dc_re, regexp, REG_EXTENDED)) != 0) {
+	    regerror(status, &dc->dc_re, errbuf, sizeof(errbuf));
 	    clicon_err(OE_DB, 0, "%s: regcomp: %s", __FUNCTION__, errbuf);
-	    return -1;
+	    goto err;
 	}
+	dc->dc_rx++;
+	dc->dc_prefix = db_regexp_prefix(regexp);
     }
-    
     /* Open database for reading */
-    if ((iterdp = dpopen(file, DP_OREADER | DP_OLCKNB, 0)) == NULL){
-	clicon_err(OE_DB, 0, "%s: dpopen(%s): %s", 
-		   __FUNCTION__, file, dperrmsg(dpecode));
-	goto quit;
-    }
-    
+    if ((dc->dc_dh = dbe_open(file, DB_OREADER, 0)) == NULL)
+	goto err;
+    if (db_overlay_base(dc->dc_dh, &dc->dc_basename) < 0)
+	goto err;
     /* Initiate iterator */
-    if(dpiterinit(iterdp) == 0) {
-	clicon_err(OE_DB, 0, "%s: dpiterinit: %s", __FUNCTION__, dperrmsg(dpecode));
-	goto quit;
+    if ((dc->dc_ordered = dbe_iterinit(dc->dc_dh, dc->dc_prefix)) < 0)
+	goto err;
+    if (!dc->dc_ordered && dc->dc_basename == NULL && dc->dc_prefix){ 
+	/* All keys are iterated anyway */
+	free(dc->dc_prefix);
+	dc->dc_prefix = NULL;
     }
-    
-    /* Iterate through DB */
-    while((key = dpiternext(iterdp, NULL)) != NULL) {
-	
-	if (regexp && regexec(&iterre, key, nmatch, pmatch, 0) != 0) {
-	    free(key);
+    return dc;
+ err:
+    db_cursor_close(dc);
+    return NULL;
+}
+
+/*
+ * db_cursor_next
+ * Step cursor to next matching entry. key and val point to memory owned by 
+ * the cursor which is valid until next call or close. val is NULL (and vlen 0) 
+ * if cursor is opened with noval.
+ * returns:
+ *   1 if entry returned
+ *   0 if no more entries
+ *  -1 on error
+ */
+int
+db_cursor_next(db_cursor *dc, char **key, char **val, int *vlen)
+{
+    void  *dh;
+    char  *dkey;
+    int    ret;
+
+    if (dc->dc_key){
+	free(dc->dc_key);
+	dc->dc_key = NULL;
+    }
+    if (dc->dc_val){
+	free(dc->dc_val);
+	dc->dc_val = NULL;
+    }
+    dc->dc_vlen = 0;
+    for (;;){
+	dh = dc->dc_inbase ? dc->dc_base : dc->dc_dh;
+	if ((ret = dbe_iternext(dh, &dc->dc_key)) < 0)
+	    return -1;
+	/* Past the key range of an ordered handle */
+	if (ret == 1 && dc->dc_prefix && 
+	    (dc->dc_inbase ? dc->dc_bordered : dc->dc_ordered) &&
+	    strncmp(dc->dc_key, dc->dc_prefix, strlen(dc->dc_prefix)) != 0){
+	    free(dc->dc_key);
+	    dc->dc_key = NULL;
+	    ret = 0;
+	}
+	if (ret == 0){
+	    if (dc->dc_basename && !dc->dc_inbase){ /* Overlay done, go to base */
+		if ((dc->dc_base = dbe_open(dc->dc_basename, 
+					    DB_OREADER, 0)) == NULL)
+		    return -1;
+		dc->dc_inbase++;
+		/* May differ from the overlay, eg if only one has an image */
+		if ((dc->dc_bordered = dbe_iterinit(dc->dc_base, 
+						    dc->dc_prefix)) < 0)
+		    return -1;
+		continue;
+	    }
+	    break;
+	}
+	if (db_reserved_key(dc->dc_key) ||
+	    (dc->dc_rx && 
+	     regexec(&dc->dc_re, dc->dc_key, 1, dc->dc_pmatch, 0) != 0)) {
+	    free(dc->dc_key);
+	    dc->dc_key = NULL;
 	    continue;
 	}
-	
+	/* Skip base entries overwritten or deleted in overlay */
+	if (dc->dc_inbase){
+	    if ((ret = dbe_get(dc->dc_dh, dc->dc_key, NULL, NULL)) == 0){
+		if ((dkey = db_overlay_delkey(dc->dc_key)) == NULL)
+		    return -1;
+		ret = dbe_get(dc->dc_dh, dkey, NULL, NULL);
+		free(dkey);
+	    }
+	    if (ret < 0)
+		return -1;
+	    if (ret == 1){
+		free(dc->dc_key);
+		dc->dc_key = NULL;
+		continue;
+	    }
+	}
 	/* Retrieve value if required */
-	if ( ! noval) {
-	    if((val = dpget(iterdp, key, -1, 0, -1, &vlen)) == NULL) {
-		clicon_log(OE_DB, "%s: dpget: %s", __FUNCTION__, dperrmsg(dpecode));
+	if (!dc->dc_noval &&
+	    (ret = dbe_get(dh, dc->dc_key, &dc->dc_val, &dc->dc_vlen)) != 1) {
+	    if (ret == 0)
+		clicon_err(OE_DB, 0, "%s: %s: no value", 
+			   __FUNCTION__, dc->dc_key);
+	    return -1;
+	}
+	if (key)
+	    *key = dc->dc_key;
+	if (val)
+	    *val = dc->dc_val;
+	if (vlen)
+	    *vlen = dc->dc_vlen;
+	return 1;
+    }
+    return 0;
+}
+
+/*
+ * db_cursor_close
+ * Close cursor and database, and free all memory of cursor.
+ */
+void
+db_cursor_close(db_cursor *dc)
+{
+    if (dc == NULL)
+	return;
+    if (dc->dc_key)
+	free(dc->dc_key);
+    if (dc->dc_val)
+	free(dc->dc_val);
+    if (dc->dc_prefix)
+	free(dc->dc_prefix);
+    if (dc->dc_rx)
+	regfree(&dc->dc_re);
+    if (dc->dc_dh)
+	dbe_close(dc->dc_dh);
+    if (dc->dc_base)
+	dbe_close(dc->dc_base);
+    if (dc->dc_basename)
+	free(dc->dc_basename);
+    free(dc);
+}
+
+/*
+ * Result set builder used by db_regexp_filter(). Entries are collected as
+ * offsets into one string arena holding keys, matched strings and values.
+ * Both the entry vector and the arena grow geometrically. When the scan is
+ * done, the result is copied into a single chunk: the db_pair vector followed
+ * by the arena, see db_rset_finish().
+ */
+struct db_rent {
+    size_t re_key;     /* Offset of key in arena */
+    size_t re_matched; /* Offset of matched string in arena */
+    size_t re_val;     /* Offset of value in arena */
+    int    re_vlen;    /* Length of value, 0 if none */
+};
+
+struct db_rset {
+    struct db_rent *rs_ents;  /* Vector of entries */
+    int             rs_n;     /* Number of entries */
+    int             rs_max;   /* Allocated number of entries */
+    char           *rs_buf;   /* String and value arena */
+    size_t          rs_len;   /* Used length of arena */
+    size_t          rs_size;  /* Allocated length of arena */
+};
+
+#define DB_RSET_ALIGN(n) (((n) + 7) & ~((size_t)7)) /* lvalues need alignment */
+
+/*
+ * Append data to arena, return offset or -1 on error 
+ * If str is set, the data is null-terminated.
+ */
+static ssize_t
+db_rset_put(struct db_rset *rs, const char *data, size_t len, int str)
+{
+    size_t off;
+    size_t need;
+    size_t size;
+    char  *buf;
+
+    off = DB_RSET_ALIGN(rs->rs_len);
+    need = off + len + (str ? 1 : 0);
+    if (need > rs->rs_size){
+	size = rs->rs_size ? rs->rs_size : 4096;
+	while (size < need)
+	    size *= 2;
+	if ((buf = realloc(rs->rs_buf, size)) == NULL){
+	    clicon_err(OE_UNIX, errno, "%s: realloc", __FUNCTION__);
+	    return -1;
+	}
+	rs->rs_buf = buf;
+	rs->rs_size = size;
+    }
+    memcpy(rs->rs_buf + off, data, len);
+    if (str)
+	rs->rs_buf[off+len] = '\0';
+    rs->rs_len = need;
+    return off;
+}
+
+/*
+ * Add entry to result set. If matched is NULL, matched string is the key.
+ */
+static int
+db_rset_add(struct db_rset *rs, 
+	    char           *key, 
+	    char           *matched, 
+	    int             mlen, 
+	    char           *val, 
+	    int             vlen)
+{
+    struct db_rent *re;
+    struct db_rent *ents;
+    ssize_t         off;
+    int             max;
+    
+    if (rs->rs_n == rs->rs_max){
+	max = rs->rs_max ? 2*rs->rs_max : 64;
+	if ((ents = realloc(rs->rs_ents, max*sizeof(struct db_rent))) == NULL){
+	    clicon_err(OE_UNIX, errno, "%s: realloc", __FUNCTION__);
+	    return -1;
+	}
+	rs->rs_ents = ents;
+	rs->rs_max = max;
+    }
+    re = &rs->rs_ents[rs->rs_n];
+    memset(re, 0, sizeof(*re));
+    if ((off = db_rset_put(rs, key, strlen(key), 1)) < 0)
+	return -1;
+    re->re_key = re->re_matched = off;
+    if (matched){
+	if ((off = db_rset_put(rs, matched, mlen, 1)) < 0)
+	    return -1;
+	re->re_matched = off;
+    }
+    if (vlen){
+	if ((off = db_rset_put(rs, val, vlen, 0)) < 0)
+	    return -1;
+	re->re_val = off;
+	re->re_vlen = vlen;
+    }
+    rs->rs_n++;
+    return 0;
+}
+
+/*
+ * Copy result set to a single chunk in group label and return it as
+ * a vector of db_pairs. Returns number of pairs, or -1 on error.
+ */
+static int
+db_rset_finish(struct db_rset *rs, const char *label, struct db_pair **pairs)
+{
+    int             i;
+    size_t          plen;
+    char           *blk;
+    char           *arena;
+    struct db_pair *pair;
+    struct db_rent *re;
+
+    *pairs = NULL;
+    if (rs->rs_n == 0)
+	return 0;
+    plen = DB_RSET_ALIGN(rs->rs_n * sizeof(struct db_pair));
+    if ((blk = chunk(plen + rs->rs_len, label)) == NULL){
+	clicon_err(OE_DB, errno, "%s: chunk", __FUNCTION__);
+	return -1;
+    }
+    arena = blk + plen;
+    memcpy(arena, rs->rs_buf, rs->rs_len);
+    for (i=0; i<rs->rs_n; i++){
+	re = &rs->rs_ents[i];
+	pair = &((struct db_pair *)blk)[i];
+	pair->dp_key = arena + re->re_key;
+	pair->dp_matched = arena + re->re_matched;
+	pair->dp_val = re->re_vlen ? arena + re->re_val : NULL;
+	pair->dp_vlen = re->re_vlen;
+    }
+    *pairs = (struct db_pair *)blk;
+    return rs->rs_n;
+}
+
+static void
+db_rset_free(struct db_rset *rs)
+{
+    if (rs->rs_ents)
+	free(rs->rs_ents);
+    if (rs->rs_buf)
+	free(rs->rs_buf);
+}
+
+/*
+ * db_regexp_filter
+ * Return all entries whose keys match regexp as a vector of pairs allocated in
+ * chunk group 'label'. If 'filter' is given it is called for every matching
+ * entry while the database is open (with val=NULL if noval is set), and the
+ * entry is only returned if filter returns 1 or 2, where 2 also stops the scan.
+ * Entries rejected by the filter (0) are never copied. If filter returns -1,
+ * the scan is aborted with error.
+ * The pairs, keys, matched strings and values are returned in one chunk, so 
+ * the result is freed with unchunk_group(label) as before.
+ * See db_cursor_open() for iterating without copying the entries.
+ * returns:
+ *   number of pairs if OK
+ *   -1 on error
+ */
+int
+db_regexp_filter(char *file,
+		 char *regexp, 
+		 const char *label, 
+		 struct db_pair **pairs,
+		 int noval,
+		 db_filter_t *filter,
+		 void *farg)
+{
+    int         retval = -1;
+    int         ret;
+    int         last = 0;
+    int         vlen;
+    int         mlen;
+    char       *key;
+    char       *val;
+    char       *matched;
+    db_cursor  *dc;
+    regmatch_t *pm;
+    struct db_rset rs;
+    
+    memset(&rs, 0, sizeof(rs));
+    *pairs = NULL;
+    if ((dc = db_cursor_open(file, regexp, noval)) == NULL)
+	goto quit;
+    while ((ret = db_cursor_next(dc, &key, &val, &vlen)) == 1) {
+	if (filter){
+	    switch ((*filter)(key, val, vlen, farg)){
+	    case -1:
 		goto quit;
+	    case 2: /* Keep and stop */
+		last++;
+		break;
+	    case 0: /* Filtered out */
+		continue;
 	    }
 	}
-
-	/* Resize and populate resulting array */
-	newpairs = rechunk(*pairs, (npairs+1) * sizeof(struct db_pair), label);
-	if (newpairs == NULL) {
-	    clicon_err(OE_DB, errno, "%s: rechunk", __FUNCTION__);
-	    goto quit;
+	/* Add to result set. Matched string is the key if whole key matched */
+	matched = NULL;
+	mlen = 0;
+	pm = &dc->dc_pmatch[0];
+	if (regexp && (pm->rm_so != 0 || key[pm->rm_eo] != '\0')){
+	    matched = key + pm->rm_so;
+	    mlen = pm->rm_eo - pm->rm_so;
 	}
-	pair = &newpairs[npairs];
-	memset (pair, 0, sizeof(*pair));
-	
-	pair->dp_key = chunk_sprintf(label, "%s", key);
-	if (regexp)
-	    pair->dp_matched = chunk_sprintf(label, "%.*s",
-					     pmatch[0].rm_eo - pmatch[0].rm_so,
-					     key + pmatch[0].rm_so);
-	else
-	    pair->dp_matched = chunk_sprintf(label, "%s", key);
-	if (pair->dp_key == NULL || pair->dp_matched == NULL) {
-	    clicon_err(OE_DB, errno, "%s: chunk_sprintf");
+	if (db_rset_add(&rs, key, matched, mlen, val, vlen) < 0)
 	    goto quit;
+	if (last)
+	    break;
+    }
+    if (ret < 0)
+	goto quit;
+    retval = db_rset_finish(&rs, label, pairs);
+quit:
+    db_cursor_close(dc);
+    db_rset_free(&rs);
+    if (retval < 0)
+	unchunk_group(label);
+    return retval;
+}
+
+int
+db_regexp(char *file,
+	  char *regexp, 
+	  const char *label, 
+	  struct db_pair **pairs,
+	  int noval)
+{
+    return db_regexp_filter(file, regexp, label, pairs, noval, NULL, NULL);
+}
+
+/*
+ * db_overlay_init
+ * Create (or truncate) database file as an empty overlay on top of base 
+ * database, see DB_OVERLAY_BASE. The base must be an existing database that 
+ * is not an overlay itself.
+ * Example: make candidate a copy of running without copying running:
+ *   db_overlay_init(candidate, running);
+ * returns:
+ *   0 if OK
+ *  -1 on error
+ */
+int
+db_overlay_init(char *file, char *base)
+{
+    void  *dh;
+    char  *bbase = NULL;
+    char   stamp[DB_STAMPLEN];
+
+    /* Check base */
+    if ((dh = dbe_open(base, DB_OREADER, 0)) == NULL)
+	return -1;
+    if (db_overlay_base(dh, &bbase) < 0){
+	dbe_close(dh);
+	return -1;
+    }
+    dbe_close(dh);
+    if (bbase){
+	clicon_err(OE_DB, 0, "%s: %s is an overlay of %s", 
+		   __FUNCTION__, base, bbase);
+	free(bbase);
+	return -1;
+    }
+    if (db_engine_get()->de_stamp(base, stamp) < 0)
+	return -1;
+    if ((dh = dbe_open(file, DB_OWRITER | DB_OCREAT | DB_OTRUNC, 0)) == NULL)
+	return -1;
+    if (dbe_put(dh, DB_OVERLAY_BASE, base, strlen(base)+1) < 0 ||
+	dbe_put(dh, DB_OVERLAY_STAMP, stamp, strlen(stamp)+1) < 0){
+	dbe_close(dh);
+	return -1;
+    }
+    if (dbe_close(dh) < 0)
+	return -1;
+    return 0;
+}
+
+/*
+ * db_overlay_current
+ * Check that the base of an overlay database file has not changed since the
+ * overlay was created or emptied by db_overlay_init(), eg that no other 
+ * session has committed to running since a candidate was created.
+ * A changed base is not merged: the overlay must be created again, eg by
+ * copying running to the candidate.
+ * returns:
+ *   1 if file is not an overlay, or if its base has not changed
+ *   0 if the base has changed
+ *  -1 on error
+ */
+int
+db_overlay_current(char *file)
+{
+    void  *dh;
+    char  *base = NULL;
+    char  *ostamp = NULL;
+    char   stamp[DB_STAMPLEN];
+    int    retval = -1;
+
+    if ((dh = dbe_open(file, DB_OREADER, 0)) == NULL)
+	return -1;
+    if (db_overlay_base(dh, &base) < 0)
+	goto done;
+    if (base == NULL){
+	retval = 1;
+	goto done;
+    }
+    if (dbe_get(dh, DB_OVERLAY_STAMP, &ostamp, NULL) < 0)
+	goto done;
+    if (db_engine_get()->de_stamp(base, stamp) < 0)
+	goto done;
+    retval = (ostamp && strcmp(ostamp, stamp) == 0) ? 1 : 0;
+  done:
+    dbe_close(dh);
+    if (base)
+	free(base);
+    if (ostamp)
+	free(ostamp);
+    return retval;
+}
+
+/*
+ * db_overlay_changes
+ * Get the keys that overlay database file changes in its base: keys set and
+ * keys deleted in the overlay. Also get the change stamp of the base when the
+ * overlay was created, see db_overlay_current(). The keys are read from the
+ * overlay only, so the cost is in the number of changed keys.
+ * keys is set to a malloced vector of nkeys malloced keys, and stamp to a
+ * malloced string. Both are NULL if file is not an overlay.
+ * returns:
+ *   0 if OK
+ *  -1 on error
+ */
+int
+db_overlay_changes(char *file, char ***keys, int *nkeys, char **stamp)
+{
+    void  *dh;
+    char  *base = NULL;
+    char  *key = NULL;
+    char **vec = NULL;
+    char **p;
+    int    n = 0;
+    int    ret;
+    int    i;
+    int    retval = -1;
+
+    *keys = NULL;
+    *nkeys = 0;
+    *stamp = NULL;
+    if ((dh = dbe_open(file, DB_OREADER, 0)) == NULL)
+	return -1;
+    if (db_overlay_base(dh, &base) < 0)
+	goto done;
+    if (base == NULL){
+	retval = 0;
+	goto done;
+    }
+    if (dbe_get(dh, DB_OVERLAY_STAMP, stamp, NULL) < 0)
+	goto done;
+    if (dbe_iterinit(dh, NULL) < 0)
+	goto done;
+    while ((ret = dbe_iternext(dh, &key)) == 1){
+	if (db_reserved_key(key) && key[0] != DB_OVERLAY_DEL){
+	    free(key);
+	    key = NULL;
+	    continue;
+	}
+	if ((p = realloc(vec, (n+1)*sizeof(char*))) == NULL){
+	    clicon_err(OE_UNIX, errno, "%s: realloc", __FUNCTION__);
+	    goto done;
+	}
+	vec = p;
+	if (key[0] == DB_OVERLAY_DEL) /* tombstone */
+	    memmove(key, key+1, strlen(key));
+	vec[n++] = key;
+	key = NULL;
+    }
+    if (ret < 0)
+	goto done;
+    *keys = vec;
+    *nkeys = n;
+    vec = NULL;
+    retval = 0;
+  done:
+    dbe_close(dh);
+    if (retval < 0 && *stamp){
+	free(*stamp);
+	*stamp = NULL;
+    }
+    if (vec){
+	for (i=0; i<n; i++)
+	    free(vec[i]);
+	free(vec);
+    }
+    if (key)
+	free(key);
+    if (base)
+	free(base);
+    return retval;
+}
+
+/*
+ * db_stamp
+ * Get change stamp of database file, see de_stamp(), followed by that of its
+ * base if it is an overlay. The stamp changes when any process changes the
+ * file or its base. stamp is a buffer of DB_STAMPLEN*2 bytes, set to "" if
+ * the file does not exist.
+ * returns:
+ *   0 if OK
+ *  -1 on error
+ */
+int
+db_stamp(char *file, char *stamp)
+{
+    struct db_engine *de = db_engine_get();
+    void             *dh;
+    char             *base = NULL;
+    int               len;
+    int               retval = -1;
+
+    if (de->de_stamp(file, stamp) < 0)
+	return -1;
+    if (stamp[0] == '\0')
+	return 0;
+    if ((dh = dbe_open(file, DB_OREADER, 0)) == NULL)
+	return -1;
+    if (db_overlay_base(dh, &base) < 0)
+	goto done;
+    if (base){
+	len = strlen(stamp);
+	stamp[len++] = ' ';
+	if (de->de_stamp(base, stamp+len) < 0)
+	    goto done;
+    }
+    retval = 0;
+  done:
+    dbe_close(dh);
+    if (base)
+	free(base);
+    return retval;
+}
+
+/*
+ * Get name of base database of database file, NULL if it is not an overlay
+ * or does not exist.
+ */
+static int
+db_file_base(char *file, char **base)
+{
+    void       *dh;
+    struct stat st;
+    int         retval;
+
+    *base = NULL;
+    if (stat(file, &st) < 0)
+	return 0;
+    if ((dh = dbe_open(file, DB_OREADER, 0)) == NULL)
+	return -1;
+    retval = db_overlay_base(dh, base);
+    dbe_close(dh);
+    return retval;
+}
+
+/*
+ * Write the changes of overlay database file to target database.
+ */
+static int
+db_overlay_apply(char *file, char *target)
+{
+    void  *dh = NULL;
+    void  *tdh = NULL;
+    char  *key = NULL;
+    char  *val;
+    int    vlen;
+    int    ret;
+    int    retval = -1;
+
+    if ((dh = dbe_open(file, DB_OREADER, 0)) == NULL)
+	goto done;
+    if ((tdh = dbe_open(target, DB_OWRITER, 0)) == NULL)
+	goto done;
+    if (dbe_iterinit(dh, NULL) < 0)
+	goto done;
+    while ((ret = dbe_iternext(dh, &key)) == 1){
+	if (key[0] == DB_OVERLAY_DEL){ /* tombstone */
+	    if (dbe_del(tdh, key+1) < 0)
+		goto done;
 	}
-	if ( ! noval) {
-	    if (vlen){
-		pair->dp_val = chunkdup (val, vlen, label);
-		if (pair->dp_val == NULL) {
-		    clicon_err(OE_DB, errno, "%s: chunkdup", __FUNCTION__);
-		    goto quit;
-		}
+	else if (!db_reserved_key(key)){
+	    if (dbe_get(dh, key, &val, &vlen) != 1){
+		clicon_err(OE_DB, 0, "%s: %s: no value", __FUNCTION__, key);
+		goto done;
+	    }
+	    if (dbe_put(tdh, key, val, vlen) < 0){
+		free(val);
+		goto done;
 	    }
-	    pair->dp_vlen = vlen;
 	    free(val);
-	    val = NULL;
 	}
-
-	(*pairs) = newpairs;
-	npairs++;
 	free(key);
+	key = NULL;
     }
-	
-    retval = npairs;
-    
-quit:
+    if (ret < 0)
+	goto done;
+    ret = dbe_close(tdh);
+    tdh = NULL;
+    if (ret < 0)
+	goto done;
+    retval = 0;
+  done:
     if (key)
 	free(key);
-    if (val)
-	free(val);
-    if (regexp)
-	regfree(&iterre);
-    if (iterdp)
-	dpclose(iterdp);
-    if (retval < 0)
-	unchunk_group(label);
+    if (tdh)
+	dbe_close(tdh);
+    if (dh)
+	dbe_close(dh);
+    return retval;
+}
+
+/*
+ * db_copy
+ * Copy database src to target, handling overlay databases, see 
+ * db_overlay_init():
+ * - If target is an overlay of src, the overlay is just emptied.
+ * - If src is an overlay of target, only the changes in the overlay are 
+ *   written to target, and the overlay is then emptied (it is the same as 
+ *   target). This fails if target has changed since the overlay was 
+ *   created, see db_overlay_current().
+ * - If src is an overlay of another database, the base is copied and the
+ *   changes in the overlay are written to the copy, which then replaces 
+ *   target.
+ * - Otherwise the database is copied by the storage engine.
+ * returns:
+ *   0 if OK
+ *  -1 on error
+ */
+int
+db_copy(char *src, char *target)
+{
+    struct db_engine *de = db_engine_get();
+    char  *sbase = NULL;
+    char  *tbase = NULL;
+    char   tmp[MAXPATHLEN];
+    int    ret;
+    int    retval = -1;
 
+    if (strcmp(src, target) == 0)
+	return 0;
+    if (db_file_base(src, &sbase) < 0)
+	goto done;
+    if (db_file_base(target, &tbase) < 0)
+	goto done;
+    if (tbase && strcmp(tbase, src) == 0){ 
+	if (db_overlay_init(target, src) < 0)
+	    goto done;
+    }
+    else if (sbase && strcmp(sbase, target) == 0){
+	if ((ret = db_overlay_current(src)) < 0)
+	    goto done;
+	if (ret == 0){
+	    clicon_err(OE_DB, 0, "%s has changed since %s was created from it", 
+		       target, src);
+	    goto done;
+	}
+	if (db_overlay_apply(src, target) < 0)
+	    goto done;
+	if (db_overlay_init(src, target) < 0)
+	    goto done;
+    }
+    else if (sbase){
+	snprintf(tmp, sizeof(tmp), "%s.%u", target, (unsigned)getpid());
+	if (de->de_copy(sbase, tmp) < 0 ||
+	    db_overlay_apply(src, tmp) < 0 ||
+	    de->de_rename(tmp, target) < 0){
+	    de->de_remove(tmp);
+	    goto done;
+	}
+    }
+    else if (de->de_copy(src, target) < 0)
+	goto done;
+    retval = 0;
+  done:
+    if (sbase)
+	free(sbase);
+    if (tbase)
+	free(tbase);
     return retval;
 }
 
+/*
+ * db_rename
+ * Replace database target with database src, and remove src. Target is
+ * replaced atomically: readers see either the old or the new database.
+ */
+int
+db_rename(char *src, char *target)
+{
+    return db_engine_get()->de_rename(src, target);
+}
+
+/*
+ * db_remove
+ * Remove database file, and other files of the storage engine
+ */
+int
+db_remove(char *file)
+{
+    return db_engine_get()->de_remove(file);
+}
+
 /*
  * Sanitize regexp string. Escape '\' etc.
  */
@@ -416,5 +1562,3 @@ db_sanitize(char *rx, const char *label)
 }
 
 
-#endif /* DEPOT */
-
@@ -60,6 +60,7 @@
 /* clicon */
 #include "clicon_log.h"
 #include "clicon_err.h"
+#include "clicon_sha1.h"
 
 
 /* 
@@ -422,6 +423,15 @@ SHA1PadMessage(SHA1Context *context)
 
 char *
 clicon_sha1hex(const char *str)
+{
+    return clicon_sha1hex_buf(str, strlen(str));
+}
+
+/*
+ * SHA1 of a binary buffer as an allocated string of 40 hex digits.
+ */
+char *
+clicon_sha1hex_buf(const void *buf, size_t len)
 {
     int i;
     char *retstr;
@@ -429,7 +439,7 @@ clicon_sha1hex(const char *str)
     
 
     SHA1Reset(&context);
-    SHA1Input(&context, (const unsigned char *)str, strlen(str));
+    SHA1Input(&context, (const unsigned char *)buf, len);
     if (!SHA1Result(&context)) {
 	clicon_err(OE_UNIX, 0, "Could not compute SHA1 message digest");
 	return NULL;
@@ -420,24 +420,31 @@ db2xml_key(char       *dbname,
 	   char       *key_regex,
 	   char       *toptag)
 {
-    struct db_pair   *pairs;
-    int               npairs;
+    db_cursor        *dc = NULL;
+    char             *key;
+    char             *val;
+    int               vlen;
+    int               ret;
     cxobj            *xt;
 
     if (key_regex == NULL)
 	key_regex = "^.*$";
     if ((xt = xml_new(toptag, NULL)) == NULL)
 	goto catch;
-    if ((npairs = db_regexp(dbname, key_regex, __FUNCTION__, &pairs, 0)) < 0)
+    /* Add entries to tree as they are read, without copying them */
+    if ((dc = db_cursor_open(dbname, key_regex, 0)) == NULL)
 	goto catch;
-    if (dbpairs2xml(pairs, npairs, db_spec, xt) < 0)
+    while ((ret = db_cursor_next(dc, &key, &val, &vlen)) == 1)
+	if (dbkey2xml(db_spec, key, val, vlen, xt) < 0)
+	    goto catch;
+    if (ret < 0)
 	goto catch;
-    unchunk_group(__FUNCTION__);  
+    db_cursor_close(dc);
     return xt;
   catch:
     if (xt)
 	xml_free(xt);
-    unchunk_group(__FUNCTION__);  
+    db_cursor_close(dc);
     return NULL;
 }
 
@@ -75,378 +75,613 @@ to the xml standards:
 /*
  * Types 
  */
-struct searchvec{
-    cxobj    **sv_v0;   /* here is result */
-    int        sv_v0len;
-    cxobj    **sv_v1;   /* this is tmp storage */
-    int        sv_v1len;
-    int        sv_max;
+/* Predicate type of a compiled xpath, eg [@x=y], [3] or [tag=val] */
+enum xpath_pred_type{
+    XP_PRED_NONE,
+    XP_PRED_ATTR,   /* [@a] or [@a=v] */
+    XP_PRED_INDEX,  /* [n] */
+    XP_PRED_CHILD,  /* [tag=val] */
 };
-typedef struct searchvec searchvec;
 
-/* move from v1 to v0 */
+/* One step of a path, eg bbb in //aaa/bbb */
+struct xpath_step{
+    char      *xs_name;    /* Shell wildcard pattern to match node name */
+    int        xs_wild;    /* Pattern has wildcards, else plain strcmp */
+    int        xs_recurse; /* '//': search deep */
+};
+
+/* One path of a union, eg //a in '//a | //b' */
+struct xpath_path{
+    struct xpath_path *xp_next;   /* Next path in union */
+    char              *xp_buf;    /* Copy of path string, tokens point here */
+    int                xp_empty;  /* Path can never match anything */
+    struct xpath_step *xp_steps;  /* Vector of steps */
+    int                xp_nsteps; /* Length of steps vector */
+    struct xpath_step  xp_attr;   /* Trailing attribute, eg @x, if xs_name */
+    enum xpath_pred_type xp_pred; /* Trailing predicate */
+    char              *xp_pred_name; /* Attribute or tag name of predicate */
+    char              *xp_pred_val;  /* Value of predicate or NULL */
+    int                xp_pred_index;
+};
+
+/* Compiled xpath: a union of paths */
+struct xpath_plan{
+    struct xpath_path *xc_paths;
+};
+
+/* Vector of matching nodes */
+struct xvec{
+    cxobj    **xv_vec;
+    int        xv_len;
+    int        xv_max;
+};
+
+/* Cursor over the matches of a compiled xpath */
+struct xpath_cursor{
+    struct xvec xc_vec;
+    int         xc_i;
+};
+
+/* Append a node to a vector, doubling it when full */
 static int
-sv_move(searchvec *sv)
+xvec_add(struct xvec *xv, 
+	 cxobj       *x)
 {
-    memcpy(sv->sv_v0, sv->sv_v1, sizeof(cxobj*)*sv->sv_v1len);
-    sv->sv_v0len = sv->sv_v1len;
-    sv->sv_v1len = 0;
+    cxobj **v;
+    int     max;
+
+    if (xv->xv_len >= xv->xv_max){
+	max = xv->xv_max ? 2*xv->xv_max : XPATH_VEC_START;
+	if ((v = realloc(xv->xv_vec, sizeof(cxobj *) * max)) == NULL){
+	    clicon_err(OE_XML, errno, "%s: realloc", __FUNCTION__);
+	    return -1;
+	}
+	xv->xv_vec = v;
+	xv->xv_max = max;
+    }
+    xv->xv_vec[xv->xv_len++] = x;
     return 0;
 }
 
-/* alloc help-function: double xv vectors. spcial case for init */
-static int
-vec_alloc(searchvec *sv)
+static inline int
+xpath_step_match(struct xpath_step *xs, 
+		 cxobj             *x)
 {
-    cxobj           **xv0     = sv->sv_v0;
-    cxobj           **xv1     = sv->sv_v1;
-    int               xv_max0 = sv->sv_max;
-    int               xv_max;
-    int               init;
-
-    init = (xv0 == NULL);
-    if (init)
-	xv_max = xv_max0;
-    else
-	xv_max = 2*xv_max0;
-    if ((xv0 = realloc(xv0, sizeof(cxobj *) * xv_max)) == NULL){
-	clicon_err(OE_XML, errno, "%s: realloc", __FUNCTION__);
-	return -1;
-    }
-    if (init)
-	memset(xv0, 0, xv_max);
-    else
-	memset(xv0+xv_max0, 0, xv_max-xv_max0);
-    if ((xv1 = realloc(xv1, sizeof(cxobj *) * xv_max)) == NULL){
-	clicon_err(OE_XML, errno, "%s: realloc", __FUNCTION__);
-	return -1;
-    }
-    if (init)
-	memset(xv1, 0, xv_max);
-    else
-	memset(xv1+xv_max0, 0, xv_max-xv_max0);
-    sv->sv_v0 = xv0;
-    sv->sv_v1 = xv1;
-    sv->sv_max = xv_max;
-    return 0;
+    if (xs->xs_wild)
+	return fnmatch(xs->xs_name, xml_name(x), 0) == 0;
+    return strcmp(xs->xs_name, xml_name(x)) == 0;
 }
 
-/*! Find a node 'deep' in an XML tree
+/*! Find nodes 'deep' in an XML tree
  *
- * The xv_* arguments are filled in  nodes found earlier.
- * args:
- *  @param[in]    xn_parent  Base XML object
- *  @param[in]    name       shell wildcard pattern to match with node name
- *  @param[in]    node_type  CX_ELMNT, CX_ATTR or CX_BODY
- *  @param[in,out] vec1        internal buffers with results
- *  @param[in,out] vec0        internal buffers with results
- *  @param[in,out] vec_len     internal buffers with length of vec0,vec1
- *  @param[in,out] vec_max     internal buffers with max of vec0,vec1
- * returns:
- *  0 on OK, -1 on error
+ * Matching nodes are not searched further.
+ * @param[in]     xn        Base XML object
+ * @param[in]     xs        Step with pattern to match with node name
+ * @param[in]     node_type CX_ELMNT, CX_ATTR or CX_BODY
+ * @param[in,out] xv        Matching nodes are appended here
+ * @param[in]     limit     Stop when xv has this many entries, 0 means no limit
+ * @retval  0   OK
+ * @retval -1   Error
  */
 static int
-recursive_find(cxobj   *xn, 
-	       char       *pattern, 
-	       int         node_type,
-	       searchvec  *sv)
+recursive_find(cxobj             *xn, 
+	       struct xpath_step *xs,
+	       int                node_type,
+	       struct xvec       *xv,
+	       int                limit)
 {
     cxobj *xsub; 
-    int       retval = -1;
+    int    retval = -1;
 
     xsub = NULL;
     while ((xsub = xml_child_each(xn, xsub, node_type)) != NULL) {
-	if (fnmatch(pattern, xml_name(xsub), 0) == 0){
-	    if (sv->sv_v1len >= sv->sv_max)
-		if (vec_alloc(sv) < 0)
-		    goto done;
-	    sv->sv_v1[sv->sv_v1len] = xsub;
-	    sv->sv_v1len += 1;
-	    continue; /* Dont go deeper */
+	if (xpath_step_match(xs, xsub)){
+	    if (xvec_add(xv, xsub) < 0)
+		goto done;
 	}
-	if (recursive_find(xsub, pattern, node_type, sv) < 0)
-	    goto done;
+	else /* Dont go deeper in matches */
+	    if (recursive_find(xsub, xs, node_type, xv, limit) < 0)
+		goto done;
+	if (limit && xv->xv_len >= limit)
+	    break;
     }
     retval = 0;
   done:
     return retval;
 }
 
+/*! Strip surrounding quotes from a predicate value, eg "hello" or 'hello' */
+static char *
+xpath_unquote(char *v)
+{
+    int len = strlen(v);
+
+    if (len >= 2 && (v[0] == '"' || v[0] == '\'') && v[len-1] == v[0]){
+	v[len-1] = '\0';
+	v++;
+    }
+    return v;
+}
+
+/*! Parse the trailing predicate of a path, eg "@x=hello", "0" or "ccc=99" */
 static int
-xpath_expr(char *e, searchvec *sv)
+xpath_compile_pred(struct xpath_path *xp, 
+		   char              *e)
 {
-    char      *e_a;
-    char      *e_v;
-    int        i;
-    int        retval = -1;
-    cxobj     *cxn;
-    cxobj     *cxc;
+    char *name;
 
     if (*e == '@'){ /* @ is a selection */
 	e++;
-	e_v=e;
-	e_a = strsep(&e_v, "=");
-	if (e_a == NULL){
-	    clicon_err(OE_XML, errno, "%s: malformed expression: [@%s]", 
-		       __FUNCTION__, e);
-	    goto done;
-	}
-	for (i=0; i<sv->sv_v0len; i++){
-	    cxn = sv->sv_v0[i];
-	    if ((cxc = xml_find(cxn, e_a)) != NULL &&
-		(xml_type(cxc) == CX_ATTR)){
-		if (!e_v || strcmp(xml_value(cxc), e_v) == 0)
-		    sv->sv_v1[sv->sv_v1len++] = cxn;
-	    }
-	}
+	name = strsep(&e, "=");
+	xp->xp_pred = XP_PRED_ATTR;
+	xp->xp_pred_name = name;
+	xp->xp_pred_val = e ? xpath_unquote(e) : NULL;
     }
-    else{ /* either <n> or <tag><op><value>, where <op>='=' for now */
-	int oplen = strcspn(e, "=");
-	if (strlen(e+oplen)==0){ /* no operator */
-	    if (sscanf(e, "%d", &i) == 1){ /* number */
-		if (i < sv->sv_v0len){
-		    cxc = sv->sv_v0[i]; /* XXX: cant compress: gcc breaks */
-		    sv->sv_v1[sv->sv_v1len++] = cxc;
-		}
-	    }
-	    else{
-		clicon_err(OE_XML, errno, "%s: malformed expression: [%s]", 
+    else /* either <n> or <tag><op><value>, where <op>='=' for now */
+	if (strchr(e, '=') == NULL){ /* no operator */
+	    if (sscanf(e, "%d", &xp->xp_pred_index) != 1){
+		clicon_err(OE_XML, 0, "%s: malformed expression: [%s]", 
 			   __FUNCTION__, e);
-		goto done;
+		return -1;
 	    }
+	    xp->xp_pred = XP_PRED_INDEX;
 	}
 	else{
-	    char *tag, *val;
-	    if ((tag = strsep(&e, "=")) == NULL){
-		clicon_err(OE_XML, errno, "%s: malformed expression: [%s]", 
-			   __FUNCTION__, e);
-		goto done;
-	    }
-	    for (i=0; i<sv->sv_v0len; i++){
-		cxn = sv->sv_v0[i];
-		if ((cxc = xml_find(cxn, tag)) != NULL &&
-		    (xml_type(cxc) == CX_ELMNT)){
-		    if ((val = xml_body(cxc)) != NULL &&
-			strcmp(val, e) == 0){
-			sv->sv_v1[sv->sv_v1len++] = cxn;
-		    }
-		}
-	    }
+	    name = strsep(&e, "=");
+	    xp->xp_pred = XP_PRED_CHILD;
+	    xp->xp_pred_name = name;
+	    xp->xp_pred_val = xpath_unquote(e);
 	}
-    }
-    /* copy the array from 1 to 0 */
-    sv_move(sv);
-    retval = 0;
-  done:
-    return retval;
+    return 0;
 }
 
-/*! Transform eg "a/b[kalle]" -> "a/b" e="kalle" */
-static int
-xpath_loop(char *xpathstr, char **pathexpr)
+/*! Compile one path of a union, eg "//a/b@x" or "/a/b[kalle]" 
+ * @param[in]  str  Path string, copied
+ * @retval     xp   Compiled path, free with xpath_path_free()
+ * @retval     NULL Error
+ */
+static struct xpath_path *
+xpath_compile_path(char *str)
 {
-    int retval = -1;
-    int len;
-    int i;
-
-    char *pe = NULL;
-    len = strlen(xpathstr) - 1;
-    if (xpathstr[len] == ']'){
-	xpathstr[len] = '\0';
-	len = strlen(xpathstr) - 1; /* recompute due to null */
-	for (i=len; i; i--){
-	    if (xpathstr[i] == '['){
-		xpathstr[i] = '\0';
-		pe = &xpathstr[i+1];
+    struct xpath_path *xp;
+    struct xpath_step *xs;
+    char              *q;
+    char              *a;
+    char              *pe = NULL;
+    char              *strn;
+    int                len;
+    int                i;
+    int                recurse = 0;
+
+    if ((xp = malloc(sizeof(*xp))) == NULL){
+	clicon_err(OE_XML, errno, "%s: malloc", __FUNCTION__);
+	return NULL;
+    }
+    memset(xp, 0, sizeof(*xp));
+    if ((xp->xp_buf = strdup(str)) == NULL){
+	clicon_err(OE_XML, errno, "%s: strdup", __FUNCTION__);
+	goto err;
+    }
+    /* Transform eg "a/b[kalle]" -> "a/b" e="kalle" */
+    q = xp->xp_buf;
+    len = strlen(q);
+    if (len && q[len-1] == ']'){
+	q[len-1] = '\0';
+	for (i=len-2; i>0; i--)
+	    if (q[i] == '['){
+		q[i] = '\0';
+		pe = &q[i+1];
 		break;
 	    }
-	}
-	if (pe==NULL){
-	    clicon_err(OE_XML, errno, "%s: mismatched []: %s", __FUNCTION__, xpathstr);
-	    goto done;
+	if (pe == NULL){
+	    clicon_err(OE_XML, 0, "%s: mismatched []: %s", __FUNCTION__, str);
+	    goto err;
 	}
     }
-    retval = 0;
-  done:
-    *pathexpr = pe;
-    return retval;
-}
-
-static int
-xpath_exec(cxobj *cxtop, char *xpath0, searchvec *sv)
-{
-    cxobj     *cxn;
-    cxobj     *cxc;
-    int        recurse = 0;
-    char      *str;
-    char      *pathexpr=NULL;
-    char      *q;
-    char      *xp;
-    int        i;
-    char      *strn;
-
-    if ((xp = strdup(xpath0)) == NULL){
-	clicon_err(OE_XML, errno, "%s: strdup", __FUNCTION__);
-	return -1;
+    /* then split off trailing attribute, eg "a/b@x" */
+    a = q;
+    q = strsep(&a, "@");
+    if (*q != '/'){ /* This is kinda broken */
+	xp->xp_empty = 1;
+	return xp;
     }
-    /* Transform eg "a/b[kalle]" -> "a/b" e="kalle" */
-    if (xpath_loop(xp, &pathexpr) < 0)
-	return -1;
-    /* first look for expressions regarding attrs */
-    str = xp;
-    q = strsep(&str, "@");
-    if (*q != '/') /* This is kinda broken */
-	goto done;
     q++;
-    /* These are search arrays allocated in sub-function used later */
-    if (vec_alloc(sv) < 0)
-	return -1;
-    /* Initialize vec0 */
-    sv->sv_v0len = 1;
-    sv->sv_v0[0] = cxtop;
-    sv->sv_v1len = 0;
-
-    while (q && strlen(q) && sv->sv_v0len){
+    /* One step per '/', at most */
+    for (i=0, len=1; q[i]; i++)
+	if (q[i] == '/')
+	    len++;
+    if ((xp->xp_steps = calloc(len, sizeof(struct xpath_step))) == NULL){
+	clicon_err(OE_XML, errno, "%s: calloc", __FUNCTION__);
+	goto err;
+    }
+    while (q && strlen(q)){
 	recurse = 0;
 	if (*q == '/') {
 	    q++;
 	    recurse = 1;
 	}
 	strn = strsep(&q, "/");
-	if (strn== NULL || strlen(strn) == 0){
-	    if (!str || !recurse){ /* eg //@ */
-		/* copy the array from 1 to 0 */
-		sv_move(sv);
-	    }
+	if (strn == NULL || strlen(strn) == 0){
+	    if (!a || !recurse) /* eg "//" */
+		xp->xp_empty = 1;
 	    break;
 	}
-	/* Fill in the searchv with values from next values */
-	for (i=0; i<sv->sv_v0len; i++){
-	    cxn = sv->sv_v0[i];
-	    if (!recurse){
-		cxc = NULL;
-		while ((cxc = xml_child_each(cxn, cxc, CX_ELMNT)) != NULL) {
-		    if (fnmatch(strn, xml_name(cxc), 0) == 0){
-			if (xml_type(cxc) == CX_ELMNT){
-			    if (sv->sv_v1len >= sv->sv_max){
-				if (vec_alloc(sv) < 0)
-				    return -1;
-			    }
-			    sv->sv_v1[sv->sv_v1len] = cxc;
-			    sv->sv_v1len += 1;
-			}
-		    }
-		}
-	    }
-	    else{
-		if (recursive_find(cxn, strn, CX_ELMNT, sv) < 0)
-		    return -1;
-	    }
-	}
-	/* copy the array from 1 to 0 */
-	sv_move(sv);
+	xs = &xp->xp_steps[xp->xp_nsteps++];
+	xs->xs_name = strn;
+	xs->xs_wild = (strpbrk(strn, "*?[\\") != NULL);
+	xs->xs_recurse = recurse;
     }
-    if (str){
-	for (i=0; i<sv->sv_v0len; i++){
-	    cxn = sv->sv_v0[i];
-	    if (recurse){
-		if (recursive_find(cxn, str, CX_ATTR, sv) < 0)
-		    return -1;
-	    }
-	    else{
-		cxc = xml_find(cxn, str);
-		if (cxc && xml_type(cxc) == CX_ATTR)
-		    sv->sv_v1[sv->sv_v1len++] = cxc;
-	    }
-	}
-	/* copy the array from 1 to 0 */
-	sv_move(sv);
-    } /* str */
-    if (pathexpr != NULL)
-	if (xpath_expr(pathexpr, sv) < 0)
-	    return -1;
-  done:
-    if (xp)
-	free(xp);
-    /* result in sv->sv_v0 */
-    if (sv){
-	if (sv->sv_v1)
-	    free(sv->sv_v1);
-	sv->sv_v1len = 0;
-	sv->sv_v1 = NULL;
+    if (a){
+	xp->xp_attr.xs_name = a;
+	xp->xp_attr.xs_wild = (strpbrk(a, "*?[\\") != NULL);
+	xp->xp_attr.xs_recurse = recurse;
     }
-    return 0;
-} /* xpath_exec */
-
+    if (pe)
+	if (xpath_compile_pred(xp, pe) < 0)
+	    goto err;
+    return xp;
+  err:
+    if (xp->xp_steps)
+	free(xp->xp_steps);
+    if (xp->xp_buf)
+	free(xp->xp_buf);
+    free(xp);
+    return NULL;
+}
 
-/*
- * intermediate function to handle the 'or' case. For example: 
- * xpath = //a | //b. xpath_first+ splits xpath up in several subcalls
- * (eg xpath=//a and xpath=//b) and collects the results.
- * Note: if a match is found in both, two (or more) same results will be 
- * returned.
- * Note, this could be 'folded' into xpath1 but I judged it too complex.
+/*! Compile an xpath expression into a plan that can be evaluated many times
+ *
+ * The expression is tokenized once into a union of paths, each with steps, 
+ * optional trailing attribute and optional trailing predicate.
+ * See the beginning of this file for the supported subset.
+ * @param[in]  xpath  String with XPATH syntax
+ * @retval     xc     Compiled xpath. Free with xpath_plan_free()
+ * @retval     NULL   Error, eg malformed predicate
+ *
+ * @code
+ *   xpath_plan   *xc;
+ *   xpath_cursor *xcur;
+ *   cxobj        *x;
+ *   if ((xc = xpath_compile("//symbol/foo")) == NULL)
+ *      err;
+ *   if ((xcur = xpath_cursor_open(xtop, xc)) == NULL)
+ *      err;
+ *   while ((x = xpath_cursor_next(xcur)) != NULL) {
+ *      ...
+ *   }
+ *   xpath_cursor_close(xcur);
+ *   xpath_plan_free(xc);
+ * @endcode
+ * @see xpath_plan_first, xpath_plan_vec
  */
-static cxobj **
-xpath_internal(cxobj *cxtop, char *xpath0, int *vec_len00)
+xpath_plan *
+xpath_compile(char *xpath)
 {
-    char             *s0;
-    char             *s1;
-    char             *s2;
-    char             *xpath;
-    cxobj           **vec0 = NULL;
-    int               vec_len0;
-    searchvec        *sv;
-
-    if ((sv = malloc(sizeof *sv)) == NULL){
+    xpath_plan         *xc;
+    struct xpath_path **xpp;
+    char               *s0;
+    char               *s1;
+    char               *s2;
+
+    if ((xc = malloc(sizeof(*xc))) == NULL){
 	clicon_err(OE_XML, errno, "%s: malloc", __FUNCTION__);
 	return NULL;
     }
-    vec_len0 = 0;
-    if ((s0 = strdup(xpath0)) == NULL){
+    memset(xc, 0, sizeof(*xc));
+    if ((s0 = strdup(xpath)) == NULL){
 	clicon_err(OE_XML, errno, "%s: strdup", __FUNCTION__);
+	free(xc);
 	return NULL;
     }
-    s2 = s1 = s0;
-    memset(sv, 0, sizeof(*sv));
-    sv->sv_max = XPATH_VEC_START;
+    xpp = &xc->xc_paths;
+    s1 = s0;
     while (s1 != NULL){
-	s2 = strstr(s1, " | ");
-	if (s2 != NULL){
+	if ((s2 = strstr(s1, " | ")) != NULL){
 	    *s2 = '\0'; /* terminate xpath */
 	    s2 += 3;
 	}
-	xpath = s1;
+	if ((*xpp = xpath_compile_path(s1)) == NULL){
+	    xpath_plan_free(xc);
+	    xc = NULL;
+	    break;
+	}
+	xpp = &(*xpp)->xp_next;
 	s1 = s2;
-	if (xpath_exec(cxtop, xpath, sv) < 0)
-	    goto done;
-	if (sv->sv_v0len > 0){
-	    vec_len0 += sv->sv_v0len;
-	    if ((vec0 = realloc(vec0, sizeof(cxobj *) * vec_len0)) == NULL){	
-		clicon_err(OE_XML, errno, "%s: realloc", __FUNCTION__);
-		goto done;
+    }
+    free(s0);
+    return xc;
+}
+
+/*! Free a compiled xpath */
+void
+xpath_plan_free(xpath_plan *xc)
+{
+    struct xpath_path *xp;
+
+    while ((xp = xc->xc_paths) != NULL){
+	xc->xc_paths = xp->xp_next;
+	if (xp->xp_steps)
+	    free(xp->xp_steps);
+	free(xp->xp_buf);
+	free(xp);
+    }
+    free(xc);
+}
+
+/*! Get names of the top-level nodes all matches of a compiled xpath are under
+ *
+ * If every path of the xpath starts with a step with a fixed name (eg /a/b but
+ * not //a or /a*), all matches are in the subtrees of the children of the top
+ * node with those names. This can be used to only read those parts of a tree.
+ * @param[in]  xc    Compiled xpath, see xpath_compile()
+ * @param[out] vec   Vector of names, pointing into xc. Free vector with free()
+ * @param[out] len   Length of vec
+ * @retval     1     All matches are under the names in vec (may be empty)
+ * @retval     0     No such names, whole tree must be searched. vec is NULL.
+ * @retval    -1     Error
+ */
+int
+xpath_plan_roots(xpath_plan *xc, 
+		 char     ***vec, 
+		 int        *len)
+{
+    struct xpath_path *xp;
+    char             **v = NULL;
+    int                n = 0;
+    int                i;
+
+    *vec = NULL;
+    *len = 0;
+    for (xp = xc->xc_paths; xp; xp = xp->xp_next)
+	n++;
+    if ((v = calloc(n+1, sizeof(char*))) == NULL){
+	clicon_err(OE_XML, errno, "%s: calloc", __FUNCTION__);
+	return -1;
+    }
+    n = 0;
+    for (xp = xc->xc_paths; xp; xp = xp->xp_next){
+	if (xp->xp_empty) /* Cannot match anything */
+	    continue;
+	if (xp->xp_nsteps == 0 || 
+	    xp->xp_steps[0].xs_recurse || xp->xp_steps[0].xs_wild){
+	    free(v);
+	    return 0;
+	}
+	for (i=0; i<n; i++)
+	    if (strcmp(v[i], xp->xp_steps[0].xs_name) == 0)
+		break;
+	if (i == n)
+	    v[n++] = xp->xp_steps[0].xs_name;
+    }
+    *vec = v;
+    *len = n;
+    return 1;
+}
+
+/*! Evaluate one compiled path and append matching nodes to a vector
+ * @param[in]     xtop   xml-tree where to search
+ * @param[in]     xp     Compiled path
+ * @param[in]     first  Only the first match is needed
+ * @param[in,out] res    Matching nodes are appended here
+ */
+static int
+xpath_path_eval(cxobj             *xtop, 
+		struct xpath_path *xp, 
+		int                first,
+		struct xvec       *res)
+{
+    int                retval = -1;
+    struct xvec        v0 = {NULL, 0, 0};
+    struct xvec        v1 = {NULL, 0, 0};
+    struct xvec        vtmp;
+    struct xpath_step *xs;
+    cxobj             *xn;
+    cxobj             *xc;
+    char              *val;
+    int                limit = 0;
+    int                i;
+    int                j;
+
+    if (xp->xp_empty)
+	return 0;
+    if (xvec_add(&v0, xtop) < 0)
+	goto done;
+    for (i=0; i<xp->xp_nsteps && v0.xv_len; i++){
+	xs = &xp->xp_steps[i];
+	if (first && i == xp->xp_nsteps-1 && 
+	    xp->xp_attr.xs_name == NULL && xp->xp_pred == XP_PRED_NONE)
+	    limit = 1;
+	v1.xv_len = 0;
+	for (j=0; j<v0.xv_len; j++){
+	    xn = v0.xv_vec[j];
+	    if (xs->xs_recurse){
+		if (recursive_find(xn, xs, CX_ELMNT, &v1, limit) < 0)
+		    goto done;
+	    }
+	    else{
+		xc = NULL;
+		while ((xc = xml_child_each(xn, xc, CX_ELMNT)) != NULL) 
+		    if (xpath_step_match(xs, xc)){
+			if (xvec_add(&v1, xc) < 0)
+			    goto done;
+			if (limit && v1.xv_len >= limit)
+			    break;
+		    }
 	    }
-	    memcpy(vec0+vec_len0-sv->sv_v0len, 
-		   sv->sv_v0, 
-		   sv->sv_v0len*sizeof(cxobj *));
+	    if (limit && v1.xv_len >= limit)
+		break;
 	}
-	if (sv->sv_v0)
-	    free(sv->sv_v0);
-	memset(sv, 0, sizeof(*sv));
-	sv->sv_max = XPATH_VEC_START;
+	vtmp = v0; v0 = v1; v1 = vtmp;
     }
+    if (xp->xp_attr.xs_name){
+	v1.xv_len = 0;
+	for (j=0; j<v0.xv_len; j++){
+	    xn = v0.xv_vec[j];
+	    if (xp->xp_attr.xs_recurse){
+		if (recursive_find(xn, &xp->xp_attr, CX_ATTR, &v1, 0) < 0)
+		    goto done;
+	    }
+	    else{
+		xc = xml_find(xn, xp->xp_attr.xs_name);
+		if (xc && xml_type(xc) == CX_ATTR)
+		    if (xvec_add(&v1, xc) < 0)
+			goto done;
+	    }
+	}
+	vtmp = v0; v0 = v1; v1 = vtmp;
+    }
+    switch (xp->xp_pred){
+    case XP_PRED_NONE:
+	for (j=0; j<v0.xv_len; j++)
+	    if (xvec_add(res, v0.xv_vec[j]) < 0)
+		goto done;
+	break;
+    case XP_PRED_INDEX:
+	if (xp->xp_pred_index >= 0 && xp->xp_pred_index < v0.xv_len)
+	    if (xvec_add(res, v0.xv_vec[xp->xp_pred_index]) < 0)
+		goto done;
+	break;
+    case XP_PRED_ATTR:
+	for (j=0; j<v0.xv_len; j++){
+	    xn = v0.xv_vec[j];
+	    if ((xc = xml_find(xn, xp->xp_pred_name)) != NULL &&
+		xml_type(xc) == CX_ATTR &&
+		(xp->xp_pred_val == NULL || 
+		 strcmp(xml_value(xc), xp->xp_pred_val) == 0))
+		if (xvec_add(res, xn) < 0)
+		    goto done;
+	}
+	break;
+    case XP_PRED_CHILD:
+	for (j=0; j<v0.xv_len; j++){
+	    xn = v0.xv_vec[j];
+	    if ((xc = xml_find(xn, xp->xp_pred_name)) != NULL &&
+		xml_type(xc) == CX_ELMNT &&
+		(val = xml_body(xc)) != NULL &&
+		strcmp(val, xp->xp_pred_val) == 0)
+		if (xvec_add(res, xn) < 0)
+		    goto done;
+	}
+	break;
+    }
+    retval = 0;
   done:
-    if (sv){
-	if (sv->sv_v1)
-	    free(sv->sv_v1);
-	if (sv->sv_v0)
-	    free(sv->sv_v0);
-	free(sv);
+    if (v0.xv_vec)
+	free(v0.xv_vec);
+    if (v1.xv_vec)
+	free(v1.xv_vec);
+    return retval;
+}
+
+/*! Evaluate all paths of a compiled xpath (the 'or' case)
+ * Note: if a match is found in several paths, two (or more) same results 
+ * will be returned.
+ */
+static int
+xpath_plan_eval(cxobj       *xtop, 
+		xpath_plan  *xc,
+		int          first,
+		struct xvec *res)
+{
+    struct xpath_path *xp;
+
+    for (xp = xc->xc_paths; xp; xp = xp->xp_next){
+	if (xpath_path_eval(xtop, xp, first, res) < 0)
+	    return -1;
+	if (first && res->xv_len)
+	    break;
     }
-    if (s0)
-	free(s0);
-    *vec_len00 = vec_len0;
-    return vec0;
+    return 0;
+}
+
+/*! Return first match of a compiled xpath
+ * @param[in]  xtop  xml-tree where to search
+ * @param[in]  xc    Compiled xpath, see xpath_compile()
+ * @retval     xml-tree of first match, or NULL on error or no match. 
+ * Only searches until the first match is found.
+ */
+cxobj *
+xpath_plan_first(cxobj      *xtop, 
+		 xpath_plan *xc)
+{
+    struct xvec xv = {NULL, 0, 0};
+    cxobj      *xn = NULL;
+
+    if (xpath_plan_eval(xtop, xc, 1, &xv) == 0 && xv.xv_len)
+	xn = xv.xv_vec[0];
+    if (xv.xv_vec)
+	free(xv.xv_vec);
+    return xn;
+}
+
+/*! Return vector of matches of a compiled xpath
+ * @param[in]  xtop    xml-tree where to search
+ * @param[in]  xc      Compiled xpath, see xpath_compile()
+ * @param[out] xv_len  Length of vector in return value
+ * @retval   vector of xml-trees, or NULL on error or no match. 
+ * Vector must be free():d after use
+ */
+cxobj **
+xpath_plan_vec(cxobj      *xtop, 
+	       xpath_plan *xc, 
+	       int        *xv_len)
+{
+    struct xvec xv = {NULL, 0, 0};
+
+    if (xpath_plan_eval(xtop, xc, 0, &xv) < 0 || xv.xv_len == 0){
+	if (xv.xv_vec)
+	    free(xv.xv_vec);
+	xv.xv_vec = NULL;
+	xv.xv_len = 0;
+    }
+    *xv_len = xv.xv_len;
+    return xv.xv_vec;
+}
+
+/*! Open a cursor over the matches of a compiled xpath
+ *
+ * A cursor has no hidden state, several cursors may be open at the same time
+ * on the same or different compiled xpaths.
+ * @param[in]  xtop  xml-tree where to search
+ * @param[in]  xc    Compiled xpath, see xpath_compile()
+ * @retval     xcur  Cursor, iterate with xpath_cursor_next() and close with
+ *                   xpath_cursor_close()
+ * @retval     NULL  Error
+ */
+xpath_cursor *
+xpath_cursor_open(cxobj      *xtop, 
+		  xpath_plan *xc)
+{
+    xpath_cursor *xcur;
+
+    if ((xcur = malloc(sizeof(*xcur))) == NULL){
+	clicon_err(OE_XML, errno, "%s: malloc", __FUNCTION__);
+	return NULL;
+    }
+    memset(xcur, 0, sizeof(*xcur));
+    if (xpath_plan_eval(xtop, xc, 0, &xcur->xc_vec) < 0){
+	xpath_cursor_close(xcur);
+	return NULL;
+    }
+    return xcur;
+}
+
+/*! Return next match of a cursor, or NULL when there are no more */
+cxobj *
+xpath_cursor_next(xpath_cursor *xcur)
+{
+    if (xcur->xc_i >= xcur->xc_vec.xv_len)
+	return NULL;
+    return xcur->xc_vec.xv_vec[xcur->xc_i++];
+}
+
+/*! Close a cursor opened with xpath_cursor_open() */
+void
+xpath_cursor_close(xpath_cursor *xcur)
+{
+    if (xcur->xc_vec.xv_vec)
+	free(xcur->xc_vec.xv_vec);
+    free(xcur);
 }
 
 /*! A restricted xpath function where the first matching entry is returned
@@ -464,26 +699,21 @@ xpath_internal(cxobj *cxtop, char *xpath0, int *vec_len00)
  * @endcode
  * Note that the returned pointer points into the original tree so should not be freed
  * after use.
+ * If the same xpath is used repeatedly, compile it once with xpath_compile()
+ * and use xpath_plan_first() instead.
  * @see also xpath_vec.
  */
 cxobj *
 xpath_first(cxobj *cxtop, char *xpath)
 {
-    cxobj **vec0;
-    int vec0_len = 0;
-    cxobj *xn = NULL;
+    xpath_plan *xc;
+    cxobj      *xn;
 
-    if ((vec0 = xpath_internal(cxtop, xpath, &vec0_len)) == NULL)
-	goto done;
-    if (vec0_len)
-	xn = vec0[0];
-    else
-	xn = NULL;
-  done:
-    if (vec0)
-	free(vec0);
+    if ((xc = xpath_compile(xpath)) == NULL)
+	return NULL;
+    xn = xpath_plan_first(cxtop, xc);
+    xpath_plan_free(xc);
     return xn;
-
 }
 
 /*! A restricted xpath iterator that loops over all matching entries. Dont use.
@@ -504,40 +734,33 @@ xpath_first(cxobj *cxtop, char *xpath)
  * Note that the returned pointer points into the original tree so should not be freed
  * after use.
  * @see also xpath, xpath_vec.
- * NOTE: uses a static variable: consider replacing with xpath_vec() instead
+ * NOTE: uses a static variable, so only one iteration can be active at a time.
+ * Use xpath_cursor_open() instead.
  */
 cxobj *
 xpath_each(cxobj *cxtop, char *xpath, cxobj *xprev)
 {
-    static    cxobj **vec0 = NULL; /* XXX */
-    static int        vec0_len = 0;
-    cxobj            *xn = NULL;
-    int i;
+    static cxobj **vec0 = NULL; /* XXX */
+    static int     vec0_len = 0;
+    static int     vec0_i = 0;  /* Index of xprev in vec0 */
+    int            i;
     
     if (xprev == NULL){
-	if (vec0) // XXX
-	    free(vec0); // XXX
-	vec0_len = 0;
-	if ((vec0 = xpath_internal(cxtop, xpath, &vec0_len)) == NULL)
-	    goto done;
+	if (vec0)
+	    free(vec0);
+	vec0_i = -1;
+	if ((vec0 = xpath_vec(cxtop, xpath, &vec0_len)) == NULL)
+	    return NULL;
     }
-    if (vec0_len){
-	if (xprev==NULL)
-	    xn = vec0[0];
-	else{
-	    for (i=0; i<vec0_len; i++)
-		if (vec0[i] == xprev)
-		    break;
-	    if (i>=vec0_len-1)
-		xn = NULL; 
-	    else
-		xn = vec0[i+1];
-	}
+    else if (vec0_i < 0 || vec0_i >= vec0_len || vec0[vec0_i] != xprev){
+	for (i=0; i<vec0_len; i++)
+	    if (vec0[i] == xprev)
+		break;
+	vec0_i = i;
     }
-    else
-	xn = NULL;
-  done:
-    return xn;
+    if (++vec0_i >= vec0_len)
+	return NULL;
+    return vec0[vec0_i];
 }
 
 /*! A restricted xpath that returns a vector of macthes
@@ -566,7 +789,15 @@ xpath_each(cxobj *cxtop, char *xpath, cxobj *xprev)
 cxobj **
 xpath_vec(cxobj *cxtop, char *xpath, int *xv_len)
 {
-    return xpath_internal(cxtop, xpath, xv_len);
+    xpath_plan *xc;
+    cxobj     **xv;
+
+    *xv_len = 0;
+    if ((xc = xpath_compile(xpath)) == NULL)
+	return NULL;
+    xv = xpath_plan_vec(cxtop, xc, xv_len);
+    xpath_plan_free(xc);
+    return xv;
 }
 
 /*